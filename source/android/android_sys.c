@@ -308,6 +308,12 @@ int Sys_GetCurrentProcessId( void )
 	return getpid();
 }
 
+int Sys_GetNumberOfProcessors( void )
+{
+	long n = sysconf( _SC_NPROCESSORS_ONLN );
+	return n > 0 ? (int)n : 1;
+}
+
 void Sys_Quit( void )
 {
 	Qcommon_Shutdown();
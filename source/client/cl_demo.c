@@ -106,6 +106,10 @@ void CL_Stop_f( void )
 	cls.demo.filename = NULL;
 	cls.demo.name = NULL;
 	cls.demo.recording = false;
+
+	// back to bit-packed snapshots
+	if( cls.sv_bitpacking && cl_snapbitpacking->integer && cls.state >= CA_CONNECTED )
+		CL_AddReliableCommand( "bitpacking 1" );
 }
 
 /*
@@ -188,6 +192,10 @@ void CL_Record_f( void )
 	cls.demo.basetime = cls.demo.duration = cls.demo.time = 0;
 	cls.demo.name = ZoneCopyString( demoname );
 
+	// demos are recorded from the net messages, so they have to be byte-aligned
+	if( cls.sv_bitpacking )
+		CL_AddReliableCommand( "bitpacking 0" );
+
 	// don't start saving messages until a non-delta compressed message is received
 	CL_AddReliableCommand( "nodelta" ); // request non delta compressed frame from server
 	cls.demo.waiting = true;
@@ -204,6 +212,11 @@ void CL_Record_f( void )
 static int demofilehandle;
 static int demofilelen, demofilelentotal;
 
+// seek index from the demo meta data
+static snap_demokeyframe_t demokeyframes[SNAP_MAX_DEMO_KEYFRAMES];
+static unsigned int numdemokeyframes;
+static bool demokeyframesloaded;
+
 /*
 * CL_BeginDemoAviDump
 */
@@ -264,6 +277,8 @@ void CL_DemoCompleted( void )
 		demofilehandle = 0;
 	}
 	demofilelen = demofilelentotal = 0;
+	numdemokeyframes = 0;
+	demokeyframesloaded = false;
 
 	cls.demo.playing = false;
 	cls.demo.basetime = cls.demo.duration = cls.demo.time = 0;
@@ -278,6 +293,8 @@ void CL_DemoCompleted( void )
 
 	Com_Printf( "Demo completed\n" );
 
+	CL_SnapBenchReport();
+
 	memset( &cls.demo, 0, sizeof( cls.demo ) );
 }
 
@@ -343,6 +360,37 @@ void CL_ReadDemoPackets( void )
 	cls.demo.play_jump = false;
 }
 
+/*
+* CL_FindDemoKeyframe
+* 
+* Returns the last keyframe before the given server time, the index is loaded
+* from the meta data on first use
+*/
+static const snap_demokeyframe_t *CL_FindDemoKeyframe( unsigned int serverTime )
+{
+	if( !demokeyframesloaded && cls.demo.meta_data_realsize )
+	{
+		numdemokeyframes = SNAP_ReadDemoMetaKeyframes( cls.demo.meta_data, cls.demo.meta_data_realsize,
+			demokeyframes, SNAP_MAX_DEMO_KEYFRAMES );
+		demokeyframesloaded = true;
+	}
+
+	return SNAP_FindDemoKeyframe( demokeyframes, numdemokeyframes, serverTime );
+}
+
+/*
+* CL_SeekDemo
+* 
+* Continues playback from the given file offset, which must be the start
+* of the demo or a keyframe
+*/
+static void CL_SeekDemo( unsigned int offset )
+{
+	FS_Seek( demofilehandle, offset, FS_SEEK_SET );
+	cl.currentSnapNum = cl.receivedSnapNum = 0;
+	cl.pendingSnapNum = 0;
+}
+
 /*
 * CL_LatchedDemoJump
 * 
@@ -350,6 +398,9 @@ void CL_ReadDemoPackets( void )
 */
 void CL_LatchedDemoJump( void )
 {
+	unsigned int snapTime;
+	const snap_demokeyframe_t *keyframe;
+
 	if( cls.demo.paused || ! cls.demo.play_jump_latched ) {
 		return;
 	}
@@ -361,11 +412,18 @@ void CL_LatchedDemoJump( void )
 
 	CL_AdjustServerTime( 1 );
 
-	if( cl.serverTime < cl.snapShots[cl.receivedSnapNum&UPDATE_MASK].serverTime )
+	snapTime = cl.snapShots[cl.receivedSnapNum&UPDATE_MASK].serverTime;
+	keyframe = CL_FindDemoKeyframe( cl.serverTime );
+
+	if( cl.serverTime < snapTime )
+	{
+		// rewind to the closest keyframe, or all the way back without the index
+		CL_SeekDemo( keyframe ? keyframe->offset : 0 );
+	}
+	else if( keyframe && keyframe->time > snapTime )
 	{
-		demofilelen = demofilelentotal;
-		FS_Seek( demofilehandle, 0, FS_SEEK_SET );
-		cl.currentSnapNum = cl.receivedSnapNum = 0;
+		// skip ahead instead of parsing every message up to the keyframe
+		CL_SeekDemo( keyframe->offset );
 	}
 
 	cls.demo.play_jump = true;
@@ -423,6 +481,8 @@ static void CL_StartDemo( const char *demoname, bool pause_on_stop )
 	memset( &cls.demo, 0, sizeof( cls.demo ) );
 
 	demofilehandle = tempdemofilehandle;
+	numdemokeyframes = 0;
+	demokeyframesloaded = false;
 	demofilelentotal = tempdemofilelen;
 	demofilelen = demofilelentotal;
 
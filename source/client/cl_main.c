@@ -73,6 +73,9 @@ cvar_t *cl_masterservers;
 cvar_t *cl_debug_serverCmd;
 cvar_t *cl_debug_timeDelta;
 
+cvar_t *cl_snapbitpacking;
+cvar_t *cl_snapbench;
+
 cvar_t *cl_downloads;
 cvar_t *cl_downloads_from_web;
 cvar_t *cl_downloads_from_web_timeout;
@@ -902,6 +905,7 @@ void CL_Disconnect( const char *message )
 	cls.connect_time = 0;
 	cls.connect_count = 0;
 	cls.rejected = false;
+	cls.sv_bitpacking = false;	// no point asking for it back when stopping the demo
 
 	if( cls.demo.recording )
 		CL_Stop_f();
@@ -1335,15 +1339,16 @@ static bool CL_ProcessPacket( netchan_t *netchan, msg_t *msg )
 	MSG_BeginReading( msg );
 	MSG_ReadLong( msg ); // sequence
 	MSG_ReadLong( msg ); // sequence_ack
-	if( msg->compressed )
+	zerror = Netchan_DecompressMessage( netchan, msg );
+	if( zerror < 0 )
 	{
-		zerror = Netchan_DecompressMessage( msg );
-		if( zerror < 0 )
-		{
-			// compression error. Drop the packet
-			Com_Printf( "CL_ProcessPacket: Compression error %i. Dropping packet\n", zerror );
-			return false;
-		}
+		// compression error. Drop the packet
+		Com_Printf( "CL_ProcessPacket: Compression error %i. Dropping packet\n", zerror );
+
+		// the following messages were likely compressed against it, have the server start over
+		if( netchan->decompressDict && netchan->dictFailures == 1 )
+			CL_AddReliableCommand( "netdict 1" );
+		return false;
 	}
 
 	return true;
@@ -2119,6 +2124,9 @@ static void CL_InitLocal( void )
 	cl_debug_serverCmd =	Cvar_Get( "cl_debug_serverCmd", "0", CVAR_ARCHIVE|CVAR_CHEAT );
 	cl_debug_timeDelta =	Cvar_Get( "cl_debug_timeDelta", "0", CVAR_ARCHIVE/*|CVAR_CHEAT*/ );
 
+	cl_snapbitpacking =	Cvar_Get( "cl_snapbitpacking", "1", CVAR_ARCHIVE );
+	cl_snapbench =		Cvar_Get( "cl_snapbench", "0", 0 );
+
 	cl_downloads =		Cvar_Get( "cl_downloads", "1", CVAR_ARCHIVE );
 	cl_downloads_from_web =	Cvar_Get( "cl_downloads_from_web", "1", CVAR_ARCHIVE|CVAR_READONLY );
 	cl_downloads_from_web_timeout = Cvar_Get( "cl_downloads_from_web_timeout", "600", CVAR_ARCHIVE );
@@ -2421,7 +2429,7 @@ void CL_Netchan_Transmit( msg_t *msg )
 	// do not enable client compression until I fix the compression+fragmentation rare case bug
 	if( ( cl_compresspackets->integer && msg->cursize > 60 ) || cl_compresspackets->integer > 1 )
 	{
-		zerror = Netchan_CompressMessage( msg );
+		zerror = Netchan_CompressMessage( &cls.netchan, msg );
 		if( zerror < 0 ) // it's compression error, just send uncompressed
 		{
 			Com_DPrintf( "CL_Netchan_Transmit (ignoring compression): Compression error %i\n", zerror );
@@ -2752,6 +2760,9 @@ void CL_Frame( int realmsec, int gamemsec )
 	allGameMsec = 0;
 
 	cls.framecount++;
+
+	// release this frame's scratch memory
+	Mem_ResetFrameArena();
 }
 
 
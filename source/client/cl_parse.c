@@ -1009,6 +1009,18 @@ static void CL_ParseServerData( msg_t *msg )
 	// get the configstrings request
 	CL_AddReliableCommand( va( "configstrings %i 0", cl.servercount ) );
 
+	// ask for bit-packed snapshots if the server supports them, but not into a demo
+	cls.sv_bitpacking = !cls.demo.playing && ( sv_bitflags & SV_BITFLAGS_BITPACKED );
+	if( cls.sv_bitpacking && cl_snapbitpacking->integer && !cls.demo.recording )
+		CL_AddReliableCommand( "bitpacking 1" );
+
+	// keep received packets around and let the server compress against them
+	if( !cls.demo.playing && ( sv_bitflags & SV_BITFLAGS_NETDICT ) )
+	{
+		Netchan_SetDecompressDict( &cls.netchan, true );
+		CL_AddReliableCommand( "netdict 1" );
+	}
+
 	old_sv_pure = cls.sv_pure;
 	cls.sv_pure = ( sv_bitflags & SV_BITFLAGS_PURE ) != 0;
 	cls.pure_restart = cls.sv_pure && old_sv_pure == false;
@@ -1036,6 +1048,132 @@ static void CL_ParseBaseline( msg_t *msg )
 	SNAP_ParseBaseline( msg, cl_baselines );
 }
 
+/*
+=====================================================================
+
+SNAPSHOT ENCODING BENCHMARK
+
+With cl_snapbench set, every snapshot played back from a demo has its
+entities delta encoded again in both the byte-aligned and the bit-packed
+formats, and the average sizes are printed when the demo completes.
+
+=====================================================================
+*/
+
+static struct
+{
+	unsigned snaps;
+	unsigned long long bytes;
+	unsigned long long bitpackedBytes;
+} cl_snapbench_stats;
+
+/*
+* CL_SnapBenchEntity
+*/
+static void CL_SnapBenchEntity( msg_t *msg, msg_t *bitsmsg, int *lastnum, entity_state_t *from, entity_state_t *to, bool force )
+{
+	uint8_t scratch[256];
+	unsigned nbits;
+	msg_t body;
+
+	MSG_WriteDeltaEntity( from, to, msg, force, true );
+
+	MSG_Init( &body, scratch, sizeof( scratch ) );
+	if( !MSG_WriteDeltaEntityBits( from, to, &body, force, true ) )
+		return;
+
+	MSG_WriteEntityNumberBits( bitsmsg, *lastnum, to->number, false );
+	*lastnum = to->number;
+
+	for( nbits = 0; nbits + 8 <= body.writebits; nbits += 8 )
+		MSG_WriteBits( bitsmsg, scratch[nbits >> 3], 8 );
+	if( nbits < body.writebits )
+		MSG_WriteBits( bitsmsg, scratch[nbits >> 3], body.writebits - nbits );
+}
+
+/*
+* CL_SnapBenchFrame
+*/
+static void CL_SnapBenchFrame( snapshot_t *snap )
+{
+	static uint8_t msgbuf[MAX_MSGLEN], bitsmsgbuf[MAX_MSGLEN];
+	msg_t msg, bitsmsg;
+	snapshot_t *oldframe;
+	entity_state_t *oldent, *newent;
+	int oldindex, newindex, oldnum, newnum, old_num_entities, lastnum;
+
+	oldframe = NULL;
+	if( snap->delta && snap->deltaFrameNum > 0 )
+		oldframe = &cl.snapShots[snap->deltaFrameNum & UPDATE_MASK];
+	old_num_entities = oldframe ? oldframe->numEntities : 0;
+
+	MSG_Init( &msg, msgbuf, sizeof( msgbuf ) );
+	MSG_Init( &bitsmsg, bitsmsgbuf, sizeof( bitsmsgbuf ) );
+
+	lastnum = 0;
+	oldindex = newindex = 0;
+	while( newindex < snap->numEntities || oldindex < old_num_entities )
+	{
+		newent = newindex < snap->numEntities ? &snap->parsedEntities[newindex & ( MAX_PARSE_ENTITIES-1 )] : NULL;
+		oldent = oldindex < old_num_entities ? &oldframe->parsedEntities[oldindex & ( MAX_PARSE_ENTITIES-1 )] : NULL;
+		newnum = newent ? newent->number : 9999;
+		oldnum = oldent ? oldent->number : 9999;
+
+		if( newnum == oldnum )
+		{
+			CL_SnapBenchEntity( &msg, &bitsmsg, &lastnum, oldent, newent, false );
+			oldindex++;
+			newindex++;
+		}
+		else if( newnum < oldnum )
+		{
+			CL_SnapBenchEntity( &msg, &bitsmsg, &lastnum, &cl_baselines[newnum], newent, true );
+			newindex++;
+		}
+		else
+		{
+			if( oldnum >= 256 )
+			{
+				MSG_WriteByte( &msg, ( U_REMOVE|U_MOREBITS1 )&255 );
+				MSG_WriteByte( &msg, ( U_NUMBER16>>8 )&255 );
+				MSG_WriteShort( &msg, oldnum );
+			}
+			else
+			{
+				MSG_WriteByte( &msg, U_REMOVE );
+				MSG_WriteByte( &msg, oldnum );
+			}
+			MSG_WriteEntityNumberBits( &bitsmsg, lastnum, oldnum, true );
+			lastnum = oldnum;
+			oldindex++;
+		}
+	}
+
+	MSG_WriteShort( &msg, 0 );
+	MSG_WriteEntityNumberBits( &bitsmsg, lastnum, 0, false );
+
+	cl_snapbench_stats.snaps++;
+	cl_snapbench_stats.bytes += msg.cursize;
+	cl_snapbench_stats.bitpackedBytes += bitsmsg.cursize;
+}
+
+/*
+* CL_SnapBenchReport
+*/
+void CL_SnapBenchReport( void )
+{
+	if( !cl_snapbench_stats.snaps )
+		return;
+
+	Com_Printf( "Snapshot entities: %u snapshots, %.1f bytes/snap byte-aligned, %.1f bytes/snap bit-packed (%.1f%%)\n",
+		cl_snapbench_stats.snaps,
+		(double)cl_snapbench_stats.bytes / cl_snapbench_stats.snaps,
+		(double)cl_snapbench_stats.bitpackedBytes / cl_snapbench_stats.snaps,
+		cl_snapbench_stats.bytes ? 100.0 * cl_snapbench_stats.bitpackedBytes / cl_snapbench_stats.bytes : 100.0 );
+
+	memset( &cl_snapbench_stats, 0, sizeof( cl_snapbench_stats ) );
+}
+
 /*
 * CL_ParseFrame
 */
@@ -1043,17 +1181,22 @@ static void CL_ParseFrame( msg_t *msg )
 {
 	snapshot_t *snap, *oldSnap;
 	int delta;
+	bool bitpacked;
 
 	oldSnap = ( cl.receivedSnapNum > 0 ) ? &cl.snapShots[cl.receivedSnapNum & UPDATE_MASK] : NULL;
 
-	snap = SNAP_ParseFrame( msg, oldSnap, &cl.suppressCount, cl.snapShots, cl_baselines, cl_shownet->integer );
+	snap = SNAP_ParseFrame( msg, oldSnap, &cl.suppressCount, cl.snapShots, cl_baselines, cl_shownet->integer, &bitpacked );
 	if( snap->valid )
 	{
+		if( cls.demo.playing && cl_snapbench->integer )
+			CL_SnapBenchFrame( snap );
+
 		cl.receivedSnapNum = snap->serverFrame;
 
 		if( cls.demo.recording )
 		{
-			if( cls.demo.waiting && !snap->delta )
+			// demos keep the byte-aligned format, see CL_Record_f
+			if( cls.demo.waiting && !snap->delta && !bitpacked )
 			{
 				cls.demo.waiting = false; // we can start recording now
 				cls.demo.basetime = snap->serverTime;
@@ -1193,6 +1336,10 @@ static void CL_UpdateConfigString( int idx, const char *s )
 		return;
 	}
 
+	// demo keyframes repeat all configstrings, only pass on the ones that actually change
+	if( cls.demo.playing && !strncmp( cl.configstrings[idx], s, sizeof( cl.configstrings[idx] ) - 1 ) )
+		return;
+
 	Q_strncpyz( cl.configstrings[idx], s, sizeof( cl.configstrings[idx] ) );
 
 	// allow cgame to update it too
@@ -296,6 +296,7 @@ typedef struct
 	// pure list
 	bool sv_pure;
 	bool sv_tv;
+	bool sv_bitpacking;         // the server can send bit-packed snapshots
 	bool pure_restart;
 
 	purelist_t *purelist;
@@ -349,6 +350,9 @@ extern cvar_t *cl_demoavi_scissor;
 extern cvar_t *cl_debug_serverCmd;
 extern cvar_t *cl_debug_timeDelta;
 
+extern cvar_t *cl_snapbitpacking;
+extern cvar_t *cl_snapbench;
+
 extern cvar_t *cl_downloads;
 extern cvar_t *cl_downloads_from_web;
 extern cvar_t *cl_downloads_from_web_timeout;
@@ -576,6 +580,7 @@ char **CL_DemoComplete( const char *partial );
 // cl_parse.c
 //
 void CL_ParseServerMessage( msg_t *msg );
+void CL_SnapBenchReport( void );
 #define SHOWNET(msg,s) _SHOWNET(msg,s,cl_shownet->integer);
 
 void CL_FreeDownloadList( void );
@@ -0,0 +1,507 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+// dt_decode.c -- decodes a single demo into column blocks
+
+#include "dt_local.h"
+
+#include <setjmp.h>
+
+#define DT_MAX_AREABYTES	255		// areabits length is sent as a byte
+
+enum
+{
+	DT_SRC_INT,
+	DT_SRC_BYTE,
+	DT_SRC_FLOAT
+};
+
+typedef struct
+{
+	const char *name;
+	int table;
+	int type;
+	int srctype;
+	size_t offset;
+} dt_column_t;
+
+#define DT_FRAME( name, type, src, field )	{ name, DT_TABLE_FRAME, type, src, offsetof( snapshot_t, field ) }
+#define DT_ENT( name, type, src, field )	{ name, DT_TABLE_ENTITY, type, src, offsetof( entity_state_t, field ) }
+#define DT_PLR( name, type, src, field )	{ name, DT_TABLE_PLAYER, type, src, offsetof( player_state_t, field ) }
+
+static const dt_column_t dt_columns[] =
+{
+	DT_FRAME( "serverTime", DT_TYPE_I32, DT_SRC_INT, serverTime ),
+	DT_FRAME( "serverFrame", DT_TYPE_I32, DT_SRC_INT, serverFrame ),
+	DT_FRAME( "numentities", DT_TYPE_U16, DT_SRC_INT, numEntities ),
+	DT_FRAME( "numplayers", DT_TYPE_U16, DT_SRC_INT, numplayers ),
+
+	DT_ENT( "number", DT_TYPE_U16, DT_SRC_INT, number ),
+	DT_ENT( "type", DT_TYPE_U8, DT_SRC_INT, type ),
+	DT_ENT( "modelindex", DT_TYPE_U16, DT_SRC_INT, modelindex ),
+	DT_ENT( "team", DT_TYPE_U8, DT_SRC_INT, team ),
+	DT_ENT( "weapon", DT_TYPE_U8, DT_SRC_INT, weapon ),
+	DT_ENT( "effects", DT_TYPE_I32, DT_SRC_INT, effects ),
+	DT_ENT( "solid", DT_TYPE_I32, DT_SRC_INT, solid ),
+	DT_ENT( "origin_x", DT_TYPE_F32, DT_SRC_FLOAT, origin[0] ),
+	DT_ENT( "origin_y", DT_TYPE_F32, DT_SRC_FLOAT, origin[1] ),
+	DT_ENT( "origin_z", DT_TYPE_F32, DT_SRC_FLOAT, origin[2] ),
+	DT_ENT( "angles_x", DT_TYPE_F32, DT_SRC_FLOAT, angles[0] ),
+	DT_ENT( "angles_y", DT_TYPE_F32, DT_SRC_FLOAT, angles[1] ),
+	DT_ENT( "angles_z", DT_TYPE_F32, DT_SRC_FLOAT, angles[2] ),
+	DT_ENT( "event0", DT_TYPE_U8, DT_SRC_INT, events[0] ),
+	DT_ENT( "event1", DT_TYPE_U8, DT_SRC_INT, events[1] ),
+
+	DT_PLR( "playerNum", DT_TYPE_U8, DT_SRC_INT, playerNum ),
+	DT_PLR( "POVnum", DT_TYPE_U16, DT_SRC_INT, POVnum ),
+	DT_PLR( "pm_type", DT_TYPE_U8, DT_SRC_INT, pmove.pm_type ),
+	DT_PLR( "pm_flags", DT_TYPE_U16, DT_SRC_INT, pmove.pm_flags ),
+	DT_PLR( "origin_x", DT_TYPE_F32, DT_SRC_FLOAT, pmove.origin[0] ),
+	DT_PLR( "origin_y", DT_TYPE_F32, DT_SRC_FLOAT, pmove.origin[1] ),
+	DT_PLR( "origin_z", DT_TYPE_F32, DT_SRC_FLOAT, pmove.origin[2] ),
+	DT_PLR( "velocity_x", DT_TYPE_F32, DT_SRC_FLOAT, pmove.velocity[0] ),
+	DT_PLR( "velocity_y", DT_TYPE_F32, DT_SRC_FLOAT, pmove.velocity[1] ),
+	DT_PLR( "velocity_z", DT_TYPE_F32, DT_SRC_FLOAT, pmove.velocity[2] ),
+	DT_PLR( "viewangles_x", DT_TYPE_F32, DT_SRC_FLOAT, viewangles[0] ),
+	DT_PLR( "viewangles_y", DT_TYPE_F32, DT_SRC_FLOAT, viewangles[1] ),
+	DT_PLR( "viewangles_z", DT_TYPE_F32, DT_SRC_FLOAT, viewangles[2] ),
+	DT_PLR( "weaponState", DT_TYPE_U8, DT_SRC_BYTE, weaponState ),
+	DT_PLR( "plrkeys", DT_TYPE_U8, DT_SRC_BYTE, plrkeys ),
+};
+
+#define DT_NUM_COLUMNS	( sizeof( dt_columns ) / sizeof( dt_columns[0] ) )
+
+/*
+=========================================================================
+
+COLUMN OUTPUT
+
+=========================================================================
+*/
+
+/*
+* DT_AppendColumnData
+*/
+static void DT_AppendColumnData( dt_columnbuf_t *buf, const void *data, size_t size )
+{
+	if( buf->size + size > buf->maxsize )
+	{
+		buf->maxsize = max( buf->maxsize * 2, buf->size + size );
+		if( buf->data )
+			buf->data = Mem_Realloc( buf->data, buf->maxsize );
+		else
+			buf->data = Mem_ZoneMallocExt( buf->maxsize, 0 );
+	}
+
+	memcpy( buf->data + buf->size, data, size );
+	buf->size += size;
+}
+
+/*
+* DT_AppendColumnValue
+*/
+static void DT_AppendColumnValue( dt_columnbuf_t *buf, const dt_column_t *col, const uint8_t *base )
+{
+	int ival;
+	float fval;
+	uint8_t b;
+	short s;
+	const uint8_t *src = base + col->offset;
+
+	switch( col->srctype )
+	{
+	case DT_SRC_BYTE:
+		ival = *src;
+		fval = ival;
+		break;
+	case DT_SRC_FLOAT:
+		fval = *( const vec_t * )src;
+		ival = (int)fval;
+		break;
+	default:
+		ival = *( const int * )src;
+		fval = ival;
+		break;
+	}
+
+	switch( col->type )
+	{
+	case DT_TYPE_U8:
+		b = (uint8_t)ival;
+		DT_AppendColumnData( buf, &b, 1 );
+		break;
+	case DT_TYPE_U16:
+		s = LittleShort( (short)ival );
+		DT_AppendColumnData( buf, &s, 2 );
+		break;
+	case DT_TYPE_F32:
+		fval = LittleFloat( fval );
+		DT_AppendColumnData( buf, &fval, 4 );
+		break;
+	default:
+		ival = LittleLong( ival );
+		DT_AppendColumnData( buf, &ival, 4 );
+		break;
+	}
+}
+
+/*
+* DT_AppendRow
+*/
+static void DT_AppendRow( dt_worker_t *worker, int table, const void *row )
+{
+	unsigned int i;
+
+	for( i = 0; i < DT_NUM_COLUMNS; i++ )
+	{
+		if( dt_columns[i].table == table )
+			DT_AppendColumnValue( &worker->columns[i], &dt_columns[i], row );
+	}
+	worker->rows[table]++;
+}
+
+/*
+* DT_WriteInt
+*/
+static void DT_WriteInt( int file, int i )
+{
+	i = LittleLong( i );
+	FS_Write( &i, 4, file );
+}
+
+/*
+* DT_WriteHeader
+*/
+static void DT_WriteHeader( dt_worker_t *worker, unsigned int snapFrameTime, const char *levelname )
+{
+	unsigned int i;
+	uint8_t b;
+
+	FS_Write( DT_FILE_MAGIC, 4, worker->outfile );
+	DT_WriteInt( worker->outfile, DT_FILE_VERSION );
+	DT_WriteInt( worker->outfile, snapFrameTime );
+	FS_Write( levelname, strlen( levelname ) + 1, worker->outfile );
+
+	b = DT_NUM_COLUMNS;
+	FS_Write( &b, 1, worker->outfile );
+	for( i = 0; i < DT_NUM_COLUMNS; i++ )
+	{
+		b = dt_columns[i].table;
+		FS_Write( &b, 1, worker->outfile );
+		b = dt_columns[i].type;
+		FS_Write( &b, 1, worker->outfile );
+		FS_Write( dt_columns[i].name, strlen( dt_columns[i].name ) + 1, worker->outfile );
+	}
+
+	worker->header = true;
+}
+
+/*
+* DT_FlushBlock
+*/
+static void DT_FlushBlock( dt_worker_t *worker )
+{
+	unsigned int i;
+
+	if( !worker->rows[DT_TABLE_FRAME] )
+		return;
+
+	DT_WriteInt( worker->outfile, worker->rows[DT_TABLE_FRAME] );
+	DT_WriteInt( worker->outfile, worker->rows[DT_TABLE_ENTITY] );
+	DT_WriteInt( worker->outfile, worker->rows[DT_TABLE_PLAYER] );
+
+	for( i = 0; i < DT_NUM_COLUMNS; i++ )
+	{
+		FS_Write( worker->columns[i].data, worker->columns[i].size, worker->outfile );
+		worker->columns[i].size = 0;
+	}
+
+	memset( worker->rows, 0, sizeof( worker->rows ) );
+}
+
+/*
+=========================================================================
+
+DEMO PARSING
+
+=========================================================================
+*/
+
+/*
+* DT_ParseServerData
+*/
+static void DT_ParseServerData( dt_worker_t *worker, msg_t *msg )
+{
+	int i, numpure;
+	unsigned int snapFrameTime;
+	int sv_bitflags;
+	char levelname[MAX_QPATH];
+
+	i = MSG_ReadLong( msg );
+	if( i != APP_PROTOCOL_VERSION && i != APP_DEMO_PROTOCOL_VERSION )
+		Com_Error( ERR_DROP, "Demo has protocol version %i, not %i", i, APP_DEMO_PROTOCOL_VERSION );
+
+	MSG_ReadLong( msg ); // servercount
+	snapFrameTime = (unsigned int)MSG_ReadShort( msg );
+	MSG_ReadString( msg ); // basegame
+	MSG_ReadString( msg ); // game
+	MSG_ReadShort( msg ); // playernum
+	Q_strncpyz( levelname, MSG_ReadString( msg ), sizeof( levelname ) );
+
+	sv_bitflags = MSG_ReadByte( msg );
+	worker->reliable = ( sv_bitflags & SV_BITFLAGS_RELIABLE ) ? true : false;
+	if( sv_bitflags & SV_BITFLAGS_HTTP )
+	{
+		if( sv_bitflags & SV_BITFLAGS_HTTP_BASEURL )
+			MSG_ReadString( msg );
+		else
+			MSG_ReadShort( msg );
+	}
+
+	numpure = MSG_ReadShort( msg );
+	while( numpure-- > 0 )
+	{
+		MSG_ReadString( msg );
+		MSG_ReadLong( msg );
+	}
+
+	// a new gamestate, older frames can't be delta decompressed against
+	for( i = 0; i < UPDATE_BACKUP; i++ )
+		worker->snapshots[i].valid = false;
+	worker->lastFrame = NULL;
+
+	if( !worker->header )
+		DT_WriteHeader( worker, snapFrameTime, levelname );
+}
+
+/*
+* DT_ParseFrame
+*/
+static void DT_ParseFrame( dt_worker_t *worker, msg_t *msg )
+{
+	int i;
+	snapshot_t *frame;
+
+	if( !worker->header )
+		Com_Error( ERR_DROP, "Frame before serverdata" );
+
+	frame = SNAP_ParseFrame( msg, worker->lastFrame, NULL, worker->snapshots, worker->baselines, 0, NULL );
+	if( !frame->valid )
+		return;
+
+	worker->lastFrame = frame;
+	worker->snapshots_decoded++;
+
+	DT_AppendRow( worker, DT_TABLE_FRAME, frame );
+	for( i = 0; i < frame->numEntities; i++ )
+		DT_AppendRow( worker, DT_TABLE_ENTITY, &frame->parsedEntities[i & ( MAX_PARSE_ENTITIES-1 )] );
+	for( i = 0; i < frame->numplayers; i++ )
+		DT_AppendRow( worker, DT_TABLE_PLAYER, &frame->playerStates[i] );
+
+	if( worker->rows[DT_TABLE_FRAME] >= DT_BLOCK_FRAMES )
+		DT_FlushBlock( worker );
+}
+
+/*
+* DT_ParseDemoMessage
+*/
+static void DT_ParseDemoMessage( dt_worker_t *worker, msg_t *msg )
+{
+	int cmd, len;
+
+	while( 1 )
+	{
+		if( msg->readcount > msg->cursize )
+			Com_Error( ERR_DROP, "Bad demo message" );
+
+		cmd = MSG_ReadByte( msg );
+		if( cmd == -1 )
+			break;
+
+		switch( cmd )
+		{
+		default:
+			Com_Error( ERR_DROP, "Illegible demo message" );
+
+		case svc_nop:
+			break;
+
+		case svc_servercmd:
+			if( !worker->reliable )
+				MSG_ReadLong( msg ); // cmdNum
+			// fall through
+		case svc_servercs:
+			MSG_ReadString( msg );
+			break;
+
+		case svc_serverdata:
+			DT_ParseServerData( worker, msg );
+			break;
+
+		case svc_spawnbaseline:
+			SNAP_ParseBaseline( msg, worker->baselines );
+			break;
+
+		case svc_clcack:
+			MSG_ReadLong( msg ); // reliableAcknowledge
+			MSG_ReadLong( msg ); // ucmdAcknowledged
+			break;
+
+		case svc_frame:
+			DT_ParseFrame( worker, msg );
+			break;
+
+		case svc_demoinfo:
+			len = MSG_ReadLong( msg );
+			MSG_SkipData( msg, len );
+			break;
+
+		case svc_extension:
+			MSG_ReadByte( msg );			// extension id
+			MSG_ReadByte( msg );			// version number
+			len = MSG_ReadShort( msg );		// command length
+			MSG_SkipData( msg, len );		// command data
+			break;
+		}
+	}
+}
+
+/*
+* DT_CloseDemo
+*/
+static void DT_CloseDemo( dt_worker_t *worker )
+{
+	if( worker->demofile )
+	{
+		FS_FCloseFile( worker->demofile );
+		worker->demofile = 0;
+	}
+	if( worker->outfile )
+	{
+		FS_FCloseFile( worker->outfile );
+		worker->outfile = 0;
+	}
+}
+
+/*
+* DT_DecodeDemo
+*/
+static void DT_DecodeDemo( dt_worker_t *worker, const char *demopath, const char *outpath )
+{
+	int read;
+	unsigned int i;
+
+	if( FS_FOpenFile( demopath, &worker->demofile, FS_READ|SNAP_DEMO_GZ ) == -1 || !worker->demofile )
+		Com_Error( ERR_DROP, "Couldn't open %s", demopath );
+	if( FS_FOpenFile( outpath, &worker->outfile, FS_WRITE ) == -1 )
+		Com_Error( ERR_DROP, "Couldn't open %s for writing", outpath );
+
+	worker->header = false;
+	worker->reliable = false;
+	worker->lastFrame = NULL;
+	memset( worker->rows, 0, sizeof( worker->rows ) );
+	for( i = 0; i < DT_NUM_COLUMNS; i++ )
+		worker->columns[i].size = 0;
+	memset( worker->baselines, 0, sizeof( worker->baselines ) );
+
+	while( ( read = SNAP_ReadDemoMessage( worker->demofile, &worker->msg ) ) != -1 )
+	{
+		worker->bytes += read + 4;
+		DT_ParseDemoMessage( worker, &worker->msg );
+	}
+
+	if( !worker->header )
+		Com_Error( ERR_DROP, "No serverdata in %s", demopath );
+
+	DT_FlushBlock( worker );
+	DT_WriteInt( worker->outfile, 0 );
+}
+
+/*
+* DT_ProcessDemo
+*
+* Decodes a demo into a column file, returns false if the demo is broken.
+* Errors raised by the decoder only abort the demo this thread is working on.
+*/
+bool DT_ProcessDemo( dt_worker_t *worker, const char *demopath, const char *outpath )
+{
+	jmp_buf abortframe;
+
+	if( setjmp( abortframe ) )
+	{
+		Com_SetThreadAbortFrame( NULL );
+		Com_Printf( "Failed to decode %s\n", demopath );
+
+		DT_CloseDemo( worker );
+		FS_RemoveFile( outpath );
+		worker->failed++;
+		return false;
+	}
+
+	Com_SetThreadAbortFrame( &abortframe );
+
+	DT_DecodeDemo( worker, demopath, outpath );
+
+	Com_SetThreadAbortFrame( NULL );
+
+	DT_CloseDemo( worker );
+	worker->demos++;
+	return true;
+}
+
+/*
+* DT_InitWorker
+*/
+void DT_InitWorker( dt_worker_t *worker, int num )
+{
+	int i;
+
+	memset( worker, 0, sizeof( *worker ) );
+	worker->num = num;
+
+	worker->snapshots = Mem_ZoneMallocExt( sizeof( snapshot_t ) * UPDATE_BACKUP, 0 );
+	worker->areabits = Mem_ZoneMallocExt( DT_MAX_AREABYTES * UPDATE_BACKUP, 0 );
+	for( i = 0; i < UPDATE_BACKUP; i++ )
+	{
+		worker->snapshots[i].areabytes = DT_MAX_AREABYTES;
+		worker->snapshots[i].areabits = worker->areabits + i * DT_MAX_AREABYTES;
+	}
+
+	worker->columns = Mem_ZoneMalloc( sizeof( dt_columnbuf_t ) * DT_NUM_COLUMNS );
+
+	MSG_Init( &worker->msg, worker->msgbuf, sizeof( worker->msgbuf ) );
+}
+
+/*
+* DT_FreeWorker
+*/
+void DT_FreeWorker( dt_worker_t *worker )
+{
+	unsigned int i;
+
+	for( i = 0; i < DT_NUM_COLUMNS; i++ )
+	{
+		if( worker->columns[i].data )
+			Mem_Free( worker->columns[i].data );
+	}
+	Mem_ZoneFree( worker->columns );
+	Mem_ZoneFree( worker->areabits );
+	Mem_ZoneFree( worker->snapshots );
+}
@@ -0,0 +1,111 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+// dt_local.h -- headless demo decoder, writes snapshots out as columnar data
+
+#ifndef __DT_LOCAL_H
+#define __DT_LOCAL_H
+
+#include "../qcommon/qcommon.h"
+#include "../qcommon/snap_read.h"
+
+/*
+* Output file format, all values are little-endian:
+*
+* header:  "QFDC", int version, int snapFrameTime, string levelname,
+*          byte numcolumns, followed by each column as byte table, byte type, string name
+* blocks:  int numframes, int numentities, int numplayers, followed by the values
+*          of each column in header order, numframes, numentities or numplayers
+*          of them depending on the column's table
+* end:     int 0
+*
+* Entity and player rows belong to frames in order, the frame's numentities
+* and numplayers columns tell how many rows each frame has.
+*/
+
+#define DT_FILE_MAGIC			"QFDC"
+#define DT_FILE_VERSION			1
+#define DT_FILE_EXTENSION		".qfdc"
+
+#define DT_BLOCK_FRAMES			256			// frames per column block
+
+enum
+{
+	DT_TABLE_FRAME,
+	DT_TABLE_ENTITY,
+	DT_TABLE_PLAYER,
+
+	DT_NUM_TABLES
+};
+
+enum
+{
+	DT_TYPE_U8,
+	DT_TYPE_U16,
+	DT_TYPE_I32,
+	DT_TYPE_F32
+};
+
+typedef struct
+{
+	uint8_t *data;
+	size_t size, maxsize;
+} dt_columnbuf_t;
+
+typedef struct
+{
+	int num;
+	qthread_t *thread;
+
+	// decoding state of the current demo
+	int demofile;
+	int outfile;
+	bool reliable;
+	bool header;
+	snapshot_t *snapshots;				// UPDATE_BACKUP frames for delta decompression
+	uint8_t *areabits;
+	snapshot_t *lastFrame;
+	entity_state_t baselines[MAX_EDICTS];
+	msg_t msg;
+	uint8_t msgbuf[MAX_MSGLEN];
+
+	// current block
+	unsigned int rows[DT_NUM_TABLES];
+	dt_columnbuf_t *columns;
+
+	// totals
+	unsigned int demos, failed;
+	uint64_t snapshots_decoded;
+	uint64_t bytes;
+} dt_worker_t;
+
+//
+// dt_decode.c
+//
+void DT_InitWorker( dt_worker_t *worker, int num );
+void DT_FreeWorker( dt_worker_t *worker );
+bool DT_ProcessDemo( dt_worker_t *worker, const char *demopath, const char *outpath );
+
+//
+// dt_main.c
+//
+extern cvar_t *dt_threads;
+
+#endif // __DT_LOCAL_H
@@ -0,0 +1,204 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+// dt_main.c -- headless demo decoding tool, takes the place of the server
+//
+// usage: qfusion_demotool +demoscan <directory> [outdir]
+// the tool quits once the commands given on the command line have been run
+
+#include "dt_local.h"
+
+#define DT_MAX_THREADS		64
+
+cvar_t *dt_threads;
+
+static struct
+{
+	char *dir;
+	char *outdir;
+	char **demos;
+	int numdemos;
+	int next;
+	qmutex_t *lock;
+} dt_scan;
+
+/*
+* DT_NextDemo
+*/
+static int DT_NextDemo( void )
+{
+	int i;
+
+	QMutex_Lock( dt_scan.lock );
+	i = dt_scan.next < dt_scan.numdemos ? dt_scan.next++ : -1;
+	QMutex_Unlock( dt_scan.lock );
+
+	return i;
+}
+
+/*
+* DT_WorkerThread
+*/
+static void *DT_WorkerThread( void *param )
+{
+	int i;
+	dt_worker_t *worker = param;
+	char demopath[MAX_QPATH*2], outpath[MAX_QPATH*2];
+
+	while( ( i = DT_NextDemo() ) >= 0 )
+	{
+		Q_snprintfz( demopath, sizeof( demopath ), "%s/%s", dt_scan.dir, dt_scan.demos[i] );
+		Q_snprintfz( outpath, sizeof( outpath ), "%s/%s", dt_scan.outdir, dt_scan.demos[i] );
+		COM_ReplaceExtension( outpath, DT_FILE_EXTENSION, sizeof( outpath ) );
+
+		DT_ProcessDemo( worker, demopath, outpath );
+	}
+
+	return NULL;
+}
+
+/*
+* DT_DemoScan_f
+*
+* Decodes all demos in a directory into column files, using a thread per processor
+*/
+static void DT_DemoScan_f( void )
+{
+	int i, numthreads;
+	size_t bufsize;
+	char *buf, *s;
+	uint64_t start, elapsed;
+	unsigned int demos, failed;
+	uint64_t snapshots, bytes;
+	double seconds;
+	dt_worker_t *workers;
+
+	if( Cmd_Argc() < 2 )
+	{
+		Com_Printf( "Usage: %s <directory> [outdir]\n", Cmd_Argv( 0 ) );
+		return;
+	}
+
+	dt_scan.dir = ZoneCopyString( va( "demos/%s", Cmd_Argv( 1 ) ) );
+	dt_scan.outdir = ZoneCopyString( Cmd_Argc() > 2 ? Cmd_Argv( 2 ) : va( "demoscan/%s", Cmd_Argv( 1 ) ) );
+	COM_SanitizeFilePath( dt_scan.dir );
+	COM_SanitizeFilePath( dt_scan.outdir );
+
+	buf = NULL;
+	if( !COM_ValidateRelativeFilename( dt_scan.dir ) || !COM_ValidateRelativeFilename( dt_scan.outdir ) )
+	{
+		Com_Printf( "Invalid directory name\n" );
+		goto done;
+	}
+
+	bufsize = 0;
+	dt_scan.numdemos = FS_GetFileListExt( dt_scan.dir, APP_DEMO_EXTENSION_STR, NULL, &bufsize, 0, 0 );
+	if( !dt_scan.numdemos || !bufsize )
+	{
+		Com_Printf( "No demos found in %s\n", dt_scan.dir );
+		goto done;
+	}
+
+	buf = Mem_TempMalloc( bufsize );
+	FS_GetFileList( dt_scan.dir, APP_DEMO_EXTENSION_STR, buf, bufsize, 0, 0 );
+
+	dt_scan.demos = Mem_TempMalloc( sizeof( char * ) * dt_scan.numdemos );
+	for( i = 0, s = buf; i < dt_scan.numdemos && *s; i++, s += strlen( s ) + 1 )
+		dt_scan.demos[i] = s;
+	dt_scan.numdemos = i;
+	dt_scan.next = 0;
+
+	numthreads = dt_threads->integer > 0 ? dt_threads->integer : Sys_GetNumberOfProcessors();
+	clamp( numthreads, 1, DT_MAX_THREADS );
+	if( numthreads > dt_scan.numdemos )
+		numthreads = dt_scan.numdemos;
+
+	Com_Printf( "Decoding %i demos from %s to %s on %i threads\n", dt_scan.numdemos, dt_scan.dir, dt_scan.outdir, numthreads );
+
+	dt_scan.lock = QMutex_Create();
+	workers = Mem_ZoneMalloc( sizeof( *workers ) * numthreads );
+
+	start = Sys_Microseconds();
+
+	for( i = 0; i < numthreads; i++ )
+	{
+		DT_InitWorker( &workers[i], i );
+		workers[i].thread = QThread_Create( DT_WorkerThread, &workers[i] );
+	}
+
+	demos = failed = 0;
+	snapshots = bytes = 0;
+	for( i = 0; i < numthreads; i++ )
+	{
+		QThread_Join( workers[i].thread );
+
+		demos += workers[i].demos;
+		failed += workers[i].failed;
+		snapshots += workers[i].snapshots_decoded;
+		bytes += workers[i].bytes;
+
+		DT_FreeWorker( &workers[i] );
+	}
+
+	elapsed = Sys_Microseconds() - start;
+	seconds = elapsed ? elapsed / 1000000.0 : 0.000001;
+
+	Com_Printf( "Decoded %u demos, %u failed, in %.2f seconds\n", demos, failed, seconds );
+	Com_Printf( "%llu snapshots, %.1f MB of messages, %.0f snapshots/sec\n", (unsigned long long)snapshots,
+		bytes / ( 1024.0 * 1024.0 ), snapshots / seconds );
+
+	Mem_ZoneFree( workers );
+	QMutex_Destroy( &dt_scan.lock );
+	Mem_TempFree( dt_scan.demos );
+	dt_scan.demos = NULL;
+
+done:
+	if( buf )
+		Mem_TempFree( buf );
+	Mem_ZoneFree( dt_scan.dir );
+	Mem_ZoneFree( dt_scan.outdir );
+	dt_scan.dir = dt_scan.outdir = NULL;
+}
+
+/*
+* The tool takes the place of the server in the common code
+*/
+
+void SV_Init( void )
+{
+	dt_threads = Cvar_Get( "dt_threads", "0", CVAR_ARCHIVE );
+
+	Cmd_AddCommand( "demoscan", DT_DemoScan_f );
+}
+
+void SV_Shutdown( const char *finalmsg )
+{
+	Cmd_RemoveCommand( "demoscan" );
+}
+
+void SV_ShutdownGame( const char *finalmsg, bool reconnect )
+{
+}
+
+void SV_Frame( int realmsec, int gamemsec )
+{
+	// the command line has been executed by now, we're done
+	Cbuf_AddText( "quit\n" );
+}
@@ -23,13 +23,11 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "ai_local.h"
 
 //==========================================
-//
-//
+// The open list is a binary heap ordered by F. Node states are
+// stamped with the search generation that last touched them, so
+// nodes from a previous search simply read as not being in any list
 //==========================================
 
-static short int alist[MAX_NODES];  //list contains all studied nodes, Open and Closed together
-static int alist_numNodes;
-
 enum
 {
 	NOLIST,
@@ -40,35 +38,48 @@ enum
 typedef struct
 {
 	short int parent;
+	short int list;
 	int G;
 	int H;
 
-	short int list;
+	int heapIndex;
+	unsigned int generation;
 
 } astarnode_t;
 
-astarnode_t astarnodes[MAX_NODES];
+struct astarcontext_s
+{
+	astarnode_t nodes[MAX_NODES];
+	short int heap[MAX_NODES];	// open list
+	int heapSize;
+	unsigned int generation;
+
+	short int originNode;
+	short int goalNode;		// -1 when expanding the whole graph
+	int validLinksMask;
+};
 
-struct astarpath_s *Apath;
-//==========================================
-//
-//
-//==========================================
-static short int originNode;
-static short int goalNode;
-static short int currentNode;
+static astarcontext_t astar;	// searches run by the bots
+static struct astarpath_s *Apath;
 
-static int ValidLinksMask;
-#define DEFAULT_MOVETYPES_MASK ( LINK_MOVE|LINK_STAIRS|LINK_FALL|LINK_WATER|LINK_WATERJUMP|LINK_JUMPPAD|LINK_PLATFORM|LINK_TELEPORT );
+#define DEFAULT_MOVETYPES_MASK ( LINK_MOVE|LINK_STAIRS|LINK_FALL|LINK_WATER|LINK_WATERJUMP|LINK_JUMPPAD|LINK_PLATFORM|LINK_TELEPORT )
 //==========================================
 //
 //
 //
 //==========================================
 
+static inline int AStar_NodeList( const astarcontext_t *ctx, int node )
+{
+	if( ctx->nodes[node].generation != ctx->generation )
+		return NOLIST;
+
+	return ctx->nodes[node].list;
+}
+
 int AStar_nodeIsInClosed( int node )
 {
-	if( astarnodes[node].list == CLOSEDLIST )
+	if( AStar_NodeList( &astar, node ) == CLOSEDLIST )
 		return 1;
 
 	return 0;
@@ -76,44 +87,41 @@ int AStar_nodeIsInClosed( int node )
 
 int AStar_nodeIsInOpen( int node )
 {
-	if( astarnodes[node].list == OPENLIST )
+	if( AStar_NodeList( &astar, node ) == OPENLIST )
 		return 1;
 
 	return 0;
 }
 
-static void AStar_InitLists( void )
+static void AStar_InitLists( astarcontext_t *ctx, int origin, int goal, int movetypes )
 {
-	memset( astarnodes, 0, sizeof( astarnodes ) ); //jabot092
-	if( Apath ) Apath->numNodes = 0;
-	alist_numNodes = 0;
-}
+	ctx->validLinksMask = movetypes;
+	if( !ctx->validLinksMask )
+		ctx->validLinksMask = DEFAULT_MOVETYPES_MASK;
 
-static int AStar_PLinkDistance( int n1, int n2 )
-{
-	int i;
-
-	//teleporters are exceptional
-	//if( nodes[n1].flags & NODEFLAGS_TELEPORTER_IN )
-	//	n1++; //it's tele out is stored in the next node in the array
+	ctx->originNode = origin;
+	ctx->goalNode = goal;
+	ctx->heapSize = 0;
 
-	for( i = 0; i < pLinks[n1].numLinks; i++ )
+	// a new generation empties the lists
+	ctx->generation++;
+	if( !ctx->generation )
 	{
-		if( pLinks[n1].nodes[i] == n2 )
-		{
-			return (int)pLinks[n1].dist[i];
-		}
+		// wrapped around, old stamps could match again
+		memset( ctx->nodes, 0, sizeof( ctx->nodes ) );
+		ctx->generation = 1;
 	}
-
-	return -1;
 }
 
-static int  Astar_HDist_ManhatanGuess( int node )
+static int Astar_HDist_ManhatanGuess( const astarcontext_t *ctx, int node )
 {
 	vec3_t DistVec;
 	int i;
 	int HDist;
 
+	if( ctx->goalNode < 0 )
+		return 0;
+
 	//teleporters are exceptional
 	if( nodes[node].flags & NODEFLAGS_TELEPORTER_IN )
 	{
@@ -124,170 +132,185 @@ static int  Astar_HDist_ManhatanGuess( int node )
 
 	for( i = 0; i < 3; i++ )
 	{
-		DistVec[i] = fabs( nodes[goalNode].origin[i] - nodes[node].origin[i] );
+		DistVec[i] = fabs( nodes[ctx->goalNode].origin[i] - nodes[node].origin[i] );
 	}
 
 	HDist = (int)( DistVec[0] + DistVec[1] + DistVec[2] );
 	return HDist;
 }
 
-static void AStar_PutInClosed( int node )
+static inline int AStar_F( const astarcontext_t *ctx, int node )
 {
-	if( !astarnodes[node].list )
-	{
-		alist[alist_numNodes] = node;
-		alist_numNodes++;
-	}
-
-	astarnodes[node].list = CLOSEDLIST;
+	return ctx->nodes[node].G + ctx->nodes[node].H;
 }
 
-static void AStar_PutAdjacentsInOpen( int node )
+static void AStar_HeapUp( astarcontext_t *ctx, int index )
 {
-	int i;
+	short int node = ctx->heap[index];
+	int F = AStar_F( ctx, node );
 
-	for( i = 0; i < pLinks[node].numLinks; i++ )
+	while( index > 0 )
 	{
-		int addnode;
+		int parent = ( index - 1 ) >> 1;
+		short int pnode = ctx->heap[parent];
 
-		//ignore invalid links
-		if( !( ValidLinksMask & pLinks[node].moveType[i] ) )
-			continue;
+		if( AStar_F( ctx, pnode ) <= F )
+			break;
 
-		addnode = pLinks[node].nodes[i];
+		ctx->heap[index] = pnode;
+		ctx->nodes[pnode].heapIndex = index;
+		index = parent;
+	}
 
-		//ignore self
-		if( addnode == node )
-			continue;
+	ctx->heap[index] = node;
+	ctx->nodes[node].heapIndex = index;
+}
 
-		//ignore if it's already in closed list
-		if( AStar_nodeIsInClosed( addnode ) )
-			continue;
+static void AStar_HeapDown( astarcontext_t *ctx, int index )
+{
+	short int node = ctx->heap[index];
+	int F = AStar_F( ctx, node );
 
-		//if it's already inside open list
-		if( AStar_nodeIsInOpen( addnode ) )
-		{
-			int plinkDist;
+	while( 1 )
+	{
+		int child = ( index << 1 ) + 1;
+
+		if( child >= ctx->heapSize )
+			break;
+		if( child + 1 < ctx->heapSize && AStar_F( ctx, ctx->heap[child+1] ) < AStar_F( ctx, ctx->heap[child] ) )
+			child++;
+		if( AStar_F( ctx, ctx->heap[child] ) >= F )
+			break;
+
+		ctx->heap[index] = ctx->heap[child];
+		ctx->nodes[ctx->heap[index]].heapIndex = index;
+		index = child;
+	}
 
-			plinkDist = AStar_PLinkDistance( node, addnode );
-			if( plinkDist != -1 )
-			{
-				//compare G distances and choose best parent
-				if( astarnodes[addnode].G > ( astarnodes[node].G + plinkDist ) )
-				{
-					astarnodes[addnode].parent = node;
-					astarnodes[addnode].G = astarnodes[node].G + plinkDist;
-				}
-			}
-		}
-		else
-		{
-			//just put it in
+	ctx->heap[index] = node;
+	ctx->nodes[node].heapIndex = index;
+}
 
-			int plinkDist;
+static void AStar_PutInOpen( astarcontext_t *ctx, int node, int parent, int G )
+{
+	astarnode_t *anode = &ctx->nodes[node];
 
-			plinkDist = AStar_PLinkDistance( node, addnode );
-			if( plinkDist == -1 )
-			{
-				plinkDist = AStar_PLinkDistance( addnode, node );
-				if( plinkDist == -1 )
-					plinkDist = 999; //jalFIXME
+	anode->generation = ctx->generation;
+	anode->list = OPENLIST;
+	anode->parent = parent;
+	anode->G = G;
+	anode->H = Astar_HDist_ManhatanGuess( ctx, node );
 
-				//ERROR
-				//printf("WARNING: AStar_PutAdjacentsInOpen - Couldn't find distance between nodes\n");
-			}
+	ctx->heap[ctx->heapSize] = node;
+	ctx->heapSize++;
+	AStar_HeapUp( ctx, ctx->heapSize - 1 );
+}
 
-			//put in global list
-			if( !astarnodes[addnode].list )
-			{
-				alist[alist_numNodes] = addnode;
-				alist_numNodes++;
-			}
+static int AStar_PutBestFInClosed( astarcontext_t *ctx )
+{
+	int best;
 
-			astarnodes[addnode].parent = node;
-			astarnodes[addnode].G = astarnodes[node].G + plinkDist;
-			astarnodes[addnode].H = Astar_HDist_ManhatanGuess( addnode );
-			astarnodes[addnode].list = OPENLIST;
-		}
+	if( !ctx->heapSize )
+		return -1;
+
+	best = ctx->heap[0];
+
+	ctx->heapSize--;
+	if( ctx->heapSize )
+	{
+		ctx->heap[0] = ctx->heap[ctx->heapSize];
+		AStar_HeapDown( ctx, 0 );
 	}
+
+	ctx->nodes[best].list = CLOSEDLIST;
+	return best;
 }
 
-static int AStar_FindInOpen_BestF( void )
+static void AStar_PutAdjacentsInOpen( astarcontext_t *ctx, int node )
 {
 	int i;
-	int bestF = -1;
-	int best = -1;
+	const nav_plink_t *plink = &pLinks[node];
 
-	for( i = 0; i < alist_numNodes; i++ )
+	for( i = 0; i < plink->numLinks; i++ )
 	{
-		int node = alist[i];
+		int addnode, G;
+
+		//ignore invalid links
+		if( !( ctx->validLinksMask & plink->moveType[i] ) )
+			continue;
 
-		if( astarnodes[node].list != OPENLIST )
+		addnode = plink->nodes[i];
+
+		//ignore self
+		if( addnode == node )
 			continue;
 
-		if( bestF == -1 || bestF > ( astarnodes[node].G + astarnodes[node].H ) )
+		G = ctx->nodes[node].G + plink->dist[i];
+
+		switch( AStar_NodeList( ctx, addnode ) )
 		{
-			bestF = astarnodes[node].G + astarnodes[node].H;
-			best = node;
+		case CLOSEDLIST:
+			break;
+
+		case OPENLIST:
+			//compare G distances and choose best parent
+			if( ctx->nodes[addnode].G > G )
+			{
+				ctx->nodes[addnode].parent = node;
+				ctx->nodes[addnode].G = G;
+				AStar_HeapUp( ctx, ctx->nodes[addnode].heapIndex );
+			}
+			break;
+
+		default:
+			AStar_PutInOpen( ctx, addnode, node, G );
+			break;
 		}
 	}
-	//printf("BEST:%i\n", best);
-	return best;
 }
 
-static void AStar_ListsToPath( void )
+static void AStar_ListsToPath( const astarcontext_t *ctx )
 {
 	int count = 0;
-	int cur = goalNode;
+	int cur = ctx->goalNode;
 	short int *pnode;
 
 	Apath->numNodes = 0;
 	pnode = Apath->nodes;
-	while( cur != originNode )
+	while( cur != ctx->originNode )
 	{
 		*pnode = cur;
 		pnode++;
-		cur = astarnodes[cur].parent;
+		cur = ctx->nodes[cur].parent;
 		count++;
 	}
 
-	Apath->totalDistance = astarnodes[goalNode].G;
+	Apath->totalDistance = ctx->nodes[ctx->goalNode].G;
 	Apath->numNodes = count-1;
 }
 
-static int AStar_FillLists( void )
-{
-	//put current node inside closed list
-	AStar_PutInClosed( currentNode );
-
-	//put adjacent nodes inside open list
-	AStar_PutAdjacentsInOpen( currentNode );
-
-	//find best adjacent and make it our current
-	currentNode = AStar_FindInOpen_BestF();
-
-	return ( currentNode != -1 ); //if -1 path is blocked
-}
-
 int AStar_ResolvePath( int n1, int n2, int movetypes )
 {
-	ValidLinksMask = movetypes;
-	if( !ValidLinksMask )
-		ValidLinksMask = DEFAULT_MOVETYPES_MASK;
+	int node;
 
-	AStar_InitLists();
+	if( Apath ) Apath->numNodes = 0;
+
+	// a path needs at least one step
+	if( n1 == n2 )
+		return 0;
 
-	originNode = n1;
-	goalNode = n2;
-	currentNode = originNode;
+	AStar_InitLists( &astar, n1, n2, movetypes );
+	AStar_PutInOpen( &astar, n1, -1, 0 );
 
-	while( !AStar_nodeIsInOpen( goalNode ) )
+	while( ( node = AStar_PutBestFInClosed( &astar ) ) != n2 )
 	{
-		if( !AStar_FillLists() )
-			return 0; //failed
+		if( node == -1 )
+			return 0; //failed, path is blocked
+
+		AStar_PutAdjacentsInOpen( &astar, node );
 	}
 
-	AStar_ListsToPath();
+	AStar_ListsToPath( &astar );
 
 	return 1;
 }
@@ -306,3 +329,57 @@ int AStar_GetPath( int origin, int goal, int movetypes, struct astarpath_s *path
 	path->goalNode = goal;
 	return 1;
 }
+
+/*
+* AStar_NewContext
+*/
+astarcontext_t *AStar_NewContext( void )
+{
+	astarcontext_t *ctx;
+
+	ctx = ( astarcontext_t * )G_Malloc( sizeof( *ctx ) );
+	memset( ctx, 0, sizeof( *ctx ) );
+	return ctx;
+}
+
+/*
+* AStar_FreeContext
+*/
+void AStar_FreeContext( astarcontext_t *ctx )
+{
+	G_Free( ctx );
+}
+
+/*
+* AStar_GetCostsFrom
+* Expands the whole graph from origin with no goal, storing the cost of
+* reaching each node and the first node to move to on the way there.
+* Unreachable nodes, and the origin itself, get -1 for both. Doesn't touch
+* the bots' search state, so it can run on any thread with its own context.
+*/
+void AStar_GetCostsFrom( astarcontext_t *ctx, int origin, int movetypes, int numNodes, int *costs, short int *nextNodes )
+{
+	int i, node, parent;
+
+	for( i = 0; i < numNodes; i++ )
+	{
+		costs[i] = -1;
+		nextNodes[i] = -1;
+	}
+
+	AStar_InitLists( ctx, origin, -1, movetypes );
+	AStar_PutInOpen( ctx, origin, -1, 0 );
+
+	while( ( node = AStar_PutBestFInClosed( ctx ) ) != -1 )
+	{
+		if( node != origin && node < numNodes )
+		{
+			// parents are always closed before their children
+			parent = ctx->nodes[node].parent;
+			costs[node] = ctx->nodes[node].G;
+			nextNodes[node] = ( parent == origin ) ? node : nextNodes[parent];
+		}
+
+		AStar_PutAdjacentsInOpen( ctx, node );
+	}
+}
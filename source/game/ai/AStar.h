@@ -29,6 +29,9 @@ typedef struct astarpath_s
 
 } astarpath_t;
 
+// search state, each thread running searches needs its own
+typedef struct astarcontext_s astarcontext_t;
+
 //	A* PROPS
 //===========================================
 int AStar_nodeIsInClosed( int node );
@@ -37,3 +40,6 @@ int AStar_nodeIsInPath( int node );
 int AStar_ResolvePath( int origin, int goal, int movetypes );
 //===========================================
 int AStar_GetPath( int origin, int goal, int movetypes, struct astarpath_s *path );
+astarcontext_t *AStar_NewContext( void );
+void AStar_FreeContext( astarcontext_t *ctx );
+void AStar_GetCostsFrom( astarcontext_t *ctx, int origin, int movetypes, int numNodes, int *costs, short int *nextNodes );
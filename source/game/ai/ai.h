@@ -66,6 +66,9 @@ float		AI_GetCharacterOffensiveness( const ai_handle_t *ai );
 float		AI_GetCharacterCampiness( const ai_handle_t *ai );
 float		AI_GetCharacterFirerate( const ai_handle_t *ai );
 
+// ai_pathcache.c
+void		AI_PathCache_Clear( void );
+
 // ai_items.c
 void        AI_EnemyAdded( edict_t *ent );
 void        AI_EnemyRemoved( edict_t *ent );
@@ -85,5 +88,6 @@ void        AITools_InitMakenodes( void );
 void        AITools_AddBotRoamNode_Cmd( void );
 void        AITools_AddNode_Cmd( void );
 void		Cmd_SaveNodes_f( void );
+void		Cmd_BenchNodes_f( void );
 
 void        AI_Cheat_NoTarget( edict_t *ent );
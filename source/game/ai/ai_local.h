@@ -126,6 +126,9 @@ extern cvar_t *sv_botpersonality;
 
 #define LINK_INVALID 0x00001000
 
+// movetypes of the deathmatch bot class, the path cache is built for these
+#define AI_DMBOT_MOVETYPES ( LINK_MOVE|LINK_STAIRS|LINK_FALL|LINK_WATER|LINK_WATERJUMP|LINK_JUMPPAD|LINK_PLATFORM|LINK_TELEPORT|LINK_LADDER|LINK_JUMP|LINK_CROUCH )
+
 typedef struct nav_plink_s
 {
 	int numLinks;
@@ -345,6 +348,8 @@ bool    AI_IsStep( edict_t *ent );
 int	    AI_FindCost( int from, int to, int movetypes );
 int	    AI_FindClosestReachableNode( vec3_t origin, edict_t *passent, int range, unsigned int flagsmask );
 int	    AI_FindClosestNode( vec3_t origin, float mindist, int range, unsigned int flagsmask );
+int		AI_FindNodesInRadius( const vec3_t origin, float mindist, float range, unsigned int flagsmask, int *list, int maxnodes );
+void	AI_NodeGrid_Clear( void );
 void	    AI_SetGoal( edict_t *self, int goal_node );
 void AI_NodeReached( edict_t *self );
 int AI_GetNodeFlags( int node );
@@ -385,6 +390,13 @@ int	    AI_LinkCloseNodes_JumpPass( int start );
 int		AI_LinkCloseNodes_RocketJumpPass( int start );
 void AI_LinkNavigationFile( bool silent );
 
+// ai_pathcache.c
+//----------------------------------------------------------
+void	AI_PathCache_Build( int movetypes );
+void	AI_PathCache_Invalidate( void );
+bool	AI_PathCache_FindCost( int from, int to, int movetypes, int *cost );
+int		AI_PathCache_GetPath( int origin, int goal, int movetypes, struct astarpath_s *path );
+
 
 //bot_classes
 //----------------------------------------------------------
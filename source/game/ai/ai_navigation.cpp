@@ -30,20 +30,166 @@ ai_navigation_t	nav;
 
 int AI_FindCost( int from, int to, int movetypes )
 {
+	int cost;
 	astarpath_t path;
 
+	if( AI_PathCache_FindCost( from, to, movetypes, &cost ) )
+		return cost;
+
 	if( !AStar_GetPath( from, to, movetypes, &path ) )
 		return -1;
 
 	return path.totalDistance;
 }
 
+//==========================================
+// Node grid
+// Nodes are hashed by the XY cell they're in, so lookups only
+// visit the cells touching the search radius. Nodes added after the
+// grid was built are inserted as they show up, anything else (a new
+// map, removed nodes) needs AI_NodeGrid_Clear
+//==========================================
+
+#define NODEGRID_CELLSIZE	NODE_DENSITY
+#define NODEGRID_HASHSIZE	1024
+
+typedef struct
+{
+	int node;
+	float dist;
+} ai_nodedist_t;
+
+static struct
+{
+	int numNodes;							// nodes in the grid
+	short int hash[NODEGRID_HASHSIZE];		// node + 1 of the first node in the cell chain, 0 if none
+	short int next[MAX_NODES];				// same for the next node in the chain
+} nodegrid;
+
+static inline int AI_NodeGridCell( float v )
+{
+	return (int)floor( v / NODEGRID_CELLSIZE );
+}
+
+static inline unsigned int AI_NodeGridHash( int x, int y )
+{
+	return ( (unsigned int)x * 73856093u ^ (unsigned int)y * 19349663u ) & ( NODEGRID_HASHSIZE - 1 );
+}
+
+void AI_NodeGrid_Clear( void )
+{
+	memset( &nodegrid, 0, sizeof( nodegrid ) );
+}
+
+static void AI_NodeGrid_Update( void )
+{
+	unsigned int hash;
+	const float *origin;
+
+	if( nav.num_nodes < nodegrid.numNodes )
+		AI_NodeGrid_Clear();
+
+	for( ; nodegrid.numNodes < nav.num_nodes; nodegrid.numNodes++ )
+	{
+		origin = nodes[nodegrid.numNodes].origin;
+		hash = AI_NodeGridHash( AI_NodeGridCell( origin[0] ), AI_NodeGridCell( origin[1] ) );
+
+		nodegrid.next[nodegrid.numNodes] = nodegrid.hash[hash];
+		nodegrid.hash[hash] = nodegrid.numNodes + 1;
+	}
+}
+
+static int AI_NodeDistCmp( const void *a, const void *b )
+{
+	const ai_nodedist_t *n1 = ( const ai_nodedist_t * )a;
+	const ai_nodedist_t *n2 = ( const ai_nodedist_t * )b;
+
+	if( n1->dist != n2->dist )
+		return n1->dist < n2->dist ? -1 : 1;
+	return n1->node - n2->node;
+}
+
+static inline int AI_AddNodeInRadius( int node, const vec3_t origin, float mindist, float range,
+	unsigned int flagsmask, ai_nodedist_t *list, int numnodes )
+{
+	float dist;
+
+	if( flagsmask == NODE_ALL || nodes[node].flags & flagsmask )
+	{
+		dist = DistanceFast( nodes[node].origin, origin );
+		if( dist > mindist && dist < range )
+		{
+			list[numnodes].node = node;
+			list[numnodes].dist = dist;
+			numnodes++;
+		}
+	}
+
+	return numnodes;
+}
+
+/*
+* AI_FindNodesInRadius
+* Stores up to maxnodes nodes farther than mindist and closer than range
+* to origin in list, closest first. Returns the number of nodes stored
+*/
+int AI_FindNodesInRadius( const vec3_t origin, float mindist, float range, unsigned int flagsmask, int *list, int maxnodes )
+{
+	int i, x, y, node;
+	int mins[2], maxs[2];
+	int numnodes = 0;
+	static ai_nodedist_t found[MAX_NODES];	// too big for the stack, only used from the game thread
+
+	for( i = 0; i < 2; i++ )
+	{
+		mins[i] = AI_NodeGridCell( origin[i] - range );
+		maxs[i] = AI_NodeGridCell( origin[i] + range );
+	}
+
+	// nodes are moved around while editing
+	if( nav.editmode || ( maxs[0] - mins[0] + 1 ) * ( maxs[1] - mins[1] + 1 ) > NODEGRID_HASHSIZE )
+	{
+		for( i = 0; i < nav.num_nodes; i++ )
+			numnodes = AI_AddNodeInRadius( i, origin, mindist, range, flagsmask, found, numnodes );
+	}
+	else
+	{
+		AI_NodeGrid_Update();
+
+		for( x = mins[0]; x <= maxs[0]; x++ )
+		{
+			for( y = mins[1]; y <= maxs[1]; y++ )
+			{
+				for( i = nodegrid.hash[AI_NodeGridHash( x, y )]; i; i = nodegrid.next[node] )
+				{
+					node = i - 1;
+
+					// other cells can share the hash
+					if( AI_NodeGridCell( nodes[node].origin[0] ) != x || AI_NodeGridCell( nodes[node].origin[1] ) != y )
+						continue;
+
+					numnodes = AI_AddNodeInRadius( node, origin, mindist, range, flagsmask, found, numnodes );
+				}
+			}
+		}
+	}
+
+	if( numnodes > 1 )
+		qsort( found, numnodes, sizeof( found[0] ), AI_NodeDistCmp );
+
+	if( numnodes > maxnodes )
+		numnodes = maxnodes;
+	for( i = 0; i < numnodes; i++ )
+		list[i] = found[i].node;
+
+	return numnodes;
+}
+
 int AI_FindClosestReachableNode( vec3_t origin, edict_t *passent, int range, unsigned int flagsmask )
 {
 	int i;
-	float closest;
-	float dist;
-	int node = -1;
+	int numnodes;
+	int list[MAX_NODES];
 	trace_t	tr;
 	vec3_t maxs, mins;
 
@@ -57,52 +203,27 @@ int AI_FindClosestReachableNode( vec3_t origin, edict_t *passent, int range, uns
 		VectorCopy( vec3_origin, mins );
 	}
 
-	closest = range;
+	// closest first, so the first visible one wins
+	numnodes = AI_FindNodesInRadius( origin, -1, range, flagsmask, list, MAX_NODES );
 
-	for( i = 0; i < nav.num_nodes; i++ )
+	for( i = 0; i < numnodes; i++ )
 	{
-		if( flagsmask == NODE_ALL || nodes[i].flags & flagsmask )
-		{
-			dist = DistanceFast( nodes[i].origin, origin );
-
-			if( dist < closest )
-			{
-				// make sure it is visible
-				G_Trace( &tr, origin, mins, maxs, nodes[i].origin, passent, MASK_NODESOLID );
-				if( tr.fraction == 1.0 )
-				{
-					node = i;
-					closest = dist;
-				}
-			}
-		}
+		// make sure it is visible
+		G_Trace( &tr, origin, mins, maxs, nodes[list[i]].origin, passent, MASK_NODESOLID );
+		if( tr.fraction == 1.0 )
+			return list[i];
 	}
-	return node;
+
+	return NODE_INVALID;
 }
 
 int AI_FindClosestNode( vec3_t origin, float mindist, int range, unsigned int flagsmask )
 {
-	int i;
-	float closest;
-	float dist;
 	int node = NODE_INVALID;
 
 	if( mindist > range ) return -1;
 
-	closest = range;
-
-	for( i = 0; i < nav.num_nodes; i++ )
-	{
-		if( flagsmask == NODE_ALL || nodes[i].flags & flagsmask )
-		{
-			dist = DistanceFast( nodes[i].origin, origin );
-			if( dist > mindist && dist < closest )
-			{
-				node = i;
-				closest = dist;
-			}
-		}
-	}
+	AI_FindNodesInRadius( origin, mindist, range, flagsmask, &node, 1 );
 	return node;
 }
 
@@ -121,7 +242,7 @@ void AI_ClearGoal( edict_t *self )
 
 void AI_SetGoal( edict_t *self, int goal_node )
 {
-	int node;
+	int node, found;
 
 	self->ai->goal_node = goal_node;
 	node = AI_FindClosestReachableNode( self->s.origin, self, NODE_DENSITY * 3, NODE_ALL );
@@ -132,8 +253,11 @@ void AI_SetGoal( edict_t *self, int goal_node )
 		return;
 	}
 
-	// ASTAR 
-	if( !AStar_GetPath( node, goal_node, self->ai->status.moveTypesMask, &self->ai->path ) )
+	// ASTAR, unless the path cache knows the way
+	found = AI_PathCache_GetPath( node, goal_node, self->ai->status.moveTypesMask, &self->ai->path );
+	if( found < 0 )
+		found = AStar_GetPath( node, goal_node, self->ai->status.moveTypesMask, &self->ai->path );
+	if( !found )
 	{
 		AI_ClearGoal( self );
 		return;
@@ -1192,6 +1192,8 @@ void AI_InitEntitiesData( void )
 	G_Printf( "       : AI Navigation Initialized.\n" );
 
 	nav.loaded = true;
+
+	AI_PathCache_Build( AI_DMBOT_MOVETYPES );
 }
 
 /*
@@ -1204,6 +1206,10 @@ void AI_InitNavigationData( bool silent )
 	int linkscount;
 	const int maxgoalEnts = sizeof( nav.goalEnts ) / sizeof( nav.goalEnts[0] );
 
+	// the path cache workers read the graph
+	AI_PathCache_Clear();
+	AI_NodeGrid_Clear();
+
 	memset( &nav, 0, sizeof( nav ) );
 	memset( nodes, 0, sizeof( nav_node_t ) * MAX_NODES );
 	memset( pLinks, 0, sizeof( nav_plink_t ) * MAX_NODES );
@@ -0,0 +1,435 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+// ai_pathcache.cpp -- precomputed costs and next nodes between all pairs of nodes
+//
+// The table is built for the movetypes the bots use once the level navigation
+// is final, on worker threads so the level starts right away, and is saved next
+// to the nav file. Until it's ready, or for other movetypes, A* runs as usual.
+
+#include "../g_local.h"
+#include "ai_local.h"
+
+#define	PATHCACHE_FILE_VERSION		1
+#define PATHCACHE_FILE_EXTENSION	"navcache"
+#define PATHCACHE_MAX_THREADS		16
+#define PATHCACHE_REBUILD_DELAY		5000	// wait for the graph to settle after a link is added
+
+typedef struct
+{
+	int version;
+	int numNodes;
+	int moveTypes;
+	unsigned int checksum;
+} pathcache_header_t;
+
+static struct
+{
+	bool ready;
+	int numNodes;
+	int moveTypes;
+	unsigned int checksum;
+	char filename[MAX_QPATH];
+
+	int *costs;					// [numNodes * numNodes], from * numNodes + to
+	short int *nextNodes;		// same layout, first node to move to from "from"
+
+	// build state, shared with the worker threads
+	struct qmutex_s *lock;
+	int nextOrigin;
+	int numDone;
+	bool abort;
+	bool finished;
+	unsigned int buildStart;
+	int numThreads;
+	struct qthread_s *threads[PATHCACHE_MAX_THREADS];
+	astarcontext_t *contexts[PATHCACHE_MAX_THREADS];
+} pathcache;
+
+static cvar_t *ai_pathcache;
+static cvar_t *ai_pathcache_maxmb;
+
+// pending rebuild after the graph changed, kept out of the struct above so clearing doesn't lose it
+static bool pathcache_rebuild;
+static int pathcache_rebuildMoveTypes;
+static unsigned int pathcache_rebuildQueued;
+
+/*
+* AI_PathCache_Checksum
+* The cache is only valid for the exact same nodes and links
+*/
+static unsigned int AI_PathCache_Checksum( int numNodes )
+{
+	size_t i;
+	unsigned int hash = 2166136261u;
+	const uint8_t *data;
+
+	data = ( const uint8_t * )nodes;
+	for( i = 0; i < sizeof( nav_node_t ) * numNodes; i++ )
+		hash = ( hash ^ data[i] ) * 16777619u;
+
+	data = ( const uint8_t * )pLinks;
+	for( i = 0; i < sizeof( nav_plink_t ) * numNodes; i++ )
+		hash = ( hash ^ data[i] ) * 16777619u;
+
+	return hash;
+}
+
+/*
+* AI_PathCache_TableSize
+*/
+static size_t AI_PathCache_TableSize( int numNodes )
+{
+	return ( size_t )numNodes * numNodes;
+}
+
+/*
+* AI_PathCache_MemorySize
+*/
+static size_t AI_PathCache_MemorySize( int numNodes )
+{
+	return AI_PathCache_TableSize( numNodes ) * ( sizeof( int ) + sizeof( short int ) );
+}
+
+/*
+* AI_PathCache_Load
+*/
+static bool AI_PathCache_Load( void )
+{
+	int filenum;
+	size_t size;
+	pathcache_header_t header;
+
+	if( trap_FS_FOpenFile( pathcache.filename, &filenum, FS_READ ) == -1 )
+		return false;
+
+	size = AI_PathCache_TableSize( pathcache.numNodes );
+
+	if( trap_FS_Read( &header, sizeof( header ), filenum ) != sizeof( header )
+		|| header.version != PATHCACHE_FILE_VERSION
+		|| header.numNodes != pathcache.numNodes
+		|| header.moveTypes != pathcache.moveTypes
+		|| header.checksum != pathcache.checksum
+		|| trap_FS_Read( pathcache.costs, sizeof( int ) * size, filenum ) != (int)( sizeof( int ) * size )
+		|| trap_FS_Read( pathcache.nextNodes, sizeof( short int ) * size, filenum ) != (int)( sizeof( short int ) * size ) )
+	{
+		trap_FS_FCloseFile( filenum );
+		return false;
+	}
+
+	trap_FS_FCloseFile( filenum );
+	return true;
+}
+
+/*
+* AI_PathCache_Save
+* Called from the worker thread finishing the build, the tables are no longer written to
+*/
+static void AI_PathCache_Save( void )
+{
+	int filenum;
+	size_t size;
+	pathcache_header_t header;
+
+	if( trap_FS_FOpenFile( pathcache.filename, &filenum, FS_WRITE ) == -1 )
+		return;
+
+	size = AI_PathCache_TableSize( pathcache.numNodes );
+
+	header.version = PATHCACHE_FILE_VERSION;
+	header.numNodes = pathcache.numNodes;
+	header.moveTypes = pathcache.moveTypes;
+	header.checksum = pathcache.checksum;
+
+	trap_FS_Write( &header, sizeof( header ), filenum );
+	trap_FS_Write( pathcache.costs, sizeof( int ) * size, filenum );
+	trap_FS_Write( pathcache.nextNodes, sizeof( short int ) * size, filenum );
+	trap_FS_FCloseFile( filenum );
+}
+
+/*
+* AI_PathCache_BuildThread
+*/
+static void *AI_PathCache_BuildThread( void *param )
+{
+	int origin;
+	size_t offset;
+	bool last;
+	astarcontext_t *ctx = ( astarcontext_t * )param;
+
+	while( 1 )
+	{
+		trap_Mutex_Lock( pathcache.lock );
+		origin = -1;
+		if( !pathcache.abort && pathcache.nextOrigin < pathcache.numNodes )
+			origin = pathcache.nextOrigin++;
+		trap_Mutex_Unlock( pathcache.lock );
+
+		if( origin < 0 )
+			break;
+
+		offset = ( size_t )origin * pathcache.numNodes;
+		AStar_GetCostsFrom( ctx, origin, pathcache.moveTypes, pathcache.numNodes,
+			pathcache.costs + offset, pathcache.nextNodes + offset );
+
+		trap_Mutex_Lock( pathcache.lock );
+		last = ( ++pathcache.numDone == pathcache.numNodes );
+		trap_Mutex_Unlock( pathcache.lock );
+
+		if( last )
+		{
+			AI_PathCache_Save();
+
+			trap_Mutex_Lock( pathcache.lock );
+			pathcache.finished = true;
+			trap_Mutex_Unlock( pathcache.lock );
+		}
+	}
+
+	return NULL;
+}
+
+/*
+* AI_PathCache_JoinThreads
+*/
+static void AI_PathCache_JoinThreads( void )
+{
+	int i;
+
+	for( i = 0; i < pathcache.numThreads; i++ )
+	{
+		trap_Thread_Join( pathcache.threads[i] );
+		AStar_FreeContext( pathcache.contexts[i] );
+	}
+	pathcache.numThreads = 0;
+
+	trap_Mutex_Destroy( &pathcache.lock );
+}
+
+/*
+* AI_PathCache_CheckBuild
+* Picks up the tables once the worker threads are done with them
+*/
+static void AI_PathCache_CheckBuild( void )
+{
+	bool finished;
+
+	trap_Mutex_Lock( pathcache.lock );
+	finished = pathcache.finished;
+	trap_Mutex_Unlock( pathcache.lock );
+
+	if( !finished )
+		return;
+
+	AI_PathCache_JoinThreads();
+	pathcache.ready = true;
+
+	G_Printf( "AI path cache built in %.1f seconds\n", ( trap_Milliseconds() - pathcache.buildStart ) * 0.001f );
+}
+
+/*
+* AI_PathCache_Free
+*/
+static void AI_PathCache_Free( void )
+{
+	if( !pathcache.costs )
+		return;
+
+	if( pathcache.numThreads )
+	{
+		trap_Mutex_Lock( pathcache.lock );
+		pathcache.abort = true;
+		trap_Mutex_Unlock( pathcache.lock );
+
+		AI_PathCache_JoinThreads();
+	}
+
+	G_Free( pathcache.costs );
+	G_Free( pathcache.nextNodes );
+
+	memset( &pathcache, 0, sizeof( pathcache ) );
+}
+
+/*
+* AI_PathCache_Clear
+* Must be called before the navigation graph is reset
+*/
+void AI_PathCache_Clear( void )
+{
+	pathcache_rebuild = false;
+	AI_PathCache_Free();
+}
+
+/*
+* AI_PathCache_Invalidate
+* Must be called before a link is added, the cache is rebuilt once the graph settles
+*/
+void AI_PathCache_Invalidate( void )
+{
+	if( !pathcache.costs && !pathcache_rebuild )
+		return;
+
+	if( pathcache.costs )
+		pathcache_rebuildMoveTypes = pathcache.moveTypes;
+	pathcache_rebuild = true;
+	pathcache_rebuildQueued = level.time;
+
+	AI_PathCache_Free();
+}
+
+/*
+* AI_PathCache_Build
+* Loads the cache for the current navigation graph, or starts building it
+*/
+void AI_PathCache_Build( int movetypes )
+{
+	int i, numThreads;
+	size_t size;
+
+	AI_PathCache_Clear();
+
+	ai_pathcache = trap_Cvar_Get( "ai_pathcache", "1", CVAR_ARCHIVE );
+	ai_pathcache_maxmb = trap_Cvar_Get( "ai_pathcache_maxmb", "16", CVAR_ARCHIVE );
+	if( !ai_pathcache->integer || !nav.num_nodes || nav.editmode )
+		return;
+
+	// the tables grow with the square of the node count
+	if( AI_PathCache_MemorySize( nav.num_nodes ) > ( size_t )max( ai_pathcache_maxmb->integer, 0 ) * 1024 * 1024 )
+	{
+		if( developer->integer )
+			G_Printf( "       : path cache disabled, %i nodes need %i MB.\n", nav.num_nodes,
+				(int)( AI_PathCache_MemorySize( nav.num_nodes ) >> 20 ) );
+		return;
+	}
+
+	pathcache.numNodes = nav.num_nodes;
+	pathcache.moveTypes = movetypes;
+	pathcache.checksum = AI_PathCache_Checksum( nav.num_nodes );
+	Q_snprintfz( pathcache.filename, sizeof( pathcache.filename ), "%s/%s_%x.%s", NAV_FILE_FOLDER, level.mapname,
+		movetypes, PATHCACHE_FILE_EXTENSION );
+
+	size = AI_PathCache_TableSize( pathcache.numNodes );
+	pathcache.costs = ( int * )G_Malloc( sizeof( int ) * size );
+	pathcache.nextNodes = ( short int * )G_Malloc( sizeof( short int ) * size );
+
+	if( AI_PathCache_Load() )
+	{
+		pathcache.ready = true;
+		if( developer->integer )
+			G_Printf( "       : loaded path cache %s.\n", pathcache.filename );
+		return;
+	}
+
+	// leave a processor to the server
+	numThreads = trap_GetNumberOfProcessors() - 1;
+	clamp( numThreads, 1, PATHCACHE_MAX_THREADS );
+
+	pathcache.lock = trap_Mutex_Create();
+	pathcache.buildStart = trap_Milliseconds();
+	for( i = 0; i < numThreads; i++ )
+	{
+		pathcache.contexts[i] = AStar_NewContext();
+		pathcache.threads[i] = trap_Thread_Create( AI_PathCache_BuildThread, pathcache.contexts[i] );
+	}
+	pathcache.numThreads = numThreads;
+}
+
+/*
+* AI_PathCache_Usable
+*/
+static bool AI_PathCache_Usable( int from, int to, int movetypes )
+{
+	if( pathcache_rebuild )
+	{
+		if( level.time - pathcache_rebuildQueued < PATHCACHE_REBUILD_DELAY )
+			return false;
+		AI_PathCache_Build( pathcache_rebuildMoveTypes );
+	}
+
+	if( !pathcache.ready )
+	{
+		if( !pathcache.numThreads )
+			return false;
+
+		AI_PathCache_CheckBuild();
+		if( !pathcache.ready )
+			return false;
+	}
+
+	if( nav.editmode || movetypes != pathcache.moveTypes )
+		return false;
+
+	if( from < 0 || from >= pathcache.numNodes || to < 0 || to >= pathcache.numNodes )
+		return false;
+
+	return true;
+}
+
+/*
+* AI_PathCache_FindCost
+* Returns false if the cache can't tell, the cost is -1 when there's no path
+*/
+bool AI_PathCache_FindCost( int from, int to, int movetypes, int *cost )
+{
+	if( !AI_PathCache_Usable( from, to, movetypes ) )
+		return false;
+
+	*cost = pathcache.costs[( size_t )from * pathcache.numNodes + to];
+	return true;
+}
+
+/*
+* AI_PathCache_GetPath
+* Same as AStar_GetPath, but returns -1 if the cache can't tell
+*/
+int AI_PathCache_GetPath( int origin, int goal, int movetypes, struct astarpath_s *path )
+{
+	int node, count;
+
+	if( !AI_PathCache_Usable( origin, goal, movetypes ) )
+		return -1;
+
+	path->numNodes = 0;
+	if( pathcache.costs[( size_t )origin * pathcache.numNodes + goal] < 0 )
+		return 0;
+
+	// count the steps first, the path is stored from the goal backwards
+	for( node = origin, count = 0; node != goal; count++ )
+	{
+		node = pathcache.nextNodes[( size_t )node * pathcache.numNodes + goal];
+		if( node < 0 || count >= pathcache.numNodes )
+			return -1;
+	}
+
+	if( count > (int)( sizeof( path->nodes ) / sizeof( path->nodes[0] ) ) )
+		return -1;
+
+	for( node = origin, count--; node != goal; count-- )
+	{
+		node = pathcache.nextNodes[( size_t )node * pathcache.numNodes + goal];
+		path->nodes[count] = node;
+		path->numNodes++;
+	}
+
+	path->numNodes--;
+	path->originNode = origin;
+	path->goalNode = goal;
+	path->totalDistance = pathcache.costs[( size_t )origin * pathcache.numNodes + goal];
+	return 1;
+}
@@ -244,6 +244,85 @@ void Cmd_SaveNodes_f( void )
 	AI_SaveNavigation();
 }
 
+/*
+* Cmd_BenchNodes_f
+* Times closest node lookups around the loaded nodes against scanning all nodes
+*/
+void Cmd_BenchNodes_f( void )
+{
+	int i, j, numqueries, node, closest, mismatches;
+	float dist, closestdist, range;
+	unsigned int seed, linearTime, gridTime, reachTime;
+	int *results;
+	vec3_t *points;
+
+	if( !nav.num_nodes )
+	{
+		G_Printf( "No navigation nodes loaded\n" );
+		return;
+	}
+
+	numqueries = trap_Cmd_Argc() > 1 ? atoi( trap_Cmd_Argv( 1 ) ) : 100000;
+	clamp( numqueries, 1, 10000000 );
+	range = NODE_DENSITY * 2;
+
+	// the same points for every pass, close to the nodes like the bots' queries
+	points = ( vec3_t * )G_Malloc( sizeof( vec3_t ) * numqueries );
+	for( i = 0, seed = 0x12345; i < numqueries; i++ )
+	{
+		seed = seed * 1103515245 + 12345;
+		node = ( seed >> 8 ) % nav.num_nodes;
+		for( j = 0; j < 3; j++ )
+		{
+			seed = seed * 1103515245 + 12345;
+			points[i][j] = nodes[node].origin[j] + ( (int)( ( seed >> 8 ) % ( NODE_DENSITY * 2 ) ) - NODE_DENSITY );
+		}
+	}
+
+	results = ( int * )G_Malloc( sizeof( int ) * numqueries );
+
+	linearTime = trap_Milliseconds();
+	for( i = 0; i < numqueries; i++ )
+	{
+		closest = NODE_INVALID;
+		closestdist = range;
+		for( j = 0; j < nav.num_nodes; j++ )
+		{
+			dist = DistanceFast( nodes[j].origin, points[i] );
+			if( dist > -1 && dist < closestdist )
+			{
+				closest = j;
+				closestdist = dist;
+			}
+		}
+		results[i] = closest;
+	}
+	linearTime = trap_Milliseconds() - linearTime;
+
+	mismatches = 0;
+	gridTime = trap_Milliseconds();
+	for( i = 0; i < numqueries; i++ )
+	{
+		if( AI_FindClosestNode( points[i], -1, range, NODE_ALL ) != results[i] )
+			mismatches++;
+	}
+	gridTime = trap_Milliseconds() - gridTime;
+
+	reachTime = trap_Milliseconds();
+	for( i = 0; i < numqueries; i++ )
+		AI_FindClosestReachableNode( points[i], NULL, range, NODE_ALL );
+	reachTime = trap_Milliseconds() - reachTime;
+
+	G_Free( results );
+	G_Free( points );
+
+	G_Printf( "%i nodes, %i queries within %i units\n", nav.num_nodes, numqueries, (int)range );
+	G_Printf( "linear scan: %.3f us/query\n", 1000.0f * linearTime / numqueries );
+	G_Printf( "node grid: %.3f us/query\n", 1000.0f * gridTime / numqueries );
+	G_Printf( "reachable node: %.3f us/query\n", 1000.0f * reachTime / numqueries );
+	G_Printf( "mismatches: %i\n", mismatches );
+}
+
 //=======================================================================
 //=======================================================================
 
@@ -67,32 +67,163 @@ static areagrid_t g_areagrid;
 extern cvar_t *g_antilag;
 extern cvar_t *g_antilag_maxtimedelta;
 
-#define	CFRAME_UPDATE_BACKUP	64  // copies of entity_state_t to keep buffered (1 second of backup at 62 fps).
+#define	CFRAME_UPDATE_BACKUP	64  // server frames kept in the antilag history (1 second of backup at 62 fps).
 #define	CFRAME_UPDATE_MASK	( CFRAME_UPDATE_BACKUP-1 )
 
+// what the clipping code needs to know about an entity at some point in time
 typedef struct c4clipedict_s
 {
-	entity_state_t s;
-	entity_shared_t	r;
+	int number;
+	bool inuse;
+	int solid;
+	unsigned int svflags;
+	unsigned int modelindex;
+	int type;
+	int packedsolid;			// entity_state_t solid
+	struct edict_s *owner;
+	vec3_t origin;
+	vec3_t angles;
+	vec3_t mins, maxs;
+	vec3_t absmin, absmax;
 } c4clipedict_t;
 
-//backups of all server frames areas and edicts
-typedef struct c4frame_s
+// collision history of an entity. A record is only added when something changed
+// since the previous backed up frame, and stays valid until the next one.
+// Fields are kept in separate arrays so lookups only touch what they read.
+typedef struct c4history_s
 {
-	c4clipedict_t clipEdicts[MAX_EDICTS];   // fixme: there is a g_maxentities cvar. We have to adjust to it
-	int numedicts;
+	unsigned int numrecords;				// records ever added, the newest is at ( numrecords-1 ) & CFRAME_UPDATE_MASK
+	unsigned int validfrom;					// first frame with the current inuse and solid values
+
+	unsigned int framenum[CFRAME_UPDATE_BACKUP];	// first frame each record is valid for
+	uint8_t inuse[CFRAME_UPDATE_BACKUP];
+	uint8_t solid[CFRAME_UPDATE_BACKUP];
+	unsigned int svflags[CFRAME_UPDATE_BACKUP];
+	unsigned int modelindex[CFRAME_UPDATE_BACKUP];
+	int type[CFRAME_UPDATE_BACKUP];
+	int packedsolid[CFRAME_UPDATE_BACKUP];
+	struct edict_s *owner[CFRAME_UPDATE_BACKUP];
+	vec3_t origin[CFRAME_UPDATE_BACKUP];
+	vec3_t angles[CFRAME_UPDATE_BACKUP];
+	vec3_t mins[CFRAME_UPDATE_BACKUP];
+	vec3_t maxs[CFRAME_UPDATE_BACKUP];
+	vec3_t absmin[CFRAME_UPDATE_BACKUP];
+	vec3_t absmax[CFRAME_UPDATE_BACKUP];
+} c4history_t;
+
+static c4history_t sv_collisionhistory[MAX_EDICTS];	// fixme: there is a g_maxentities cvar. We have to adjust to it
+static unsigned int sv_collisionframetimes[CFRAME_UPDATE_BACKUP];
+static unsigned int sv_collisionFrameNum = 0;
 
-	unsigned int timestamp;
-	unsigned int framenum;
-} c4frame_t;
+/*
+* GClip_IsAntilagEntity
+* Whether the entity is clipped against with a time delta
+*/
+static inline bool GClip_IsAntilagEntity( const edict_t *ent, int entNum )
+{
+	if( !ent->r.inuse || ent->r.solid == SOLID_NOT )
+		return false;
+	if( ent->r.solid == SOLID_TRIGGER && !( entNum >= 1 && entNum <= gs.maxclients ) )
+		return false;
+	return true;
+}
 
-c4frame_t sv_collisionframes[CFRAME_UPDATE_BACKUP];
-static unsigned int sv_collisionFrameNum = 0;
+/*
+* GClip_HistoryChanged
+*/
+static bool GClip_HistoryChanged( const c4history_t *hist, const edict_t *ent, bool antilag )
+{
+	int i;
+
+	if( !hist->numrecords )
+		return true;
+
+	i = ( hist->numrecords - 1 ) & CFRAME_UPDATE_MASK;
+	if( hist->inuse[i] != ( ent->r.inuse ? 1 : 0 ) || hist->solid[i] != ent->r.solid )
+		return true;
+
+	// nothing else is ever read from records of entities which aren't clipped against
+	if( !antilag )
+		return false;
+
+	return !VectorCompare( hist->origin[i], ent->s.origin ) || !VectorCompare( hist->angles[i], ent->s.angles )
+		|| !VectorCompare( hist->mins[i], ent->r.mins ) || !VectorCompare( hist->maxs[i], ent->r.maxs )
+		|| !VectorCompare( hist->absmin[i], ent->r.absmin ) || !VectorCompare( hist->absmax[i], ent->r.absmax )
+		|| hist->svflags[i] != ent->r.svflags || hist->modelindex[i] != ent->s.modelindex
+		|| hist->type[i] != ent->s.type || hist->packedsolid[i] != ent->s.solid
+		|| hist->owner[i] != ent->r.owner;
+}
+
+/*
+* GClip_AddHistoryRecord
+*/
+static void GClip_AddHistoryRecord( c4history_t *hist, const edict_t *ent, unsigned int framenum )
+{
+	int i;
+
+	if( !hist->numrecords )
+	{
+		hist->validfrom = framenum;
+	}
+	else
+	{
+		i = ( hist->numrecords - 1 ) & CFRAME_UPDATE_MASK;
+		if( hist->inuse[i] != ( ent->r.inuse ? 1 : 0 ) || hist->solid[i] != ent->r.solid )
+			hist->validfrom = framenum;
+	}
+
+	i = hist->numrecords & CFRAME_UPDATE_MASK;
+	hist->numrecords++;
+
+	hist->framenum[i] = framenum;
+	hist->inuse[i] = ent->r.inuse ? 1 : 0;
+	hist->solid[i] = ent->r.solid;
+	hist->svflags[i] = ent->r.svflags;
+	hist->modelindex[i] = ent->s.modelindex;
+	hist->type[i] = ent->s.type;
+	hist->packedsolid[i] = ent->s.solid;
+	hist->owner[i] = ent->r.owner;
+	VectorCopy( ent->s.origin, hist->origin[i] );
+	VectorCopy( ent->s.angles, hist->angles[i] );
+	VectorCopy( ent->r.mins, hist->mins[i] );
+	VectorCopy( ent->r.maxs, hist->maxs[i] );
+	VectorCopy( ent->r.absmin, hist->absmin[i] );
+	VectorCopy( ent->r.absmax, hist->absmax[i] );
+}
+
+/*
+* GClip_HistoryRecordForFrame
+* Returns the index of the record valid at the given frame, or -1 if it's no longer known
+*/
+static int GClip_HistoryRecordForFrame( const c4history_t *hist, unsigned int framenum )
+{
+	unsigned int lo, hi, mid;
+
+	lo = hist->numrecords > CFRAME_UPDATE_BACKUP ? hist->numrecords - CFRAME_UPDATE_BACKUP : 0;
+	hi = hist->numrecords;
+	if( lo == hi || hist->framenum[lo & CFRAME_UPDATE_MASK] > framenum )
+		return -1;
+
+	// find the newest record starting at or before the frame
+	while( hi - lo > 1 )
+	{
+		mid = lo + ( hi - lo ) / 2;
+		if( hist->framenum[mid & CFRAME_UPDATE_MASK] <= framenum )
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	return lo & CFRAME_UPDATE_MASK;
+}
 
+/*
+* GClip_BackUpCollisionFrame
+*/
 void GClip_BackUpCollisionFrame( void )
 {
-	c4frame_t *cframe;
 	edict_t	*svedict;
+	bool antilag;
 	int i;
 
 	if( !g_antilag->integer )
@@ -100,28 +231,61 @@ void GClip_BackUpCollisionFrame( void )
 
 	// fixme: should check for any validation here?
 
-	cframe = &sv_collisionframes[sv_collisionFrameNum & CFRAME_UPDATE_MASK];
-	cframe->timestamp = game.serverTime;
-	cframe->framenum = sv_collisionFrameNum;
-	sv_collisionFrameNum++;
+	sv_collisionframetimes[sv_collisionFrameNum & CFRAME_UPDATE_MASK] = game.serverTime;
 
-	//memset( cframe->clipEdicts, 0, sizeof(cframe->clipEdicts) );
-
-	//backup edicts
+	// only entities which changed since the last frame get a new record
 	for( i = 0; i < game.numentities; i++ )
 	{
 		svedict = &game.edicts[i];
 
-		cframe->clipEdicts[i].r.inuse = svedict->r.inuse;
-		cframe->clipEdicts[i].r.solid = svedict->r.solid;
-		if( !svedict->r.inuse || svedict->r.solid == SOLID_NOT 
-			|| ( svedict->r.solid == SOLID_TRIGGER && !(i >= 1 && i <= gs.maxclients) ) )
-			continue;
-
-		cframe->clipEdicts[i].r = svedict->r;
-		cframe->clipEdicts[i].s = svedict->s;
+		antilag = GClip_IsAntilagEntity( svedict, i );
+		if( GClip_HistoryChanged( &sv_collisionhistory[i], svedict, antilag ) )
+			GClip_AddHistoryRecord( &sv_collisionhistory[i], svedict, sv_collisionFrameNum );
 	}
-	cframe->numedicts = game.numentities;
+
+	sv_collisionFrameNum++;
+}
+
+/*
+* GClip_SetClipEdictFromEntity
+*/
+static void GClip_SetClipEdictFromEntity( c4clipedict_t *clipent, const edict_t *ent )
+{
+	clipent->number = ent->s.number;
+	clipent->inuse = ent->r.inuse;
+	clipent->solid = ent->r.solid;
+	clipent->svflags = ent->r.svflags;
+	clipent->modelindex = ent->s.modelindex;
+	clipent->type = ent->s.type;
+	clipent->packedsolid = ent->s.solid;
+	clipent->owner = ent->r.owner;
+	VectorCopy( ent->s.origin, clipent->origin );
+	VectorCopy( ent->s.angles, clipent->angles );
+	VectorCopy( ent->r.mins, clipent->mins );
+	VectorCopy( ent->r.maxs, clipent->maxs );
+	VectorCopy( ent->r.absmin, clipent->absmin );
+	VectorCopy( ent->r.absmax, clipent->absmax );
+}
+
+/*
+* GClip_SetClipEdictFromHistory
+*/
+static void GClip_SetClipEdictFromHistory( c4clipedict_t *clipent, const edict_t *ent, const c4history_t *hist, int i )
+{
+	clipent->number = ent->s.number;
+	clipent->inuse = hist->inuse[i] ? true : false;
+	clipent->solid = hist->solid[i];
+	clipent->svflags = hist->svflags[i];
+	clipent->modelindex = hist->modelindex[i];
+	clipent->type = hist->type[i];
+	clipent->packedsolid = hist->packedsolid[i];
+	clipent->owner = hist->owner[i];
+	VectorCopy( hist->origin[i], clipent->origin );
+	VectorCopy( hist->angles[i], clipent->angles );
+	VectorCopy( hist->mins[i], clipent->mins );
+	VectorCopy( hist->maxs[i], clipent->maxs );
+	VectorCopy( hist->absmin[i], clipent->absmin );
+	VectorCopy( hist->absmax[i], clipent->absmax );
 }
 
 static c4clipedict_t *GClip_GetClipEdictForDeltaTime( int entNum, int deltaTime )
@@ -129,27 +293,20 @@ static c4clipedict_t *GClip_GetClipEdictForDeltaTime( int entNum, int deltaTime
 	static int index = 0;
 	static c4clipedict_t clipEnts[8];
 	static c4clipedict_t *clipent;
-	static c4clipedict_t clipentNewer; // for interpolation
-	c4frame_t *cframe = NULL;
-	unsigned int backTime, cframenum, bf, i;
+	const c4history_t *hist;
+	unsigned int backTime, numframes, oldest, lo, hi, mid, framenum, i;
+	float lerpFrac;
+	int rec, newerRec;
 	edict_t	*ent = game.edicts + entNum;
 
 	// pick one of the 8 slots to prevent overwritings
 	clipent = &clipEnts[index];
 	index = ( index + 1 )&7;
 
-	if( !entNum || deltaTime >= 0 || !g_antilag->integer )
-	{                                                    // current time entity
-		clipent->r = ent->r;
-		clipent->s = ent->s;
-		return clipent;
-	}
-
-	if( !ent->r.inuse || ent->r.solid == SOLID_NOT 
-		|| ( ent->r.solid == SOLID_TRIGGER && !(entNum >= 1 && entNum <= gs.maxclients) ) )
+	if( !entNum || deltaTime >= 0 || !g_antilag->integer || !GClip_IsAntilagEntity( ent, entNum ) )
 	{
-		clipent->r = ent->r;
-		clipent->s = ent->s;
+		// current time entity
+		GClip_SetClipEdictFromEntity( clipent, ent );
 		return clipent;
 	}
 
@@ -163,84 +320,100 @@ static c4clipedict_t *GClip_GetClipEdictForDeltaTime( int entNum, int deltaTime
 			backTime = (unsigned int)g_antilag_maxtimedelta->integer;
 	}
 
-	// find the first snap with timestamp < than realtime - backtime
-	cframenum = sv_collisionFrameNum;
-	for( bf = 1; bf < CFRAME_UPDATE_BACKUP && bf < sv_collisionFrameNum; bf++ ) // never overpass limits
+	hist = &sv_collisionhistory[entNum];
+	if( sv_collisionFrameNum < 2 || !hist->numrecords )
 	{
-		cframe = &sv_collisionframes[( cframenum-bf ) & CFRAME_UPDATE_MASK];
+		GClip_SetClipEdictFromEntity( clipent, ent );
+		return clipent;
+	}
+
+	// backed up frames [oldest, sv_collisionFrameNum-1] are usable, the one written
+	// first is never used (never overpass limits)
+	numframes = min( CFRAME_UPDATE_BACKUP - 1, sv_collisionFrameNum - 1 );
+	oldest = sv_collisionFrameNum - numframes;
 
-		// if solid has changed, we can't keep moving backwards
-		if( ent->r.solid != cframe->clipEdicts[entNum].r.solid 
-			|| ent->r.inuse != cframe->clipEdicts[entNum].r.inuse )
+	// binary search for the newest frame with timestamp <= realtime - backtime,
+	// or the oldest one if they are all newer
+	lo = oldest;
+	if( game.serverTime >= sv_collisionframetimes[lo & CFRAME_UPDATE_MASK] + backTime )
+	{
+		hi = sv_collisionFrameNum;
+		while( hi - lo > 1 )
 		{
-			bf--;
-			if( bf == 0 )
-			{
-				// we can't step back from first
-				cframe = NULL;
-			}
+			mid = lo + ( hi - lo ) / 2;
+			if( game.serverTime >= sv_collisionframetimes[mid & CFRAME_UPDATE_MASK] + backTime )
+				lo = mid;
 			else
-			{
-				cframe = &sv_collisionframes[( cframenum-bf ) & CFRAME_UPDATE_MASK];
-			}
-			break;
+				hi = mid;
 		}
+	}
+	framenum = lo;
 
-		if( game.serverTime >= cframe->timestamp + backTime )
-			break;
+	// if solid has changed, we can't move further back than the change
+	rec = ( hist->numrecords - 1 ) & CFRAME_UPDATE_MASK;
+	if( hist->inuse[rec] != ( ent->r.inuse ? 1 : 0 ) || hist->solid[rec] != ent->r.solid )
+	{
+		// changed after the last backup, we can't step back from first
+		GClip_SetClipEdictFromEntity( clipent, ent );
+		return clipent;
 	}
 
-	if( !cframe )
+	if( framenum < hist->validfrom )
 	{
-		// current time entity
-		clipent->r = ent->r;
-		clipent->s = ent->s;
+		rec = GClip_HistoryRecordForFrame( hist, hist->validfrom );
+		GClip_SetClipEdictFromHistory( clipent, ent, hist, rec );
+		return clipent;
+	}
+
+	rec = GClip_HistoryRecordForFrame( hist, framenum );
+	if( rec < 0 )
+	{
+		GClip_SetClipEdictFromEntity( clipent, ent );
 		return clipent;
 	}
 
 	// setup with older for the data that is not interpolated
-	*clipent = cframe->clipEdicts[entNum];
+	GClip_SetClipEdictFromHistory( clipent, ent, hist, rec );
 
 	// if we found an older than desired backtime frame, interpolate to find a more precise position.
-	if( game.serverTime > cframe->timestamp+backTime )
+	if( game.serverTime > sv_collisionframetimes[framenum & CFRAME_UPDATE_MASK] + backTime )
 	{
-		float lerpFrac;
+		const float *origin, *mins, *maxs, *angles;
+		unsigned int timestamp = sv_collisionframetimes[framenum & CFRAME_UPDATE_MASK];
 
-		if( bf == 1 )
+		if( framenum + 1 == sv_collisionFrameNum )
 		{
-			// interpolate from 1st backed up to current
-			lerpFrac = (float)( ( game.serverTime - backTime ) - cframe->timestamp ) 
-				/ (float)( game.serverTime - cframe->timestamp );
-			clipentNewer.r = ent->r;
-			clipentNewer.s = ent->s;
+			// interpolate from last backed up to current
+			lerpFrac = (float)( ( game.serverTime - backTime ) - timestamp ) 
+				/ (float)( game.serverTime - timestamp );
+			origin = ent->s.origin;
+			angles = ent->s.angles;
+			mins = ent->r.mins;
+			maxs = ent->r.maxs;
 		}
 		else
 		{
 			// interpolate between 2 backed up
-			c4frame_t *cframeNewer = &sv_collisionframes[( cframenum-( bf-1 ) ) & CFRAME_UPDATE_MASK];
-			lerpFrac = (float)( ( game.serverTime - backTime ) - cframe->timestamp ) 
-				/ (float)( cframeNewer->timestamp - cframe->timestamp );
-			clipentNewer = cframeNewer->clipEdicts[entNum];
+			newerRec = GClip_HistoryRecordForFrame( hist, framenum + 1 );
+			if( newerRec == rec )
+				return clipent; // didn't move in between
+
+			lerpFrac = (float)( ( game.serverTime - backTime ) - timestamp ) 
+				/ (float)( sv_collisionframetimes[( framenum + 1 ) & CFRAME_UPDATE_MASK] - timestamp );
+			origin = hist->origin[newerRec];
+			angles = hist->angles[newerRec];
+			mins = hist->mins[newerRec];
+			maxs = hist->maxs[newerRec];
 		}
 
-#if 0
-		G_Printf( "backTime:%i cframeBackTime:%i backFrames:%i lerfrac:%f\n",
-			backTime, game.serverTime - cframe->timestamp, backframes, lerpFrac );
-#endif
-
 		// interpolate
-		VectorLerp( clipent->s.origin, lerpFrac, clipentNewer.s.origin, clipent->s.origin );
-		VectorLerp( clipent->r.mins, lerpFrac, clipentNewer.r.mins, clipent->r.mins );
-		VectorLerp( clipent->r.maxs, lerpFrac, clipentNewer.r.maxs, clipent->r.maxs );
+		VectorLerp( clipent->origin, lerpFrac, origin, clipent->origin );
+		VectorLerp( clipent->mins, lerpFrac, mins, clipent->mins );
+		VectorLerp( clipent->maxs, lerpFrac, maxs, clipent->maxs );
 		for( i = 0; i < 3; i++ )
-			clipent->s.angles[i] = LerpAngle( clipent->s.angles[i], clipentNewer.s.angles[i], lerpFrac );
+			clipent->angles[i] = LerpAngle( clipent->angles[i], angles[i], lerpFrac );
 	}
 
-#if 0
-	G_Printf( "backTime:%i cframeBackTime:%i backFrames:%i\n", backTime,
-		game.serverTime - cframe->timestamp, backframes );
-#endif
-
 	// back time entity
 	return clipent;
 }
@@ -427,18 +600,18 @@ static int GClip_EntitiesInBox_AreaGrid( areagrid_t *areagrid, const vec3_t mins
 			}
 			areagrid->entmarknumber[l->entNum] = areagrid->marknumber;
 
-			if( !clipEnt->r.inuse ) {
+			if( !clipEnt->inuse ) {
 				continue; // deactivated
 			}
-			if( areatype == AREA_TRIGGERS && clipEnt->r.solid != SOLID_TRIGGER ) {
+			if( areatype == AREA_TRIGGERS && clipEnt->solid != SOLID_TRIGGER ) {
 				continue;
 			}
 			if( areatype == AREA_SOLID && 
-				( clipEnt->r.solid == SOLID_TRIGGER || clipEnt->r.solid == SOLID_NOT ) ) {
+				( clipEnt->solid == SOLID_TRIGGER || clipEnt->solid == SOLID_NOT ) ) {
 				continue;
 			}
 
-			if( BoundsIntersect( paddedmins, paddedmaxs, clipEnt->r.absmin, clipEnt->r.absmax )) {
+			if( BoundsIntersect( paddedmins, paddedmaxs, clipEnt->absmin, clipEnt->absmax )) {
 				if( numlist < maxcount ) {
 					list[numlist] = l->entNum;
 				}
@@ -464,18 +637,18 @@ static int GClip_EntitiesInBox_AreaGrid( areagrid_t *areagrid, const vec3_t mins
 				}
 				areagrid->entmarknumber[l->entNum] = areagrid->marknumber;
 
-				if( !clipEnt->r.inuse ) {
+				if( !clipEnt->inuse ) {
 					continue; // deactivated
 				}
-				if( areatype == AREA_TRIGGERS && clipEnt->r.solid != SOLID_TRIGGER ) {
+				if( areatype == AREA_TRIGGERS && clipEnt->solid != SOLID_TRIGGER ) {
 					continue;
 				}
 				if( areatype == AREA_SOLID && 
-					( clipEnt->r.solid == SOLID_TRIGGER || clipEnt->r.solid == SOLID_NOT ) ) {
+					( clipEnt->solid == SOLID_TRIGGER || clipEnt->solid == SOLID_NOT ) ) {
 					continue;
 				}
 
-				if( BoundsIntersect( paddedmins, paddedmaxs, clipEnt->r.absmin, clipEnt->r.absmax )) {
+				if( BoundsIntersect( paddedmins, paddedmaxs, clipEnt->absmin, clipEnt->absmax )) {
 					if( numlist < maxcount ) {
 						list[numlist] = l->entNum;
 					}
@@ -731,14 +904,14 @@ static int GClip_AreaEdicts( const vec3_t mins, const vec3_t maxs,
 * Returns a collision model that can be used for testing or clipping an
 * object of mins/maxs size.
 */
-static struct cmodel_s *GClip_CollisionModelForEntity( entity_state_t *s, entity_shared_t *r )
+static struct cmodel_s *GClip_CollisionModelForEntity( c4clipedict_t *clipEnt )
 {
 	struct cmodel_s	*model;
 
-	if( ISBRUSHMODEL( s->modelindex ) )
+	if( ISBRUSHMODEL( clipEnt->modelindex ) )
 	{ 
 		// explicit hulls in the BSP model
-		model = trap_CM_InlineModel( s->modelindex );
+		model = trap_CM_InlineModel( clipEnt->modelindex );
 		if( !model )
 			G_Error( "MOVETYPE_PUSH with a non bsp model" );
 
@@ -746,10 +919,10 @@ static struct cmodel_s *GClip_CollisionModelForEntity( entity_state_t *s, entity
 	}
 
 	// create a temp hull from bounding box sizes
-	if( s->type == ET_PLAYER || s->type == ET_CORPSE )
-		return trap_CM_OctagonModelForBBox( r->mins, r->maxs );
+	if( clipEnt->type == ET_PLAYER || clipEnt->type == ET_CORPSE )
+		return trap_CM_OctagonModelForBBox( clipEnt->mins, clipEnt->maxs );
 	else
-		return trap_CM_ModelForBBox( r->mins, r->maxs );
+		return trap_CM_ModelForBBox( clipEnt->mins, clipEnt->maxs );
 }
 
 
@@ -777,9 +950,9 @@ static int GClip_PointContents( vec3_t p, int timeDelta )
 		clipEnt = GClip_GetClipEdictForDeltaTime( touch[i], timeDelta );
 
 		// might intersect, so do an exact clip
-		cmodel = GClip_CollisionModelForEntity( &clipEnt->s, &clipEnt->r );
+		cmodel = GClip_CollisionModelForEntity( clipEnt );
 
-		c2 = trap_CM_TransformedPointContents( p, cmodel, clipEnt->s.origin, clipEnt->s.angles );
+		c2 = trap_CM_TransformedPointContents( p, cmodel, clipEnt->origin, clipEnt->angles );
 		contents |= c2;
 	}
 
@@ -809,6 +982,34 @@ typedef struct
 	int contentmask;
 } moveclip_t;
 
+/*
+* GClip_IgnoreClipEdict
+* Whether moves from passent are never clipped against the entity
+*/
+static bool GClip_IgnoreClipEdict( c4clipedict_t *touch, int passent, int contentmask )
+{
+	if( passent >= 0 )
+	{
+		// when they are offseted in time, they can be a different pointer but be the same entity
+		if( touch->number == passent )
+			return true;
+		if( touch->owner && ( touch->owner->s.number == passent ) )
+			return true;
+		if( game.edicts[passent].r.owner 
+			&& ( game.edicts[passent].r.owner->s.number == touch->number ) )
+			return true;
+
+		// wsw : jal : never clipmove against SVF_PROJECTILE entities
+		if( touch->svflags & SVF_PROJECTILE )
+			return true;
+	}
+
+	if( ( touch->svflags & SVF_CORPSE ) && !( contentmask & CONTENTS_CORPSE ) )
+		return true;
+
+	return false;
+}
+
 /*
 * GClip_ClipMoveToEntities
 */
@@ -828,40 +1029,24 @@ typedef struct
 	for( i = 0; i < num; i++ )
 	{
 		touch = GClip_GetClipEdictForDeltaTime( touchlist[i], timeDelta );
-		if( clip->passent >= 0 )
-		{
-			// when they are offseted in time, they can be a different pointer but be the same entity
-			if( touch->s.number == clip->passent )
-				continue;
-			if( touch->r.owner && ( touch->r.owner->s.number == clip->passent ) )
-				continue;
-			if( game.edicts[clip->passent].r.owner 
-				&& ( game.edicts[clip->passent].r.owner->s.number == touch->s.number ) )
-				continue;
-
-			// wsw : jal : never clipmove against SVF_PROJECTILE entities
-			if( touch->r.svflags & SVF_PROJECTILE )
-				continue;
-		}
-
-		if( ( touch->r.svflags & SVF_CORPSE ) && !( clip->contentmask & CONTENTS_CORPSE ) )
+		if( GClip_IgnoreClipEdict( touch, clip->passent, clip->contentmask ) )
 			continue;
 
 		// might intersect, so do an exact clip
-		cmodel = GClip_CollisionModelForEntity( &touch->s, &touch->r );
+		cmodel = GClip_CollisionModelForEntity( touch );
 
-		if( ISBRUSHMODEL( touch->s.modelindex ) )
-			angles = touch->s.angles;
+		if( ISBRUSHMODEL( touch->modelindex ) )
+			angles = touch->angles;
 		else
 			angles = vec3_origin; // boxes don't rotate
 
 		trap_CM_TransformedBoxTrace( &trace, clip->start, clip->end,
 			clip->mins, clip->maxs, cmodel, clip->contentmask,
-			touch->s.origin, angles );
+			touch->origin, angles );
 
 		if( trace.allsolid || trace.fraction < clip->trace->fraction )
 		{
-			trace.ent = touch->s.number;
+			trace.ent = touch->number;
 			*( clip->trace ) = trace;
 		}
 		else if( trace.startsolid )
@@ -970,6 +1155,123 @@ void G_Trace4D( trace_t *tr, vec3_t start, vec3_t mins, vec3_t maxs,
 {
 	GClip_Trace( tr, start, mins, maxs, end, passedict, contentmask, timeDelta );
 }
+
+/*
+* G_TraceMulti4D
+* 
+* Same as G_Trace4D for numtraces moves sharing the same box size, passedict and
+* contentmask, like pellet spreads. The entities they may hit are gathered and
+* set up only once for all of them, instead of once per move.
+*/
+void G_TraceMulti4D( trace_t *traces, int numtraces, vec3_t *starts, vec3_t mins, vec3_t maxs, 
+	vec3_t *ends, edict_t *passedict, int contentmask, int timeDelta )
+{
+	int i, j, num, numactive, passent;
+	int touchlist[MAX_EDICTS];
+	bool active[MAX_MULTITRACE];
+	vec3_t boxmins[MAX_MULTITRACE], boxmaxs[MAX_MULTITRACE];
+	vec3_t allmins, allmaxs;
+	c4clipedict_t *touch;
+	struct cmodel_s	*cmodel;
+	float *angles;
+	trace_t	trace, *tr;
+
+	if( numtraces > MAX_MULTITRACE )
+	{
+		G_TraceMulti4D( traces + MAX_MULTITRACE, numtraces - MAX_MULTITRACE, starts + MAX_MULTITRACE, 
+			mins, maxs, ends + MAX_MULTITRACE, passedict, contentmask, timeDelta );
+		numtraces = MAX_MULTITRACE;
+	}
+
+	if( !mins )
+		mins = vec3_origin;
+	if( !maxs )
+		maxs = vec3_origin;
+
+	passent = passedict ? ENTNUM( passedict ) : -1;
+
+	// clip to world, each move on its own
+	ClearBounds( allmins, allmaxs );
+	numactive = 0;
+	for( i = 0; i < numtraces; i++ )
+	{
+		tr = &traces[i];
+		active[i] = false;
+
+		if( passedict == world )
+		{
+			memset( tr, 0, sizeof( trace_t ) );
+			tr->fraction = 1;
+			tr->ent = -1;
+		}
+		else
+		{
+			trap_CM_TransformedBoxTrace( tr, starts[i], ends[i], mins, maxs, NULL, contentmask, NULL, NULL );
+			tr->ent = tr->fraction < 1.0 ? world->s.number : -1;
+			if( tr->fraction == 0 )
+				continue; // blocked by the world
+		}
+
+		// create the bounding box of the entire move
+		GClip_TraceBounds( starts[i], mins, maxs, ends[i], boxmins[i], boxmaxs[i] );
+		AddPointToBounds( boxmins[i], allmins, allmaxs );
+		AddPointToBounds( boxmaxs[i], allmins, allmaxs );
+
+		active[i] = true;
+		numactive++;
+	}
+
+	if( !numactive )
+		return;
+
+	// clip to other solid entities, gathered for all moves at once
+	num = GClip_AreaEdicts( allmins, allmaxs, touchlist, MAX_EDICTS, AREA_SOLID, timeDelta );
+
+	for( j = 0; j < num && numactive; j++ )
+	{
+		touch = GClip_GetClipEdictForDeltaTime( touchlist[j], timeDelta );
+		if( GClip_IgnoreClipEdict( touch, passent, contentmask ) )
+			continue;
+
+		cmodel = NULL;
+		angles = vec3_origin; // boxes don't rotate
+
+		for( i = 0; i < numtraces; i++ )
+		{
+			if( !active[i] )
+				continue;
+			if( !BoundsIntersect( boxmins[i], boxmaxs[i], touch->absmin, touch->absmax ) )
+				continue;
+
+			// might intersect, so do an exact clip
+			if( !cmodel )
+			{
+				cmodel = GClip_CollisionModelForEntity( touch );
+				if( ISBRUSHMODEL( touch->modelindex ) )
+					angles = touch->angles;
+			}
+
+			tr = &traces[i];
+			trap_CM_TransformedBoxTrace( &trace, starts[i], ends[i],
+				mins, maxs, cmodel, contentmask,
+				touch->origin, angles );
+
+			if( trace.allsolid || trace.fraction < tr->fraction )
+			{
+				trace.ent = touch->number;
+				*tr = trace;
+			}
+			else if( trace.startsolid )
+				tr->startsolid = true;
+
+			if( tr->allsolid )
+			{
+				active[i] = false;
+				numactive--;
+			}
+		}
+	}
+}
 //===========================================================================
 
 
@@ -1218,12 +1520,15 @@ void G_SplashFrac4D( int entNum, vec3_t hitpoint, float maxradius, vec3_t pushdi
 	c4clipedict_t *clipEnt;
 
 	clipEnt = GClip_GetClipEdictForDeltaTime( entNum, timeDelta );
-	G_SplashFrac( clipEnt->s.origin, clipEnt->r.mins, clipEnt->r.maxs, hitpoint, 
+	G_SplashFrac( clipEnt->origin, clipEnt->mins, clipEnt->maxs, hitpoint, 
 		maxradius, pushdir, kickFrac, dmgFrac );
 }
 
 entity_state_t *G_GetEntityStateForDeltaTime( int entNum, int deltaTime )
 {
+	static int index = 0;
+	static entity_state_t states[8];
+	entity_state_t *state;
 	c4clipedict_t *clipEnt;
 
 	if( entNum == -1 )
@@ -1231,8 +1536,22 @@ entity_state_t *G_GetEntityStateForDeltaTime( int entNum, int deltaTime )
 
 	assert( entNum >= 0 && entNum < MAX_EDICTS );
 
+	// pick one of the 8 slots to prevent overwritings
+	state = &states[index];
+	index = ( index + 1 )&7;
+
+	*state = game.edicts[entNum].s;
+	if( deltaTime >= 0 )
+		return state;
+
 	clipEnt = GClip_GetClipEdictForDeltaTime( entNum, deltaTime );
 
-	return &clipEnt->s;
+	state->modelindex = clipEnt->modelindex;
+	state->type = clipEnt->type;
+	state->solid = clipEnt->packedsolid;
+	VectorCopy( clipEnt->origin, state->origin );
+	VectorCopy( clipEnt->angles, state->angles );
+
+	return state;
 }
 
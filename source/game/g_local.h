@@ -731,6 +731,7 @@ void SP_trigger_gravity( edict_t *ent );
 // g_clip.c
 //
 #define MAX_ENT_AREAS 16
+#define MAX_MULTITRACE 64	// moves traced together by G_TraceMulti4D
 
 typedef struct link_s
 {
@@ -742,6 +743,7 @@ int	G_PointContents( vec3_t p );
 void G_Trace( trace_t *tr, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, edict_t *passedict, int contentmask );
 int G_PointContents4D( vec3_t p, int timeDelta );
 void G_Trace4D( trace_t *tr, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, edict_t *passedict, int contentmask, int timeDelta );
+void G_TraceMulti4D( trace_t *traces, int numtraces, vec3_t *starts, vec3_t mins, vec3_t maxs, vec3_t *ends, edict_t *passedict, int contentmask, int timeDelta );
 void GClip_BackUpCollisionFrame( void );
 int GClip_FindInRadius4D( vec3_t org, float rad, int *list, int maxcount, int timeDelta );
 void G_SplashFrac4D( int entNum, vec3_t hitpoint, float maxradius, vec3_t pushdir, float *kickFrac, float *dmgFrac, int timeDelta );
@@ -377,6 +377,90 @@ static void Cmd_ListLocations_f( void )
 	}
 }
 
+/*
+* Cmd_BenchTraces_f
+* Times pellet spreads from open points of the map traced one by one and batched
+*/
+static void Cmd_BenchTraces_f( void )
+{
+	int i, j, k, numshots, numpellets, numtraces, mismatches, attempts, seed;
+	float fi;
+	unsigned int singleTime, batchTime;
+	vec3_t *starts, *ends, dir, right, up;
+	trace_t *traces, trace;
+
+	if( !world->r.inuse )
+	{
+		G_Printf( "No map loaded\n" );
+		return;
+	}
+
+	numshots = trap_Cmd_Argc() > 1 ? atoi( trap_Cmd_Argv( 1 ) ) : 10000;
+	numpellets = trap_Cmd_Argc() > 2 ? atoi( trap_Cmd_Argv( 2 ) ) : 20;
+	clamp( numshots, 1, 1000000 );
+	clamp( numpellets, 1, MAX_MULTITRACE );
+	numtraces = numshots * numpellets;
+
+	// the same shots for every pass, fired from random points out of the solid
+	starts = ( vec3_t * )G_Malloc( sizeof( vec3_t ) * numtraces );
+	ends = ( vec3_t * )G_Malloc( sizeof( vec3_t ) * numtraces );
+	traces = ( trace_t * )G_Malloc( sizeof( trace_t ) * numtraces );
+
+	seed = 0x12345;
+	for( i = 0; i < numshots; i++ )
+	{
+		k = i * numpellets;
+		for( attempts = 0; attempts < 64; attempts++ )
+		{
+			for( j = 0; j < 3; j++ )
+				starts[k][j] = world->r.absmin[j] + Q_random( &seed ) * ( world->r.absmax[j] - world->r.absmin[j] );
+			if( !( G_PointContents( starts[k] ) & MASK_SOLID ) )
+				break;
+		}
+
+		VectorSet( dir, Q_crandom( &seed ), Q_crandom( &seed ), Q_crandom( &seed ) * 0.5f );
+		VectorNormalize( dir );
+		MakeNormalVectors( dir, right, up );
+
+		// riotgun like sunflower spread
+		for( j = 0; j < numpellets; j++ )
+		{
+			fi = j * 2.4;
+			VectorCopy( starts[k], starts[k + j] );
+			VectorMA( starts[k], 8192, dir, ends[k + j] );
+			VectorMA( ends[k + j], cos( fi ) * 80 * sqrt( fi ), right, ends[k + j] );
+			VectorMA( ends[k + j], sin( fi ) * 80 * sqrt( fi ), up, ends[k + j] );
+		}
+	}
+
+	singleTime = trap_Milliseconds();
+	for( i = 0; i < numtraces; i++ )
+		G_Trace4D( &traces[i], starts[i], NULL, NULL, ends[i], NULL, MASK_SHOT, 0 );
+	singleTime = trap_Milliseconds() - singleTime;
+
+	mismatches = 0;
+	batchTime = trap_Milliseconds();
+	for( i = 0; i < numtraces; i += numpellets )
+		G_TraceMulti4D( traces + i, numpellets, starts + i, NULL, NULL, ends + i, NULL, MASK_SHOT, 0 );
+	batchTime = trap_Milliseconds() - batchTime;
+
+	for( i = 0; i < numtraces; i++ )
+	{
+		G_Trace4D( &trace, starts[i], NULL, NULL, ends[i], NULL, MASK_SHOT, 0 );
+		if( trace.fraction != traces[i].fraction || trace.ent != traces[i].ent )
+			mismatches++;
+	}
+
+	G_Printf( "%i shots of %i pellets\n", numshots, numpellets );
+	G_Printf( "single: %u ms, %.0f traces/sec\n", singleTime, numtraces * 1000.0f / max( singleTime, 1 ) );
+	G_Printf( "batched: %u ms, %.0f traces/sec\n", batchTime, numtraces * 1000.0f / max( batchTime, 1 ) );
+	G_Printf( "%i mismatches\n", mismatches );
+
+	G_Free( starts );
+	G_Free( ends );
+	G_Free( traces );
+}
+
 /*
 * G_AddCommands
 */
@@ -400,6 +484,7 @@ void G_AddServerCommands( void )
 	trap_Cmd_AddCommand( "editnodes", AITools_InitEditnodes );
 	trap_Cmd_AddCommand( "makenodes", AITools_InitMakenodes );
 	trap_Cmd_AddCommand( "savenodes", Cmd_SaveNodes_f );
+	trap_Cmd_AddCommand( "benchnodes", Cmd_BenchNodes_f );
 	trap_Cmd_AddCommand( "addnode", AITools_AddNode_Cmd );
 	trap_Cmd_AddCommand( "dropnode", AITools_AddNode_Cmd );
 	trap_Cmd_AddCommand( "addbotroam", AITools_AddBotRoamNode_Cmd );
@@ -410,6 +495,8 @@ void G_AddServerCommands( void )
 	trap_Cmd_AddCommand( "listraces", G_ListRaces_f );
 
 	trap_Cmd_AddCommand( "listlocations", Cmd_ListLocations_f );
+
+	trap_Cmd_AddCommand( "benchtraces", Cmd_BenchTraces_f );
 }
 
 /*
@@ -435,6 +522,7 @@ void G_RemoveCommands( void )
 	trap_Cmd_RemoveCommand( "editnodes" );
 	trap_Cmd_RemoveCommand( "makenodes" );
 	trap_Cmd_RemoveCommand( "savenodes" );
+	trap_Cmd_RemoveCommand( "benchnodes" );
 	trap_Cmd_RemoveCommand( "addnode" );
 	trap_Cmd_RemoveCommand( "dropnode" );
 	trap_Cmd_RemoveCommand( "addbotroam" );
@@ -445,4 +533,6 @@ void G_RemoveCommands( void )
 	trap_Cmd_RemoveCommand( "listraces" );
 
 	trap_Cmd_RemoveCommand( "listlocations" );
+
+	trap_Cmd_RemoveCommand( "benchtraces" );
 }
@@ -533,33 +533,98 @@ void W_Fire_Bullet( edict_t *self, vec3_t start, vec3_t angles, int seed, int ra
 	}
 }
 
+/*
+* G_TraceBullets
+* 
+* Same as GS_TraceBullet for each of the r, u offsets, but tracing all of them
+* together. All bullets are traced before any of them does damage.
+*/
+static void G_TraceBullets( trace_t *traces, int count, vec3_t start, vec3_t dir, float *r, float *u, 
+	int range, edict_t *self, int timeDelta )
+{
+	int i, numwater;
+	mat3_t axis;
+	int content_mask = MASK_SHOT | MASK_WATER;
+	vec3_t starts[MAX_MULTITRACE], ends[MAX_MULTITRACE];
+	vec3_t water_starts[MAX_MULTITRACE], water_ends[MAX_MULTITRACE];
+	trace_t water_traces[MAX_MULTITRACE];
+	int water_bullets[MAX_MULTITRACE];
+
+	assert( count <= MAX_MULTITRACE );
+
+	VectorNormalizeFast( dir );
+	NormalVectorToAxis( dir, axis );
+
+	if( G_PointContents4D( start, timeDelta ) & MASK_WATER )
+		content_mask &= ~MASK_WATER;
+
+	for( i = 0; i < count; i++ )
+	{
+		VectorCopy( start, starts[i] );
+		VectorMA( start, range, &axis[AXIS_FORWARD], ends[i] );
+		if( r[i] ) VectorMA( ends[i], r[i], &axis[AXIS_RIGHT], ends[i] );
+		if( u[i] ) VectorMA( ends[i], u[i], &axis[AXIS_UP], ends[i] );
+	}
+
+	G_TraceMulti4D( traces, count, starts, vec3_origin, vec3_origin, ends, self, content_mask, timeDelta );
+
+	// re-trace the bullets which hit water ignoring water this time
+	numwater = 0;
+	for( i = 0; i < count; i++ )
+	{
+		if( !( traces[i].contents & MASK_WATER ) )
+			continue;
+
+		VectorCopy( traces[i].endpos, water_starts[numwater] );
+		VectorCopy( ends[i], water_ends[numwater] );
+		water_bullets[numwater++] = i;
+	}
+
+	if( !numwater )
+		return;
+
+	G_TraceMulti4D( water_traces, numwater, water_starts, vec3_origin, vec3_origin, water_ends, self, MASK_SHOT, timeDelta );
+	for( i = 0; i < numwater; i++ )
+		traces[water_bullets[i]] = water_traces[i];
+}
+
 //Sunflower spiral with Fibonacci numbers 
 static void G_Fire_SunflowerPattern( edict_t *self, vec3_t start, vec3_t dir, int *seed, int count, 
 	int hspread, int vspread, int range, float damage, int kick, int stun, int dflags, int mod, int timeDelta )
 {
-	int i;
-	float r;
-	float u;
+	int i, first, num;
+	float r[MAX_MULTITRACE];
+	float u[MAX_MULTITRACE];
 	float fi;
-	trace_t trace;
+	trace_t traces[MAX_MULTITRACE], *trace;
 
-	for( i = 0; i < count; i++ )
+	for( first = 0; first < count; first += num )
 	{
-		fi = i * 2.4; //magic value creating Fibonacci numbers
-		r = cos( (float)*seed + fi ) * hspread * sqrt(fi);
-		u = sin( (float)*seed + fi ) * vspread * sqrt(fi); 
+		num = min( count - first, MAX_MULTITRACE );
 
-		GS_TraceBullet( &trace, start, dir, r, u, range, ENTNUM( self ), timeDelta );
-		if( trace.ent != -1 )
+		for( i = 0; i < num; i++ )
 		{
-			if( game.edicts[trace.ent].takedamage )
-			{
-				G_Damage( &game.edicts[trace.ent], self, self, dir, dir, trace.endpos, damage, kick, stun, dflags, mod );
-			}
-			else
+			fi = ( first + i ) * 2.4; //magic value creating Fibonacci numbers
+			r[i] = cos( (float)*seed + fi ) * hspread * sqrt(fi);
+			u[i] = sin( (float)*seed + fi ) * vspread * sqrt(fi); 
+		}
+
+		G_TraceBullets( traces, num, start, dir, r, u, range, self, timeDelta );
+
+		for( i = 0; i < num; i++ )
+		{
+			trace = &traces[i];
+			if( trace->ent != -1 )
 			{
-				if( !( trace.surfFlags & SURF_NOIMPACT ) )
+				if( game.edicts[trace->ent].takedamage )
+				{
+					G_Damage( &game.edicts[trace->ent], self, self, dir, dir, trace->endpos, damage, kick, stun, dflags, mod );
+				}
+				else
 				{
+					if( !( trace->surfFlags & SURF_NOIMPACT ) )
+					{
+					}
 				}
 			}
 		}
@@ -390,8 +390,13 @@ char *va_r( char *dest, size_t size, const char *format, ... )
 char *va( const char *format, ... )
 {
 	va_list	argptr;
+#ifdef ATTRIBUTE_THREAD_LOCAL
+	static ATTRIBUTE_THREAD_LOCAL int str_index;
+	static ATTRIBUTE_THREAD_LOCAL char string[8][2048];	// may be called from several threads
+#else
 	static int str_index;
 	static char string[8][2048];
+#endif
 
 	str_index = ( str_index+1 ) & 7;
 	va_start( argptr, format );
@@ -364,6 +364,8 @@ void Com_Error( com_error_code_t code, const char *format, ... );
 #define FS_UPDATE			0x200
 #define FS_SECURE			0x400
 #define FS_CACHE			0x800
+#define FS_NOCOPY			0x1000	// FS_LoadFile may return stored pk3 data in place: the buffer is read-only,
+									// isn't NUL-terminated and must still be released with FS_FreeFile
 
 #define FS_RWA_MASK			(FS_READ|FS_WRITE|FS_APPEND)
 
@@ -22,6 +22,8 @@
 
 #include "../qcommon/qcommon.h"
 
+int c_pointcontents, c_traces, c_brush_traces, c_node_traces;
+
 void CM_Init( void )
 {
 }
@@ -29,6 +29,11 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // and to avoid various numeric issues
 #define	SURFACE_CLIP_EPSILON	(0.125)
 
+// brush planes are also packed four at a time, so that traces can test them with SSE
+#if ( defined( __SSE__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 1 ) ) && !defined( TRACEVICFIX )
+#define CM_USE_SSE
+#endif
+
 typedef struct
 {
 	char *name;
@@ -36,10 +41,13 @@ typedef struct
 	int flags;
 } cshaderref_t;
 
+// nodes carry their own copy of the splitting plane so that a trace touches
+// a single cache line per node, see CMod_LayoutNodes for their order
 typedef struct
 {
-	cplane_t *plane;
+	cplane_t plane;             // plane.type < 3 for axial planes
 	int children[2];            // negative numbers are leafs
+	int pad;                    // two nodes per cache line
 } cnode_t;
 
 typedef struct
@@ -48,19 +56,25 @@ typedef struct
 	int surfFlags;
 } cbrushside_t;
 
+// four brush planes, each component in its own vector
+typedef struct
+{
+	float normal[3][4];
+	float dist[4];
+} cplanegroup_t;
+
 typedef struct
 {
 	int contents;
-	int checkcount;             // to avoid repeated testings
 
 	int numsides;
 	cbrushside_t *brushsides;
+	cplanegroup_t *planegroups;     // the planes of brushsides, NULL without CM_USE_SSE
 } cbrush_t;
 
 typedef struct
 {
 	int contents;
-	int checkcount;             // to avoid repeated testings
 
 	vec3_t mins, maxs;
 
@@ -99,6 +113,17 @@ typedef struct cmodel_s
 	bool builtin;
 } cmodel_t;
 
+// brushes and patches already checked by the current trace of a thread,
+// those with a stamp equal to checkcount
+typedef struct cvisitstamps_s
+{
+	unsigned int checkcount;
+	unsigned int *brushes;          // [numbrushes]
+	unsigned int *faces;            // [numfaces]
+	uintptr_t owner;                // id of the thread using them, see CM_NextVisitStamp
+	struct cvisitstamps_s *next;
+} cvisitstamps_t;
+
 typedef struct
 {
 	int floodnum;               // if two areas have equal floodnums, they are connected
@@ -107,7 +132,6 @@ typedef struct
 
 struct cmodel_state_s
 {
-	int checkcount;
 	int refcount;
 	struct mempool_s *mempool;
 
@@ -142,6 +166,7 @@ struct cmodel_state_s
 
 	int numbrushes;
 	cbrush_t *map_brushes;
+	cplanegroup_t *map_planegroups;
 
 	int numfaces;
 	cface_t	*map_faces;
@@ -174,22 +199,9 @@ struct cmodel_state_s
 	uint8_t *cmod_base;
 
 	// cm_trace.c
-	cplane_t box_planes[6];
-	cbrushside_t box_brushsides[6];
-	cbrush_t box_brush[1];
-	cbrush_t *box_markbrushes[1];
-	cmodel_t box_cmodel[1];
-
-	cplane_t oct_planes[10];
-	cbrushside_t oct_brushsides[10];
-	cbrush_t oct_brush[1];
-	cbrush_t *oct_markbrushes[1];
-	cmodel_t oct_cmodel[1];
-
-	int leaf_count, leaf_maxcount;
-	int *leaf_list;
-	float *leaf_mins, *leaf_maxs;
-	int leaf_topnode;
+	int instance;                   // changes with each map, see CM_ClearVisitStamps
+	struct qmutex_s *visitstamps_lock;
+	cvisitstamps_t *visitstamps;    // one for each thread that traced the map
 
 	// optional special handling of line tracing and point contents
 	void ( *CM_TransformedBoxTrace )( struct cmodel_state_s *cms, trace_t *tr, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, struct cmodel_s *cmodel, int brushmask, vec3_t origin, vec3_t angles );
@@ -199,7 +211,16 @@ struct cmodel_state_s
 
 //=======================================================================
 
-void	CM_InitBoxHull( cmodel_state_t *cms );
-void	CM_InitOctagonHull( cmodel_state_t *cms );
+extern cvar_t *cm_noSIMD;
+extern cvar_t *cm_noNodeLayout;
+
+int	CM_NumPlaneGroups( int numsides );
+void	CM_PackBrushPlanes( cbrush_t *brush, cplanegroup_t *groups );
+
+void	CM_ClipCheck_f( void );
+
+void	CM_InitVisitStamps( cmodel_state_t *cms );
+void	CM_ClearVisitStamps( cmodel_state_t *cms );
+void	CM_ShutdownVisitStamps( cmodel_state_t *cms );
 
 void	CM_FloodAreaConnections( cmodel_state_t *cms );
@@ -29,6 +29,11 @@ static mempool_t *cmap_mempool;
 
 static cvar_t *cm_noAreas;
 cvar_t *cm_noCurves;
+cvar_t *cm_noSIMD;
+cvar_t *cm_noNodeLayout;
+
+// debug/performance counter vars
+int c_pointcontents, c_traces, c_brush_traces, c_node_traces;
 
 void CM_LoadQ3BrushModel( cmodel_state_t *cms, void *parent, void *buffer, bspFormatDesc_t *format );
 
@@ -147,6 +152,12 @@ static void CM_Clear( cmodel_state_t *cms )
 		cms->numbrushes = 0;
 	}
 
+	if( cms->map_planegroups )
+	{
+		Mem_Free( cms->map_planegroups );
+		cms->map_planegroups = NULL;
+	}
+
 	if( cms->map_pvs )
 	{
 		Mem_Free( cms->map_pvs );
@@ -163,6 +174,8 @@ static void CM_Clear( cmodel_state_t *cms )
 
 	ClearBounds( cms->world_mins, cms->world_maxs );
 
+	CM_ClearVisitStamps( cms );
+
 	cms->CM_TransformedBoxTrace = NULL;
 	cms->CM_TransformedPointContents = NULL;
 	cms->CM_RoundUpToHullSize = NULL;
@@ -221,7 +234,7 @@ cmodel_t *CM_LoadMap( cmodel_state_t *cms, const char *name, bool clientload, un
 	//
 	// load the file
 	//
-	length = FS_LoadFile( name, ( void ** )&buf, NULL, 0 );
+	length = FS_LoadFileExt( name, FS_NOCOPY, ( void ** )&buf, NULL, 0, __FILE__, __LINE__ );
 	if( !buf )
 		Com_Error( ERR_DROP, "Couldn't load %s", name );
 
@@ -249,9 +262,6 @@ cmodel_t *CM_LoadMap( cmodel_state_t *cms, const char *name, bool clientload, un
 
 	descr->loader( cms, NULL, buf, bspFormat );
 
-	CM_InitBoxHull( cms );
-	CM_InitOctagonHull( cms );
-
 	if( cms->numareas )
 	{
 		cms->map_areas = Mem_Alloc( cms->mempool, cms->numareas * sizeof( *cms->map_areas ) );
@@ -878,6 +888,8 @@ cmodel_state_t *CM_New( void *mempool )
 	cms->map_areas = &cms->map_area_empty;
 	cms->map_entitystring = &cms->map_entitystring_empty;
 
+	CM_InitVisitStamps( cms );
+
 	return cms;
 }
 
@@ -888,6 +900,8 @@ static void CM_Free( cmodel_state_t *cms )
 {
 	CM_Clear( cms );
 
+	CM_ShutdownVisitStamps( cms );
+
 	Mem_Free( cms );
 }
 
@@ -930,6 +944,10 @@ void CM_Init( void )
 
 	cm_noAreas =	    Cvar_Get( "cm_noAreas", "0", CVAR_CHEAT );
 	cm_noCurves =	    Cvar_Get( "cm_noCurves", "0", CVAR_CHEAT );
+	cm_noSIMD =	    Cvar_Get( "cm_noSIMD", "0", CVAR_CHEAT );
+	cm_noNodeLayout =   Cvar_Get( "cm_noNodeLayout", "0", CVAR_CHEAT );
+
+	Cmd_AddCommand( "cm_clipcheck", CM_ClipCheck_f );
 
 	cm_initialized = true;
 }
@@ -942,6 +960,8 @@ void CM_Shutdown( void )
 	if( !cm_initialized )
 		return;
 
+	Cmd_RemoveCommand( "cm_clipcheck" );
+
 	Mem_FreePool( &cmap_mempool );
 
 	cm_initialized = false;
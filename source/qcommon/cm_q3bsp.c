@@ -264,8 +264,15 @@ static void CM_CreatePatch( cmodel_state_t *cms, cface_t *patch, cshaderref_t *s
 	if( patch->numfacets )
 	{
 		uint8_t *data;
+		int numgroups;
+		cplanegroup_t *groups;
 
-		data = Mem_Alloc( cms->mempool, patch->numfacets * sizeof( cbrush_t ) + totalsides * ( sizeof( cbrushside_t ) + sizeof( cplane_t ) ) );
+		for( i = 0, numgroups = 0; i < patch->numfacets; i++ )
+			numgroups += CM_NumPlaneGroups( facets[i].numsides );
+
+		// the plane groups go last, aligned for SSE
+		data = Mem_Alloc( cms->mempool, patch->numfacets * sizeof( cbrush_t ) + totalsides * ( sizeof( cbrushside_t ) + sizeof( cplane_t ) )
+			+ ( numgroups ? numgroups * sizeof( cplanegroup_t ) + 15 : 0 ) );
 
 		patch->facets = ( cbrush_t * )data; data += patch->numfacets * sizeof( cbrush_t );
 		memcpy( patch->facets, facets, patch->numfacets * sizeof( cbrush_t ) );
@@ -288,6 +295,13 @@ static void CM_CreatePatch( cmodel_state_t *cms, cface_t *patch, cshaderref_t *s
 			}
 		}
 
+		groups = ( cplanegroup_t * )( ( (size_t)data + 15 ) & ~(size_t)15 );
+		for( i = 0, facet = patch->facets; i < patch->numfacets; i++, facet++ )
+		{
+			CM_PackBrushPlanes( facet, groups );
+			groups += CM_NumPlaneGroups( facet->numsides );
+		}
+
 		patch->contents = shaderref->contents;
 
 		for( i = 0; i < 3; i++ )
@@ -565,7 +579,7 @@ static void CMod_LoadNodes( cmodel_state_t *cms, lump_t *l )
 	if( count < 1 )
 		Com_Error( ERR_DROP, "Map has no nodes" );
 
-	out = cms->map_nodes = Mem_Alloc( cms->mempool, count * sizeof( *out ) );
+	out = cms->map_nodes = _Mem_AllocExt( cms->mempool, count * sizeof( *out ), 64, 1, 0, 0, __FILE__, __LINE__ );
 	cms->numnodes = count;
 
 	for( i = 0; i < 3; i++ )
@@ -576,12 +590,134 @@ static void CMod_LoadNodes( cmodel_state_t *cms, lump_t *l )
 
 	for( i = 0; i < count; i++, out++, in++ )
 	{
-		out->plane = cms->map_planes + LittleLong( in->planenum );
+		out->plane = cms->map_planes[LittleLong( in->planenum )];
 		out->children[0] = LittleLong( in->children[0] );
 		out->children[1] = LittleLong( in->children[1] );
 	}
 }
 
+/*
+* CMod_LayoutNodes
+*
+* q3map writes the nodes depth-first, so a trace going down the tree
+* touches a new cache line at almost every level. Laying them out in van
+* Emde Boas order keeps each small subtree together: the top half of the
+* tree, then each of the subtrees below it, each laid out the same way.
+*/
+typedef struct
+{
+	const cnode_t *nodes;
+	int *heights;
+	int *remap;             // old node number to new one
+	int *order;             // new node number to old one
+	int count;
+	int *bottoms;           // roots of the subtrees below the top half
+	int numbottoms;
+} cnodelayout_t;
+
+static int CMod_NodeHeights_r( cnodelayout_t *nl, int num )
+{
+	int h0, h1;
+
+	if( num < 0 )
+		return 0;
+
+	h0 = CMod_NodeHeights_r( nl, nl->nodes[num].children[0] );
+	h1 = CMod_NodeHeights_r( nl, nl->nodes[num].children[1] );
+	nl->heights[num] = 1 + max( h0, h1 );
+	return nl->heights[num];
+}
+
+static void CMod_BottomNodes_r( cnodelayout_t *nl, int num, int depth )
+{
+	if( num < 0 )
+		return;
+
+	if( !depth )
+	{
+		nl->bottoms[nl->numbottoms++] = num;
+		return;
+	}
+
+	CMod_BottomNodes_r( nl, nl->nodes[num].children[0], depth - 1 );
+	CMod_BottomNodes_r( nl, nl->nodes[num].children[1], depth - 1 );
+}
+
+static void CMod_LayoutNodes_r( cnodelayout_t *nl, int num, int height )
+{
+	int i, top, first, last;
+
+	if( height > nl->heights[num] )
+		height = nl->heights[num];
+
+	if( height == 1 )
+	{
+		nl->remap[num] = nl->count;
+		nl->order[nl->count++] = num;
+		return;
+	}
+
+	top = height / 2;
+	CMod_LayoutNodes_r( nl, num, top );
+
+	first = nl->numbottoms;
+	CMod_BottomNodes_r( nl, num, top );
+	last = nl->numbottoms;
+
+	for( i = first; i < last; i++ )
+		CMod_LayoutNodes_r( nl, nl->bottoms[i], height - top );
+	nl->numbottoms = first;
+}
+
+static void CMod_LayoutNodes( cmodel_state_t *cms )
+{
+	int i, j, child;
+	cnode_t *out;
+	cnodelayout_t nl;
+
+	if( cm_noNodeLayout->integer )
+		return;
+
+	memset( &nl, 0, sizeof( nl ) );
+	nl.nodes = cms->map_nodes;
+	nl.heights = Mem_TempMalloc( sizeof( int ) * cms->numnodes * 4 );
+	nl.remap = nl.heights + cms->numnodes;
+	nl.order = nl.remap + cms->numnodes;
+	nl.bottoms = nl.order + cms->numnodes;
+
+	for( i = 0; i < cms->numnodes; i++ )
+		nl.remap[i] = -1;
+
+	CMod_NodeHeights_r( &nl, 0 );
+	CMod_LayoutNodes_r( &nl, 0, nl.heights[0] );
+
+	// keep whatever can't be reached from the root, the root stays first
+	for( i = 0; i < cms->numnodes; i++ )
+	{
+		if( nl.remap[i] < 0 )
+		{
+			nl.remap[i] = nl.count;
+			nl.order[nl.count++] = i;
+		}
+	}
+
+	out = _Mem_AllocExt( cms->mempool, cms->numnodes * sizeof( *out ), 64, 1, 0, 0, __FILE__, __LINE__ );
+	for( i = 0; i < cms->numnodes; i++ )
+	{
+		out[i] = cms->map_nodes[nl.order[i]];
+		for( j = 0; j < 2; j++ )
+		{
+			child = out[i].children[j];
+			if( child >= 0 )
+				out[i].children[j] = nl.remap[child];
+		}
+	}
+
+	Mem_TempFree( nl.heights );
+	Mem_Free( cms->map_nodes );
+	cms->map_nodes = out;
+}
+
 /*
 * CMod_LoadMarkFaces
 */
@@ -798,9 +934,10 @@ static void CMod_LoadBrushSides_RBSP( cmodel_state_t *cms, lump_t *l )
 static void CMod_LoadBrushes( cmodel_state_t *cms, lump_t *l )
 {
 	int i;
-	int count;
+	int count, numgroups;
 	dbrush_t *in;
 	cbrush_t *out;
+	cplanegroup_t *groups;
 	int shaderref;
 
 	in = ( void * )( cms->cmod_base + l->fileofs );
@@ -820,6 +957,20 @@ static void CMod_LoadBrushes( cmodel_state_t *cms, lump_t *l )
 		out->numsides = LittleLong( in->numsides );
 		out->brushsides = cms->map_brushsides + LittleLong( in->firstside );
 	}
+
+	// pack the planes of all brushes together
+	numgroups = 0;
+	for( i = 0, out = cms->map_brushes; i < count; i++, out++ )
+		numgroups += CM_NumPlaneGroups( out->numsides );
+	if( !numgroups )
+		return;
+
+	groups = cms->map_planegroups = Mem_Alloc( cms->mempool, numgroups * sizeof( *groups ) );
+	for( i = 0, out = cms->map_brushes; i < count; i++, out++ )
+	{
+		CM_PackBrushPlanes( out, groups );
+		groups += CM_NumPlaneGroups( out->numsides );
+	}
 }
 
 /*
@@ -891,6 +1042,7 @@ void CM_LoadQ3BrushModel( cmodel_state_t *cms, void *parent, void *buf, bspForma
 	CMod_LoadMarkFaces( cms, &header.lumps[LUMP_LEAFFACES] );
 	CMod_LoadLeafs( cms, &header.lumps[LUMP_LEAFS] );
 	CMod_LoadNodes( cms, &header.lumps[LUMP_NODES] );
+	CMod_LayoutNodes( cms );
 	CMod_LoadSubmodels( cms, &header.lumps[LUMP_MODELS] );
 	CMod_LoadVisibility( cms, &header.lumps[LUMP_VISIBILITY] );
 	CMod_LoadEntityString( cms, &header.lumps[LUMP_ENTITIES] );
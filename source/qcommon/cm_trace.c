@@ -21,6 +21,79 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "qcommon.h"
 #include "cm_local.h"
+#include "sys_threads.h"
+
+#ifdef CM_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+/*
+* CM_NumPlaneGroups
+*/
+int CM_NumPlaneGroups( int numsides )
+{
+#ifdef CM_USE_SSE
+	return ( numsides + 3 ) / 4;
+#else
+	return 0;
+#endif
+}
+
+/*
+* CM_PackBrushPlanes
+*
+* Copies the planes of the brush into CM_NumPlaneGroups groups, must be called again
+* whenever the planes change. Unused lanes hold a null plane, nothing is ever in front of it.
+*/
+void CM_PackBrushPlanes( cbrush_t *brush, cplanegroup_t *groups )
+{
+	int i, numgroups;
+	cplane_t *p;
+	cplanegroup_t *g;
+
+	numgroups = CM_NumPlaneGroups( brush->numsides );
+	if( !numgroups )
+	{
+		brush->planegroups = NULL;
+		return;
+	}
+
+	memset( groups, 0, numgroups * sizeof( *groups ) );
+
+	for( i = 0; i < brush->numsides; i++ )
+	{
+		p = brush->brushsides[i].plane;
+		g = &groups[i >> 2];
+		g->normal[0][i & 3] = p->normal[0];
+		g->normal[1][i & 3] = p->normal[1];
+		g->normal[2][i & 3] = p->normal[2];
+		g->dist[i & 3] = p->dist;
+	}
+
+	brush->planegroups = groups;
+}
+
+/*
+* The planes of the bounding box hulls are rewritten for each box, so every thread
+* has its own hulls. The models they return are only valid on the calling thread.
+*/
+typedef struct
+{
+	ATTRIBUTE_ALIGNED( 16 ) cplanegroup_t planegroups[3];
+	cplane_t planes[10];
+	cbrushside_t brushsides[10];
+	cbrush_t brush[1];
+	cbrush_t *markbrushes[1];
+	cmodel_t cmodel[1];
+} cboxhull_t;
+
+#ifdef ATTRIBUTE_THREAD_LOCAL
+static ATTRIBUTE_THREAD_LOCAL cboxhull_t cm_boxhull;
+static ATTRIBUTE_THREAD_LOCAL cboxhull_t cm_octhull;
+#else
+static cboxhull_t cm_boxhull;
+static cboxhull_t cm_octhull;
+#endif
 
 /*
 * CM_InitBoxHull
@@ -28,33 +101,33 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 * Set up the planes so that the six floats of a bounding box
 * can just be stored out and get a proper clipping hull structure.
 */
-void CM_InitBoxHull( cmodel_state_t *cms )
+static void CM_InitBoxHull( cboxhull_t *hull )
 {
 	int i;
 	cplane_t *p;
 	cbrushside_t *s;
 
-	cms->box_brush->numsides = 6;
-	cms->box_brush->brushsides = cms->box_brushsides;
-	cms->box_brush->contents = CONTENTS_BODY;
+	hull->brush->numsides = 6;
+	hull->brush->brushsides = hull->brushsides;
+	hull->brush->contents = CONTENTS_BODY;
 
-	cms->box_markbrushes[0] = cms->box_brush;
+	hull->markbrushes[0] = hull->brush;
 
-	cms->box_cmodel->builtin = true;
-	cms->box_cmodel->nummarkfaces = 0;
-	cms->box_cmodel->markfaces = NULL;
-	cms->box_cmodel->markbrushes = cms->box_markbrushes;
-	cms->box_cmodel->nummarkbrushes = 1;
+	hull->cmodel->builtin = true;
+	hull->cmodel->nummarkfaces = 0;
+	hull->cmodel->markfaces = NULL;
+	hull->cmodel->markbrushes = hull->markbrushes;
+	hull->cmodel->nummarkbrushes = 1;
 
 	for( i = 0; i < 6; i++ )
 	{
 		// brush sides
-		s = cms->box_brushsides + i;
-		s->plane = cms->box_planes + i;
+		s = hull->brushsides + i;
+		s->plane = hull->planes + i;
 		s->surfFlags = 0;
 
 		// planes
-		p = &cms->box_planes[i];
+		p = &hull->planes[i];
 		VectorClear( p->normal );
 
 		if( ( i & 1 ) )
@@ -78,7 +151,7 @@ void CM_InitBoxHull( cmodel_state_t *cms )
 * Set up the planes so that the six floats of a bounding box
 * can just be stored out and get a proper clipping hull structure.
 */
-void CM_InitOctagonHull( cmodel_state_t *cms )
+static void CM_InitOctagonHull( cboxhull_t *hull )
 {
 	int i;
 	cplane_t *p;
@@ -90,28 +163,28 @@ void CM_InitOctagonHull( cmodel_state_t *cms )
 		{  1, -1, 0 }
 	};
 
-	cms->oct_brush->numsides = 10;
-	cms->oct_brush->brushsides = cms->oct_brushsides;
-	cms->oct_brush->contents = CONTENTS_BODY;
+	hull->brush->numsides = 10;
+	hull->brush->brushsides = hull->brushsides;
+	hull->brush->contents = CONTENTS_BODY;
 
-	cms->oct_markbrushes[0] = cms->oct_brush;
+	hull->markbrushes[0] = hull->brush;
 
-	cms->oct_cmodel->builtin = true;
-	cms->oct_cmodel->nummarkfaces = 0;
-	cms->oct_cmodel->markfaces = NULL;
-	cms->oct_cmodel->markbrushes = cms->oct_markbrushes;
-	cms->oct_cmodel->nummarkbrushes = 1;
+	hull->cmodel->builtin = true;
+	hull->cmodel->nummarkfaces = 0;
+	hull->cmodel->markfaces = NULL;
+	hull->cmodel->markbrushes = hull->markbrushes;
+	hull->cmodel->nummarkbrushes = 1;
 
 	// axial planes
 	for( i = 0; i < 6; i++ )
 	{
 		// brush sides
-		s = cms->oct_brushsides + i;
-		s->plane = cms->oct_planes + i;
+		s = hull->brushsides + i;
+		s->plane = hull->planes + i;
 		s->surfFlags = 0;
 
 		// planes
-		p = &cms->oct_planes[i];
+		p = &hull->planes[i];
 		VectorClear( p->normal );
 
 		if( ( i & 1 ) )
@@ -131,12 +204,12 @@ void CM_InitOctagonHull( cmodel_state_t *cms )
 	// non-axial planes
 	for( i = 6; i < 10; i++ ) {
 		// brush sides
-		s = cms->oct_brushsides + i;
-		s->plane = cms->oct_planes + i;
+		s = hull->brushsides + i;
+		s->plane = hull->planes + i;
 		s->surfFlags = 0;
 
 		// planes
-		p = &cms->oct_planes[i];
+		p = &hull->planes[i];
 		VectorCopy( oct_dirs[i-6], p->normal );
 
 		p->type = PLANE_NONAXIAL;
@@ -151,17 +224,24 @@ void CM_InitOctagonHull( cmodel_state_t *cms )
 */
 cmodel_t *CM_ModelForBBox( cmodel_state_t *cms, vec3_t mins, vec3_t maxs )
 {
-	cms->box_planes[0].dist = maxs[0];
-	cms->box_planes[1].dist = -mins[0];
-	cms->box_planes[2].dist = maxs[1];
-	cms->box_planes[3].dist = -mins[1];
-	cms->box_planes[4].dist = maxs[2];
-	cms->box_planes[5].dist = -mins[2];
+	cboxhull_t *hull = &cm_boxhull;
+
+	if( !hull->cmodel->builtin )
+		CM_InitBoxHull( hull );
+
+	hull->planes[0].dist = maxs[0];
+	hull->planes[1].dist = -mins[0];
+	hull->planes[2].dist = maxs[1];
+	hull->planes[3].dist = -mins[1];
+	hull->planes[4].dist = maxs[2];
+	hull->planes[5].dist = -mins[2];
 
-	VectorCopy( mins, cms->box_cmodel->mins );
-	VectorCopy( maxs, cms->box_cmodel->maxs );
+	VectorCopy( mins, hull->cmodel->mins );
+	VectorCopy( maxs, hull->cmodel->maxs );
 
-	return cms->box_cmodel;
+	CM_PackBrushPlanes( hull->brush, hull->planegroups );
+
+	return hull->cmodel;
 }
 
 /*
@@ -176,6 +256,10 @@ cmodel_t *CM_OctagonModelForBBox( cmodel_state_t *cms, vec3_t mins, vec3_t maxs
 	float a, b, d, t;
 	float sina, cosa;
 	vec3_t offset, size[2];
+	cboxhull_t *hull = &cm_octhull;
+
+	if( !hull->cmodel->builtin )
+		CM_InitOctagonHull( hull );
 
 	for( i = 0; i < 3; i++ ) {
 		offset[i] = ( mins[i] + maxs[i] ) * 0.5;
@@ -183,16 +267,16 @@ cmodel_t *CM_OctagonModelForBBox( cmodel_state_t *cms, vec3_t mins, vec3_t maxs
 		size[1][i] = maxs[i] - offset[i];
 	}
 
-	VectorCopy( offset, cms->oct_cmodel->cyl_offset );
-	VectorCopy( size[0], cms->oct_cmodel->mins );
-	VectorCopy( size[1], cms->oct_cmodel->maxs );
+	VectorCopy( offset, hull->cmodel->cyl_offset );
+	VectorCopy( size[0], hull->cmodel->mins );
+	VectorCopy( size[1], hull->cmodel->maxs );
 
-	cms->oct_planes[0].dist = size[1][0];
-	cms->oct_planes[1].dist = -size[0][0];
-	cms->oct_planes[2].dist = size[1][1];
-	cms->oct_planes[3].dist = -size[0][1];
-	cms->oct_planes[4].dist = size[1][2];
-	cms->oct_planes[5].dist = -size[0][2];
+	hull->planes[0].dist = size[1][0];
+	hull->planes[1].dist = -size[0][0];
+	hull->planes[2].dist = size[1][1];
+	hull->planes[3].dist = -size[0][1];
+	hull->planes[4].dist = size[1][2];
+	hull->planes[5].dist = -size[0][2];
 
 	a = size[1][0]; // halfx
 	b = size[1][1]; // halfy
@@ -212,19 +296,21 @@ cmodel_t *CM_OctagonModelForBBox( cmodel_state_t *cms, vec3_t mins, vec3_t maxs
 
 	// the following should match normals and signbits set in CM_InitOctagonHull
 
-	VectorSet( cms->oct_planes[6].normal, cosa, sina, 0 );
-	cms->oct_planes[6].dist = d;
+	VectorSet( hull->planes[6].normal, cosa, sina, 0 );
+	hull->planes[6].dist = d;
+
+	VectorSet( hull->planes[7].normal, -cosa, sina, 0 );
+	hull->planes[7].dist = d;
 
-	VectorSet( cms->oct_planes[7].normal, -cosa, sina, 0 );
-	cms->oct_planes[7].dist = d;
+	VectorSet( hull->planes[8].normal, -cosa, -sina, 0 );
+	hull->planes[8].dist = d;
 
-	VectorSet( cms->oct_planes[8].normal, -cosa, -sina, 0 );
-	cms->oct_planes[8].dist = d;
+	VectorSet( hull->planes[9].normal, cosa, -sina, 0 );
+	hull->planes[9].dist = d;
 
-	VectorSet( cms->oct_planes[9].normal, cosa, -sina, 0 );
-	cms->oct_planes[9].dist = d;
+	CM_PackBrushPlanes( hull->brush, hull->planegroups );
 
-	return cms->oct_cmodel;
+	return hull->cmodel;
 }
 
 /*
@@ -241,27 +327,51 @@ int CM_PointLeafnum( cmodel_state_t *cms, const vec3_t p )
 	do
 	{
 		node = cms->map_nodes + num;
-		num = node->children[PlaneDiff( p, node->plane ) < 0];
+		num = node->children[PlaneDiff( p, &node->plane ) < 0];
 	}
 	while( num >= 0 );
 
 	return -1 - num;
 }
 
+// the node walks keep the other side of a split on a stack of their own,
+// and only recurse in the unlikely case of a deeper tree
+#define CM_MAX_NODE_STACK	128
+
 /*
 * CM_BoxLeafnums
 *
 * Fills in a list of all the leafs touched
 */
-static void CM_BoxLeafnums_r( cmodel_state_t *cms, int nodenum )
+typedef struct
+{
+	int count, maxcount;
+	int *list;
+	float *mins, *maxs;
+	int topnode;
+} cboxleafs_t;
+
+static void CM_BoxLeafnums_r( cmodel_state_t *cms, cboxleafs_t *bl, int nodenum )
 {
-	int s;
+	int s, sp;
+	int stack[CM_MAX_NODE_STACK];
 	cnode_t	*node;
 
-	while( nodenum >= 0 )
+	sp = 0;
+	while( 1 )
 	{
+		if( nodenum < 0 )
+		{
+			if( bl->count < bl->maxcount )
+				bl->list[bl->count++] = -1 - nodenum;
+			if( !sp )
+				return;
+			nodenum = stack[--sp];
+			continue;
+		}
+
 		node = &cms->map_nodes[nodenum];
-		s = BOX_ON_PLANE_SIDE( cms->leaf_mins, cms->leaf_maxs, node->plane ) - 1;
+		s = BOX_ON_PLANE_SIDE( bl->mins, bl->maxs, &node->plane ) - 1;
 
 		if( s < 2 )
 		{
@@ -270,35 +380,44 @@ static void CM_BoxLeafnums_r( cmodel_state_t *cms, int nodenum )
 		}
 
 		// go down both sides
-		if( cms->leaf_topnode == -1 )
-			cms->leaf_topnode = nodenum;
-		CM_BoxLeafnums_r( cms, node->children[0] );
-		nodenum = node->children[1];
+		if( bl->topnode == -1 )
+			bl->topnode = nodenum;
+		if( sp < CM_MAX_NODE_STACK )
+		{
+			stack[sp++] = node->children[1];
+			nodenum = node->children[0];
+		}
+		else
+		{
+			CM_BoxLeafnums_r( cms, bl, node->children[0] );
+			nodenum = node->children[1];
+		}
 	}
-
-	if( cms->leaf_count < cms->leaf_maxcount )
-		cms->leaf_list[cms->leaf_count++] = -1 - nodenum;
 }
 
 /*
 * CM_BoxLeafnums
+*
+* The traversal state lives on the stack, so this is safe to call
+* from multiple threads sharing the same collision model.
 */
 int CM_BoxLeafnums( cmodel_state_t *cms, vec3_t mins, vec3_t maxs, int *list, int listsize, int *topnode )
 {
-	cms->leaf_list = list;
-	cms->leaf_count = 0;
-	cms->leaf_maxcount = listsize;
-	cms->leaf_mins = mins;
-	cms->leaf_maxs = maxs;
+	cboxleafs_t bl;
 
-	cms->leaf_topnode = -1;
+	bl.list = list;
+	bl.count = 0;
+	bl.maxcount = listsize;
+	bl.mins = mins;
+	bl.maxs = maxs;
+	bl.topnode = -1;
 
-	CM_BoxLeafnums_r( cms, 0 );
+	CM_BoxLeafnums_r( cms, &bl, 0 );
 
 	if( topnode )
-		*topnode = cms->leaf_topnode;
+		*topnode = bl.topnode;
 
-	return cms->leaf_count;
+	return bl.count;
 }
 
 /*
@@ -488,24 +607,208 @@ BOX TRACING
 #endif
 #define RADIUS_EPSILON		1.0f
 
-static vec3_t trace_start, trace_end;
-static vec3_t trace_mins, trace_maxs;
-static vec3_t trace_startmins, trace_endmins;
-static vec3_t trace_startmaxs, trace_endmaxs;
-static vec3_t trace_absmins, trace_absmaxs;
-static vec3_t trace_extents;
+/*
+* Visit stamps
+*
+* A trace through the world may reach the same brush or patch from several leafs.
+* Each thread keeps its own stamps of what the current trace has already checked,
+* so traces can run on several threads at once. The stamps belong to the map and
+* are released along with it.
+*/
+
+static volatile int cm_numinstances;
+
+#ifdef ATTRIBUTE_THREAD_LOCAL
+#define CM_THREAD_VISITSTAMPS	4		// maps a single thread may trace in turn without taking the map's lock
+
+typedef struct
+{
+	int instance;
+	cvisitstamps_t *stamps;
+} cvisitstampsref_t;
+
+static ATTRIBUTE_THREAD_LOCAL cvisitstampsref_t cm_threadstamps[CM_THREAD_VISITSTAMPS];
+static ATTRIBUTE_THREAD_LOCAL int cm_threadstamps_next;
+#endif
+
+/*
+* CM_InitVisitStamps
+*/
+void CM_InitVisitStamps( cmodel_state_t *cms )
+{
+	cms->visitstamps_lock = QMutex_Create();
+	cms->instance = Sys_Atomic_Add( &cm_numinstances, 1, NULL ) + 1;
+}
+
+/*
+* CM_ClearVisitStamps
+*
+* Must be called whenever the map changes, threads will allocate new stamps on their next trace
+*/
+void CM_ClearVisitStamps( cmodel_state_t *cms )
+{
+	cvisitstamps_t *stamps, *next;
+
+	for( stamps = cms->visitstamps; stamps; stamps = next )
+	{
+		next = stamps->next;
+		Mem_Free( stamps );
+	}
+	cms->visitstamps = NULL;
+
+	cms->instance = Sys_Atomic_Add( &cm_numinstances, 1, NULL ) + 1;
+}
+
+/*
+* CM_ShutdownVisitStamps
+*/
+void CM_ShutdownVisitStamps( cmodel_state_t *cms )
+{
+	CM_ClearVisitStamps( cms );
+
+	QMutex_Destroy( &cms->visitstamps_lock );
+}
+
+/*
+* CM_NextVisitStamp
+*
+* Returns the stamps of the calling thread with a fresh checkcount
+*/
+static cvisitstamps_t *CM_NextVisitStamp( cmodel_state_t *cms )
+{
+	cvisitstamps_t *stamps;
+#ifdef ATTRIBUTE_THREAD_LOCAL
+	int i;
+	cvisitstampsref_t *ref;
+
+	stamps = NULL;
+	for( i = 0; i < CM_THREAD_VISITSTAMPS; i++ )
+	{
+		if( cm_threadstamps[i].instance == cms->instance )
+		{
+			stamps = cm_threadstamps[i].stamps;
+			break;
+		}
+	}
+#else
+	// no thread local cache, look the stamps up on every trace
+	stamps = NULL;
+#endif
+
+	if( !stamps )
+	{
+		// a new thread may get the id of one that has exited and can take over its stamps then
+		uintptr_t owner = QThread_Id();
 
-static trace_t	*trace_trace;
+		QMutex_Lock( cms->visitstamps_lock );
+		for( stamps = cms->visitstamps; stamps; stamps = stamps->next )
+		{
+			if( stamps->owner == owner )
+				break;
+		}
+
+		if( !stamps )
+		{
+			// first trace of this thread since the map was loaded
+			stamps = Mem_Alloc( cms->mempool, sizeof( *stamps ) + ( cms->numbrushes + cms->numfaces ) * sizeof( unsigned int ) );
+			stamps->brushes = ( unsigned int * )( stamps + 1 );
+			stamps->faces = stamps->brushes + cms->numbrushes;
+			stamps->owner = owner;
+			stamps->next = cms->visitstamps;
+			cms->visitstamps = stamps;
+		}
+		QMutex_Unlock( cms->visitstamps_lock );
+
+#ifdef ATTRIBUTE_THREAD_LOCAL
+		ref = &cm_threadstamps[cm_threadstamps_next];
+		cm_threadstamps_next = ( cm_threadstamps_next + 1 ) % CM_THREAD_VISITSTAMPS;
+		ref->instance = cms->instance;
+		ref->stamps = stamps;
+#endif
+	}
+
+	if( !++stamps->checkcount )
+	{
+		// wrapped around, forget about the old stamps
+		memset( stamps->brushes, 0, ( cms->numbrushes + cms->numfaces ) * sizeof( unsigned int ) );
+		stamps->checkcount = 1;
+	}
+
+	return stamps;
+}
+
+/*
+* The state of a single trace, passed down the recursion
+*/
+typedef struct
+{
+	vec3_t startmins, endmins;
+	vec3_t startmaxs, endmaxs;
+	vec3_t absmins, absmaxs;
+	vec3_t extents;
+
+	trace_t	*trace;
 #ifdef TRACEVICFIX
-static float trace_realfraction;
+	float realfraction;
+#endif
+	int contents;
+	bool ispoint;               // optimized case
+
+	cvisitstamps_t *stamps;     // NULL when tracing against an inline model, its brushes are listed once
+
+	int brushtraces, nodetraces;    // added to the global counters once the trace is done
+
+#ifdef CM_USE_SSE
+	// each component of the box corners in all lanes
+	__m128 startmins4[3], startmaxs4[3];
+	__m128 endmins4[3], endmaxs4[3];
+#endif
+} ctrace_t;
+
+/*
+* CM_SetupTrace
+*/
+static void CM_SetupTrace( ctrace_t *ct, trace_t *tr, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int brushmask )
+{
+#ifdef CM_USE_SSE
+	int i;
+#endif
+
+	ct->trace = tr;
+	ct->contents = brushmask;
+	ct->brushtraces = ct->nodetraces = 0;
+
+	// build a bounding box of the entire move
+	ClearBounds( ct->absmins, ct->absmaxs );
+
+	VectorAdd( start, mins, ct->startmins );
+	AddPointToBounds( ct->startmins, ct->absmins, ct->absmaxs );
+
+	VectorAdd( start, maxs, ct->startmaxs );
+	AddPointToBounds( ct->startmaxs, ct->absmins, ct->absmaxs );
+
+	VectorAdd( end, mins, ct->endmins );
+	AddPointToBounds( ct->endmins, ct->absmins, ct->absmaxs );
+
+	VectorAdd( end, maxs, ct->endmaxs );
+	AddPointToBounds( ct->endmaxs, ct->absmins, ct->absmaxs );
+
+#ifdef CM_USE_SSE
+	for( i = 0; i < 3; i++ )
+	{
+		ct->startmins4[i] = _mm_set1_ps( ct->startmins[i] );
+		ct->startmaxs4[i] = _mm_set1_ps( ct->startmaxs[i] );
+		ct->endmins4[i] = _mm_set1_ps( ct->endmins[i] );
+		ct->endmaxs4[i] = _mm_set1_ps( ct->endmaxs[i] );
+	}
 #endif
-static int trace_contents;
-static bool trace_ispoint;      // optimized case
+}
+
 
 /*
 * CM_ClipBoxToBrush
 */
-static void CM_ClipBoxToBrush( cmodel_state_t *cms, cbrush_t *brush )
+static void CM_ClipBoxToBrush( cmodel_state_t *cms, ctrace_t *ct, cbrush_t *brush )
 {
 	int i;
 	cplane_t *p, *clipplane;
@@ -524,7 +827,7 @@ static void CM_ClipBoxToBrush( cmodel_state_t *cms, cbrush_t *brush )
 	leavefrac = 1;
 	clipplane = NULL;
 
-	c_brush_traces++;
+	ct->brushtraces++;
 
 	getout = false;
 	startout = false;
@@ -538,44 +841,44 @@ static void CM_ClipBoxToBrush( cmodel_state_t *cms, cbrush_t *brush )
 		// push the plane out apropriately for mins/maxs
 		if( p->type < 3 )
 		{
-			d1 = trace_startmins[p->type] - p->dist;
-			d2 = trace_endmins[p->type] - p->dist;
+			d1 = ct->startmins[p->type] - p->dist;
+			d2 = ct->endmins[p->type] - p->dist;
 		}
 		else
 		{
 			switch( p->signbits )
 			{
 			case 0:
-				d1 = p->normal[0]*trace_startmins[0] + p->normal[1]*trace_startmins[1] + p->normal[2]*trace_startmins[2] - p->dist;
-				d2 = p->normal[0]*trace_endmins[0] + p->normal[1]*trace_endmins[1] + p->normal[2]*trace_endmins[2] - p->dist;
+				d1 = p->normal[0]*ct->startmins[0] + p->normal[1]*ct->startmins[1] + p->normal[2]*ct->startmins[2] - p->dist;
+				d2 = p->normal[0]*ct->endmins[0] + p->normal[1]*ct->endmins[1] + p->normal[2]*ct->endmins[2] - p->dist;
 				break;
 			case 1:
-				d1 = p->normal[0]*trace_startmaxs[0] + p->normal[1]*trace_startmins[1] + p->normal[2]*trace_startmins[2] - p->dist;
-				d2 = p->normal[0]*trace_endmaxs[0] + p->normal[1]*trace_endmins[1] + p->normal[2]*trace_endmins[2] - p->dist;
+				d1 = p->normal[0]*ct->startmaxs[0] + p->normal[1]*ct->startmins[1] + p->normal[2]*ct->startmins[2] - p->dist;
+				d2 = p->normal[0]*ct->endmaxs[0] + p->normal[1]*ct->endmins[1] + p->normal[2]*ct->endmins[2] - p->dist;
 				break;
 			case 2:
-				d1 = p->normal[0]*trace_startmins[0] + p->normal[1]*trace_startmaxs[1] + p->normal[2]*trace_startmins[2] - p->dist;
-				d2 = p->normal[0]*trace_endmins[0] + p->normal[1]*trace_endmaxs[1] + p->normal[2]*trace_endmins[2] - p->dist;
+				d1 = p->normal[0]*ct->startmins[0] + p->normal[1]*ct->startmaxs[1] + p->normal[2]*ct->startmins[2] - p->dist;
+				d2 = p->normal[0]*ct->endmins[0] + p->normal[1]*ct->endmaxs[1] + p->normal[2]*ct->endmins[2] - p->dist;
 				break;
 			case 3:
-				d1 = p->normal[0]*trace_startmaxs[0] + p->normal[1]*trace_startmaxs[1] + p->normal[2]*trace_startmins[2] - p->dist;
-				d2 = p->normal[0]*trace_endmaxs[0] + p->normal[1]*trace_endmaxs[1] + p->normal[2]*trace_endmins[2] - p->dist;
+				d1 = p->normal[0]*ct->startmaxs[0] + p->normal[1]*ct->startmaxs[1] + p->normal[2]*ct->startmins[2] - p->dist;
+				d2 = p->normal[0]*ct->endmaxs[0] + p->normal[1]*ct->endmaxs[1] + p->normal[2]*ct->endmins[2] - p->dist;
 				break;
 			case 4:
-				d1 = p->normal[0]*trace_startmins[0] + p->normal[1]*trace_startmins[1] + p->normal[2]*trace_startmaxs[2] - p->dist;
-				d2 = p->normal[0]*trace_endmins[0] + p->normal[1]*trace_endmins[1] + p->normal[2]*trace_endmaxs[2] - p->dist;
+				d1 = p->normal[0]*ct->startmins[0] + p->normal[1]*ct->startmins[1] + p->normal[2]*ct->startmaxs[2] - p->dist;
+				d2 = p->normal[0]*ct->endmins[0] + p->normal[1]*ct->endmins[1] + p->normal[2]*ct->endmaxs[2] - p->dist;
 				break;
 			case 5:
-				d1 = p->normal[0]*trace_startmaxs[0] + p->normal[1]*trace_startmins[1] + p->normal[2]*trace_startmaxs[2] - p->dist;
-				d2 = p->normal[0]*trace_endmaxs[0] + p->normal[1]*trace_endmins[1] + p->normal[2]*trace_endmaxs[2] - p->dist;
+				d1 = p->normal[0]*ct->startmaxs[0] + p->normal[1]*ct->startmins[1] + p->normal[2]*ct->startmaxs[2] - p->dist;
+				d2 = p->normal[0]*ct->endmaxs[0] + p->normal[1]*ct->endmins[1] + p->normal[2]*ct->endmaxs[2] - p->dist;
 				break;
 			case 6:
-				d1 = p->normal[0]*trace_startmins[0] + p->normal[1]*trace_startmaxs[1] + p->normal[2]*trace_startmaxs[2] - p->dist;
-				d2 = p->normal[0]*trace_endmins[0] + p->normal[1]*trace_endmaxs[1] + p->normal[2]*trace_endmaxs[2] - p->dist;
+				d1 = p->normal[0]*ct->startmins[0] + p->normal[1]*ct->startmaxs[1] + p->normal[2]*ct->startmaxs[2] - p->dist;
+				d2 = p->normal[0]*ct->endmins[0] + p->normal[1]*ct->endmaxs[1] + p->normal[2]*ct->endmaxs[2] - p->dist;
 				break;
 			case 7:
-				d1 = p->normal[0]*trace_startmaxs[0] + p->normal[1]*trace_startmaxs[1] + p->normal[2]*trace_startmaxs[2] - p->dist;
-				d2 = p->normal[0]*trace_endmaxs[0] + p->normal[1]*trace_endmaxs[1] + p->normal[2]*trace_endmaxs[2] - p->dist;
+				d1 = p->normal[0]*ct->startmaxs[0] + p->normal[1]*ct->startmaxs[1] + p->normal[2]*ct->startmaxs[2] - p->dist;
+				d2 = p->normal[0]*ct->endmaxs[0] + p->normal[1]*ct->endmaxs[1] + p->normal[2]*ct->endmaxs[2] - p->dist;
 				break;
 			default:
 				d1 = d2 = 0; // shut up compiler
@@ -640,42 +943,42 @@ static void CM_ClipBoxToBrush( cmodel_state_t *cms, cbrush_t *brush )
 	if( !startout )
 	{
 		// original point was inside brush
-		trace_trace->startsolid = true;
-		trace_trace->contents = brush->contents;
+		ct->trace->startsolid = true;
+		ct->trace->contents = brush->contents;
 		if( !getout )
 		{
-			trace_trace->allsolid = true;
-			trace_trace->fraction = 0;
+			ct->trace->allsolid = true;
+			ct->trace->fraction = 0;
 		}
 		return;
 	}
 #ifdef TRACEVICFIX
 	if( enterfrac - FRAC_EPSILON <= leavefrac )
 	{
-		if( enterfrac > -1 && enterfrac < trace_realfraction )
+		if( enterfrac > -1 && enterfrac < ct->realfraction )
 		{
 			if( enterfrac < 0 )
 				enterfrac = 0;
-			trace_realfraction = enterfrac;
-			trace_trace->plane = *clipplane;
-			trace_trace->surfFlags = leadside->surfFlags;
-			trace_trace->contents = brush->contents;
-			trace_trace->fraction = ( enterdist - DIST_EPSILON ) / move;
-			if( trace_trace->fraction < 0 )
-				trace_trace->fraction = 0;
+			ct->realfraction = enterfrac;
+			ct->trace->plane = *clipplane;
+			ct->trace->surfFlags = leadside->surfFlags;
+			ct->trace->contents = brush->contents;
+			ct->trace->fraction = ( enterdist - DIST_EPSILON ) / move;
+			if( ct->trace->fraction < 0 )
+				ct->trace->fraction = 0;
 		}
 	}
 #else
 	if( enterfrac - ( 1.0f / 1024.0f ) <= leavefrac )
 	{
-		if( enterfrac > -1 && enterfrac < trace_trace->fraction )
+		if( enterfrac > -1 && enterfrac < ct->trace->fraction )
 		{
 			if( enterfrac < 0 )
 				enterfrac = 0;
-			trace_trace->fraction = enterfrac;
-			trace_trace->plane = *clipplane;
-			trace_trace->surfFlags = leadside->surfFlags;
-			trace_trace->contents = brush->contents;
+			ct->trace->fraction = enterfrac;
+			ct->trace->plane = *clipplane;
+			ct->trace->surfFlags = leadside->surfFlags;
+			ct->trace->contents = brush->contents;
 		}
 	}
 #endif
@@ -684,7 +987,7 @@ static void CM_ClipBoxToBrush( cmodel_state_t *cms, cbrush_t *brush )
 /*
 * CM_TestBoxInBrush
 */
-static void CM_TestBoxInBrush( cmodel_state_t *cms, cbrush_t *brush )
+static void CM_TestBoxInBrush( cmodel_state_t *cms, ctrace_t *ct, cbrush_t *brush )
 {
 	int i;
 	cplane_t *p;
@@ -702,7 +1005,7 @@ static void CM_TestBoxInBrush( cmodel_state_t *cms, cbrush_t *brush )
 		// if completely in front of face, no intersection
 		if( p->type < 3 )
 		{
-			if( trace_startmins[p->type] > p->dist )
+			if( ct->startmins[p->type] > p->dist )
 				return;
 		}
 		else
@@ -710,35 +1013,35 @@ static void CM_TestBoxInBrush( cmodel_state_t *cms, cbrush_t *brush )
 			switch( p->signbits )
 			{
 			case 0:
-				if( p->normal[0]*trace_startmins[0] + p->normal[1]*trace_startmins[1] + p->normal[2]*trace_startmins[2] > p->dist )
+				if( p->normal[0]*ct->startmins[0] + p->normal[1]*ct->startmins[1] + p->normal[2]*ct->startmins[2] > p->dist )
 					return;
 				break;
 			case 1:
-				if( p->normal[0]*trace_startmaxs[0] + p->normal[1]*trace_startmins[1] + p->normal[2]*trace_startmins[2] > p->dist )
+				if( p->normal[0]*ct->startmaxs[0] + p->normal[1]*ct->startmins[1] + p->normal[2]*ct->startmins[2] > p->dist )
 					return;
 				break;
 			case 2:
-				if( p->normal[0]*trace_startmins[0] + p->normal[1]*trace_startmaxs[1] + p->normal[2]*trace_startmins[2] > p->dist )
+				if( p->normal[0]*ct->startmins[0] + p->normal[1]*ct->startmaxs[1] + p->normal[2]*ct->startmins[2] > p->dist )
 					return;
 				break;
 			case 3:
-				if( p->normal[0]*trace_startmaxs[0] + p->normal[1]*trace_startmaxs[1] + p->normal[2]*trace_startmins[2] > p->dist )
+				if( p->normal[0]*ct->startmaxs[0] + p->normal[1]*ct->startmaxs[1] + p->normal[2]*ct->startmins[2] > p->dist )
 					return;
 				break;
 			case 4:
-				if( p->normal[0]*trace_startmins[0] + p->normal[1]*trace_startmins[1] + p->normal[2]*trace_startmaxs[2] > p->dist )
+				if( p->normal[0]*ct->startmins[0] + p->normal[1]*ct->startmins[1] + p->normal[2]*ct->startmaxs[2] > p->dist )
 					return;
 				break;
 			case 5:
-				if( p->normal[0]*trace_startmaxs[0] + p->normal[1]*trace_startmins[1] + p->normal[2]*trace_startmaxs[2] > p->dist )
+				if( p->normal[0]*ct->startmaxs[0] + p->normal[1]*ct->startmins[1] + p->normal[2]*ct->startmaxs[2] > p->dist )
 					return;
 				break;
 			case 6:
-				if( p->normal[0]*trace_startmins[0] + p->normal[1]*trace_startmaxs[1] + p->normal[2]*trace_startmaxs[2] > p->dist )
+				if( p->normal[0]*ct->startmins[0] + p->normal[1]*ct->startmaxs[1] + p->normal[2]*ct->startmaxs[2] > p->dist )
 					return;
 				break;
 			case 7:
-				if( p->normal[0]*trace_startmaxs[0] + p->normal[1]*trace_startmaxs[1] + p->normal[2]*trace_startmaxs[2] > p->dist )
+				if( p->normal[0]*ct->startmaxs[0] + p->normal[1]*ct->startmaxs[1] + p->normal[2]*ct->startmaxs[2] > p->dist )
 					return;
 				break;
 			default:
@@ -749,33 +1052,215 @@ static void CM_TestBoxInBrush( cmodel_state_t *cms, cbrush_t *brush )
 	}
 
 	// inside this brush
-	trace_trace->startsolid = trace_trace->allsolid = true;
-	trace_trace->fraction = 0;
-	trace_trace->contents = brush->contents;
+	ct->trace->startsolid = ct->trace->allsolid = true;
+	ct->trace->fraction = 0;
+	ct->trace->contents = brush->contents;
 }
 
+#ifdef CM_USE_SSE
+/*
+* CM_Select4
+*/
+static inline __m128 CM_Select4( __m128 mask, __m128 a, __m128 b )
+{
+	return _mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b ) );
+}
+
+/*
+* CM_ClipBoxToBrush_SSE
+*
+* Same as CM_ClipBoxToBrush, four planes at a time. Each lane keeps the first of its
+* planes with the highest enter fraction and ties between lanes go to the plane that
+* comes first, so both pick the same plane.
+*/
+static void CM_ClipBoxToBrush_SSE( cmodel_state_t *cms, ctrace_t *ct, cbrush_t *brush )
+{
+	int i;
+	int startout, getout;
+	float enterfrac, leavefrac;
+	float enterfracs[4], leavefracs[4], sides[4];
+	cbrushside_t *leadside, *side;
+	const cplanegroup_t *g;
+	__m128 zero, eps, four, dist;
+	__m128 nx, ny, nz, x, y, z;
+	__m128 d1, d2, f, frac, out1, out2, cross, mask;
+	__m128 index, bestenter, bestleave, bestindex;
+
+	if( !brush->numsides )
+		return;
+
+	assert( brush->planegroups );
+
+	ct->brushtraces++;
+
+	zero = _mm_setzero_ps();
+	eps = _mm_set1_ps( DIST_EPSILON );
+	four = _mm_set1_ps( 4 );
+	index = _mm_setr_ps( 0, 1, 2, 3 );
+	bestenter = _mm_set1_ps( -1 );
+	bestleave = _mm_set1_ps( 1 );
+	bestindex = zero;
+
+	startout = getout = 0;
+
+	for( i = 0, g = brush->planegroups; i < brush->numsides; i += 4, g++ )
+	{
+		nx = _mm_load_ps( g->normal[0] );
+		ny = _mm_load_ps( g->normal[1] );
+		nz = _mm_load_ps( g->normal[2] );
+		dist = _mm_load_ps( g->dist );
+
+		// push the planes out apropriately for mins/maxs
+		x = CM_Select4( _mm_cmplt_ps( nx, zero ), ct->startmaxs4[0], ct->startmins4[0] );
+		y = CM_Select4( _mm_cmplt_ps( ny, zero ), ct->startmaxs4[1], ct->startmins4[1] );
+		z = CM_Select4( _mm_cmplt_ps( nz, zero ), ct->startmaxs4[2], ct->startmins4[2] );
+		d1 = _mm_sub_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( nx, x ), _mm_mul_ps( ny, y ) ), _mm_mul_ps( nz, z ) ), dist );
+
+		x = CM_Select4( _mm_cmplt_ps( nx, zero ), ct->endmaxs4[0], ct->endmins4[0] );
+		y = CM_Select4( _mm_cmplt_ps( ny, zero ), ct->endmaxs4[1], ct->endmins4[1] );
+		z = CM_Select4( _mm_cmplt_ps( nz, zero ), ct->endmaxs4[2], ct->endmins4[2] );
+		d2 = _mm_sub_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( nx, x ), _mm_mul_ps( ny, y ) ), _mm_mul_ps( nz, z ) ), dist );
+
+		out1 = _mm_cmpgt_ps( d1, zero );
+		out2 = _mm_cmpgt_ps( d2, zero );
+
+		// if completely in front of any face, no intersection
+		if( _mm_movemask_ps( _mm_and_ps( out1, _mm_cmpge_ps( d2, d1 ) ) ) )
+			return;
+
+		startout |= _mm_movemask_ps( out1 );
+		getout |= _mm_movemask_ps( out2 );
+
+		// faces crossed by the move
+		cross = _mm_or_ps( out1, out2 );
+		f = _mm_sub_ps( d1, d2 );
+
+		// enter
+		frac = _mm_div_ps( _mm_sub_ps( d1, eps ), f );
+		mask = _mm_and_ps( _mm_and_ps( cross, _mm_cmpgt_ps( f, zero ) ), _mm_cmpgt_ps( frac, bestenter ) );
+		bestenter = CM_Select4( mask, frac, bestenter );
+		bestindex = CM_Select4( mask, index, bestindex );
+
+		// leave
+		frac = _mm_div_ps( _mm_add_ps( d1, eps ), f );
+		mask = _mm_and_ps( _mm_and_ps( cross, _mm_cmplt_ps( f, zero ) ), _mm_cmplt_ps( frac, bestleave ) );
+		bestleave = CM_Select4( mask, frac, bestleave );
+
+		index = _mm_add_ps( index, four );
+	}
+
+	_mm_storeu_ps( enterfracs, bestenter );
+	_mm_storeu_ps( leavefracs, bestleave );
+	_mm_storeu_ps( sides, bestindex );
+
+	enterfrac = -1;
+	leavefrac = 1;
+	leadside = NULL;
+	for( i = 0; i < 4; i++ )
+	{
+		side = brush->brushsides + (int)sides[i];
+		if( enterfracs[i] > enterfrac || ( leadside && enterfracs[i] == enterfrac && side < leadside ) )
+		{
+			enterfrac = enterfracs[i];
+			leadside = side;
+		}
+		if( leavefracs[i] < leavefrac )
+			leavefrac = leavefracs[i];
+	}
+
+	if( !startout )
+	{
+		// original point was inside brush
+		ct->trace->startsolid = true;
+		ct->trace->contents = brush->contents;
+		if( !getout )
+		{
+			ct->trace->allsolid = true;
+			ct->trace->fraction = 0;
+		}
+		return;
+	}
+
+	if( enterfrac - ( 1.0f / 1024.0f ) <= leavefrac )
+	{
+		if( enterfrac > -1 && enterfrac < ct->trace->fraction )
+		{
+			if( enterfrac < 0 )
+				enterfrac = 0;
+			ct->trace->fraction = enterfrac;
+			ct->trace->plane = *leadside->plane;
+			ct->trace->surfFlags = leadside->surfFlags;
+			ct->trace->contents = brush->contents;
+		}
+	}
+}
+
+/*
+* CM_TestBoxInBrush_SSE
+*/
+static void CM_TestBoxInBrush_SSE( cmodel_state_t *cms, ctrace_t *ct, cbrush_t *brush )
+{
+	int i;
+	const cplanegroup_t *g;
+	__m128 zero, nx, ny, nz, x, y, z, d;
+
+	if( !brush->numsides )
+		return;
+
+	assert( brush->planegroups );
+
+	zero = _mm_setzero_ps();
+
+	for( i = 0, g = brush->planegroups; i < brush->numsides; i += 4, g++ )
+	{
+		nx = _mm_load_ps( g->normal[0] );
+		ny = _mm_load_ps( g->normal[1] );
+		nz = _mm_load_ps( g->normal[2] );
+
+		// push the planes out appropriately for mins/maxs
+		// if completely in front of any face, no intersection
+		x = CM_Select4( _mm_cmplt_ps( nx, zero ), ct->startmaxs4[0], ct->startmins4[0] );
+		y = CM_Select4( _mm_cmplt_ps( ny, zero ), ct->startmaxs4[1], ct->startmins4[1] );
+		z = CM_Select4( _mm_cmplt_ps( nz, zero ), ct->startmaxs4[2], ct->startmins4[2] );
+		d = _mm_add_ps( _mm_add_ps( _mm_mul_ps( nx, x ), _mm_mul_ps( ny, y ) ), _mm_mul_ps( nz, z ) );
+
+		if( _mm_movemask_ps( _mm_cmpgt_ps( d, _mm_load_ps( g->dist ) ) ) )
+			return;
+	}
+
+	// inside this brush
+	ct->trace->startsolid = ct->trace->allsolid = true;
+	ct->trace->fraction = 0;
+	ct->trace->contents = brush->contents;
+}
+#endif
+
 /*
 * CM_CollideBox
 */
-static void CM_CollideBox( cmodel_state_t *cms, cbrush_t **markbrushes, int nummarkbrushes, cface_t **markfaces,
-						  int nummarkfaces, void ( *func )( cmodel_state_t *cms, cbrush_t *b ) )
+static void CM_CollideBox( cmodel_state_t *cms, ctrace_t *ct, cbrush_t **markbrushes, int nummarkbrushes, cface_t **markfaces,
+						  int nummarkfaces, void ( *func )( cmodel_state_t *cms, ctrace_t *ct, cbrush_t *b ) )
 {
 	int i, j;
 	cbrush_t *b;
 	cface_t	*patch;
 	cbrush_t *facet;
+	cvisitstamps_t *stamps = ct->stamps;
 
 	// trace line against all brushes
 	for( i = 0; i < nummarkbrushes; i++ )
 	{
 		b = markbrushes[i];
-		if( b->checkcount == cms->checkcount )
-			continue; // already checked this brush
-		b->checkcount = cms->checkcount;
-		if( !( b->contents & trace_contents ) )
+		if( stamps )
+		{
+			if( stamps->brushes[b - cms->map_brushes] == stamps->checkcount )
+				continue; // already checked this brush
+			stamps->brushes[b - cms->map_brushes] = stamps->checkcount;
+		}
+		if( !( b->contents & ct->contents ) )
 			continue;
-		func( cms, b );
-		if( !trace_trace->fraction )
+		func( cms, ct, b );
+		if( !ct->trace->fraction )
 			return;
 	}
 
@@ -786,18 +1271,21 @@ static void CM_CollideBox( cmodel_state_t *cms, cbrush_t **markbrushes, int numm
 	for( i = 0; i < nummarkfaces; i++ )
 	{
 		patch = markfaces[i];
-		if( patch->checkcount == cms->checkcount )
-			continue; // already checked this patch
-		patch->checkcount = cms->checkcount;
-		if( !( patch->contents & trace_contents ) )
+		if( stamps )
+		{
+			if( stamps->faces[patch - cms->map_faces] == stamps->checkcount )
+				continue; // already checked this patch
+			stamps->faces[patch - cms->map_faces] = stamps->checkcount;
+		}
+		if( !( patch->contents & ct->contents ) )
 			continue;
-		if( !BoundsIntersect( patch->mins, patch->maxs, trace_absmins, trace_absmaxs ) )
+		if( !BoundsIntersect( patch->mins, patch->maxs, ct->absmins, ct->absmaxs ) )
 			continue;
 		facet = patch->facets;
 		for( j = 0; j < patch->numfacets; j++, facet++ )
 		{
-			func( cms, facet );
-			if( !trace_trace->fraction )
+			func( cms, ct, facet );
+			if( !ct->trace->fraction )
 				return;
 		}
 	}
@@ -806,139 +1294,211 @@ static void CM_CollideBox( cmodel_state_t *cms, cbrush_t **markbrushes, int numm
 /*
 * CM_ClipBox
 */
-static inline void CM_ClipBox( cmodel_state_t *cms, cbrush_t **markbrushes, int nummarkbrushes, cface_t **markfaces,
+static inline void CM_ClipBox( cmodel_state_t *cms, ctrace_t *ct, cbrush_t **markbrushes, int nummarkbrushes, cface_t **markfaces,
 							  int nummarkfaces )
 {
-	CM_CollideBox( cms, markbrushes, nummarkbrushes, markfaces, nummarkfaces, CM_ClipBoxToBrush );
+#ifdef CM_USE_SSE
+	if( !cm_noSIMD->integer )
+	{
+		CM_CollideBox( cms, ct, markbrushes, nummarkbrushes, markfaces, nummarkfaces, CM_ClipBoxToBrush_SSE );
+		return;
+	}
+#endif
+	CM_CollideBox( cms, ct, markbrushes, nummarkbrushes, markfaces, nummarkfaces, CM_ClipBoxToBrush );
 }
 
 /*
 * CM_TestBox
 */
-static inline void CM_TestBox( cmodel_state_t *cms, cbrush_t **markbrushes, int nummarkbrushes, cface_t **markfaces,
+static inline void CM_TestBox( cmodel_state_t *cms, ctrace_t *ct, cbrush_t **markbrushes, int nummarkbrushes, cface_t **markfaces,
 							  int nummarkfaces )
 {
-	CM_CollideBox( cms, markbrushes, nummarkbrushes, markfaces, nummarkfaces, CM_TestBoxInBrush );
+#ifdef CM_USE_SSE
+	if( !cm_noSIMD->integer )
+	{
+		CM_CollideBox( cms, ct, markbrushes, nummarkbrushes, markfaces, nummarkfaces, CM_TestBoxInBrush_SSE );
+		return;
+	}
+#endif
+	CM_CollideBox( cms, ct, markbrushes, nummarkbrushes, markfaces, nummarkfaces, CM_TestBoxInBrush );
 }
 
 /*
-* CM_RecursiveHullCheck
+* CM_HullCheck
+*
+* Walks the nodes front to back, the far side of each split the trace
+* crosses is kept on a stack and only visited if nothing nearer was hit.
 */
-static void CM_RecursiveHullCheck( cmodel_state_t *cms, int num, float p1f, float p2f, vec3_t p1, vec3_t p2 )
+typedef struct
+{
+	int num;
+	float p1f, p2f;
+	vec3_t p1, p2;
+} chullcheck_t;
+
+static void CM_HullCheck( cmodel_state_t *cms, ctrace_t *ct, int num, float p1f, float p2f, const vec3_t start, const vec3_t end )
 {
 	cnode_t	*node;
 	cplane_t *plane;
-	int side;
+	int side, sp;
 	float t1, t2, offset;
 	float frac, frac2;
 	float idist, midf;
-	vec3_t mid;
+	vec3_t p1, p2, mid;
+	chullcheck_t stack[CM_MAX_NODE_STACK], *far;
+
+	VectorCopy( start, p1 );
+	VectorCopy( end, p2 );
+	sp = 0;
 
-loc0:
+	while( 1 )
+	{
 #ifdef TRACEVICFIX
-	if( trace_realfraction <= p1f )
-		return; // already hit something nearer
+		if( ct->realfraction <= p1f )
+			goto pop; // already hit something nearer
 #else
-	if( trace_trace->fraction <= p1f )
-		return; // already hit something nearer
+		if( ct->trace->fraction <= p1f )
+			goto pop; // already hit something nearer
 #endif
-	// if < 0, we are in a leaf node
-	if( num < 0 )
-	{
-		cleaf_t	*leaf;
+		// if < 0, we are in a leaf node
+		if( num < 0 )
+		{
+			cleaf_t	*leaf;
 
-		leaf = &cms->map_leafs[-1 - num];
-		if( leaf->contents & trace_contents )
-			CM_ClipBox( cms, leaf->markbrushes, leaf->nummarkbrushes, leaf->markfaces, leaf->nummarkfaces );
-		return;
-	}
+			leaf = &cms->map_leafs[-1 - num];
+			if( leaf->contents & ct->contents )
+				CM_ClipBox( cms, ct, leaf->markbrushes, leaf->nummarkbrushes, leaf->markfaces, leaf->nummarkfaces );
+			goto pop;
+		}
 
-	//
-	// find the point distances to the seperating plane
-	// and the offset for the size of the box
-	//
-	node = cms->map_nodes + num;
-	plane = node->plane;
+		ct->nodetraces++;
 
-	if( plane->type < 3 )
-	{
-		t1 = p1[plane->type] - plane->dist;
-		t2 = p2[plane->type] - plane->dist;
-		offset = trace_extents[plane->type];
-	}
-	else
-	{
-		t1 = DotProduct( plane->normal, p1 ) - plane->dist;
-		t2 = DotProduct( plane->normal, p2 ) - plane->dist;
-		if( trace_ispoint )
-			offset = 0;
+		//
+		// find the point distances to the seperating plane
+		// and the offset for the size of the box
+		//
+		node = cms->map_nodes + num;
+		plane = &node->plane;
+
+		if( plane->type < 3 )
+		{
+			t1 = p1[plane->type] - plane->dist;
+			t2 = p2[plane->type] - plane->dist;
+			offset = ct->extents[plane->type];
+		}
 		else
-			offset = fabs( trace_extents[0] * plane->normal[0] ) +
-			fabs( trace_extents[1] * plane->normal[1] ) +
-			fabs( trace_extents[2] * plane->normal[2] );
-	}
+		{
+			t1 = DotProduct( plane->normal, p1 ) - plane->dist;
+			t2 = DotProduct( plane->normal, p2 ) - plane->dist;
+			if( ct->ispoint )
+				offset = 0;
+			else
+				offset = fabs( ct->extents[0] * plane->normal[0] ) +
+				fabs( ct->extents[1] * plane->normal[1] ) +
+				fabs( ct->extents[2] * plane->normal[2] );
+		}
 
-	// see which sides we need to consider
-	if( t1 >= offset && t2 >= offset )
-	{
-		num = node->children[0];
-		goto loc0;
-	}
-	if( t1 < -offset && t2 < -offset )
-	{
-		num = node->children[1];
-		goto loc0;
-	}
+		// see which sides we need to consider
+		if( t1 >= offset && t2 >= offset )
+		{
+			num = node->children[0];
+			continue;
+		}
+		if( t1 < -offset && t2 < -offset )
+		{
+			num = node->children[1];
+			continue;
+		}
 
-	// put the crosspoint DIST_EPSILON pixels on the near side
-	if( t1 < t2 )
-	{
-		idist = 1.0 / ( t1 - t2 );
-		side = 1;
+		// put the crosspoint DIST_EPSILON pixels on the near side
+		if( t1 < t2 )
+		{
+			idist = 1.0 / ( t1 - t2 );
+			side = 1;
 #ifdef TRACEVICFIX
-		frac2 = ( t1 + offset ) * idist;
-		frac = ( t1 - offset ) * idist;
+			frac2 = ( t1 + offset ) * idist;
+			frac = ( t1 - offset ) * idist;
 #else
-		frac2 = ( t1 + offset + DIST_EPSILON ) * idist;
-		frac = ( t1 - offset + DIST_EPSILON ) * idist;
+			frac2 = ( t1 + offset + DIST_EPSILON ) * idist;
+			frac = ( t1 - offset + DIST_EPSILON ) * idist;
 #endif
-	}
-	else if( t1 > t2 )
-	{
-		idist = 1.0 / ( t1 - t2 );
-		side = 0;
+		}
+		else if( t1 > t2 )
+		{
+			idist = 1.0 / ( t1 - t2 );
+			side = 0;
 #ifdef TRACEVICFIX
-		frac2 = ( t1 - offset ) * idist;
-		frac = ( t1 + offset ) * idist;
+			frac2 = ( t1 - offset ) * idist;
+			frac = ( t1 + offset ) * idist;
 #else
-		frac2 = ( t1 - offset - DIST_EPSILON ) * idist;
-		frac = ( t1 + offset + DIST_EPSILON ) * idist;
+			frac2 = ( t1 - offset - DIST_EPSILON ) * idist;
+			frac = ( t1 + offset + DIST_EPSILON ) * idist;
 #endif
-	}
-	else
-	{
-		side = 0;
-		frac = 1;
-		frac2 = 0;
-	}
+		}
+		else
+		{
+			side = 0;
+			frac = 1;
+			frac2 = 0;
+		}
+
+		// the part past the node is visited after the near side
+		if( sp < CM_MAX_NODE_STACK )
+		{
+			far = &stack[sp++];
+			clamp( frac2, 0, 1 );
+			far->num = node->children[side^1];
+			far->p1f = p1f + ( p2f - p1f ) * frac2;
+			far->p2f = p2f;
+			VectorLerp( p1, frac2, p2, far->p1 );
+			VectorCopy( p2, far->p2 );
+
+			// move up to the node
+			clamp( frac, 0, 1 );
+			p2f = p1f + ( p2f - p1f ) * frac;
+			VectorLerp( p1, frac, p2, mid );
+			VectorCopy( mid, p2 );
+			num = node->children[side];
+			continue;
+		}
 
-	// move up to the node
-	clamp( frac, 0, 1 );
-	midf = p1f + ( p2f - p1f ) * frac;
-	VectorLerp( p1, frac, p2, mid );
+		// out of stack space, recurse into the near side instead
+		clamp( frac, 0, 1 );
+		midf = p1f + ( p2f - p1f ) * frac;
+		VectorLerp( p1, frac, p2, mid );
 
-	CM_RecursiveHullCheck( cms, node->children[side], p1f, midf, p1, mid );
+		CM_HullCheck( cms, ct, node->children[side], p1f, midf, p1, mid );
 
-	// go past the node
-	clamp( frac2, 0, 1 );
-	midf = p1f + ( p2f - p1f ) * frac2;
-	VectorLerp( p1, frac2, p2, mid );
+		clamp( frac2, 0, 1 );
+		p1f = p1f + ( p2f - p1f ) * frac2;
+		VectorLerp( p1, frac2, p2, mid );
+		VectorCopy( mid, p1 );
+		num = node->children[side^1];
+		continue;
 
-	CM_RecursiveHullCheck( cms, node->children[side^1], midf, p2f, mid, p2 );
+pop:
+		if( !sp )
+			return;
+		far = &stack[--sp];
+		num = far->num;
+		p1f = far->p1f;
+		p2f = far->p2f;
+		VectorCopy( far->p1, p1 );
+		VectorCopy( far->p2, p2 );
+	}
 }
 
 //======================================================================
 
+/*
+* CM_AddTraceCounters
+*/
+static inline void CM_AddTraceCounters( const ctrace_t *ct )
+{
+	c_brush_traces += ct->brushtraces;
+	c_node_traces += ct->nodetraces;
+}
+
 /*
 * CM_BoxTrace
 */
@@ -946,43 +1506,24 @@ static void CM_BoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec3_t
 						cmodel_t *cmodel, vec3_t origin, int brushmask )
 {
 	bool notworld;
+	ctrace_t ct;
 
 	notworld = ( cmodel != cms->map_cmodels ? true : false );
 
-	cms->checkcount++;  // for multi-check avoidance
 	c_traces++;     // for statistics, may be zeroed
 
 	// fill in a default trace
 	memset( tr, 0, sizeof( *tr ) );
 #ifdef TRACEVICFIX
-	tr->fraction = trace_realfraction = 1;
+	tr->fraction = ct.realfraction = 1;
 #else
 	tr->fraction = 1;
 #endif
 	if( !cms->numnodes )  // map not loaded
 		return;
 
-	trace_trace = tr;
-	trace_contents = brushmask;
-	VectorCopy( start, trace_start );
-	VectorCopy( end, trace_end );
-	VectorCopy( mins, trace_mins );
-	VectorCopy( maxs, trace_maxs );
-
-	// build a bounding box of the entire move
-	ClearBounds( trace_absmins, trace_absmaxs );
-
-	VectorAdd( start, trace_mins, trace_startmins );
-	AddPointToBounds( trace_startmins, trace_absmins, trace_absmaxs );
-
-	VectorAdd( start, trace_maxs, trace_startmaxs );
-	AddPointToBounds( trace_startmaxs, trace_absmins, trace_absmaxs );
-
-	VectorAdd( end, trace_mins, trace_endmins );
-	AddPointToBounds( trace_endmins, trace_absmins, trace_absmaxs );
-
-	VectorAdd( end, trace_maxs, trace_endmaxs );
-	AddPointToBounds( trace_endmaxs, trace_absmins, trace_absmaxs );
+	CM_SetupTrace( &ct, tr, start, end, mins, maxs, brushmask );
+	ct.stamps = notworld ? NULL : CM_NextVisitStamp( cms );
 
 	//
 	// check for position test special case
@@ -997,9 +1538,9 @@ static void CM_BoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec3_t
 
 		if( notworld )
 		{
-			if( BoundsIntersect( cmodel->mins, cmodel->maxs, trace_absmins, trace_absmaxs ) )
+			if( BoundsIntersect( cmodel->mins, cmodel->maxs, ct.absmins, ct.absmaxs ) )
 			{
-				CM_TestBox( cms, cmodel->markbrushes, cmodel->nummarkbrushes, cmodel->markfaces, cmodel->nummarkfaces );
+				CM_TestBox( cms, &ct, cmodel->markbrushes, cmodel->nummarkbrushes, cmodel->markfaces, cmodel->nummarkfaces );
 			}
 		}
 		else
@@ -1015,9 +1556,9 @@ static void CM_BoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec3_t
 			{
 				leaf = &cms->map_leafs[leafs[i]];
 
-				if( leaf->contents & trace_contents )
+				if( leaf->contents & ct.contents )
 				{
-					CM_TestBox( cms, leaf->markbrushes, leaf->nummarkbrushes, leaf->markfaces, leaf->nummarkfaces );
+					CM_TestBox( cms, &ct, leaf->markbrushes, leaf->nummarkbrushes, leaf->markfaces, leaf->nummarkfaces );
 					if( tr->allsolid )
 						break;
 				}
@@ -1025,6 +1566,7 @@ static void CM_BoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec3_t
 		}
 
 		VectorCopy( start, tr->endpos );
+		CM_AddTraceCounters( &ct );
 		return;
 	}
 
@@ -1033,13 +1575,13 @@ static void CM_BoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec3_t
 	//
 	if( VectorCompare( mins, vec3_origin ) && VectorCompare( maxs, vec3_origin ) )
 	{
-		trace_ispoint = true;
-		VectorClear( trace_extents );
+		ct.ispoint = true;
+		VectorClear( ct.extents );
 	}
 	else
 	{
-		trace_ispoint = false;
-		VectorSet( trace_extents,
+		ct.ispoint = false;
+		VectorSet( ct.extents,
 			-mins[0] > maxs[0] ? -mins[0] : maxs[0],
 			-mins[1] > maxs[1] ? -mins[1] : maxs[1],
 			-mins[2] > maxs[2] ? -mins[2] : maxs[2] );
@@ -1049,9 +1591,11 @@ static void CM_BoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec3_t
 	// general sweeping through world
 	//
 	if( !notworld )
-		CM_RecursiveHullCheck( cms, 0, 0, 1, start, end );
-	else if( BoundsIntersect( cmodel->mins, cmodel->maxs, trace_absmins, trace_absmaxs ) )
-		CM_ClipBox( cms, cmodel->markbrushes, cmodel->nummarkbrushes, cmodel->markfaces, cmodel->nummarkfaces );
+		CM_HullCheck( cms, &ct, 0, 0, 1, start, end );
+	else if( BoundsIntersect( cmodel->mins, cmodel->maxs, ct.absmins, ct.absmaxs ) )
+		CM_ClipBox( cms, &ct, cmodel->markbrushes, cmodel->nummarkbrushes, cmodel->markfaces, cmodel->nummarkfaces );
+
+	CM_AddTraceCounters( &ct );
 
 #ifdef TRACEVICFIX
 	clamp( tr->fraction, 0, 1 );
@@ -1109,7 +1653,7 @@ void CM_TransformedBoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec
 	}
 
 	// cylinder offset
-	if( cmodel == cms->oct_cmodel )
+	if( cmodel == cm_octhull.cmodel )
 	{
 		VectorSubtract( start, cmodel->cyl_offset, start_l );
 		VectorSubtract( end, cmodel->cyl_offset, end_l );
@@ -1174,3 +1718,236 @@ void CM_TransformedBoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec
 #endif
 	}
 }
+
+/*
+===============================================================================
+
+KERNEL CHECK
+
+===============================================================================
+*/
+
+#define CLIPCHECK_MAX_SIDES		20
+#define CLIPCHECK_BATCH			64		// traces for each random brush
+#define CLIPCHECK_EPSILON		( 1.0f / 65536.0f )
+
+typedef struct
+{
+	vec3_t start, end;
+	vec3_t mins, maxs;
+	float fraction;
+} clipcheck_trace_t;
+
+/*
+* CM_ClipCheckRandom
+*/
+static float CM_ClipCheckRandom( unsigned int *seed, float min, float max )
+{
+	*seed = *seed * 1103515245 + 12345;
+	return min + ( max - min ) * ( ( *seed >> 8 ) & 0xffff ) / 65535.0f;
+}
+
+/*
+* CM_ClipCheckBrush
+*
+* Builds a random brush in the way q3map does, six axial planes followed by bevels.
+* Some bevels repeat an earlier plane, so that several sides tie.
+*/
+static void CM_ClipCheckBrush( unsigned int *seed, cbrush_t *brush, cplane_t *planes, cplanegroup_t *groups )
+{
+	int i, j;
+	float size;
+	vec3_t center;
+	cplane_t *p;
+
+	for( i = 0; i < 3; i++ )
+		center[i] = floor( CM_ClipCheckRandom( seed, -32, 32 ) );
+	size = floor( CM_ClipCheckRandom( seed, 8, 128 ) );
+
+	brush->contents = CONTENTS_SOLID;
+	brush->numsides = 6 + (int)CM_ClipCheckRandom( seed, 0, CLIPCHECK_MAX_SIDES - 6 );
+	clamp_high( brush->numsides, CLIPCHECK_MAX_SIDES );
+
+	for( i = 0, p = planes; i < brush->numsides; i++, p++ )
+	{
+		if( i < 6 )
+		{
+			VectorClear( p->normal );
+			p->normal[i >> 1] = ( i & 1 ) ? -1 : 1;
+			p->dist = ( i & 1 ) ? -( center[i >> 1] - size ) : center[i >> 1] + size;
+		}
+		else if( CM_ClipCheckRandom( seed, 0, 1 ) < 0.2f )
+		{
+			*p = planes[(int)CM_ClipCheckRandom( seed, 0, i - 1 )];
+		}
+		else
+		{
+			for( j = 0; j < 3; j++ )
+				p->normal[j] = CM_ClipCheckRandom( seed, -1, 1 );
+			if( !VectorNormalize( p->normal ) )
+				VectorSet( p->normal, 0, 0, 1 );
+			p->dist = DotProduct( p->normal, center ) + size * CM_ClipCheckRandom( seed, 0.5f, 1.5f );
+		}
+
+		CategorizePlane( p );
+		brush->brushsides[i].plane = p;
+		brush->brushsides[i].surfFlags = i;
+	}
+
+	CM_PackBrushPlanes( brush, groups );
+}
+
+/*
+* CM_ClipCheckTrace
+*/
+static void CM_ClipCheckTrace( unsigned int *seed, clipcheck_trace_t *t )
+{
+	int i;
+
+	for( i = 0; i < 3; i++ )
+	{
+		t->start[i] = CM_ClipCheckRandom( seed, -192, 192 );
+		t->end[i] = CM_ClipCheckRandom( seed, -192, 192 );
+		t->mins[i] = CM_ClipCheckRandom( seed, -48, 0 );
+		t->maxs[i] = CM_ClipCheckRandom( seed, 0, 48 );
+	}
+
+	// integral coordinates touch the axial planes exactly
+	if( CM_ClipCheckRandom( seed, 0, 1 ) < 0.5f )
+	{
+		for( i = 0; i < 3; i++ )
+		{
+			t->start[i] = floor( t->start[i] );
+			t->end[i] = floor( t->end[i] );
+			t->mins[i] = floor( t->mins[i] );
+			t->maxs[i] = floor( t->maxs[i] );
+		}
+	}
+
+	if( CM_ClipCheckRandom( seed, 0, 1 ) < 0.4f )
+	{
+		VectorClear( t->mins );
+		VectorClear( t->maxs );
+	}
+
+	if( CM_ClipCheckRandom( seed, 0, 1 ) < 0.2f )
+		VectorCopy( t->start, t->end );
+
+	// something nearer may have been hit already
+	t->fraction = CM_ClipCheckRandom( seed, 0, 1 ) < 0.5f ? 1 : CM_ClipCheckRandom( seed, 0, 1 );
+}
+
+/*
+* CM_ClipCheckRun
+*/
+static uint64_t CM_ClipCheckRun( cbrush_t *brush, clipcheck_trace_t *traces, int numtraces, trace_t *results, bool simd )
+{
+	int i;
+	ctrace_t ct;
+	clipcheck_trace_t *t;
+	uint64_t start;
+
+	start = Sys_Microseconds();
+
+	for( i = 0, t = traces; i < numtraces; i++, t++ )
+	{
+		memset( &results[i], 0, sizeof( results[i] ) );
+		results[i].fraction = t->fraction;
+
+		CM_SetupTrace( &ct, &results[i], t->start, t->end, t->mins, t->maxs, MASK_ALL );
+		ct.stamps = NULL;
+
+		if( VectorCompare( t->start, t->end ) )
+		{
+			if( simd )
+				CM_TestBoxInBrush_SSE( NULL, &ct, brush );
+			else
+				CM_TestBoxInBrush( NULL, &ct, brush );
+		}
+		else
+		{
+			if( simd )
+				CM_ClipBoxToBrush_SSE( NULL, &ct, brush );
+			else
+				CM_ClipBoxToBrush( NULL, &ct, brush );
+		}
+	}
+
+	return Sys_Microseconds() - start;
+}
+
+/*
+* CM_ClipCheck_f
+*
+* Fires random traces at random brushes through both the scalar and the SSE brush
+* kernels. With -ffast-math the compiler may evaluate the plane distances in another
+* order for each kernel, so the fractions may differ in the last bits, everything
+* else must be the same.
+*/
+void CM_ClipCheck_f( void )
+{
+#ifdef CM_USE_SSE
+	int i, j, numtraces, batch, mismatches, hits, inexact;
+	unsigned int seed;
+	float delta, maxdelta;
+	uint64_t scalarusec, simdusec;
+	cbrush_t brush;
+	cbrushside_t brushsides[CLIPCHECK_MAX_SIDES];
+	cplane_t planes[CLIPCHECK_MAX_SIDES];
+	ATTRIBUTE_ALIGNED( 16 ) cplanegroup_t groups[( CLIPCHECK_MAX_SIDES + 3 ) / 4];
+	clipcheck_trace_t traces[CLIPCHECK_BATCH];
+	trace_t scalar[CLIPCHECK_BATCH], simd[CLIPCHECK_BATCH];
+
+	numtraces = Cmd_Argc() > 1 ? atoi( Cmd_Argv( 1 ) ) : 1000000;
+	seed = Cmd_Argc() > 2 ? strtoul( Cmd_Argv( 2 ), NULL, 0 ) : 0x3c0ffee;
+	clamp_low( numtraces, 1 );
+
+	brush.brushsides = brushsides;
+
+	mismatches = hits = inexact = 0;
+	maxdelta = 0;
+	scalarusec = simdusec = 0;
+	for( i = 0; i < numtraces; i += batch )
+	{
+		batch = min( numtraces - i, CLIPCHECK_BATCH );
+
+		CM_ClipCheckBrush( &seed, &brush, planes, groups );
+		for( j = 0; j < batch; j++ )
+			CM_ClipCheckTrace( &seed, &traces[j] );
+
+		scalarusec += CM_ClipCheckRun( &brush, traces, batch, scalar, false );
+		simdusec += CM_ClipCheckRun( &brush, traces, batch, simd, true );
+
+		for( j = 0; j < batch; j++ )
+		{
+			if( scalar[j].fraction != traces[j].fraction || scalar[j].startsolid )
+				hits++;
+			if( !memcmp( &scalar[j], &simd[j], sizeof( trace_t ) ) )
+				continue;
+
+			delta = fabs( scalar[j].fraction - simd[j].fraction );
+			if( delta <= CLIPCHECK_EPSILON && scalar[j].surfFlags == simd[j].surfFlags
+				&& scalar[j].contents == simd[j].contents && scalar[j].startsolid == simd[j].startsolid
+				&& scalar[j].allsolid == simd[j].allsolid )
+			{
+				inexact++;
+				maxdelta = max( maxdelta, delta );
+				continue;
+			}
+
+			if( mismatches++ < 10 )
+			{
+				Com_Printf( "Trace %i differs: fraction %.9g/%.9g, side %i/%i, startsolid %i/%i, allsolid %i/%i\n", i + j,
+					scalar[j].fraction, simd[j].fraction, scalar[j].surfFlags, simd[j].surfFlags,
+					scalar[j].startsolid, simd[j].startsolid, scalar[j].allsolid, simd[j].allsolid );
+			}
+		}
+	}
+
+	Com_Printf( "%i traces, %i hit their brush, %i mismatches\n", numtraces, hits, mismatches );
+	Com_Printf( "%i fractions differ by rounding, by %g at most\n", inexact, maxdelta );
+	Com_Printf( "scalar: %.1f ns/trace, SSE: %.1f ns/trace\n", scalarusec * 1000.0 / numtraces, simdusec * 1000.0 / numtraces );
+#else
+	Com_Printf( "The SSE brush kernels are not built in\n" );
+#endif
+}
@@ -19,6 +19,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 */
 // common.c -- misc functions used in client and server
 #include "qcommon.h"
+#include "sys_threads.h"
 #if defined(__GNUC__) && defined(i386)
 #include <cpuid.h>
 #endif
@@ -43,6 +44,11 @@ static bool com_quit;
 
 static jmp_buf abortframe;     // an ERR_DROP occured, exit the entire frame
 
+#ifdef ATTRIBUTE_THREAD_LOCAL
+static ATTRIBUTE_THREAD_LOCAL jmp_buf *com_threadabortframe;	// ERR_DROP on a worker thread, see Com_SetThreadAbortFrame
+static ATTRIBUTE_THREAD_LOCAL int com_threadabortlocks;		// mutexes already held when the frame was set
+#endif
+
 cvar_t *host_speeds;
 cvar_t *developer;
 cvar_t *timescale;
@@ -63,6 +69,45 @@ static qmutex_t *com_print_mutex;
 
 static int log_file = 0;
 
+/*
+* The console log is written from a dedicated thread. Lines go through a bounded
+* ring with multiple lock-free producers: a producer reserves consecutive slots
+* by moving com_log_head forward and publishes each slot by bumping its sequence
+* number. The consumer side is serialized by com_log_mutex, so the ring can also
+* be drained from the calling thread when flushing on errors and shutdown.
+*/
+#define COM_LOG_RING_SLOTS		1024		// must be a power of two
+#define COM_LOG_SLOT_TEXT		248
+#define COM_LOG_BATCH_SIZE		0x4000
+#define COM_LOG_WAKE_MSEC		100			// the writer also wakes up periodically, in case a wake up was missed
+#define COM_LOG_BLOCK_MSEC		100			// producers wait for room this long before dropping the line
+#define COM_LOG_FLUSH_MSEC		100			// a flush on error waits for the writer this long before giving up
+
+// positions only ever grow and are allowed to wrap around, so they're unsigned
+typedef struct
+{
+	volatile unsigned int seq;	// position the slot is free for, position+1 once it's been filled
+	int len;
+	char text[COM_LOG_SLOT_TEXT];
+} comLogSlot_t;
+
+static comLogSlot_t com_log_slots[COM_LOG_RING_SLOTS];
+static volatile unsigned int com_log_head;
+static unsigned int com_log_tail;
+
+static qmutex_t *com_log_mutex;
+static qthread_t *com_log_thread;
+static qcondvar_t *com_log_condvar;
+static qmutex_t *com_log_wake_mutex;
+static volatile int com_log_sleeping;
+static volatile int com_log_quit;
+
+static volatile int com_log_queued;
+static volatile int com_log_blocked;
+static volatile int com_log_dropped;
+static uint64_t com_log_written;
+static uint64_t com_log_batches;
+
 static int server_state = CA_UNINITIALIZED;
 static int client_state = CA_UNINITIALIZED;
 static bool	demo_playing = false;
@@ -148,19 +193,274 @@ void Com_DeferConsoleLogReopen( void )
 	}
 }
 
+/*
+* Com_InitConsoleLog
+*/
+static void Com_InitConsoleLog( void )
+{
+	int i;
+
+	for( i = 0; i < COM_LOG_RING_SLOTS; i++ )
+		com_log_slots[i].seq = i;
+	com_log_head = com_log_tail = 0;
+
+	com_log_mutex = QMutex_Create();
+	com_log_wake_mutex = QMutex_Create();
+	com_log_condvar = QCondVar_Create();
+}
+
+/*
+* Com_ConsoleLogCAS
+*/
+static inline bool Com_ConsoleLogCAS( volatile unsigned int *value, unsigned int oldval, unsigned int newval )
+{
+	return Sys_Atomic_CAS( ( volatile int * )value, (int)oldval, (int)newval, NULL );
+}
+
+/*
+* Com_WakeConsoleLogWriter
+*/
+static void Com_WakeConsoleLogWriter( void )
+{
+	QMutex_Lock( com_log_wake_mutex );
+	QCondVar_Wake( com_log_condvar );
+	QMutex_Unlock( com_log_wake_mutex );
+}
+
+/*
+* Com_QueueConsoleLog
+* 
+* Reserves enough consecutive slots for the text, so lines of different
+* threads never get interleaved. When the writer can't keep up, waits
+* for a while and then drops the line.
+*/
+static void Com_QueueConsoleLog( const char *text, size_t len )
+{
+	unsigned int i, n, pos, last;
+	size_t ofs;
+	comLogSlot_t *slot;
+	bool blocked = false;
+	unsigned int start = 0, now;
+
+	n = ( len + COM_LOG_SLOT_TEXT - 1 ) / COM_LOG_SLOT_TEXT;
+	if( !n )
+		return;
+	if( n > COM_LOG_RING_SLOTS / 4 )
+	{
+		n = COM_LOG_RING_SLOTS / 4;
+		len = n * COM_LOG_SLOT_TEXT;
+	}
+
+	while( true )
+	{
+		pos = com_log_head;
+		last = pos + n - 1;
+
+		// slots are released in order, so if the last one is free, all of them are
+		if( Com_ConsoleLogCAS( &com_log_slots[last & ( COM_LOG_RING_SLOTS - 1 )].seq, last, last ) )
+		{
+			if( Com_ConsoleLogCAS( &com_log_head, pos, pos + n ) )
+				break;
+			continue;
+		}
+
+		// another producer got there first
+		if( pos != com_log_head )
+			continue;
+
+		// the ring is full
+		now = Sys_Milliseconds();
+		if( !blocked )
+		{
+			blocked = true;
+			start = now;
+			Sys_Atomic_Add( &com_log_blocked, 1, NULL );
+		}
+		else if( now - start > COM_LOG_BLOCK_MSEC || !com_log_thread )
+		{
+			Sys_Atomic_Add( &com_log_dropped, 1, NULL );
+			return;
+		}
+
+		Com_WakeConsoleLogWriter();
+		QThread_Yield();
+	}
+
+	for( i = 0, ofs = 0; i < n; i++, ofs += COM_LOG_SLOT_TEXT )
+	{
+		slot = &com_log_slots[( pos + i ) & ( COM_LOG_RING_SLOTS - 1 )];
+		slot->len = min( len - ofs, COM_LOG_SLOT_TEXT );
+		memcpy( slot->text, text + ofs, slot->len );
+
+		// publish
+		Com_ConsoleLogCAS( &slot->seq, pos + i, pos + i + 1 );
+	}
+
+	Sys_Atomic_Add( &com_log_queued, 1, NULL );
+
+	if( com_log_sleeping )
+		Com_WakeConsoleLogWriter();
+}
+
+/*
+* Com_ConsoleLogPending
+*/
+static bool Com_ConsoleLogPending( void )
+{
+	unsigned int tail = com_log_tail;
+	return Com_ConsoleLogCAS( &com_log_slots[tail & ( COM_LOG_RING_SLOTS - 1 )].seq, tail + 1, tail + 1 );
+}
+
+/*
+* Com_DrainConsoleLog
+* 
+* Writes all published slots to the log file in large batches.
+* Must be called with com_log_mutex held.
+*/
+static void Com_DrainConsoleLog( void )
+{
+	static char batch[COM_LOG_BATCH_SIZE];
+	size_t batchlen = 0;
+	comLogSlot_t *slot;
+	unsigned int tail;
+	bool wrote = false;
+
+	while( true )
+	{
+		tail = com_log_tail;
+		slot = &com_log_slots[tail & ( COM_LOG_RING_SLOTS - 1 )];
+		if( !Com_ConsoleLogCAS( &slot->seq, tail + 1, tail + 1 ) )
+			break;
+
+		if( batchlen + slot->len > sizeof( batch ) )
+		{
+			if( log_file )
+				FS_Write( batch, batchlen, log_file );
+			com_log_written += batchlen;
+			com_log_batches++;
+			batchlen = 0;
+		}
+
+		memcpy( batch + batchlen, slot->text, slot->len );
+		batchlen += slot->len;
+		wrote = true;
+
+		// hand the slot back to the producers for the next lap
+		Com_ConsoleLogCAS( &slot->seq, tail + 1, tail + COM_LOG_RING_SLOTS );
+		com_log_tail = tail + 1;
+	}
+
+	if( batchlen )
+	{
+		if( log_file )
+			FS_Write( batch, batchlen, log_file );
+		com_log_written += batchlen;
+		com_log_batches++;
+	}
+
+	if( wrote && log_file && logconsole_flush && logconsole_flush->integer )
+		FS_Flush( log_file ); // force it to save every time
+}
+
+/*
+* Com_ConsoleLogThread
+*/
+static void *Com_ConsoleLogThread( void *param )
+{
+	while( !com_log_quit )
+	{
+		QMutex_Lock( com_log_mutex );
+		Com_DrainConsoleLog();
+		QMutex_Unlock( com_log_mutex );
+
+		QMutex_Lock( com_log_wake_mutex );
+		com_log_sleeping = 1;
+		if( !com_log_quit && !Com_ConsoleLogPending() )
+			QCondVar_Wait( com_log_condvar, com_log_wake_mutex, COM_LOG_WAKE_MSEC );
+		com_log_sleeping = 0;
+		QMutex_Unlock( com_log_wake_mutex );
+	}
+
+	return NULL;
+}
+
+/*
+* Com_StopConsoleLogWriter
+*/
+static void Com_StopConsoleLogWriter( void )
+{
+	if( !com_log_thread )
+		return;
+
+	com_log_quit = 1;
+	Com_WakeConsoleLogWriter();
+	QThread_Join( com_log_thread );
+	com_log_thread = NULL;
+	com_log_quit = 0;
+}
+
+/*
+* Com_FlushConsoleLog
+* 
+* Synchronously writes everything queued so far, for crashes and shutdown.
+* The error may come from the writer thread while it holds the lock, so this
+* gives up instead of waiting for the lock for long.
+*/
+void Com_FlushConsoleLog( void )
+{
+	int i;
+	static bool flushing = false;
+
+	// writing may fail with another Sys_Error
+	if( !com_log_mutex || flushing )
+		return;
+
+	for( i = 0; !QMutex_TryLock( com_log_mutex ); i++ )
+	{
+		if( i == COM_LOG_FLUSH_MSEC )
+			return;
+		Sys_Sleep( 1 );
+	}
+	flushing = true;
+
+	Com_DrainConsoleLog();
+	if( log_file )
+		FS_Flush( log_file );
+	QMutex_Unlock( com_log_mutex );
+
+	flushing = false;
+}
+
+/*
+* Com_LogConsoleStats_f
+*/
+static void Com_LogConsoleStats_f( void )
+{
+	Com_Printf( "%i lines queued, %i blocked on a full ring, %i dropped\n", com_log_queued, com_log_blocked, com_log_dropped );
+	Com_Printf( "%llu bytes written in %llu batches\n", (unsigned long long)com_log_written, (unsigned long long)com_log_batches );
+}
+
 static void Com_CloseConsoleLog( bool lock, bool shutdown )
 {
 	if( shutdown )
+	{
 		lock = true;
 
+		// the writer may be printing errors, so don't hold the print mutex while waiting for it
+		Com_StopConsoleLogWriter();
+	}
+
 	if( lock )
 		QMutex_Lock( com_print_mutex );
 
+	QMutex_Lock( com_log_mutex );
+	Com_DrainConsoleLog();
 	if( log_file )
 	{
 		FS_FCloseFile( log_file );
 		log_file = 0;
 	}
+	QMutex_Unlock( com_log_mutex );
 
 	if( shutdown )
 		logconsole = NULL;
@@ -181,17 +481,26 @@ static void Com_ReopenConsoleLog( void )
 	{
 		size_t name_size;
 		char *name;
+		int file;
 
 		name_size = strlen( logconsole->string ) + strlen( ".log" ) + 1;
 		name = ( char* )Mem_TempMalloc( name_size );
 		Q_strncpyz( name, logconsole->string, name_size );
 			COM_DefaultExtension( name, ".log", name_size );
 
-		if( FS_FOpenFile( name, &log_file, ( logconsole_append && logconsole_append->integer ? FS_APPEND : FS_WRITE ) ) == -1 )
+		if( FS_FOpenFile( name, &file, ( logconsole_append && logconsole_append->integer ? FS_APPEND : FS_WRITE ) ) == -1 )
 		{
-			log_file = 0;
 			Q_snprintfz( errmsg, MAX_PRINTMSG, "Couldn't open: %s\n", name );
 		}
+		else
+		{
+			QMutex_Lock( com_log_mutex );
+			log_file = file;
+			QMutex_Unlock( com_log_mutex );
+
+			if( !com_log_thread )
+				com_log_thread = QThread_Create( Com_ConsoleLogThread, NULL );
+		}
 
 		Mem_TempFree( name );
 	}
@@ -215,13 +524,6 @@ void Com_Printf( const char *format, ... )
 	va_list argptr;
 	char msg[MAX_PRINTMSG];
 
-	time_t timestamp;
-	char timestamp_str[MAX_PRINTMSG];
-	struct tm *timestampptr;
-	timestamp = time( NULL );
-	timestampptr = gmtime( &timestamp );
-	strftime( timestamp_str, MAX_PRINTMSG, "%Y-%m-%dT%H:%M:%SZ ", timestampptr );
-
 	va_start( argptr, format );
 	Q_vsnprintfz( msg, sizeof( msg ), format, argptr );
 	va_end( argptr );
@@ -246,16 +548,26 @@ void Com_Printf( const char *format, ... )
 
 	Con_Print( msg );
 
+	QMutex_Unlock( com_print_mutex );
+
 	if( log_file )
 	{
 		if( logconsole_timestamp && logconsole_timestamp->integer )
-			FS_Printf( log_file, "%s", timestamp_str );
-		FS_Printf( log_file, "%s", msg );
-		if( logconsole_flush && logconsole_flush->integer )
-			FS_Flush( log_file ); // force it to save every time
+		{
+			time_t timestamp;
+			char line[32 + MAX_PRINTMSG];
+			size_t len;
+
+			timestamp = time( NULL );
+			len = strftime( line, 32, "%Y-%m-%dT%H:%M:%SZ ", gmtime( &timestamp ) );
+			Q_strncpyz( line + len, msg, sizeof( line ) - len );
+			Com_QueueConsoleLog( line, strlen( line ) );
+		}
+		else
+		{
+			Com_QueueConsoleLog( msg, strlen( msg ) );
+		}
 	}
-
-	QMutex_Unlock( com_print_mutex );
 }
 
 
@@ -293,6 +605,23 @@ void Com_Error( com_error_code_t code, const char *format, ... )
 	const size_t sizeof_msg = sizeof( com_errormsg );
 	static bool	recursive = false;
 
+#ifdef ATTRIBUTE_THREAD_LOCAL
+	if( code == ERR_DROP && com_threadabortframe )
+	{
+		char threadmsg[MAX_PRINTMSG];
+
+		va_start( argptr, format );
+		Q_vsnprintfz( threadmsg, sizeof( threadmsg ), format, argptr );
+		va_end( argptr );
+
+		Com_Printf( "********************\nERROR: %s\n********************\n", threadmsg );
+
+		// don't leave the filesystem or memory mutexes locked behind the jump
+		QMutex_UnlockHeld( com_threadabortlocks );
+		longjmp( *com_threadabortframe, -1 );
+	}
+#endif
+
 	if( recursive )
 	{
 		Com_Printf( "recursive error after: %s", msg ); // wsw : jal : log it
@@ -320,15 +649,32 @@ void Com_Error( com_error_code_t code, const char *format, ... )
 		MM_Shutdown();
 	}
 
-	if( log_file )
-	{
-		FS_FCloseFile( log_file );
-		log_file = 0;
-	}
+	// the error may come from the log writer itself or from a thread holding
+	// the print mutex, so write out what's queued without waiting for either
+	Com_FlushConsoleLog();
 
 	Sys_Error( "%s", msg );
 }
 
+/*
+* Com_SetThreadAbortFrame
+* 
+* Worker threads can't unwind to the main loop, so ERR_DROP errors raised on
+* the calling thread jump to the given jmp_buf instead, NULL restores the default.
+* Mutexes taken after this call are released before the jump.
+* Returns false if the platform has no thread local storage to support it.
+*/
+bool Com_SetThreadAbortFrame( void *frame )
+{
+#ifdef ATTRIBUTE_THREAD_LOCAL
+	com_threadabortframe = ( jmp_buf * )frame;
+	com_threadabortlocks = frame ? QMutex_NumHeld() : 0;
+	return true;
+#else
+	return false;
+#endif
+}
+
 /*
 * Com_DeferQuit
 */
@@ -833,6 +1179,8 @@ void Qcommon_InitCommands( void )
 	Cmd_AddCommand( "irc_connect", Irc_Connect_f );
 	Cmd_AddCommand( "irc_disconnect", Irc_Disconnect_f );
 
+	Cmd_AddCommand( "logconsole_stats", Com_LogConsoleStats_f );
+
 	if( dedicated->integer )
 		Cmd_AddCommand( "quit", Com_Quit );
 
@@ -855,6 +1203,8 @@ void Qcommon_ShutdownCommands( void )
 	Cmd_RemoveCommand( "irc_connect" );
 	Cmd_RemoveCommand( "irc_disconnect" );
 
+	Cmd_RemoveCommand( "logconsole_stats" );
+
 	if( dedicated->integer )
 		Cmd_RemoveCommand( "quit" );
 
@@ -873,6 +1223,8 @@ void Qcommon_Init( int argc, char **argv )
 
 	com_print_mutex = QMutex_Create();
 
+	Com_InitConsoleLog();
+
 	// initialize memory manager
 	Memory_Init();
 
@@ -1081,10 +1433,11 @@ void Qcommon_Frame( unsigned int realmsec )
 
 	if( com_showtrace->integer )
 	{
-		Com_Printf( "%4i traces %4i brush traces %4i points\n",
-			c_traces, c_brush_traces, c_pointcontents );
+		Com_Printf( "%4i traces %4i brush traces %4i node traces %4i points\n",
+			c_traces, c_brush_traces, c_node_traces, c_pointcontents );
 		c_traces = 0;
 		c_brush_traces = 0;
+		c_node_traces = 0;
 		c_pointcontents = 0;
 	}
 
@@ -1191,5 +1544,9 @@ void Qcommon_Shutdown( void )
 	
 	QMutex_Destroy( &com_print_mutex );
 
+	QMutex_Destroy( &com_log_mutex );
+	QMutex_Destroy( &com_log_wake_mutex );
+	QCondVar_Destroy( &com_log_condvar );
+
 	QThreads_Shutdown();
 }
@@ -25,6 +25,9 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define qzinflateInit2(strm, windowBits) \
         qzinflateInit2_((strm), (windowBits), ZLIB_VERSION, \
                       (int)sizeof(z_stream))
+#define qzdeflateInit2(strm, level, method, windowBits, memLevel, strategy) \
+        qzdeflateInit2_((strm), (level), (method), (windowBits), (memLevel), \
+                      (strategy), ZLIB_VERSION, (int)sizeof(z_stream))
 
 extern int (ZEXPORT *qzcompress)(Bytef *dest,   uLongf *destLen, const Bytef *source, uLong sourceLen);
 extern int (ZEXPORT *qzcompress2)(Bytef *dest, uLongf *destLen, const Bytef *source, uLong sourceLen, int level);
@@ -33,6 +36,13 @@ extern int (ZEXPORT *qzinflateInit2_)(z_streamp strm, int  windowBits, const cha
 extern int (ZEXPORT *qzinflate)(z_streamp strm, int flush);
 extern int (ZEXPORT *qzinflateEnd)(z_streamp strm);
 extern int (ZEXPORT *qzinflateReset)(z_streamp strm);
+extern int (ZEXPORT *qzinflateSetDictionary)(z_streamp strm, const Bytef *dictionary, uInt dictLength);
+extern int (ZEXPORT *qzdeflateInit2_)(z_streamp strm, int level, int method, int windowBits, int memLevel, int strategy, const char *version, int stream_size);
+extern int (ZEXPORT *qzdeflate)(z_streamp strm, int flush);
+extern int (ZEXPORT *qzdeflateEnd)(z_streamp strm);
+extern int (ZEXPORT *qzdeflateReset)(z_streamp strm);
+extern int (ZEXPORT *qzdeflateSetDictionary)(z_streamp strm, const Bytef *dictionary, uInt dictLength);
+extern uLong (ZEXPORT *qzadler32)(uLong adler, const Bytef *buf, uInt len);
 extern gzFile (ZEXPORT *qgzopen)(const char *file, const char *mode);
 extern z_off_t (ZEXPORT *qgzseek)(gzFile, z_off_t, int);
 extern z_off_t (ZEXPORT *qgztell)(gzFile);
@@ -53,6 +63,13 @@ extern int (ZEXPORT *qgzbuffer)(gzFile file, unsigned size);
 #define qzinflate inflate
 #define qzinflateEnd inflateEnd
 #define qzinflateReset inflateReset
+#define qzinflateSetDictionary inflateSetDictionary
+#define qzdeflateInit2 deflateInit2
+#define qzdeflate deflate
+#define qzdeflateEnd deflateEnd
+#define qzdeflateReset deflateReset
+#define qzdeflateSetDictionary deflateSetDictionary
+#define qzadler32 adler32
 #define qgzopen gzopen
 #define qgzseek gzseek
 #define qgztell gztell
@@ -50,6 +50,13 @@ QUAKE FILESYSTEM
 
 #define FS_PAK_MANIFEST_FILE		"manifest.txt"
 
+#define FS_PAKINDEX_FILE			"pakindex.bin"
+#define FS_PAKINDEX_MAGIC			"QPKI"
+#define FS_PAKINDEX_VERSION			1
+#define FS_PAKINDEX_HEADERSIZE		12    // magic, version, number of packs
+#define FS_PAKINDEX_ENTRYSIZE		32    // fixed part of a pack entry, followed by the path
+#define FS_PAKINDEX_RECORDSIZE		28    // fixed part of a file record, followed by the name
+
 #define FZ_GZ_BUFSIZE				0x00020000
 
 enum
@@ -92,6 +99,8 @@ typedef struct
 
 #define FS_PACKFILE_NUM_THREADS		4     // including the main thread
 
+#define FS_MAX_MAPPED_BUFFERS		64    // FS_NOCOPY buffers handed out at the same time
+
 typedef struct packfile_s
 {
 	char *name;
@@ -102,11 +111,40 @@ typedef struct packfile_s
 	unsigned uncompressedSize;  // uncompressed size
 	unsigned offset;            // relative offset of local header
 	time_t mtime;				// latest modified time, if available
+	struct pack_s *pack;
 } packfile_t;
 
+//
+// parsed pk3 directory, as stored in the pak index cache
+//
+typedef struct pakindex_s
+{
+	char *filename;
+	unsigned fileSize;
+	time_t fileMTime;
+	unsigned checksum;
+	int numFiles;
+	unsigned namesLen;
+	unsigned recordsSize;
+	uint8_t *records;
+	bool stale;					// replaced by a newer entry or no longer matching the file
+	struct pakindex_s *next;
+} pakindex_t;
+
 //
 // in memory
 //
+
+// a mapped archive, which outlives its pack while FS_NOCOPY buffers still point into it
+typedef struct fs_pakmapping_s
+{
+	const uint8_t *data;
+	size_t size;
+	void *mapping;
+	size_t offset;
+	int refcount;				// the pack and each buffer pointing into it, protected by fs_fh_mutex
+} fs_pakmapping_t;
+
 typedef struct pack_s
 {
 	char *filename;     // full path
@@ -121,14 +159,32 @@ typedef struct pack_s
 	packfile_t *files;
 	char *fileNames;
 	trie_t *trie;
+
+	// the whole archive mapped into memory, NULL when it's read through stdio
+	const uint8_t *data;
+	size_t dataSize;
+	struct fs_pakmapping_s *mapping;
+
+	pakindex_t *index;			// freshly parsed directory, to be added to the pak index cache
+	bool indexHit;				// directory came from the pak index cache
 } pack_t;
 
+// reads pk3 headers either in place from a mapping or through stdio
+typedef struct
+{
+	FILE *f;
+	unsigned vfsOffset;
+	const uint8_t *data;
+	size_t size;
+} pk3reader_t;
+
 typedef struct filehandle_s
 {
 	FILE *fstream;
 	packfile_t *pakFile;
 	void *vfsHandle;
 	unsigned pakOffset;
+	const uint8_t *pakData;			// entry data in a mapped pack, read without stdio
 	unsigned uncompressedSize;		// uncompressed size
 	unsigned offset;				// current read/write pos
 	zipEntry_t *zipEntry;
@@ -185,6 +241,22 @@ static searchpath_t *fs_downloads_searchpath;   // write directory for downloads
 
 static mempool_t *fs_mempool;
 
+static cvar_t *fs_mmappaks;
+static cvar_t *fs_pakindex;
+
+// the pak index cache is only kept in memory while packs are being loaded
+static trie_t *fs_pakindex_trie;
+static pakindex_t *fs_pakindex_head;
+static bool fs_pakindex_dirty;
+
+typedef struct
+{
+	const void *data;
+	fs_pakmapping_t *mapping;
+} fs_mappedbuffer_t;
+
+static fs_mappedbuffer_t fs_mappedbuffers[FS_MAX_MAPPED_BUFFERS];
+
 #define FS_Malloc( size ) Mem_Alloc( fs_mempool, size )
 #define FS_Realloc( data, size ) Mem_Realloc( data, size )
 #define FS_Free( data ) Mem_Free( data )
@@ -214,25 +286,56 @@ static inline unsigned int LittleLongRaw( const uint8_t *raw )
 	return ( raw[3] << 24 ) | ( raw[2] << 16 ) | ( raw[1] << 8 ) | raw[0];
 }
 
+static inline void LittleLongToRaw( uint8_t *raw, unsigned int value )
+{
+	raw[0] = value & 0xFF;
+	raw[1] = ( value >> 8 ) & 0xFF;
+	raw[2] = ( value >> 16 ) & 0xFF;
+	raw[3] = ( value >> 24 ) & 0xFF;
+}
+
 static inline unsigned short LittleShortRaw( const uint8_t *raw )
 {
 	return ( raw[1] << 8 ) | raw[0];
 }
 
+/*
+* FS_PK3Read
+* 
+* Returns len bytes at pos, relative to the start of the archive. Mapped archives
+* are accessed in place, otherwise the data is read into buf.
+*/
+static const uint8_t *FS_PK3Read( pk3reader_t *reader, unsigned pos, size_t len, uint8_t *buf )
+{
+	if( reader->data )
+	{
+		if( (size_t)pos + len > reader->size )
+			return NULL;
+		return reader->data + pos;
+	}
+
+	if( fseek( reader->f, reader->vfsOffset + pos, SEEK_SET ) != 0 )
+		return NULL;
+	if( fread( buf, 1, len, reader->f ) != len )
+		return NULL;
+	return buf;
+}
+
 /*
 * FS_PK3CheckFileCoherency
 * 
 * Read the local header of the current zipfile
 * Check the coherency of the local header and info in the end of central directory about this file
 */
-static unsigned FS_PK3CheckFileCoherency( FILE *f, packfile_t *file )
+static unsigned FS_PK3CheckFileCoherency( pk3reader_t *reader, packfile_t *file )
 {
 	unsigned flags;
-	unsigned char localHeader[31], compressed;
+	unsigned char compressed;
+	uint8_t buf[31];
+	const uint8_t *localHeader;
 
-	if( fseek( f, Sys_VFS_FileOffset( file->vfsHandle ) + file->offset, SEEK_SET ) != 0 )
-		return 0;
-	if( fread( localHeader, 1, sizeof( localHeader ), f ) != sizeof( localHeader ) )
+	localHeader = FS_PK3Read( reader, file->offset, sizeof( buf ), buf );
+	if( !localHeader )
 		return 0;
 
 	// check the magic
@@ -1081,6 +1184,8 @@ static void FS_StreamDoneSimpleCb( wswcurl_req *req, int status, void *customp )
 static int _FS_FOpenPakFile( packfile_t *pakFile, int *filenum )
 {
 	filehandle_t *file;
+	pk3reader_t reader;
+	const pack_t *pack;
 
 	*filenum = 0;
 
@@ -1089,18 +1194,33 @@ static int _FS_FOpenPakFile( packfile_t *pakFile, int *filenum )
 	if( pakFile->flags & FS_PACKFILE_DIRECTORY )
 		return -1;
 
+	pack = pakFile->pack;
+
 	*filenum = FS_OpenFileHandle();
 	file = &fs_filehandles[*filenum - 1];
-	file->fstream = fopen( pakFile->vfsHandle ? Sys_VFS_VFSName( pakFile->vfsHandle ) : pakFile->pakname, "rb" );
-	if( !file->fstream )
-		Com_Error( ERR_FATAL, "Error opening pak file: %s", pakFile->pakname );
+
+	memset( &reader, 0, sizeof( reader ) );
+	if( pack && pack->data )
+	{
+		// no stdio at all for mapped packs
+		reader.data = pack->data;
+		reader.size = pack->dataSize;
+	}
+	else
+	{
+		file->fstream = fopen( pakFile->vfsHandle ? Sys_VFS_VFSName( pakFile->vfsHandle ) : pakFile->pakname, "rb" );
+		if( !file->fstream )
+			Com_Error( ERR_FATAL, "Error opening pak file: %s", pakFile->pakname );
+		reader.f = file->fstream;
+		reader.vfsOffset = Sys_VFS_FileOffset( pakFile->vfsHandle );
+	}
 	file->uncompressedSize = pakFile->uncompressedSize;
 	file->zipEntry = NULL;
 	file->pakFile = pakFile;
 
 	if( !( pakFile->flags & FS_PACKFILE_COHERENT ) )
 	{
-		unsigned offset = FS_PK3CheckFileCoherency( file->fstream, pakFile );
+		unsigned offset = FS_PK3CheckFileCoherency( &reader, pakFile );
 		if( !offset )
 		{
 			Com_DPrintf( "_FS_FOpenPakFile: can't get proper offset for %s\n", pakFile->name );
@@ -1111,6 +1231,18 @@ static int _FS_FOpenPakFile( packfile_t *pakFile, int *filenum )
 	}
 	file->pakOffset = Sys_VFS_FileOffset( pakFile->vfsHandle ) + pakFile->offset;
 
+	if( reader.data )
+	{
+		size_t size = ( pakFile->flags & FS_PACKFILE_DEFLATED ) ? pakFile->compressedSize : pakFile->uncompressedSize;
+
+		if( (size_t)pakFile->offset + size > reader.size )
+		{
+			Com_DPrintf( "_FS_FOpenPakFile: %s is truncated\n", pakFile->name );
+			return -1;
+		}
+		file->pakData = reader.data + pakFile->offset;
+	}
+
 	if( pakFile->flags & FS_PACKFILE_DEFLATED )
 	{
 		file->zipEntry = ( zipEntry_t* )Mem_Alloc( fs_mempool, sizeof( zipEntry_t ) );
@@ -1127,9 +1259,17 @@ static int _FS_FOpenPakFile( packfile_t *pakFile, int *filenum )
 			Com_DPrintf( "_FS_FOpenPakFile: can't inflate %s\n", pakFile->name );
 			return -1;
 		}
+
+		// inflate straight from the mapping
+		if( file->pakData )
+		{
+			file->zipEntry->zstream.next_in = (Bytef *)file->pakData;
+			file->zipEntry->zstream.avail_in = (uInt)pakFile->compressedSize;
+			file->zipEntry->restReadCompressed = 0;
+		}
 	}
 
-	if( fseek( file->fstream, file->pakOffset, SEEK_SET ) != 0 )
+	if( file->fstream && fseek( file->fstream, file->pakOffset, SEEK_SET ) != 0 )
 	{
 		Com_DPrintf( "_FS_FOpenPakFile: can't inflate %s\n", pakFile->name );
 		return -1;
@@ -1475,7 +1615,7 @@ static int FS_ReadPK3File( uint8_t *buf, size_t len, filehandle_t *fh )
 
 	totalOutBefore = zipEntry->zstream.total_out;
 	flush = ((len == fh->uncompressedSize) 
-		&& (zipEntry->restReadCompressed <= FS_ZIP_BUFSIZE) && !zipEntry->zstream.avail_in ? Z_FINISH : Z_SYNC_FLUSH);
+		&& (fh->pakData || ((zipEntry->restReadCompressed <= FS_ZIP_BUFSIZE) && !zipEntry->zstream.avail_in)) ? Z_FINISH : Z_SYNC_FLUSH);
 
 	do
 	{
@@ -1505,6 +1645,15 @@ static int FS_ReadPK3File( uint8_t *buf, size_t len, filehandle_t *fh )
 	return (int)( zipEntry->zstream.total_out - totalOutBefore );
 }
 
+/*
+* FS_ReadMappedFile
+*/
+static int FS_ReadMappedFile( uint8_t *buf, size_t len, filehandle_t *fh )
+{
+	memcpy( buf, fh->pakData + fh->offset, len );
+	return (int)len;
+}
+
 /*
 * FS_ReadFile
 * 
@@ -1531,7 +1680,7 @@ int FS_Read( void *buffer, size_t len, int file )
 
 	fh = FS_FileHandleForNum( file );
 
-	if( fh->fstream && ( fh->pakFile || fh->vfsHandle ) && len + fh->offset > fh->uncompressedSize ) {
+	if( ( fh->fstream || fh->pakData ) && ( fh->pakFile || fh->vfsHandle ) && len + fh->offset > fh->uncompressedSize ) {
 		len = fh->uncompressedSize - fh->offset;
 		if( !len )
 			return 0;
@@ -1543,6 +1692,8 @@ int FS_Read( void *buffer, size_t len, int file )
 		total = FS_ReadStream( (uint8_t *)buffer, len, fh );
 	else if( fh->gzstream )
 		total = qgzread( fh->gzstream, buffer, len );
+	else if( fh->pakData )
+		total = FS_ReadMappedFile( ( uint8_t * )buffer, len, fh );
 	else if( fh->fstream )
 		total = FS_ReadFile( ( uint8_t * )buffer, len, fh );
 	else
@@ -1718,7 +1869,7 @@ int FS_Seek( int file, int offset, int whence )
 	if( offset == currentOffset )
 		return 0;
 
-	if( !fh->fstream )
+	if( !fh->fstream && !fh->pakData )
 		return -1;
 	if( offset > (int)fh->uncompressedSize )
 		return -1;
@@ -1726,6 +1877,8 @@ int FS_Seek( int file, int offset, int whence )
 	if( !fh->zipEntry )
 	{
 		fh->offset = offset;
+		if( fh->pakData )
+			return 0;
 		return fseek( fh->fstream, fh->pakOffset + offset, SEEK_SET );
 	}
 
@@ -1738,17 +1891,27 @@ int FS_Seek( int file, int offset, int whence )
 	}
 	else
 	{
-		if( fseek( fh->fstream, fh->pakOffset, SEEK_SET ) != 0 )
-			return -1;
+		if( fh->pakData )
+		{
+			zipEntry->zstream.next_in = (Bytef *)fh->pakData;
+			zipEntry->zstream.avail_in = (uInt)zipEntry->compressedSize;
+			zipEntry->restReadCompressed = 0;
+		}
+		else
+		{
+			if( fseek( fh->fstream, fh->pakOffset, SEEK_SET ) != 0 )
+				return -1;
+
+			zipEntry->zstream.next_in = zipEntry->readBuffer;
+			zipEntry->zstream.avail_in = 0;
+			zipEntry->restReadCompressed = zipEntry->compressedSize;
+		}
 
-		zipEntry->zstream.next_in = zipEntry->readBuffer;
-		zipEntry->zstream.avail_in = 0;
 		error = qzinflateReset( &zipEntry->zstream );
 		if( error != Z_OK )
 			Sys_Error( "FS_Seek: can't inflateReset file" );
 
 		fh->offset = 0;
-		zipEntry->restReadCompressed = zipEntry->compressedSize;
 	}
 
 	remaining = offset;
@@ -1776,6 +1939,8 @@ int FS_Eof( int file )
 	fh = FS_FileHandleForNum( file );
 	if( fh->streamHandle )
 		return wswcurl_eof( fh->streamHandle );
+	if( fh->pakData )
+		return fh->offset >= fh->uncompressedSize;
 	if( fh->zipEntry )
 		return fh->zipEntry->restReadCompressed == 0;
 	if( fh->gzstream )
@@ -1850,6 +2015,87 @@ int	FS_GetCompressionLevel( int file )
 	return 0;
 }
 
+/*
+* FS_ReleasePakMapping
+* 
+* Unmaps the archive once neither its pack nor any buffer uses it anymore.
+*/
+static void FS_ReleasePakMapping( fs_pakmapping_t *mapping )
+{
+	int refcount;
+
+	QMutex_Lock( fs_fh_mutex );
+	refcount = --mapping->refcount;
+	QMutex_Unlock( fs_fh_mutex );
+
+	if( refcount > 0 )
+		return;
+
+	Sys_FS_UnMMapFile( mapping->mapping, (void *)mapping->data, mapping->size, mapping->offset );
+	FS_Free( mapping );
+}
+
+/*
+* FS_MapPakFile
+* 
+* Returns the data of a stored entry in a mapped pack, registering it so
+* that FS_FreeFile can tell it apart from heap buffers.
+*/
+static void *FS_MapPakFile( int file )
+{
+	int i;
+	filehandle_t *fh;
+	void *data = NULL;
+
+	fh = FS_FileHandleForNum( file );
+	if( !fh->pakData || fh->zipEntry || !fh->pakFile || !fh->pakFile->pack || !fh->pakFile->pack->mapping )
+		return NULL;
+
+	QMutex_Lock( fs_fh_mutex );
+	for( i = 0; i < FS_MAX_MAPPED_BUFFERS; i++ )
+	{
+		if( !fs_mappedbuffers[i].data )
+		{
+			fs_mappedbuffers[i].data = fh->pakData;
+			fs_mappedbuffers[i].mapping = fh->pakFile->pack->mapping;
+			fs_mappedbuffers[i].mapping->refcount++;
+			data = (void *)fh->pakData;
+			break;
+		}
+	}
+	QMutex_Unlock( fs_fh_mutex );
+
+	return data;
+}
+
+/*
+* FS_UnmapPakFile
+*/
+static bool FS_UnmapPakFile( void *buffer )
+{
+	int i;
+	fs_pakmapping_t *mapping = NULL;
+
+	QMutex_Lock( fs_fh_mutex );
+	for( i = 0; i < FS_MAX_MAPPED_BUFFERS; i++ )
+	{
+		if( fs_mappedbuffers[i].data == buffer )
+		{
+			mapping = fs_mappedbuffers[i].mapping;
+			fs_mappedbuffers[i].data = NULL;
+			fs_mappedbuffers[i].mapping = NULL;
+			break;
+		}
+	}
+	QMutex_Unlock( fs_fh_mutex );
+
+	if( !mapping )
+		return false;
+
+	FS_ReleasePakMapping( mapping );
+	return true;
+}
+
 /*
 * _FS_LoadFile
 */
@@ -1895,7 +2141,19 @@ int FS_LoadFileExt( const char *path, int flags, void **buffer, void *stack, siz
 	int fhandle;
 
 	// look for it in the filesystem or pack files
-	len = FS_FOpenFile( path, &fhandle, FS_READ|flags );
+	len = FS_FOpenFile( path, &fhandle, FS_READ|( flags & ~FS_NOCOPY ) );
+
+	if( ( flags & FS_NOCOPY ) && fhandle && buffer )
+	{
+		void *data = FS_MapPakFile( fhandle );
+		if( data )
+		{
+			FS_FCloseFile( fhandle );
+			*buffer = data;
+			return len;
+		}
+	}
+
 	return _FS_LoadFile( fhandle, len, buffer, stack, stackSize, filename, fileline );
 }
 
@@ -1926,6 +2184,15 @@ void *FS_MMapBaseFile( int file, size_t size, size_t offset )
 		return NULL;
 
 	fh = FS_FileHandleForNum( file );
+
+	// stored entries of mapped packs are already in memory
+	if( fh->pakData && !fh->zipEntry )
+	{
+		if( offset + size > fh->uncompressedSize )
+			return NULL;
+		return (void *)( fh->pakData + offset );
+	}
+
 	if( !fh->fstream || fh->vfsHandle || fh->mapping )
 		return NULL;
 
@@ -1954,6 +2221,10 @@ void FS_UnMMapBaseFile( int file, void *data )
 */
 void FS_FreeFile( void *buffer )
 {
+	if( !buffer )
+		return;
+	if( FS_UnmapPakFile( buffer ) )
+		return;
 	Mem_TempFree( buffer );
 }
 
@@ -2430,26 +2701,14 @@ static void FS_ReadPackManifest( pack_t *pack )
 * 
 * Locate the central directory of a zipfile (at the end, just before the global comment)
 */
-static unsigned FS_PK3SearchCentralDir( FILE *fin, void *vfsHandle )
+static unsigned FS_PK3SearchCentralDir( pk3reader_t *reader )
 {
 	unsigned fileSize, backRead;
 	unsigned maxBack = 0xffff; // maximum size of global comment
 	unsigned char buf[FS_ZIP_BUFREADCOMMENT+4];
-	unsigned vfsOffset = 0;
-
-	if( vfsHandle )
-	{
-		vfsOffset = Sys_VFS_FileOffset( vfsHandle );
-		if( fseek( fin, vfsOffset + Sys_VFS_FileSize( vfsHandle ), SEEK_SET ) != 0 )
-			return 0;
-	}
-	else
-	{
-		if( fseek( fin, 0, SEEK_END ) != 0 )
-			return 0;
-	}
+	const uint8_t *data;
 
-	fileSize = ftell( fin ) - vfsOffset;
+	fileSize = reader->size;
 	if( maxBack > fileSize )
 		maxBack = fileSize;
 
@@ -2468,15 +2727,14 @@ static unsigned FS_PK3SearchCentralDir( FILE *fin, void *vfsHandle )
 		if( readSize < 4 )
 			continue;
 
-		if( fseek( fin, vfsOffset + readPos, SEEK_SET ) != 0 )
-			break;
-		if( fread( buf, 1, readSize, fin ) != readSize )
+		data = FS_PK3Read( reader, readPos, readSize, buf );
+		if( !data )
 			break;
 
 		for( i = readSize - 3; i--; )
 		{
 			// check the magic
-			if( LittleLongRaw( buf + i ) == FS_ZIP_ENDHEADERMAGIC )
+			if( LittleLongRaw( data + i ) == FS_ZIP_ENDHEADERMAGIC )
 				return readPos + i;
 		}
 	}
@@ -2514,17 +2772,17 @@ static time_t FS_DosTimeToUnixtime( unsigned dosDateTime )
 * 
 * Get Info about the current file in the zipfile, with internal only info
 */
-static unsigned FS_PK3GetFileInfo( FILE *f, void *vfsHandle, unsigned pos, unsigned byteBeforeTheZipFile, 
+static unsigned FS_PK3GetFileInfo( pk3reader_t *reader, unsigned pos, unsigned byteBeforeTheZipFile, 
 	packfile_t *file, size_t *fileNameLen, int *crc )
 {
 	size_t sizeRead;
 	unsigned dosDateTime;
 	unsigned compressed;
-	unsigned char infoHeader[46]; // we can't use a struct here because of packing
+	unsigned char buf[FS_ZIP_SIZECENTRALDIRITEM]; // we can't use a struct here because of packing
+	const uint8_t *infoHeader;
 
-	if( fseek( f, Sys_VFS_FileOffset( vfsHandle ) + pos, SEEK_SET ) != 0 )
-		return 0;
-	if( fread( infoHeader, 1, sizeof( infoHeader ), f ) != sizeof( infoHeader ) )
+	infoHeader = FS_PK3Read( reader, pos, sizeof( buf ), buf );
+	if( !infoHeader )
 		return 0;
 
 	// check the magic
@@ -2558,8 +2816,11 @@ static unsigned FS_PK3GetFileInfo( FILE *f, void *vfsHandle, unsigned pos, unsig
 
 	if( file )
 	{
-		if( fread( file->name, 1, sizeRead, f ) != sizeRead )
+		const uint8_t *name = FS_PK3Read( reader, pos + FS_ZIP_SIZECENTRALDIRITEM, sizeRead, (uint8_t *)file->name );
+		if( !name )
 			return 0;
+		if( name != (uint8_t *)file->name )
+			memcpy( file->name, name, sizeRead );
 
 		*( file->name + sizeRead ) = 0;
 		if( *( file->name + sizeRead - 1 ) == '/' )
@@ -2570,6 +2831,449 @@ static unsigned FS_PK3GetFileInfo( FILE *f, void *vfsHandle, unsigned pos, unsig
 		( unsigned )LittleShortRaw( &infoHeader[30] ) + ( unsigned )LittleShortRaw( &infoHeader[32] );
 }
 
+/*
+* FS_PakIndexFilename
+*/
+static void FS_PakIndexFilename( char *filename, size_t size )
+{
+	Q_snprintfz( filename, size, "%s/%s", FS_CacheDirectory(), FS_PAKINDEX_FILE );
+}
+
+/*
+* FS_AllocPakIndex
+*/
+static pakindex_t *FS_AllocPakIndex( const char *filename, unsigned recordsSize )
+{
+	size_t filenameSize = strlen( filename ) + 1;
+	pakindex_t *index;
+
+	index = ( pakindex_t * )FS_Malloc( sizeof( *index ) + filenameSize + recordsSize );
+	index->filename = ( char * )( ( uint8_t * )index + sizeof( *index ) );
+	index->records = ( uint8_t * )index->filename + filenameSize;
+	index->recordsSize = recordsSize;
+	memcpy( index->filename, filename, filenameSize );
+
+	return index;
+}
+
+/*
+* FS_AddPakIndex
+* 
+* Links the entry into the cache, superseding any previous entry for the same pack
+*/
+static void FS_AddPakIndex( pakindex_t *index )
+{
+	pakindex_t *old = NULL;
+
+	if( Trie_Replace( fs_pakindex_trie, index->filename, index, (void **)&old ) == TRIE_KEY_NOT_FOUND )
+		Trie_Insert( fs_pakindex_trie, index->filename, index );
+	else if( old )
+		old->stale = true;
+
+	index->next = fs_pakindex_head;
+	fs_pakindex_head = index;
+}
+
+/*
+* FS_FreePakIndex
+*/
+static void FS_FreePakIndex( void )
+{
+	pakindex_t *index, *next;
+
+	for( index = fs_pakindex_head; index; index = next )
+	{
+		next = index->next;
+		FS_Free( index );
+	}
+	fs_pakindex_head = NULL;
+
+	if( fs_pakindex_trie )
+	{
+		Trie_Destroy( fs_pakindex_trie );
+		fs_pakindex_trie = NULL;
+	}
+}
+
+/*
+* FS_ParsePakIndexRecords
+* 
+* Makes sure the file records of a cached pack are well-formed, so they can
+* later be read without any checks.
+*/
+static bool FS_ParsePakIndexRecords( const uint8_t *records, unsigned recordsSize, int numFiles, unsigned namesLen )
+{
+	int i;
+	unsigned nameLen, pos, names;
+
+	for( i = 0, pos = 0, names = 1; i < numFiles; i++ )
+	{
+		if( recordsSize - pos < FS_PAKINDEX_RECORDSIZE )
+			return false;
+		nameLen = LittleLongRaw( records + pos + 24 );
+		pos += FS_PAKINDEX_RECORDSIZE;
+
+		if( !nameLen || nameLen >= FS_MAX_PATH || recordsSize - pos < nameLen )
+			return false;
+		if( memchr( records + pos, 0, nameLen ) )
+			return false;
+		pos += nameLen;
+		names += nameLen + 1;
+	}
+
+	return pos == recordsSize && names == namesLen;
+}
+
+/*
+* FS_LoadPakIndex
+* 
+* Reads the pak index cache in one go. Entries are keyed by the pack path and
+* are only used if the size and modification time of the pack still match.
+*/
+static void FS_LoadPakIndex( void )
+{
+	FILE *f;
+	long len;
+	int i, numEntries;
+	uint8_t *buf = NULL;
+	const uint8_t *p, *end;
+	char filename[FS_MAX_PATH];
+	md5_byte_t digest[16];
+	md5_state_t state;
+
+	if( fs_pakindex_trie )
+		return;
+
+	Trie_Create( TRIE_CASE_SENSITIVE, &fs_pakindex_trie );
+	fs_pakindex_head = NULL;
+	fs_pakindex_dirty = false;
+
+	if( !fs_pakindex->integer )
+		return;
+
+	FS_PakIndexFilename( filename, sizeof( filename ) );
+	f = fopen( filename, "rb" );
+	if( !f )
+		return;
+
+	if( fseek( f, 0, SEEK_END ) != 0 || ( len = ftell( f ) ) < FS_PAKINDEX_HEADERSIZE + 4 
+		|| fseek( f, 0, SEEK_SET ) != 0 )
+		goto corrupt;
+
+	buf = ( uint8_t * )FS_Malloc( len );
+	if( fread( buf, 1, len, f ) != (size_t)len )
+		goto corrupt;
+
+	fclose( f );
+	f = NULL;
+
+	// the checksum at the end catches truncated or partially written files
+	md5_init( &state );
+	md5_append( &state, buf, len - 4 );
+	md5_finish( &state, digest );
+	if( md5_reduce( digest ) != LittleLongRaw( buf + len - 4 ) )
+		goto corrupt;
+
+	if( memcmp( buf, FS_PAKINDEX_MAGIC, 4 ) || LittleLongRaw( buf + 4 ) != FS_PAKINDEX_VERSION )
+		goto corrupt;
+
+	numEntries = LittleLongRaw( buf + 8 );
+	p = buf + FS_PAKINDEX_HEADERSIZE;
+	end = buf + len - 4;
+
+	for( i = 0; i < numEntries; i++ )
+	{
+		pakindex_t *index;
+		unsigned pathLen, recordsSize;
+		char path[FS_MAX_PATH];
+
+		if( end - p < FS_PAKINDEX_ENTRYSIZE )
+			goto corrupt;
+
+		pathLen = LittleLongRaw( p );
+		recordsSize = LittleLongRaw( p + 28 );
+		if( !pathLen || pathLen >= sizeof( path ) || (size_t)( end - p - FS_PAKINDEX_ENTRYSIZE ) < (size_t)pathLen + recordsSize )
+			goto corrupt;
+
+		memcpy( path, p + FS_PAKINDEX_ENTRYSIZE, pathLen );
+		path[pathLen] = '\0';
+
+		index = FS_AllocPakIndex( path, recordsSize );
+		index->fileSize = LittleLongRaw( p + 4 );
+		index->fileMTime = ( time_t )( LittleLongRaw( p + 8 ) | ( ( uint64_t )LittleLongRaw( p + 12 ) << 32 ) );
+		index->checksum = LittleLongRaw( p + 16 );
+		index->numFiles = LittleLongRaw( p + 20 );
+		index->namesLen = LittleLongRaw( p + 24 );
+		memcpy( index->records, p + FS_PAKINDEX_ENTRYSIZE + pathLen, recordsSize );
+		FS_AddPakIndex( index );
+
+		if( index->numFiles <= 0 || !index->checksum ||
+			!FS_ParsePakIndexRecords( index->records, recordsSize, index->numFiles, index->namesLen ) )
+			goto corrupt;
+
+		p += FS_PAKINDEX_ENTRYSIZE + pathLen + recordsSize;
+	}
+
+	FS_Free( buf );
+	return;
+
+corrupt:
+	Com_Printf( "Ignoring invalid pak index cache %s\n", filename );
+	if( f )
+		fclose( f );
+	if( buf )
+		FS_Free( buf );
+	FS_FreePakIndex();
+	Trie_Create( TRIE_CASE_SENSITIVE, &fs_pakindex_trie );
+	fs_pakindex_dirty = true;
+}
+
+/*
+* FS_WritePakIndex
+* 
+* Writes all matching entries to a temporary file, which then replaces the cache
+*/
+static void FS_WritePakIndex( void )
+{
+	FILE *f;
+	size_t size, pathLen;
+	int numEntries;
+	uint8_t *buf, *p;
+	pakindex_t *index;
+	char filename[FS_MAX_PATH], tempname[FS_MAX_PATH];
+	md5_byte_t digest[16];
+	md5_state_t state;
+	bool written;
+
+	size = FS_PAKINDEX_HEADERSIZE + 4;
+	numEntries = 0;
+	for( index = fs_pakindex_head; index; index = index->next )
+	{
+		// prune packs that have been changed or removed
+		if( !index->stale && Sys_FS_FileMTime( index->filename ) != index->fileMTime )
+			index->stale = true;
+		if( index->stale )
+			continue;
+
+		size += FS_PAKINDEX_ENTRYSIZE + strlen( index->filename ) + index->recordsSize;
+		numEntries++;
+	}
+
+	buf = p = ( uint8_t * )FS_Malloc( size );
+
+	memcpy( p, FS_PAKINDEX_MAGIC, 4 );
+	LittleLongToRaw( p + 4, FS_PAKINDEX_VERSION );
+	LittleLongToRaw( p + 8, numEntries );
+	p += FS_PAKINDEX_HEADERSIZE;
+
+	for( index = fs_pakindex_head; index; index = index->next )
+	{
+		if( index->stale )
+			continue;
+
+		pathLen = strlen( index->filename );
+		LittleLongToRaw( p + 0, pathLen );
+		LittleLongToRaw( p + 4, index->fileSize );
+		LittleLongToRaw( p + 8, ( uint64_t )index->fileMTime & 0xFFFFFFFF );
+		LittleLongToRaw( p + 12, ( uint64_t )index->fileMTime >> 32 );
+		LittleLongToRaw( p + 16, index->checksum );
+		LittleLongToRaw( p + 20, index->numFiles );
+		LittleLongToRaw( p + 24, index->namesLen );
+		LittleLongToRaw( p + 28, index->recordsSize );
+		p += FS_PAKINDEX_ENTRYSIZE;
+
+		memcpy( p, index->filename, pathLen );
+		p += pathLen;
+		memcpy( p, index->records, index->recordsSize );
+		p += index->recordsSize;
+	}
+
+	md5_init( &state );
+	md5_append( &state, buf, p - buf );
+	md5_finish( &state, digest );
+	LittleLongToRaw( p, md5_reduce( digest ) );
+
+	FS_PakIndexFilename( filename, sizeof( filename ) );
+	Q_snprintfz( tempname, sizeof( tempname ), "%s.tmp", filename );
+	FS_CreateAbsolutePath( tempname );
+
+	written = false;
+	f = fopen( tempname, "wb" );
+	if( f )
+	{
+		written = fwrite( buf, 1, size, f ) == size;
+		written = ( fclose( f ) == 0 ) && written;
+		if( written )
+			written = rename( tempname, filename ) == 0;
+		if( !written )
+			remove( tempname );
+	}
+
+	if( written )
+		Com_DPrintf( "Wrote pak index cache %s (%i packs)\n", filename, numEntries );
+	else
+		Com_Printf( "Couldn't write pak index cache %s\n", filename );
+
+	FS_Free( buf );
+	fs_pakindex_dirty = false;
+}
+
+/*
+* FS_FindPakIndex
+* 
+* Safe to call from the pack loader threads, the cache isn't modified while they're running
+*/
+static const pakindex_t *FS_FindPakIndex( const char *packfilename, size_t fileSize, time_t fileMTime )
+{
+	pakindex_t *index = NULL;
+
+	if( !fs_pakindex_trie )
+		return NULL;
+	if( Trie_Find( fs_pakindex_trie, packfilename, TRIE_EXACT_MATCH, (void **)&index ) != TRIE_OK || !index )
+		return NULL;
+	if( index->stale || index->fileSize != fileSize || index->fileMTime != fileMTime )
+		return NULL;
+	return index;
+}
+
+/*
+* FS_CreatePakIndex
+* 
+* Serializes the directory of a freshly parsed pack. Must be called before any
+* file in the pack is opened, as that replaces the offsets of local headers.
+*/
+static pakindex_t *FS_CreatePakIndex( const pack_t *pack, size_t fileSize, time_t fileMTime, unsigned namesLen )
+{
+	int i;
+	unsigned nameLen;
+	uint8_t *p;
+	const packfile_t *file;
+	pakindex_t *index;
+
+	index = FS_AllocPakIndex( pack->filename, pack->numFiles * FS_PAKINDEX_RECORDSIZE + namesLen - pack->numFiles - 1 );
+	index->fileSize = fileSize;
+	index->fileMTime = fileMTime;
+	index->checksum = pack->checksum;
+	index->numFiles = pack->numFiles;
+	index->namesLen = namesLen;
+
+	for( i = 0, file = pack->files, p = index->records; i < pack->numFiles; i++, file++ )
+	{
+		nameLen = strlen( file->name );
+		LittleLongToRaw( p + 0, file->flags & ( FS_PACKFILE_DEFLATED|FS_PACKFILE_DIRECTORY ) );
+		LittleLongToRaw( p + 4, file->compressedSize );
+		LittleLongToRaw( p + 8, file->uncompressedSize );
+		LittleLongToRaw( p + 12, file->offset );
+		LittleLongToRaw( p + 16, ( uint64_t )file->mtime & 0xFFFFFFFF );
+		LittleLongToRaw( p + 20, ( uint64_t )file->mtime >> 32 );
+		LittleLongToRaw( p + 24, nameLen );
+		p += FS_PAKINDEX_RECORDSIZE;
+
+		memcpy( p, file->name, nameLen );
+		p += nameLen;
+	}
+
+	return index;
+}
+
+/*
+* FS_PakIndexGetFileInfo
+* 
+* Counterpart of FS_PK3GetFileInfo for cached directories, returns the next record
+*/
+static const uint8_t *FS_PakIndexGetFileInfo( const uint8_t *record, packfile_t *file, size_t *fileNameLen )
+{
+	size_t nameLen;
+
+	file->flags = LittleLongRaw( record + 0 );
+	file->compressedSize = LittleLongRaw( record + 4 );
+	file->uncompressedSize = LittleLongRaw( record + 8 );
+	file->offset = LittleLongRaw( record + 12 );
+	file->mtime = ( time_t )( LittleLongRaw( record + 16 ) | ( ( uint64_t )LittleLongRaw( record + 20 ) << 32 ) );
+	nameLen = LittleLongRaw( record + 24 );
+	record += FS_PAKINDEX_RECORDSIZE;
+
+	memcpy( file->name, record, nameLen );
+	file->name[nameLen] = '\0';
+	*fileNameLen = nameLen;
+
+	return record + nameLen;
+}
+
+/*
+* FS_PK3ReadCentralDir
+* 
+* Locates the central directory and computes the number of files and the space needed for their names
+*/
+static bool FS_PK3ReadCentralDir( pk3reader_t *reader, const char *packfilename, bool silent, 
+	int *pNumFiles, size_t *pNamesLen, unsigned *pCentralPos, unsigned *pByteBeforeTheZipFile )
+{
+	int i;
+	int numFiles;
+	size_t namesLen, len;
+	unsigned char zipHeader[20]; // we can't use a struct here because of packing
+	const uint8_t *header;
+	unsigned offset, centralPos, sizeCentralDir, offsetCentralDir, byteBeforeTheZipFile;
+
+	centralPos = FS_PK3SearchCentralDir( reader );
+	if( centralPos == 0 )
+	{
+		if( !silent ) Com_Printf( "No central directory found for PK3 file: %s\n", packfilename );
+		return false;
+	}
+	header = FS_PK3Read( reader, centralPos, sizeof( zipHeader ), zipHeader );
+	if( !header )
+	{
+		if( !silent ) Com_Printf( "Error reading PK3 file: %s\n", packfilename );
+		return false;
+	}
+
+	// total number of entries in the central dir on this disk
+	numFiles = LittleShortRaw( &header[8] );
+	if( !numFiles )
+	{
+		if( !silent ) Com_Printf( "%s is not a valid pk3 file\n", packfilename );
+		return false;
+	}
+	if( LittleShortRaw( &header[10] ) != numFiles || LittleShortRaw( &header[6] ) != 0
+		|| LittleShortRaw( &header[4] ) != 0 )
+	{
+		if( !silent ) Com_Printf( "%s is not a valid pk3 file\n", packfilename );
+		return false;
+	}
+
+	// size of the central directory
+	sizeCentralDir = LittleLongRaw( &header[12] );
+
+	// offset of start of central directory with respect to the starting disk number
+	offsetCentralDir = LittleLongRaw( &header[16] );
+	if( centralPos < offsetCentralDir + sizeCentralDir )
+	{
+		if( !silent ) Com_Printf( "%s is not a valid pk3 file\n", packfilename );
+		return false;
+	}
+	byteBeforeTheZipFile = centralPos - offsetCentralDir - sizeCentralDir;
+
+	for( i = 0, namesLen = 0, centralPos = offsetCentralDir + byteBeforeTheZipFile; i < numFiles; i++, centralPos += offset )
+	{
+		offset = FS_PK3GetFileInfo( reader, centralPos, byteBeforeTheZipFile, NULL, &len, NULL );
+		if( !offset )
+		{
+			if( !silent ) Com_Printf( "%s is not a valid pk3 file\n", packfilename );
+			return false; // something wrong occured
+		}
+		namesLen += len + 1;
+	}
+
+	namesLen += 1; // add space for a guard
+
+	*pNumFiles = numFiles;
+	*pNamesLen = namesLen;
+	*pCentralPos = offsetCentralDir + byteBeforeTheZipFile;
+	*pByteBeforeTheZipFile = byteBeforeTheZipFile;
+	return true;
+}
+
 /*
 * FS_LoadPK3File
 * 
@@ -2588,12 +3292,19 @@ static pack_t *FS_LoadPK3File( const char *packfilename, bool silent )
 	packfile_t *file;
 	FILE *fin = NULL;
 	char *names;
-	unsigned char zipHeader[20]; // we can't use a struct here because of packing
-	unsigned offset, centralPos, sizeCentralDir, offsetCentralDir, byteBeforeTheZipFile;
+	unsigned offset, centralPos, byteBeforeTheZipFile;
 	bool modulepack;
 	int manifestFilesize;
 	void *handle = NULL;
 	void *vfsHandle = NULL;
+	pk3reader_t reader;
+	void *mapping = NULL;
+	size_t mappingOffset = 0;
+	time_t mtime = 0;
+	const pakindex_t *index = NULL;
+	const uint8_t *record = NULL;
+
+	memset( &reader, 0, sizeof( reader ) );
 
 	if( FS_AbsoluteFileExists( packfilename ) == -1 )
 		vfsHandle = FS_VFSHandleForPakName( packfilename );
@@ -2615,62 +3326,43 @@ static pack_t *FS_LoadPK3File( const char *packfilename, bool silent )
 		if( !silent ) Com_Printf( "Error opening PK3 file: %s\n", packfilename );
 		goto error;
 	}
-	centralPos = FS_PK3SearchCentralDir( fin, vfsHandle );
-	if( centralPos == 0 )
-	{
-		if( !silent ) Com_Printf( "No central directory found for PK3 file: %s\n", packfilename );
-		goto error;
-	}
-	if( fseek( fin, Sys_VFS_FileOffset( vfsHandle ) + centralPos, SEEK_SET ) != 0 )
-	{
-		if( !silent ) Com_Printf( "Error seeking PK3 file: %s\n", packfilename );
-		goto error;
-	}
-	if( fread( zipHeader, 1, sizeof( zipHeader ), fin ) != sizeof( zipHeader ) )
-	{
-		if( !silent ) Com_Printf( "Error reading PK3 file: %s\n", packfilename );
-		goto error;
-	}
 
-	// total number of entries in the central dir on this disk
-	numFiles = LittleShortRaw( &zipHeader[8] );
-	if( !numFiles )
+	reader.f = fin;
+	reader.vfsOffset = Sys_VFS_FileOffset( vfsHandle );
+	if( vfsHandle )
 	{
-		if( !silent ) Com_Printf( "%s is not a valid pk3 file\n", packfilename );
-		goto error;
+		reader.size = Sys_VFS_FileSize( vfsHandle );
 	}
-	if( LittleShortRaw( &zipHeader[10] ) != numFiles || LittleShortRaw( &zipHeader[6] ) != 0
-		|| LittleShortRaw( &zipHeader[4] ) != 0 )
+	else
 	{
-		if( !silent ) Com_Printf( "%s is not a valid pk3 file\n", packfilename );
-		goto error;
+		if( fseek( fin, 0, SEEK_END ) != 0 )
+		{
+			if( !silent ) Com_Printf( "Error seeking PK3 file: %s\n", packfilename );
+			goto error;
+		}
+		reader.size = ftell( fin );
+
+		// packs inside VFS containers are not cached, the index is keyed by the file on disk
+		mtime = Sys_FS_FileMTime( packfilename );
+		index = FS_FindPakIndex( packfilename, reader.size, mtime );
 	}
 
-	// size of the central directory
-	sizeCentralDir = LittleLongRaw( &zipHeader[12] );
+	// map the whole archive, so neither the directory nor the files are read through stdio
+	if( fs_mmappaks && fs_mmappaks->integer && reader.size )
+		reader.data = Sys_FS_MMapFile( Sys_FS_FileNo( fin ), reader.size, reader.vfsOffset, &mapping, &mappingOffset );
 
-	// offset of start of central directory with respect to the starting disk number
-	offsetCentralDir = LittleLongRaw( &zipHeader[16] );
-	if( centralPos < offsetCentralDir + sizeCentralDir )
+	if( index )
 	{
-		if( !silent ) Com_Printf( "%s is not a valid pk3 file\n", packfilename );
-		goto error;
+		numFiles = index->numFiles;
+		namesLen = index->namesLen;
+		record = index->records;
+		centralPos = byteBeforeTheZipFile = 0;
 	}
-	byteBeforeTheZipFile = centralPos - offsetCentralDir - sizeCentralDir;
-
-	for( i = 0, namesLen = 0, centralPos = offsetCentralDir + byteBeforeTheZipFile; i < numFiles; i++, centralPos += offset )
+	else if( !FS_PK3ReadCentralDir( &reader, packfilename, silent, &numFiles, &namesLen, &centralPos, &byteBeforeTheZipFile ) )
 	{
-		offset = FS_PK3GetFileInfo( fin, vfsHandle, centralPos, byteBeforeTheZipFile, NULL, &len, NULL );
-		if( !offset )
-		{
-			if( !silent ) Com_Printf( "%s is not a valid pk3 file\n", packfilename );
-			goto error; // something wrong occured
-		}
-		namesLen += len + 1;
+		goto error;
 	}
 
-	namesLen += 1; // add space for a guard
-
 	pack = ( pack_t* )FS_Malloc( (int)( sizeof( pack_t ) + numFiles * sizeof( packfile_t ) + namesLen) );
 	pack->filename = FS_CopyString( packfilename );
 	pack->files = ( packfile_t * )( ( uint8_t * )pack + sizeof( pack_t ) );
@@ -2680,11 +3372,24 @@ static pack_t *FS_LoadPK3File( const char *packfilename, bool silent )
 	pack->vfsHandle = vfsHandle;
 	pack->trie = NULL;
 	pack->pure = FS_IsExplicitPurePak( packfilename, NULL ) ? FS_PURE_EXPLICIT : FS_PURE_NONE;
+	pack->data = reader.data;
+	pack->dataSize = reader.size;
+	pack->mapping = NULL;
+	if( reader.data )
+	{
+		pack->mapping = ( fs_pakmapping_t * )FS_Malloc( sizeof( fs_pakmapping_t ) );
+		pack->mapping->data = reader.data;
+		pack->mapping->size = reader.size;
+		pack->mapping->mapping = mapping;
+		pack->mapping->offset = mappingOffset;
+		pack->mapping->refcount = 1;
+	}
 
 	Trie_Create( TRIE_CASE_INSENSITIVE, &pack->trie );
 
 	// allocate temp memory for files' checksums
-	checksums = ( int* )Mem_TempMallocExt( ( numFiles + 1 ) * sizeof( *checksums ), 0 );
+	if( !index )
+		checksums = ( int* )Mem_TempMallocExt( ( numFiles + 1 ) * sizeof( *checksums ), 0 );
 
 	if( !Q_strnicmp( COM_FileBase( packfilename ), "modules", strlen( "modules" ) ) )
 		modulepack = true;
@@ -2694,7 +3399,7 @@ static pack_t *FS_LoadPK3File( const char *packfilename, bool silent )
 	manifestFilesize = -1;
 
 	// add all files to the trie
-	for( i = 0, file = pack->files, centralPos = offsetCentralDir + byteBeforeTheZipFile; i < numFiles; i++, file++, centralPos += offset, names += len + 1 )
+	for( i = 0, file = pack->files; i < numFiles; i++, file++, names += len + 1 )
 	{
 		const char *ext;
 		trie_error_t trie_err;
@@ -2703,8 +3408,17 @@ static pack_t *FS_LoadPK3File( const char *packfilename, bool silent )
 		file->name = names;
 		file->pakname = pack->filename;
 		file->vfsHandle = vfsHandle;
+		file->pack = pack;
 
-		offset = FS_PK3GetFileInfo( fin, vfsHandle, centralPos, byteBeforeTheZipFile, file, &len, &checksums[i] );
+		if( index )
+		{
+			record = FS_PakIndexGetFileInfo( record, file, &len );
+		}
+		else
+		{
+			offset = FS_PK3GetFileInfo( &reader, centralPos, byteBeforeTheZipFile, file, &len, &checksums[i] );
+			centralPos += offset;
+		}
 
 		if( !COM_ValidateRelativeFilename( file->name ) )
 		{
@@ -2738,16 +3452,29 @@ static pack_t *FS_LoadPK3File( const char *packfilename, bool silent )
 	fclose( fin );
 	fin = NULL;
 
-	checksums[numFiles] = 0x1234567; // add some pseudo-random stuff
-	pack->checksum = FS_ChecksumPK3File( pack->filename, numFiles + 1, checksums );
-
-	if( !pack->checksum )
+	if( index )
 	{
-		if( !silent ) Com_Printf( "Couldn't generate checksum for pk3 file: %s\n", packfilename );
-		goto error;
+		pack->checksum = index->checksum;
+		pack->indexHit = true;
 	}
+	else
+	{
+		checksums[numFiles] = 0x1234567; // add some pseudo-random stuff
+		pack->checksum = FS_ChecksumPK3File( pack->filename, numFiles + 1, checksums );
+
+		if( !pack->checksum )
+		{
+			if( !silent ) Com_Printf( "Couldn't generate checksum for pk3 file: %s\n", packfilename );
+			goto error;
+		}
 
-	Mem_TempFree( checksums );
+		Mem_TempFree( checksums );
+		checksums = NULL;
+
+		// only while packs are being added to the search path, see FS_TouchGameDirectory
+		if( !vfsHandle && fs_pakindex_trie && fs_pakindex->integer )
+			pack->index = FS_CreatePakIndex( pack, reader.size, mtime, namesLen );
+	}
 
 	// read manifest file if it's a module pk3
 	if( modulepack && manifestFilesize > 0 )
@@ -2760,8 +3487,12 @@ static pack_t *FS_LoadPK3File( const char *packfilename, bool silent )
 error:
 	if( fin )
 		fclose( fin );
+	if( reader.data )
+		Sys_FS_UnMMapFile( mapping, (void *)reader.data, reader.size, mappingOffset );
 	if( pack )
 	{
+		if( pack->mapping )
+			FS_Free( pack->mapping );
 		if( pack->trie )
 			Trie_Destroy( pack->trie );
 		if( pack->filename )
@@ -2889,8 +3620,13 @@ return_result:
 */
 static void FS_FreePakFile( pack_t *pack )
 {
+	// buffers still pointing into the mapping keep it alive, the last one unmaps it
+	if( pack->mapping )
+		FS_ReleasePakMapping( pack->mapping );
 	if( pack->sysHandle )
 		Sys_FS_UnlockFile( pack->sysHandle );
+	if( pack->index )
+		FS_Free( pack->index );
 	Trie_Destroy( pack->trie );
 	FS_Free( pack->filename );
 	FS_Free( pack );
@@ -3944,17 +4680,58 @@ static void FS_RemoveExtraPaks( searchpath_t *old )
 	QMutex_Unlock( fs_searchpaths_mutex );
 }
 
+/*
+* FS_UpdatePakIndex
+* 
+* Adds freshly parsed packs to the pak index cache and rewrites it if needed.
+* Returns the number of packs that have been loaded from the cache.
+*/
+static int FS_UpdatePakIndex( void )
+{
+	int hits = 0;
+	searchpath_t *search;
+
+	for( search = fs_searchpaths; search; search = search->next )
+	{
+		pack_t *pack = search->pack;
+
+		if( !pack )
+			continue;
+		if( pack->indexHit )
+		{
+			hits++;
+			pack->indexHit = false;
+		}
+		if( pack->index )
+		{
+			FS_AddPakIndex( pack->index );
+			pack->index = NULL;
+			fs_pakindex_dirty = true;
+		}
+	}
+
+	if( fs_pakindex_dirty && fs_pakindex->integer )
+		FS_WritePakIndex();
+
+	FS_FreePakIndex();
+
+	return hits;
+}
+
 /*
 * FS_TouchGameDirectory
 */
 static int FS_TouchGameDirectory( const char *gamedir, bool initial )
 {
-	int newpaks;
+	int newpaks, indexed;
+	unsigned time;
 	searchpath_t *old, *prev, *basepath;
 
+	time = Sys_Milliseconds();
+
 	// add for every basepath, in reverse order
 	QMutex_Lock( fs_searchpaths_mutex );
-	
+
 	old = fs_searchpaths;
 	prev = NULL;
 	newpaks = 0;
@@ -3970,17 +4747,27 @@ static int FS_TouchGameDirectory( const char *gamedir, bool initial )
 		prev = basepath;
 	}
 
-	// possibly spawn a few threads to load deferred packs in parallel
+	// possibly spawn a few threads to load deferred packs in parallel,
+	// with the pak index cache at hand so unchanged packs aren't parsed again
 	if( newpaks )
+	{
+		FS_LoadPakIndex();
 		FS_LoadDeferredPaks( newpaks );
+	}
 
 	// FIXME: remove the initial check?
 	// not sure whether removing pak files on the fly is such a good idea
 	if( initial && newpaks )
 		FS_RemoveExtraPaks( old );
 
+	indexed = newpaks ? FS_UpdatePakIndex() : 0;
+
 	QMutex_Unlock( fs_searchpaths_mutex );
 
+	if( newpaks )
+		Com_Printf( "Loaded %i pk3 files from %s in %u ms, %i from the index cache\n", 
+			newpaks, gamedir, Sys_Milliseconds() - time, indexed );
+
 	return newpaks;
 }
 
@@ -4361,6 +5148,8 @@ void FS_Init( void )
 	//
 	fs_cdpath = Cvar_Get( "fs_cdpath", "", CVAR_NOSET );
 	fs_basepath = Cvar_Get( "fs_basepath", ".", CVAR_NOSET );
+	fs_mmappaks = Cvar_Get( "fs_mmappaks", "1", CVAR_NOSET );
+	fs_pakindex = Cvar_Get( "fs_pakindex", "1", CVAR_NOSET );
 	homedir = Sys_FS_GetHomeDirectory();
 	if( homedir != NULL )
 #ifdef PUBLIC_BUILD
@@ -20,6 +20,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // Z_zone.c
 
 #include "qcommon.h"
+#include "sys_threads.h"
 
 //#define MEMTRASH
 
@@ -28,8 +29,24 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define MEMHEADER_SENTINEL1			0xDEADF00D
 #define MEMHEADER_SENTINEL2			0xDF
 
+#define MEMHEADER_FREED				0xDEADBEEF		// sentinel1 of arena and slab blocks that were freed
+
 #define MEMALIGNMENT_DEFAULT		16
 
+#define MEM_MAX_THREADS				64				// threads with their own arenas and slabs, others take the lock
+#define MEM_ARENA_CHUNK_SIZE		0x10000
+#define MEM_SLAB_PAGE_SIZE			0x4000
+#define MEM_NUM_SIZECLASSES			10
+
+static const size_t mem_sizeclasses[MEM_NUM_SIZECLASSES] = { 16, 32, 48, 64, 96, 128, 192, 256, 384, 512 };
+
+enum
+{
+	MEMBLOCK_HEAP,		// malloc'ed, linked into the pool chain under memMutex
+	MEMBLOCK_ARENA,		// bumped from a per-thread arena chunk
+	MEMBLOCK_SLAB		// slot in a per-thread slab page
+};
+
 typedef struct memheader_s
 {
 	// address returned by malloc (may be significantly before this header to satisify alignment)
@@ -52,11 +69,54 @@ typedef struct memheader_s
 	const char *filename;
 	int fileline;
 
+	// MEMBLOCK_HEAP, MEMBLOCK_ARENA or MEMBLOCK_SLAB, and the size class of slab blocks
+	short kind;
+	short sizeclass;
+
+	// per-thread arenas or slabs the block was taken from, not set for heap blocks
+	struct memthreadpool_s *thread;
+
 	// should always be MEMHEADER_SENTINEL1
 	unsigned int sentinel1;
 	// immediately followed by data, which is followed by a MEMHEADER_SENTINEL2 byte
 } memheader_t;
 
+// arena chunk or slab page, followed by data
+typedef struct memchunk_s
+{
+	struct memchunk_s *next;
+	size_t size;		// bytes of data
+	size_t used;		// bytes bumped in arena chunks, size of a slot in slab pages
+} memchunk_t;
+
+// allocations of a single thread from a MEMPOOL_THREADARENA or MEMPOOL_THREADSLABS pool
+typedef struct memthreadpool_s
+{
+	int thread;							// owner, the only thread which allocates from here
+	volatile int lock;					// held by the owner while it changes its blocks and by Mem_WalkThreadBlocks
+
+	memchunk_t *chunks;
+	memchunk_t *curchunk;				// arena chunk currently being bumped
+	memheader_t *blocks;				// arena blocks, most recent first
+
+	memheader_t *freelist[MEM_NUM_SIZECLASSES];
+	memheader_t * volatile remotefree[MEM_NUM_SIZECLASSES];	// slots freed by other threads
+
+	size_t totalsize;					// only changed by the owner
+	size_t realsize;
+	volatile int remotesize;			// bytes freed by other threads, not yet taken into account
+
+	size_t peaksize;					// high-water mark of totalsize
+	unsigned int resets;				// number of Mem_ResetFrameArena calls
+} memthreadpool_t;
+
+// updated by each thread without locking, summed up for memstats
+typedef struct
+{
+	uint64_t localops;					// allocations and frees done without touching memMutex
+	uint64_t remotefrees;				// frees handed over to the owning thread
+} memthreadstats_t;
+
 struct mempool_s
 {
 	// should always be MEMHEADER_SENTINEL1
@@ -91,6 +151,9 @@ struct mempool_s
 
 	int fileline;
 
+	// per-thread arenas or slabs, indexed by thread number, for MEMPOOL_THREADARENA and MEMPOOL_THREADSLABS
+	memthreadpool_t **threads;
+
 	// should always be MEMHEADER_SENTINEL1
 	unsigned int sentinel2;
 };
@@ -111,8 +174,25 @@ mempool_t *tempMemPool;
 // only for zone
 mempool_t *zoneMemPool;
 
+// per-thread scratch memory which only lives until the end of the current
+// server or client frame, see Mem_ResetFrameArena
+mempool_t *frameMemPool;
+
 static qmutex_t *memMutex;
 
+static volatile int mem_lockwaiters;
+static uint64_t mem_lockedops;
+static uint64_t mem_contendedops;
+
+static int mem_numthreads;
+static int mem_numfreethreads;
+static int mem_freethreads[MEM_MAX_THREADS];	// numbers given back by threads which exited
+static memthreadstats_t mem_threadstats[MEM_MAX_THREADS];
+
+#ifdef ATTRIBUTE_THREAD_LOCAL
+static ATTRIBUTE_THREAD_LOCAL int mem_threadnum;		// 1-based, 0 if not assigned yet, -1 if we ran out
+#endif
+
 static bool memory_initialized = false;
 static bool commands_initialized = false;
 
@@ -128,6 +208,494 @@ static void _Mem_Error( const char *format, ... )
 	Sys_Error( msg );
 }
 
+/*
+* Mem_Lock
+* 
+* Counts how often the global lock is taken and how often another thread
+* was already holding or waiting for it.
+*/
+static void Mem_Lock( void )
+{
+	Sys_Atomic_Add( &mem_lockwaiters, 1, NULL );
+	QMutex_Lock( memMutex );
+
+	mem_lockedops++;
+	if( mem_lockwaiters > 1 )
+		mem_contendedops++;
+}
+
+/*
+* Mem_Unlock
+*/
+static void Mem_Unlock( void )
+{
+	QMutex_Unlock( memMutex );
+	Sys_Atomic_Add( &mem_lockwaiters, -1, NULL );
+}
+
+/*
+* Mem_ThreadNum
+* 
+* Returns a zero-based number for the calling thread, -1 if it can't have its own arenas.
+* Numbers of threads which exited are handed out again, along with their arenas and
+* slabs, so only more than MEM_MAX_THREADS threads at once fall back to the locked path.
+*/
+static int Mem_ThreadNum( void )
+{
+#ifdef ATTRIBUTE_THREAD_LOCAL
+	if( !mem_threadnum )
+	{
+		Mem_Lock();
+		if( mem_numfreethreads )
+			mem_threadnum = mem_freethreads[--mem_numfreethreads];
+		else
+			mem_threadnum = mem_numthreads < MEM_MAX_THREADS ? ++mem_numthreads : -1;
+		Mem_Unlock();
+	}
+	return mem_threadnum > 0 ? mem_threadnum - 1 : -1;
+#else
+	return -1;
+#endif
+}
+
+/*
+* Mem_ThreadExit
+* 
+* Called by each thread created with QThread_Create when it's done. The blocks it
+* still has stay valid, the next thread given the number takes them over.
+*/
+void Mem_ThreadExit( void )
+{
+#ifdef ATTRIBUTE_THREAD_LOCAL
+	if( mem_threadnum <= 0 )
+		return;
+
+	Mem_Lock();
+	mem_freethreads[mem_numfreethreads++] = mem_threadnum;
+	Mem_Unlock();
+
+	mem_threadnum = -1;
+#endif
+}
+
+/*
+* Mem_ThreadPool
+* 
+* The arenas of all threads are published in pool->threads under memMutex,
+* so Mem_WalkThreadBlocks can look at them.
+*/
+static memthreadpool_t *Mem_ThreadPool( mempool_t *pool, int thread )
+{
+	memthreadpool_t *tp;
+
+	tp = pool->threads[thread];
+	if( !tp )
+	{
+		tp = ( memthreadpool_t * )malloc( sizeof( *tp ) );
+		if( tp == NULL )
+			return NULL;
+		memset( tp, 0, sizeof( *tp ) );
+		tp->thread = thread;
+		tp->realsize = sizeof( *tp );
+
+		Mem_Lock();
+		pool->threads[thread] = tp;
+		Mem_Unlock();
+	}
+
+	return tp;
+}
+
+/*
+* Mem_LockThreadPool
+* 
+* Only contended while another thread walks the blocks, so a spin lock will do.
+*/
+static void Mem_LockThreadPool( memthreadpool_t *tp )
+{
+	while( !Sys_Atomic_CAS( &tp->lock, 0, 1, NULL ) )
+		Sys_Thread_Yield();
+}
+
+/*
+* Mem_UnlockThreadPool
+*/
+static void Mem_UnlockThreadPool( memthreadpool_t *tp )
+{
+	Sys_Atomic_CAS( &tp->lock, 1, 0, NULL );
+}
+
+/*
+* Mem_AllocChunk
+*/
+static memchunk_t *Mem_AllocChunk( memthreadpool_t *tp, size_t size )
+{
+	memchunk_t *chunk;
+
+	chunk = ( memchunk_t * )malloc( sizeof( memchunk_t ) + MEMALIGNMENT_DEFAULT + size );
+	if( chunk == NULL )
+		return NULL;
+
+	chunk->next = NULL;
+	chunk->size = size;
+	chunk->used = 0;
+	tp->realsize += sizeof( memchunk_t ) + MEMALIGNMENT_DEFAULT + size;
+
+	return chunk;
+}
+
+static inline uint8_t *Mem_ChunkData( memchunk_t *chunk )
+{
+	return ( uint8_t * )( ( (size_t)chunk + sizeof( memchunk_t ) + MEMALIGNMENT_DEFAULT - 1 ) & ~( MEMALIGNMENT_DEFAULT - 1 ) );
+}
+
+/*
+* Mem_ArenaAlloc
+* 
+* Bumps the current chunk, moving on to the next one (chunks are kept after
+* Mem_EmptyPool) or allocating a new one when it's full.
+*/
+static memheader_t *Mem_ArenaAlloc( memthreadpool_t *tp, size_t size, size_t alignment )
+{
+	uint8_t *data;
+	memheader_t *mem;
+	memchunk_t *chunk, *next;
+	size_t need = sizeof( memheader_t ) + alignment + size + 1;
+
+	for( chunk = tp->curchunk; chunk; chunk = chunk->next )
+	{
+		data = Mem_ChunkData( chunk );
+		mem = ( memheader_t * )( ( ( (size_t)data + chunk->used + sizeof( memheader_t ) + alignment - 1 ) & ~( alignment - 1 ) ) - sizeof( memheader_t ) );
+		if( ( uint8_t * )mem + sizeof( memheader_t ) + size + 1 <= data + chunk->size )
+			break;
+
+		// after a reset, following chunks are empty
+		if( chunk->next )
+			chunk->next->used = 0;
+	}
+
+	if( !chunk )
+	{
+		chunk = Mem_AllocChunk( tp, max( need, MEM_ARENA_CHUNK_SIZE ) );
+		if( chunk == NULL )
+			return NULL;
+
+		// append to the end of the list so reused chunks keep their order
+		if( tp->curchunk )
+		{
+			for( next = tp->curchunk; next->next; next = next->next );
+			next->next = chunk;
+		}
+		else
+		{
+			chunk->next = tp->chunks;
+			tp->chunks = chunk;
+		}
+
+		data = Mem_ChunkData( chunk );
+		mem = ( memheader_t * )( ( ( (size_t)data + sizeof( memheader_t ) + alignment - 1 ) & ~( alignment - 1 ) ) - sizeof( memheader_t ) );
+	}
+
+	tp->curchunk = chunk;
+	chunk->used = ( ( uint8_t * )mem + sizeof( memheader_t ) + size + 1 ) - Mem_ChunkData( chunk );
+
+	mem->baseaddress = NULL;
+	mem->kind = MEMBLOCK_ARENA;
+	mem->sizeclass = 0;
+	mem->thread = tp;
+	mem->realsize = sizeof( memheader_t ) + size + 1;
+	mem->prev = NULL;
+	mem->next = tp->blocks;
+	tp->blocks = mem;
+
+	return mem;
+}
+
+/*
+* Mem_SizeClass
+*/
+static int Mem_SizeClass( size_t size )
+{
+	int i;
+
+	for( i = 0; i < MEM_NUM_SIZECLASSES; i++ )
+	{
+		if( size <= mem_sizeclasses[i] )
+			return i;
+	}
+	return -1;
+}
+
+/*
+* Mem_SlabAlloc
+* 
+* Takes a slot from the free list, then from the slots freed by other threads and
+* finally carves a new page.
+*/
+static memheader_t *Mem_SlabAlloc( memthreadpool_t *tp, int sizeclass )
+{
+	memheader_t *mem;
+
+	if( !tp->freelist[sizeclass] && tp->remotefree[sizeclass] )
+	{
+		memheader_t *list;
+		int remotesize = 0;
+
+		do {
+			list = tp->remotefree[sizeclass];
+		} while( !Sys_Atomic_CASPtr( ( void * volatile * )&tp->remotefree[sizeclass], list, NULL, NULL ) );
+
+		for( mem = list; mem; mem = mem->next )
+			remotesize += mem->size;
+
+		tp->freelist[sizeclass] = list;
+		tp->totalsize -= remotesize;
+		Sys_Atomic_Add( &tp->remotesize, -remotesize, NULL );
+	}
+
+	if( !tp->freelist[sizeclass] )
+	{
+		size_t i, slotsize, pad;
+		memchunk_t *page;
+		uint8_t *data;
+
+		// headers are placed so that data is aligned
+		pad = ( MEMALIGNMENT_DEFAULT - sizeof( memheader_t ) % MEMALIGNMENT_DEFAULT ) % MEMALIGNMENT_DEFAULT;
+		slotsize = ( pad + sizeof( memheader_t ) + mem_sizeclasses[sizeclass] + 1 + MEMALIGNMENT_DEFAULT - 1 ) & ~( MEMALIGNMENT_DEFAULT - 1 );
+
+		page = Mem_AllocChunk( tp, MEM_SLAB_PAGE_SIZE );
+		if( page == NULL )
+			return NULL;
+		page->used = slotsize;
+		page->next = tp->chunks;
+		tp->chunks = page;
+
+		data = Mem_ChunkData( page );
+		for( i = page->size / slotsize; i-- > 0; )
+		{
+			mem = ( memheader_t * )( data + i * slotsize + pad );
+			mem->baseaddress = NULL;
+			mem->kind = MEMBLOCK_SLAB;
+			mem->sizeclass = sizeclass;
+			mem->thread = tp;
+			mem->size = 0;
+			mem->realsize = slotsize;
+			mem->sentinel1 = MEMHEADER_FREED;
+			mem->prev = NULL;
+			mem->next = tp->freelist[sizeclass];
+			tp->freelist[sizeclass] = mem;
+		}
+	}
+
+	mem = tp->freelist[sizeclass];
+	tp->freelist[sizeclass] = mem->next;
+	mem->next = NULL;
+
+	return mem;
+}
+
+/*
+* Mem_FreeThreadBlock
+* 
+* The owner puts slots back on its free list, other threads push them onto
+* a lock-free stack which the owner drains when it runs out of slots.
+* The owner freeing its last arena block gives the space back to the arena,
+* so blocks freed in reverse order of allocation don't pile up until the reset.
+*/
+static void Mem_FreeThreadBlock( memheader_t *mem )
+{
+	memthreadpool_t *tp = mem->thread;
+	int thread = Mem_ThreadNum();
+
+	mem->sentinel1 = MEMHEADER_FREED;
+
+	if( thread == tp->thread )
+	{
+		Mem_LockThreadPool( tp );
+		tp->totalsize -= mem->size;
+		if( mem->kind == MEMBLOCK_SLAB )
+		{
+			mem->next = tp->freelist[mem->sizeclass];
+			tp->freelist[mem->sizeclass] = mem;
+		}
+		else if( mem == tp->blocks && tp->curchunk )
+		{
+			uint8_t *data = Mem_ChunkData( tp->curchunk );
+
+			if( ( uint8_t * )mem >= data && ( uint8_t * )mem < data + tp->curchunk->size )
+			{
+				tp->blocks = mem->next;
+				tp->curchunk->used = ( uint8_t * )mem - data;
+			}
+		}
+		Mem_UnlockThreadPool( tp );
+		mem_threadstats[thread].localops++;
+		return;
+	}
+
+	Sys_Atomic_Add( &tp->remotesize, mem->size, NULL );
+	if( mem->kind == MEMBLOCK_SLAB )
+	{
+		memheader_t *head;
+
+		do {
+			head = tp->remotefree[mem->sizeclass];
+			mem->next = head;
+		} while( !Sys_Atomic_CASPtr( ( void * volatile * )&tp->remotefree[mem->sizeclass], head, mem, NULL ) );
+	}
+	if( thread >= 0 )
+		mem_threadstats[thread].remotefrees++;
+}
+
+/*
+* Mem_RewindThreadPool
+* 
+* Drops all blocks of an arena, the chunks are bumped again from the first one.
+*/
+static void Mem_RewindThreadPool( memthreadpool_t *tp )
+{
+	if( tp->chunks )
+		tp->chunks->used = 0;
+
+	tp->curchunk = tp->chunks;
+	tp->blocks = NULL;
+	tp->totalsize = 0;
+	tp->remotesize = 0;
+}
+
+/*
+* Mem_ResetThreadPools
+* 
+* Frees all arena and slab blocks of the pool. Arena chunks are kept for reuse unless
+* freeAll is set. Must not run concurrently with allocations from the pool.
+*/
+static void Mem_ResetThreadPools( mempool_t *pool, bool freeAll )
+{
+	int i;
+	memthreadpool_t *tp;
+	memchunk_t *chunk, *next;
+
+	Mem_Lock();
+
+	for( i = 0; i < MEM_MAX_THREADS; i++ )
+	{
+		tp = pool->threads[i];
+		if( !tp )
+			continue;
+
+		if( freeAll || ( pool->flags & MEMPOOL_THREADSLABS ) )
+		{
+			for( chunk = tp->chunks; chunk; chunk = next )
+			{
+				next = chunk->next;
+				free( chunk );
+			}
+			if( freeAll )
+			{
+				free( tp );
+				pool->threads[i] = NULL;
+				continue;
+			}
+			memset( tp->freelist, 0, sizeof( tp->freelist ) );
+			memset( ( void * )tp->remotefree, 0, sizeof( tp->remotefree ) );
+			tp->chunks = NULL;
+			tp->realsize = sizeof( *tp );
+		}
+
+		Mem_RewindThreadPool( tp );
+	}
+
+	Mem_Unlock();
+}
+
+/*
+* Mem_WalkThreadBlocks
+* 
+* Calls the function for each live arena and slab block of all threads. memMutex
+* keeps the arenas from being created or released meanwhile and the lock of each
+* arena keeps its owner from changing it while it's walked. Other threads may still
+* free blocks meanwhile, which only ever changes sentinel1 to MEMHEADER_FREED.
+*/
+static void Mem_WalkThreadBlocks( mempool_t *pool, void ( *func )( memheader_t *, void * ), void *arg )
+{
+	int i, self = -1;
+	size_t j, pad;
+	memthreadpool_t *tp;
+	memchunk_t *chunk;
+	memheader_t *mem;
+
+	if( !pool->threads )
+		return;
+
+#ifdef ATTRIBUTE_THREAD_LOCAL
+	// our own arena can't change under our feet, and the function may allocate from it
+	self = mem_threadnum - 1;
+#endif
+
+	pad = ( MEMALIGNMENT_DEFAULT - sizeof( memheader_t ) % MEMALIGNMENT_DEFAULT ) % MEMALIGNMENT_DEFAULT;
+
+	Mem_Lock();
+
+	for( i = 0; i < MEM_MAX_THREADS; i++ )
+	{
+		tp = pool->threads[i];
+		if( !tp )
+			continue;
+
+		if( i != self )
+			Mem_LockThreadPool( tp );
+
+		if( pool->flags & MEMPOOL_THREADARENA )
+		{
+			for( mem = tp->blocks; mem; mem = mem->next )
+			{
+				if( mem->sentinel1 != MEMHEADER_FREED )
+					func( mem, arg );
+			}
+		}
+		else
+		{
+			for( chunk = tp->chunks; chunk; chunk = chunk->next )
+			{
+				for( j = 0; j + chunk->used <= chunk->size; j += chunk->used )
+				{
+					mem = ( memheader_t * )( Mem_ChunkData( chunk ) + j + pad );
+					if( mem->sentinel1 != MEMHEADER_FREED )
+						func( mem, arg );
+				}
+			}
+		}
+
+		if( i != self )
+			Mem_UnlockThreadPool( tp );
+	}
+
+	Mem_Unlock();
+}
+
+/*
+* Mem_ThreadPoolSizes
+*/
+static void Mem_ThreadPoolSizes( mempool_t *pool, size_t *size, size_t *realsize )
+{
+	int i;
+	memthreadpool_t *tp;
+
+	if( !pool->threads )
+		return;
+
+	for( i = 0; i < MEM_MAX_THREADS; i++ )
+	{
+		tp = pool->threads[i];
+		if( !tp )
+			continue;
+		if( size )
+			( *size ) += tp->totalsize - tp->remotesize;
+		if( realsize )
+			( *realsize ) += tp->realsize;
+	}
+}
+
 void *_Mem_AllocExt( mempool_t *pool, size_t size, size_t alignment, int z, int musthave, int canthave, const char *filename, int fileline )
 {
 	void *base;
@@ -153,7 +721,46 @@ void *_Mem_AllocExt( mempool_t *pool, size_t size, size_t alignment, int z, int
 	if( developerMemory && developerMemory->integer )
 		Com_DPrintf( "Mem_Alloc: pool %s, file %s:%i, size %i bytes\n", pool->name, filename, fileline, size );
 
-	QMutex_Lock( memMutex );
+	if( pool->threads )
+	{
+		int thread = Mem_ThreadNum(), sizeclass;
+		memthreadpool_t *tp = thread >= 0 ? Mem_ThreadPool( pool, thread ) : NULL;
+
+		mem = NULL;
+		if( tp )
+		{
+			Mem_LockThreadPool( tp );
+			if( pool->flags & MEMPOOL_THREADARENA )
+				mem = Mem_ArenaAlloc( tp, size, alignment );
+			else if( alignment <= MEMALIGNMENT_DEFAULT && ( sizeclass = Mem_SizeClass( size ) ) >= 0 )
+				mem = Mem_SlabAlloc( tp, sizeclass );
+			if( !mem )
+				Mem_UnlockThreadPool( tp );
+		}
+
+		if( mem )
+		{
+			mem->pool = pool;
+			mem->filename = filename;
+			mem->fileline = fileline;
+			mem->size = size;
+			*( (uint8_t *) mem + sizeof( memheader_t ) + mem->size ) = MEMHEADER_SENTINEL2;
+			mem->sentinel1 = MEMHEADER_SENTINEL1;
+
+			tp->totalsize += size;
+			if( tp->totalsize > tp->peaksize )
+				tp->peaksize = tp->totalsize;
+			Mem_UnlockThreadPool( tp );
+			mem_threadstats[thread].localops++;
+
+			if( z )
+				memset( (void *)( (uint8_t *) mem + sizeof( memheader_t ) ), 0, mem->size );
+
+			return (void *)( (uint8_t *) mem + sizeof( memheader_t ) );
+		}
+	}
+
+	Mem_Lock();
 
 	pool->totalsize += size;
 	realsize = sizeof( memheader_t ) + size + alignment + sizeof( int );
@@ -172,6 +779,9 @@ void *_Mem_AllocExt( mempool_t *pool, size_t size, size_t alignment, int z, int
 	mem->size = size;
 	mem->realsize = realsize;
 	mem->pool = pool;
+	mem->kind = MEMBLOCK_HEAP;
+	mem->sizeclass = 0;
+	mem->thread = NULL;
 	mem->sentinel1 = MEMHEADER_SENTINEL1;
 
 	// we have to use only a single byte for this sentinel, because it may not be aligned, and some platforms can't use unaligned accesses
@@ -184,7 +794,7 @@ void *_Mem_AllocExt( mempool_t *pool, size_t size, size_t alignment, int z, int
 	if( mem->next )
 		mem->next->prev = mem;
 
-	QMutex_Unlock( memMutex );
+	Mem_Unlock();
 
 	if( z )
 		memset( (void *)( (uint8_t *) mem + sizeof( memheader_t ) ), 0, mem->size );
@@ -247,6 +857,10 @@ void _Mem_Free( void *data, int musthave, int canthave, const char *filename, in
 
 	mem = ( memheader_t * )( (uint8_t *) data - sizeof( memheader_t ) );
 
+	// arena and slab memory stays mapped, so double frees can be told apart
+	if( mem->sentinel1 == MEMHEADER_FREED )
+		_Mem_Error( "Mem_Free: double freed (alloc at %s:%i, free at %s:%i)", mem->filename, mem->fileline, filename, fileline );
+
 	assert( mem->sentinel1 == MEMHEADER_SENTINEL1 );
 	assert( *( (uint8_t *) mem + sizeof( memheader_t ) + mem->size ) == MEMHEADER_SENTINEL2 );
 
@@ -264,7 +878,13 @@ void _Mem_Free( void *data, int musthave, int canthave, const char *filename, in
 	if( developerMemory && developerMemory->integer )
 		Com_DPrintf( "Mem_Free: pool %s, alloc %s:%i, free %s:%i, size %i bytes\n", pool->name, mem->filename, mem->fileline, filename, fileline, mem->size );
 
-	QMutex_Lock( memMutex );
+	if( mem->kind != MEMBLOCK_HEAP )
+	{
+		Mem_FreeThreadBlock( mem );
+		return;
+	}
+
+	Mem_Lock();
 
 	// unlink memheader from doubly linked list
 	if( ( mem->prev ? mem->prev->next != mem : pool->chain != mem ) || ( mem->next && mem->next->prev != mem ) )
@@ -283,7 +903,7 @@ void _Mem_Free( void *data, int musthave, int canthave, const char *filename, in
 	base = mem->baseaddress;
 	pool->realsize -= mem->realsize;
 
-	QMutex_Unlock( memMutex );
+	Mem_Unlock();
 
 #ifdef MEMTRASH
 	memset( mem, 0xBF, sizeof( memheader_t ) + mem->size + sizeof( int ) );
@@ -300,6 +920,8 @@ mempool_t *_Mem_AllocPool( mempool_t *parent, const char *name, int flags, const
 		_Mem_Error( "Mem_AllocPool: nested temporary pools are not allowed (allocpool at %s:%i)", filename, fileline );
 	if( flags & MEMPOOL_TEMPORARY )
 		_Mem_Error( "Mem_AllocPool: tried to allocate temporary pool, use Mem_AllocTempPool instead (allocpool at %s:%i)", filename, fileline );
+	if( ( flags & MEMPOOL_THREADARENA ) && ( flags & MEMPOOL_THREADSLABS ) )
+		_Mem_Error( "Mem_AllocPool: pool can't have both thread arenas and slabs (allocpool at %s:%i)", filename, fileline );
 
 	pool = ( mempool_t* )malloc( sizeof( mempool_t ) );
 	if( pool == NULL )
@@ -318,6 +940,15 @@ mempool_t *_Mem_AllocPool( mempool_t *parent, const char *name, int flags, const
 	pool->realsize = sizeof( mempool_t );
 	Q_strncpyz( pool->name, name, sizeof( pool->name ) );
 
+	if( flags & ( MEMPOOL_THREADARENA|MEMPOOL_THREADSLABS ) )
+	{
+		pool->threads = ( memthreadpool_t ** )malloc( MEM_MAX_THREADS * sizeof( *pool->threads ) );
+		if( pool->threads == NULL )
+			_Mem_Error( "Mem_AllocPool: out of memory (allocpool at %s:%i)", filename, fileline );
+		memset( pool->threads, 0, MEM_MAX_THREADS * sizeof( *pool->threads ) );
+		pool->realsize += MEM_MAX_THREADS * sizeof( *pool->threads );
+	}
+
 	if( parent )
 	{
 		pool->next = parent->child;
@@ -393,6 +1024,12 @@ void _Mem_FreePool( mempool_t **pool, int musthave, int canthave, const char *fi
 	while( ( *pool )->chain )  // free memory owned by the pool
 		Mem_Free( (void *)( (uint8_t *)( *pool )->chain + sizeof( memheader_t ) ) );
 
+	if( ( *pool )->threads )
+	{
+		Mem_ResetThreadPools( *pool, true );
+		free( ( *pool )->threads );
+	}
+
 	*chainAddress = ( *pool )->next;
 
 	// free the pool itself
@@ -445,13 +1082,51 @@ void _Mem_EmptyPool( mempool_t *pool, int musthave, int canthave, const char *fi
 #endif
 	while( pool->chain )        // free memory owned by the pool
 		Mem_Free( (void *)( (uint8_t *) pool->chain + sizeof( memheader_t ) ) );
+
+	if( pool->threads )
+		Mem_ResetThreadPools( pool, false );
+}
+
+/*
+* Mem_ResetFrameArena
+* 
+* Releases everything the calling thread took from frameMemPool, keeping the
+* chunks for the next frame, so steady-state frames don't touch the heap.
+* Threads without their own arena fall back to the heap, so their blocks
+* must be released with Mem_FrameFree.
+*/
+void Mem_ResetFrameArena( void )
+{
+	int thread;
+	memthreadpool_t *tp;
+
+	if( !frameMemPool )
+		return;
+
+	thread = Mem_ThreadNum();
+	if( thread < 0 )
+		return;
+
+	tp = frameMemPool->threads[thread];
+	if( !tp )
+		return;
+
+	Mem_LockThreadPool( tp );
+	Mem_RewindThreadPool( tp );
+	tp->resets++;
+	Mem_UnlockThreadPool( tp );
 }
 
 size_t Mem_PoolTotalSize( mempool_t *pool )
 {
+	size_t size;
+
 	assert( pool != NULL );
 
-	return pool->totalsize;
+	size = (size_t)pool->totalsize;
+	Mem_ThreadPoolSizes( pool, &size, NULL );
+
+	return size;
 }
 
 void _Mem_CheckSentinels( void *data, const char *filename, int fileline )
@@ -472,6 +1147,27 @@ void _Mem_CheckSentinels( void *data, const char *filename, int fileline )
 		_Mem_Error( "Mem_CheckSentinels: trashed header sentinel 2 (block allocated at %s:%i, sentinel check at %s:%i)", mem->filename, mem->fileline, filename, fileline );
 }
 
+typedef struct
+{
+	const char *filename;
+	int fileline;
+} memcheckarg_t;
+
+static void Mem_CheckThreadBlockSentinels( memheader_t *mem, void *parg )
+{
+	memcheckarg_t *arg = parg;
+	unsigned int sentinel1 = mem->sentinel1;
+
+	// may have just been freed by another thread
+	if( sentinel1 == MEMHEADER_FREED )
+		return;
+
+	if( sentinel1 != MEMHEADER_SENTINEL1 )
+		_Mem_Error( "Mem_CheckSentinels: trashed header sentinel 1 (block allocated at %s:%i, sentinel check at %s:%i)", mem->filename, mem->fileline, arg->filename, arg->fileline );
+	if( *( (uint8_t *) mem + sizeof( memheader_t ) + mem->size ) != MEMHEADER_SENTINEL2 )
+		_Mem_Error( "Mem_CheckSentinels: trashed header sentinel 2 (block allocated at %s:%i, sentinel check at %s:%i)", mem->filename, mem->fileline, arg->filename, arg->fileline );
+}
+
 static void _Mem_CheckSentinelsPool( mempool_t *pool, const char *filename, int fileline )
 {
 	memheader_t *mem;
@@ -494,6 +1190,15 @@ static void _Mem_CheckSentinelsPool( mempool_t *pool, const char *filename, int
 
 	for( mem = pool->chain; mem; mem = mem->next )
 		_Mem_CheckSentinels( (void *)( (uint8_t *) mem + sizeof( memheader_t ) ), filename, fileline );
+
+	if( pool->threads )
+	{
+		memcheckarg_t arg;
+
+		arg.filename = filename;
+		arg.fileline = fileline;
+		Mem_WalkThreadBlocks( pool, Mem_CheckThreadBlockSentinels, &arg );
+	}
 }
 
 void _Mem_CheckSentinelsGlobal( const char *filename, int fileline )
@@ -507,6 +1212,7 @@ void _Mem_CheckSentinelsGlobal( const char *filename, int fileline )
 static void Mem_CountPoolStats( mempool_t *pool, int *count, int *size, int *realsize )
 {
 	mempool_t *child;
+	size_t threadsize = 0, threadrealsize = 0;
 
 	// recurse into children
 	if( pool->child )
@@ -521,6 +1227,53 @@ static void Mem_CountPoolStats( mempool_t *pool, int *count, int *size, int *rea
 		( *size ) += pool->totalsize;
 	if( realsize )
 		( *realsize ) += pool->realsize;
+
+	Mem_ThreadPoolSizes( pool, &threadsize, &threadrealsize );
+	if( size )
+		( *size ) += (int)threadsize;
+	if( realsize )
+		( *realsize ) += (int)threadrealsize;
+}
+
+static void Mem_PrintAllocation( memheader_t *mem, void *unused )
+{
+	Com_Printf( "%10i bytes allocated at %s:%i\n", mem->size, mem->filename, mem->fileline );
+}
+
+static void Mem_PrintLockStats( void )
+{
+	int i;
+	uint64_t localops = 0, remotefrees = 0;
+
+	for( i = 0; i < mem_numthreads; i++ )
+	{
+		localops += mem_threadstats[i].localops;
+		remotefrees += mem_threadstats[i].remotefrees;
+	}
+
+	Com_Printf( "%llu locked allocations and frees, %llu contended (%.1f%%)\n", (unsigned long long)mem_lockedops, 
+		(unsigned long long)mem_contendedops, mem_lockedops ? mem_contendedops * 100.0 / mem_lockedops : 0.0 );
+	Com_Printf( "%llu lock-free allocations and frees on %i threads, %llu frees handed over to other threads\n", 
+		(unsigned long long)localops, mem_numthreads, (unsigned long long)remotefrees );
+}
+
+static void Mem_PrintFrameArenaStats( void )
+{
+	int i;
+	memthreadpool_t *tp;
+
+	if( !frameMemPool )
+		return;
+
+	for( i = 0; i < MEM_MAX_THREADS; i++ )
+	{
+		tp = frameMemPool->threads[i];
+		if( !tp )
+			continue;
+
+		Com_Printf( "frame arena of thread %i: %u frames, %u bytes high-water mark, %u bytes (%.3fMB) reserved\n", 
+			i, tp->resets, (unsigned)tp->peaksize, (unsigned)tp->realsize, tp->realsize / 1048576.0 );
+	}
 }
 
 static void Mem_PrintStats( void )
@@ -542,6 +1295,9 @@ static void Mem_PrintStats( void )
 	Com_Printf( "%i memory pools, totalling %i bytes (%.3fMB), %i bytes (%.3fMB) actual\n", total, totalsize, totalsize / 1048576.0,
 		realsize, realsize / 1048576.0 );
 
+	Mem_PrintLockStats();
+	Mem_PrintFrameArenaStats();
+
 	// temporary pools are not nested
 	for( pool = poolChain; pool; pool = pool->next )
 	{
@@ -585,7 +1341,8 @@ static void Mem_PrintPoolStats( mempool_t *pool, int listchildren, int listalloc
 	if( listallocations )
 	{
 		for( mem = pool->chain; mem; mem = mem->next )
-			Com_Printf( "%10i bytes allocated at %s:%i\n", mem->size, mem->filename, mem->fileline );
+			Mem_PrintAllocation( mem, NULL );
+		Mem_WalkThreadBlocks( pool, Mem_PrintAllocation, NULL );
 	}
 
 	if( listchildren )
@@ -664,8 +1421,10 @@ void Memory_Init( void )
 
 	memMutex = QMutex_Create();
 
-	zoneMemPool = Mem_AllocPool( NULL, "Zone" );
+	// the zone is shared by all threads, mostly for small long-lived allocations
+	zoneMemPool = Mem_AllocPoolExt( NULL, "Zone", MEMPOOL_THREADSLABS );
 	tempMemPool = Mem_AllocTempPool( "Temporary Memory" );
+	frameMemPool = Mem_AllocPoolExt( NULL, "Frame Arena", MEMPOOL_THREADARENA );
 
 	memory_initialized = true;
 }
@@ -704,6 +1463,7 @@ void Memory_Shutdown( void )
 
 	Mem_FreePool( &zoneMemPool );
 	Mem_FreePool( &tempMemPool );
+	Mem_FreePool( &frameMemPool );
 
 	for( pool = poolChain; pool; pool = next )
 	{
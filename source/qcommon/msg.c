@@ -43,6 +43,7 @@ void MSG_Clear( msg_t *msg )
 {
 	msg->cursize = 0;
 	msg->compressed = false;
+	msg->writebits = 0;
 }
 
 void *MSG_GetSpace( msg_t *msg, size_t length )
@@ -55,6 +56,7 @@ void *MSG_GetSpace( msg_t *msg, size_t length )
 
 	ptr = msg->data + msg->cursize;
 	msg->cursize += length;
+	msg->writebits = 0;
 	return ptr;
 }
 
@@ -157,11 +159,13 @@ void MSG_WriteString( msg_t *msg, const char *s )
 void MSG_BeginReading( msg_t *msg )
 {
 	msg->readcount = 0;
+	msg->readbits = 0;
 }
 
 int MSG_ReadChar( msg_t *msg )
 {
 	int i = (signed char)msg->data[msg->readcount++];
+	msg->readbits = 0;
 	if( msg->readcount > msg->cursize )
 		i = -1;
 	return i;
@@ -171,6 +175,7 @@ int MSG_ReadChar( msg_t *msg )
 int MSG_ReadByte( msg_t *msg )
 {
 	msg->readcount++;
+	msg->readbits = 0;
 	if( msg->readcount > msg->cursize )
 		return -1;
 
@@ -180,6 +185,7 @@ int MSG_ReadByte( msg_t *msg )
 int MSG_ReadShort( msg_t *msg )
 {
 	msg->readcount += 2;
+	msg->readbits = 0;
 	if( msg->readcount > msg->cursize )
 		return -1;
 
@@ -189,6 +195,7 @@ int MSG_ReadShort( msg_t *msg )
 int MSG_ReadInt3( msg_t *msg )
 {
 	msg->readcount += 3;
+	msg->readbits = 0;
 	if( msg->readcount > msg->cursize )
 		return -1;
 
@@ -201,6 +208,7 @@ int MSG_ReadInt3( msg_t *msg )
 int MSG_ReadLong( msg_t *msg )
 {
 	msg->readcount += 4;
+	msg->readbits = 0;
 	if( msg->readcount > msg->cursize )
 		return -1;
 
@@ -244,6 +252,7 @@ int MSG_SkipData( msg_t *msg, size_t length )
 	if( msg->readcount + length <= msg->cursize )
 	{
 		msg->readcount += length;
+		msg->readbits = 0;
 		return 1;
 	}
 	return 0;
@@ -252,7 +261,11 @@ int MSG_SkipData( msg_t *msg, size_t length )
 static char *MSG_ReadString2( msg_t *msg, bool linebreak )
 {
 	int l, c;
+#ifdef ATTRIBUTE_THREAD_LOCAL
+	static ATTRIBUTE_THREAD_LOCAL char string[MAX_MSG_STRING_CHARS];	// messages may be parsed on several threads
+#else
 	static char string[MAX_MSG_STRING_CHARS];
+#endif
 
 	l = 0;
 	do
@@ -281,31 +294,140 @@ char *MSG_ReadStringLine( msg_t *msg )
 }
 
 //==================================================
-// SPECIAL CASES
+// BIT FUNCTIONS
 //==================================================
 
+static const int msg_varbits[4] = { 4, 8, 16, 32 };
+
 /*
-* MSG_WriteDeltaEntity
-* 
-* Writes part of a packetentities message.
-* Can delta from either a baseline or a previous packet_entity
+* MSG_WriteBits
+*
+* Writes the low nbits of value, least significant bit first. Consecutive
+* calls share bytes, a byte-wise write in between starts a new byte.
 */
-void MSG_WriteDeltaEntity( entity_state_t *from, entity_state_t *to, msg_t *msg, bool force, bool updateOtherOrigin )
+void MSG_WriteBits( msg_t *msg, unsigned value, int nbits )
 {
-	int bits;
+	int n, shift;
+	uint8_t *p;
 
-	if( !to->number )
-		Com_Error( ERR_FATAL, "MSG_WriteDeltaEntity: Unset entity number" );
-	else if( to->number >= MAX_EDICTS )
-		Com_Error( ERR_FATAL, "MSG_WriteDeltaEntity: Entity number >= MAX_EDICTS" );
-	else if( to->number < 0 )
-		Com_Error( ERR_FATAL, "MSG_WriteDeltaEntity: Invalid Entity number" );
+	assert( nbits >= 0 && nbits <= 32 );
 
-	// send an update
-	bits = 0;
+	while( nbits > 0 )
+	{
+		if( !( msg->writebits & 7 ) || ( msg->writebits >> 3 ) + 1 != msg->cursize )
+		{
+			p = ( uint8_t * )MSG_GetSpace( msg, 1 );
+			*p = 0;
+			msg->writebits = ( msg->cursize - 1 ) << 3;
+		}
 
-	if( to->number & 0xFF00 )
-		bits |= U_NUMBER16; // number8 is implicit otherwise
+		shift = msg->writebits & 7;
+		n = min( 8 - shift, nbits );
+		msg->data[msg->cursize - 1] |= ( value & ( ( 1u << n ) - 1 ) ) << shift;
+
+		value >>= n;
+		nbits -= n;
+		msg->writebits += n;
+	}
+}
+
+/*
+* MSG_WriteVarBits
+*
+* Small values take less bits: a 2 bit width selector and 4, 8, 16 or 32 bits.
+*/
+void MSG_WriteVarBits( msg_t *msg, unsigned value )
+{
+	int i;
+
+	for( i = 0; i < 3; i++ )
+	{
+		if( value < ( 1u << msg_varbits[i] ) )
+			break;
+	}
+
+	MSG_WriteBits( msg, i, 2 );
+	MSG_WriteBits( msg, value, msg_varbits[i] );
+}
+
+/*
+* MSG_WriteDeltaBits
+*
+* Signed variant of MSG_WriteVarBits, small deltas of either sign are cheap.
+*/
+void MSG_WriteDeltaBits( msg_t *msg, int delta )
+{
+	if( delta < 0 )
+		MSG_WriteVarBits( msg, ( (unsigned)( -( delta + 1 ) ) << 1 ) | 1 );
+	else
+		MSG_WriteVarBits( msg, (unsigned)delta << 1 );
+}
+
+/*
+* MSG_ReadBits
+*/
+unsigned MSG_ReadBits( msg_t *msg, int nbits )
+{
+	int n, shift, got;
+	unsigned value;
+
+	assert( nbits >= 0 && nbits <= 32 );
+
+	value = 0;
+	for( got = 0; got < nbits; got += n )
+	{
+		if( !( msg->readbits & 7 ) || ( msg->readbits >> 3 ) + 1 != msg->readcount )
+		{
+			msg->readcount++;
+			if( msg->readcount > msg->cursize )
+				return 0;
+			msg->readbits = ( msg->readcount - 1 ) << 3;
+		}
+
+		shift = msg->readbits & 7;
+		n = min( 8 - shift, nbits - got );
+		value |= ( ( msg->data[msg->readcount - 1] >> shift ) & ( ( 1u << n ) - 1 ) ) << got;
+
+		msg->readbits += n;
+	}
+
+	return value;
+}
+
+/*
+* MSG_ReadVarBits
+*/
+unsigned MSG_ReadVarBits( msg_t *msg )
+{
+	return MSG_ReadBits( msg, msg_varbits[MSG_ReadBits( msg, 2 )] );
+}
+
+/*
+* MSG_ReadDeltaBits
+*/
+int MSG_ReadDeltaBits( msg_t *msg )
+{
+	unsigned value = MSG_ReadVarBits( msg );
+
+	if( value & 1 )
+		return -(int)( value >> 1 ) - 1;
+	return (int)( value >> 1 );
+}
+
+//==================================================
+// SPECIAL CASES
+//==================================================
+
+/*
+* MSG_DeltaEntityBits
+*
+* Returns the U_* bits of the fields that need to be sent
+*/
+static unsigned MSG_DeltaEntityBits( entity_state_t *from, entity_state_t *to, bool updateOtherOrigin )
+{
+	unsigned bits;
+
+	bits = 0;
 
 	if( to->linearMovement )
 	{
@@ -403,6 +525,32 @@ void MSG_WriteDeltaEntity( entity_state_t *from, entity_state_t *to, msg_t *msg,
 	if( to->team != from->team )
 		bits |= U_TEAM;
 
+	return bits;
+}
+
+/*
+* MSG_WriteDeltaEntity
+*
+* Writes part of a packetentities message.
+* Can delta from either a baseline or a previous packet_entity
+*/
+void MSG_WriteDeltaEntity( entity_state_t *from, entity_state_t *to, msg_t *msg, bool force, bool updateOtherOrigin )
+{
+	int bits;
+
+	if( !to->number )
+		Com_Error( ERR_FATAL, "MSG_WriteDeltaEntity: Unset entity number" );
+	else if( to->number >= MAX_EDICTS )
+		Com_Error( ERR_FATAL, "MSG_WriteDeltaEntity: Entity number >= MAX_EDICTS" );
+	else if( to->number < 0 )
+		Com_Error( ERR_FATAL, "MSG_WriteDeltaEntity: Invalid Entity number" );
+
+	// send an update
+	bits = MSG_DeltaEntityBits( from, to, updateOtherOrigin );
+
+	if( to->number & 0xFF00 )
+		bits |= U_NUMBER16; // number8 is implicit otherwise
+
 	//
 	// write the message
 	//
@@ -579,7 +727,7 @@ void MSG_WriteDeltaEntity( entity_state_t *from, entity_state_t *to, msg_t *msg,
 
 /*
 * MSG_ReadEntityBits
-* 
+*
 * Returns the entity number and the header bits
 */
 int MSG_ReadEntityBits( msg_t *msg, unsigned *bits )
@@ -616,7 +764,7 @@ int MSG_ReadEntityBits( msg_t *msg, unsigned *bits )
 
 /*
 * MSG_ReadDeltaEntity
-* 
+*
 * Can go from either a baseline or a previous packet_entity
 */
 void MSG_ReadDeltaEntity( msg_t *msg, entity_state_t *from, entity_state_t *to, int number, unsigned bits )
@@ -760,6 +908,384 @@ void MSG_ReadDeltaEntity( msg_t *msg, entity_state_t *from, entity_state_t *to,
 		to->team = (uint8_t)MSG_ReadByte( msg );
 }
 
+/*
+=============================================================================
+
+BIT-PACKED ENTITY DELTAS
+
+Used in bit-packed frames (FRAMESNAP_FLAG_BITPACKED). An entity record is
+the gap to the previous entity number, a remove bit and, unless removed,
+the changed fields mask and the fields. Origins of entities that don't use
+linear movement are sent as deltas of their quantized values, which both
+sides can recompute exactly from the state the delta is made from. Angles
+keep their quantized width, since their quantization depends on the solid
+type and a delta base isn't guaranteed to be shared.
+
+=============================================================================
+*/
+
+// fields that are most likely to change go first, the rest only if any changed
+#define MSG_ENTITYBITS_LOW		( U_ORIGIN1|U_ORIGIN2|U_ORIGIN3|U_ANGLE1|U_ANGLE2|U_EVENT )
+
+static const unsigned msg_entitybits_high[] =
+{
+	U_FRAME8, U_SVFLAGS, U_MODEL, U_TYPE, U_OTHERORIGIN, U_SKIN8, U_EFFECTS8, U_WEAPON, U_SOUND, U_MODEL2,
+	U_LIGHT, U_SOLID, U_EVENT2, U_SKIN16, U_ANGLE3, U_ATTENUATION, U_EFFECTS16, U_FRAME16, U_TEAM
+};
+
+#define MSG_NUM_ENTITYBITS_HIGH	( sizeof( msg_entitybits_high ) / sizeof( msg_entitybits_high[0] ) )
+
+/*
+* MSG_WriteCoordBits
+*/
+static void MSG_WriteCoordBits( msg_t *msg, float from, float to, bool delta )
+{
+	if( delta )
+		MSG_WriteDeltaBits( msg, MSG_Int3( Q_rint( to*PM_VECTOR_SNAP ) ) - MSG_Int3( Q_rint( from*PM_VECTOR_SNAP ) ) );
+	else
+		MSG_WriteBits( msg, Q_rint( to*PM_VECTOR_SNAP ), 24 );
+}
+
+/*
+* MSG_ReadCoordBits
+*/
+static float MSG_ReadCoordBits( msg_t *msg, float from, bool delta )
+{
+	int q;
+
+	if( delta )
+		q = MSG_Int3( MSG_Int3( Q_rint( from*PM_VECTOR_SNAP ) ) + MSG_ReadDeltaBits( msg ) );
+	else
+		q = MSG_Int3( (int)MSG_ReadBits( msg, 24 ) );
+
+	return (float)q*( 1.0/PM_VECTOR_SNAP );
+}
+
+/*
+* MSG_WriteEntityNumberBits
+*
+* Writes the header of an entity record, or the end of the list if number is 0.
+* Numbers must be written in increasing order.
+*/
+void MSG_WriteEntityNumberBits( msg_t *msg, int lastnum, int number, bool remove )
+{
+	if( !number )
+	{
+		MSG_WriteVarBits( msg, 0 );
+		return;
+	}
+
+	assert( number > lastnum );
+	MSG_WriteVarBits( msg, number - lastnum );
+	MSG_WriteBits( msg, remove ? 1 : 0, 1 );
+}
+
+/*
+* MSG_WriteDeltaEntityBits
+*
+* Writes the body of an entity record. Returns false and writes nothing
+* if no field has changed and force is not set.
+*/
+bool MSG_WriteDeltaEntityBits( entity_state_t *from, entity_state_t *to, msg_t *msg, bool force, bool updateOtherOrigin )
+{
+	unsigned i, bits;
+	bool delta;
+
+	bits = MSG_DeltaEntityBits( from, to, updateOtherOrigin );
+	if( !bits && !force )
+		return false;
+
+	MSG_WriteBits( msg, bits & MSG_ENTITYBITS_LOW, 6 );
+	if( bits & ~MSG_ENTITYBITS_LOW )
+	{
+		MSG_WriteBits( msg, 1, 1 );
+		for( i = 0; i < MSG_NUM_ENTITYBITS_HIGH; i++ )
+			MSG_WriteBits( msg, ( bits & msg_entitybits_high[i] ) ? 1 : 0, 1 );
+	}
+	else
+	{
+		MSG_WriteBits( msg, 0, 1 );
+	}
+
+	if( bits & U_TYPE )
+	{
+		uint8_t ttype = to->type & ~ET_INVERSE;
+		if( to->linearMovement )
+			ttype |= ET_INVERSE;
+		MSG_WriteBits( msg, ttype, 8 );
+	}
+
+	if( bits & U_SOLID )
+		MSG_WriteBits( msg, to->solid, 16 );
+
+	if( bits & U_MODEL )
+		MSG_WriteBits( msg, to->modelindex, 16 );
+	if( bits & U_MODEL2 )
+		MSG_WriteBits( msg, to->modelindex2, 16 );
+
+	if( bits & U_FRAME8 )
+		MSG_WriteBits( msg, to->frame, 8 );
+	else if( bits & U_FRAME16 )
+		MSG_WriteBits( msg, to->frame, 16 );
+
+	if( ( bits & U_SKIN8 ) && ( bits & U_SKIN16 ) )
+		MSG_WriteBits( msg, to->skinnum, 32 );
+	else if( bits & U_SKIN8 )
+		MSG_WriteBits( msg, to->skinnum, 8 );
+	else if( bits & U_SKIN16 )
+		MSG_WriteBits( msg, to->skinnum, 16 );
+
+	if( ( bits & ( U_EFFECTS8|U_EFFECTS16 ) ) == ( U_EFFECTS8|U_EFFECTS16 ) )
+		MSG_WriteBits( msg, to->effects, 32 );
+	else if( bits & U_EFFECTS8 )
+		MSG_WriteBits( msg, to->effects, 8 );
+	else if( bits & U_EFFECTS16 )
+		MSG_WriteBits( msg, to->effects, 16 );
+
+	if( to->linearMovement )
+	{
+		for( i = 0; i < 3; i++ )
+		{
+			if( bits & ( U_ORIGIN1<<i ) )
+				MSG_WriteCoordBits( msg, from->linearMovementVelocity[i], to->linearMovementVelocity[i], false );
+		}
+	}
+	else
+	{
+		delta = !from->linearMovement;
+		for( i = 0; i < 3; i++ )
+		{
+			if( bits & ( U_ORIGIN1<<i ) )
+				MSG_WriteCoordBits( msg, from->origin[i], to->origin[i], delta );
+		}
+	}
+
+	if( bits & U_ANGLE1 )
+		MSG_WriteBits( msg, to->solid == SOLID_BMODEL ? ANGLE2SHORT( to->angles[0] ) : ANGLE2BYTE( to->angles[0] ), to->solid == SOLID_BMODEL ? 16 : 8 );
+	if( bits & U_ANGLE2 )
+		MSG_WriteBits( msg, to->solid == SOLID_BMODEL ? ANGLE2SHORT( to->angles[1] ) : ANGLE2BYTE( to->angles[1] ), to->solid == SOLID_BMODEL ? 16 : 8 );
+	if( bits & U_ANGLE3 )
+		MSG_WriteBits( msg, to->solid == SOLID_BMODEL ? ANGLE2SHORT( to->angles[2] ) : ANGLE2BYTE( to->angles[2] ), to->solid == SOLID_BMODEL ? 16 : 8 );
+
+	if( bits & U_OTHERORIGIN )
+	{
+		for( i = 0; i < 3; i++ )
+			MSG_WriteCoordBits( msg, 0, to->origin2[i], false );
+	}
+
+	if( bits & U_SOUND )
+		MSG_WriteBits( msg, (uint8_t)to->sound, 8 );
+
+	if( bits & U_EVENT )
+	{
+		MSG_WriteBits( msg, (uint8_t)( to->events[0] & ~EV_INVERSE ), 7 );
+		MSG_WriteBits( msg, to->eventParms[0] ? 1 : 0, 1 );
+		if( to->eventParms[0] )
+			MSG_WriteBits( msg, (uint8_t)to->eventParms[0], 8 );
+	}
+	if( bits & U_EVENT2 )
+	{
+		MSG_WriteBits( msg, (uint8_t)( to->events[1] & ~EV_INVERSE ), 7 );
+		MSG_WriteBits( msg, to->eventParms[1] ? 1 : 0, 1 );
+		if( to->eventParms[1] )
+			MSG_WriteBits( msg, (uint8_t)to->eventParms[1], 8 );
+	}
+
+	if( bits & U_ATTENUATION )
+		MSG_WriteBits( msg, (uint8_t)( to->attenuation * 16 ), 8 );
+
+	if( bits & U_WEAPON )
+	{
+		MSG_WriteBits( msg, to->weapon & ~0x80, 7 );
+		MSG_WriteBits( msg, to->teleported ? 1 : 0, 1 );
+	}
+
+	if( bits & U_SVFLAGS )
+		MSG_WriteBits( msg, to->svflags, 16 );
+
+	if( bits & U_LIGHT )
+		MSG_WriteBits( msg, to->light, 32 );
+
+	if( bits & U_TEAM )
+		MSG_WriteBits( msg, to->team, 8 );
+
+	return true;
+}
+
+/*
+* MSG_ReadEntityNumberBits
+*
+* Returns the entity number, 0 at the end of the list, and the header bits
+*/
+int MSG_ReadEntityNumberBits( msg_t *msg, int lastnum, unsigned *bits )
+{
+	unsigned i, gap, total;
+
+	*bits = 0;
+
+	gap = MSG_ReadVarBits( msg );
+	if( !gap )
+		return 0;
+
+	if( MSG_ReadBits( msg, 1 ) )
+	{
+		*bits = U_REMOVE;
+		return lastnum + gap;
+	}
+
+	total = MSG_ReadBits( msg, 6 );
+	if( MSG_ReadBits( msg, 1 ) )
+	{
+		for( i = 0; i < MSG_NUM_ENTITYBITS_HIGH; i++ )
+		{
+			if( MSG_ReadBits( msg, 1 ) )
+				total |= msg_entitybits_high[i];
+		}
+	}
+
+	*bits = total;
+
+	return lastnum + gap;
+}
+
+/*
+* MSG_ReadDeltaEntityBits
+*
+* Bit-packed counterpart of MSG_ReadDeltaEntity
+*/
+void MSG_ReadDeltaEntityBits( msg_t *msg, entity_state_t *from, entity_state_t *to, int number, unsigned bits )
+{
+	int i;
+	bool delta;
+
+	// set everything to the state we are delta'ing from
+	*to = *from;
+
+	to->number = number;
+
+	if( bits & U_TYPE )
+	{
+		uint8_t ttype;
+		ttype = (uint8_t)MSG_ReadBits( msg, 8 );
+		to->type = ttype & ~ET_INVERSE;
+		to->linearMovement = ( ttype & ET_INVERSE ) ? true : false;
+	}
+
+	if( bits & U_SOLID )
+		to->solid = (short)MSG_ReadBits( msg, 16 );
+
+	if( bits & U_MODEL )
+		to->modelindex = (short)MSG_ReadBits( msg, 16 );
+	if( bits & U_MODEL2 )
+		to->modelindex2 = (short)MSG_ReadBits( msg, 16 );
+
+	if( bits & U_FRAME8 )
+		to->frame = (uint8_t)MSG_ReadBits( msg, 8 );
+	if( bits & U_FRAME16 )
+		to->frame = (short)MSG_ReadBits( msg, 16 );
+
+	if( ( bits & U_SKIN8 ) && ( bits & U_SKIN16 ) )
+		to->skinnum = (int)MSG_ReadBits( msg, 32 );
+	else if( bits & U_SKIN8 )
+		to->skinnum = (uint8_t)MSG_ReadBits( msg, 8 );
+	else if( bits & U_SKIN16 )
+		to->skinnum = (short)MSG_ReadBits( msg, 16 );
+
+	if( ( bits & ( U_EFFECTS8|U_EFFECTS16 ) ) == ( U_EFFECTS8|U_EFFECTS16 ) )
+		to->effects = (int)MSG_ReadBits( msg, 32 );
+	else if( bits & U_EFFECTS8 )
+		to->effects = (uint8_t)MSG_ReadBits( msg, 8 );
+	else if( bits & U_EFFECTS16 )
+		to->effects = (short)MSG_ReadBits( msg, 16 );
+
+	if( to->linearMovement )
+	{
+		for( i = 0; i < 3; i++ )
+		{
+			if( bits & ( U_ORIGIN1<<i ) )
+				to->linearMovementVelocity[i] = MSG_ReadCoordBits( msg, from->linearMovementVelocity[i], false );
+		}
+	}
+	else
+	{
+		delta = !from->linearMovement;
+		for( i = 0; i < 3; i++ )
+		{
+			if( bits & ( U_ORIGIN1<<i ) )
+				to->origin[i] = MSG_ReadCoordBits( msg, from->origin[i], delta );
+		}
+	}
+
+	if( ( bits & U_ANGLE1 ) && ( to->solid == SOLID_BMODEL ) )
+		to->angles[0] = SHORT2ANGLE( (short)MSG_ReadBits( msg, 16 ) );
+	else if( bits & U_ANGLE1 )
+		to->angles[0] = BYTE2ANGLE( (uint8_t)MSG_ReadBits( msg, 8 ) );
+
+	if( ( bits & U_ANGLE2 ) && ( to->solid == SOLID_BMODEL ) )
+		to->angles[1] = SHORT2ANGLE( (short)MSG_ReadBits( msg, 16 ) );
+	else if( bits & U_ANGLE2 )
+		to->angles[1] = BYTE2ANGLE( (uint8_t)MSG_ReadBits( msg, 8 ) );
+
+	if( ( bits & U_ANGLE3 ) && ( to->solid == SOLID_BMODEL ) )
+		to->angles[2] = SHORT2ANGLE( (short)MSG_ReadBits( msg, 16 ) );
+	else if( bits & U_ANGLE3 )
+		to->angles[2] = BYTE2ANGLE( (uint8_t)MSG_ReadBits( msg, 8 ) );
+
+	if( bits & U_OTHERORIGIN )
+	{
+		for( i = 0; i < 3; i++ )
+			to->origin2[i] = MSG_ReadCoordBits( msg, 0, false );
+	}
+
+	if( bits & U_SOUND )
+		to->sound = (uint8_t)MSG_ReadBits( msg, 8 );
+
+	if( bits & U_EVENT )
+	{
+		to->events[0] = MSG_ReadBits( msg, 7 );
+		to->eventParms[0] = MSG_ReadBits( msg, 1 ) ? (uint8_t)MSG_ReadBits( msg, 8 ) : 0;
+	}
+	else
+	{
+		to->events[0] = 0;
+		to->eventParms[0] = 0;
+	}
+
+	if( bits & U_EVENT2 )
+	{
+		to->events[1] = MSG_ReadBits( msg, 7 );
+		to->eventParms[1] = MSG_ReadBits( msg, 1 ) ? (uint8_t)MSG_ReadBits( msg, 8 ) : 0;
+	}
+	else
+	{
+		to->events[1] = 0;
+		to->eventParms[1] = 0;
+	}
+
+	if( bits & U_ATTENUATION )
+		to->attenuation = (float)MSG_ReadBits( msg, 8 ) / 16.0;
+
+	if( bits & U_WEAPON )
+	{
+		to->weapon = MSG_ReadBits( msg, 7 );
+		to->teleported = MSG_ReadBits( msg, 1 ) ? true : false;
+	}
+
+	if( bits & U_SVFLAGS )
+		to->svflags = (short)MSG_ReadBits( msg, 16 );
+
+	if( bits & U_LIGHT )
+	{
+		if( to->linearMovement )
+			to->linearMovementTimeStamp = MSG_ReadBits( msg, 32 );
+		else
+			to->light = (int)MSG_ReadBits( msg, 32 );
+	}
+
+	if( bits & U_TEAM )
+		to->team = (uint8_t)MSG_ReadBits( msg, 8 );
+}
+
 
 void MSG_WriteDeltaUsercmd( msg_t *buf, usercmd_t *from, usercmd_t *cmd )
 {
@@ -18,9 +18,14 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 */
 
+#if defined( __linux__ ) && !defined( _GNU_SOURCE )
+#define _GNU_SOURCE		// recvmmsg, sendmmsg
+#endif
+
 #include "qcommon.h"
 
 #include "sys_net.h"
+#include "sys_threads.h"
 
 #ifdef _WIN32
 #include "../win32/winquake.h"
@@ -33,6 +38,12 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/time.h>
+#ifdef __linux__
+#include <errno.h>
+#include <sys/epoll.h>
+#define NET_USE_EPOLL
+#define NET_USE_MMSG
+#endif
 #endif
 
 #define	MAX_LOOPBACK	4
@@ -66,6 +77,32 @@ typedef struct
 static loopback_t loopbacks[2];
 static char errorstring[MAX_PRINTMSG];
 static bool	net_initialized = false;
+static unsigned int net_socket_serial;
+
+#ifdef NET_USE_MMSG
+#define NET_MAX_SENDBATCH	64
+
+typedef struct
+{
+	socket_handle_t handle;
+	struct sockaddr_storage addr;
+	socklen_t addrlen;
+	size_t length;
+	uint8_t data[MAX_PACKETLEN];
+} net_batchpacket_t;
+
+// the queue belongs to one thread at a time, the others keep sending right away
+#ifdef ATTRIBUTE_THREAD_LOCAL
+static ATTRIBUTE_THREAD_LOCAL bool net_sendbatching;
+#else
+static bool net_sendbatching;
+#endif
+static volatile int net_sendbatchowned;
+static int net_numbatchpackets;
+static net_batchpacket_t net_batchpackets[NET_MAX_SENDBATCH];
+
+static void NET_FlushSendBatch( void );
+#endif
 
 #define MAX_IPS 16
 static int numIP;
@@ -399,6 +436,28 @@ static bool NET_UDP_SendPacket( const socket_t *socket, const void *data, size_t
 		return false;
 
 	addrlen = ( addr.ss_family == AF_INET6 ? sizeof( struct sockaddr_in6 ) : sizeof( struct sockaddr_in ) );
+
+#ifdef NET_USE_MMSG
+	if( net_sendbatching )
+	{
+		net_batchpacket_t *packet;
+
+		if( net_numbatchpackets == NET_MAX_SENDBATCH || length > MAX_PACKETLEN )
+			NET_FlushSendBatch();
+
+		if( length <= MAX_PACKETLEN )
+		{
+			packet = &net_batchpackets[net_numbatchpackets++];
+			packet->handle = socket->handle;
+			packet->addr = addr;
+			packet->addrlen = addrlen;
+			packet->length = length;
+			memcpy( packet->data, data, length );
+			return true;
+		}
+	}
+#endif
+
 	if( sendto( socket->handle, data, length, 0, (struct sockaddr *)&addr, addrlen ) == SOCKET_ERROR )
 	{
 		NET_SetErrorStringFromLastError( "sendto" );
@@ -487,6 +546,7 @@ static bool NET_IP_OpenSocket( socket_t *sock, const netadr_t *address, socket_t
 	sock->address = *address;
 	sock->server = server;
 	sock->handle = newsocket;
+	sock->serial = ++net_socket_serial;
 
 	return true;
 }
@@ -501,6 +561,12 @@ static void NET_UDP_CloseSocket( socket_t *socket )
 	if( !socket->open )
 		return;
 
+#ifdef NET_USE_MMSG
+	// don't let queued packets go out through a recycled handle
+	if( net_sendbatching && net_numbatchpackets )
+		NET_FlushSendBatch();
+#endif
+
 	Sys_NET_SocketClose( socket->handle );
 	socket->handle = 0;
 	socket->open = false;
@@ -789,6 +855,7 @@ static int NET_TCP_Accept( const socket_t *socket, socket_t *newsocket, netadr_t
 	newsocket->address = socket->address;
 	newsocket->remoteAddress = *address;
 	newsocket->handle = handle;
+	newsocket->serial = ++net_socket_serial;
 
 	return 1;
 }
@@ -1011,6 +1078,205 @@ int NET_GetPacket( const socket_t *socket, netadr_t *address, msg_t *message )
 	}
 }
 
+#ifdef NET_USE_MMSG
+/*
+* NET_UDP_GetPackets
+*/
+static int NET_UDP_GetPackets( const socket_t *socket, netadr_t *addresses, msg_t *messages, int count )
+{
+	struct mmsghdr hdrs[NET_MAX_RECVBATCH];
+	struct iovec iovs[NET_MAX_RECVBATCH];
+	struct sockaddr_storage from[NET_MAX_RECVBATCH];
+	int i, ret, numpackets;
+
+	assert( socket && socket->open && socket->type == SOCKET_UDP );
+
+	if( count > NET_MAX_RECVBATCH )
+		count = NET_MAX_RECVBATCH;
+
+	do
+	{
+		for( i = 0; i < count; i++ )
+		{
+			assert( messages[i].data );
+			assert( messages[i].maxsize > 0 );
+
+			iovs[i].iov_base = messages[i].data;
+			iovs[i].iov_len = messages[i].maxsize;
+			memset( &hdrs[i], 0, sizeof( hdrs[i] ) );
+			hdrs[i].msg_hdr.msg_name = &from[i];
+			hdrs[i].msg_hdr.msg_namelen = sizeof( from[i] );
+			hdrs[i].msg_hdr.msg_iov = &iovs[i];
+			hdrs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		ret = recvmmsg( socket->handle, hdrs, count, MSG_DONTWAIT, NULL );
+		if( ret == SOCKET_ERROR )
+		{
+			net_error_t err;
+
+			NET_SetErrorStringFromLastError( "recvmmsg" );
+
+			err = Sys_NET_GetLastError();
+			if( err == NET_ERR_WOULDBLOCK || err == NET_ERR_CONNRESET )  // would block
+				return 0;
+
+			return -1;
+		}
+
+		// compact the valid packets to the front, dropping the ones
+		// NET_UDP_GetPacket would have reported as errors
+		numpackets = 0;
+		for( i = 0; i < ret; i++ )
+		{
+			if( hdrs[i].msg_len == messages[i].maxsize || ( hdrs[i].msg_hdr.msg_flags & MSG_TRUNC ) )
+			{
+				Com_DPrintf( "NET_GetPackets: Oversized packet\n" );
+				continue;
+			}
+			if( !SockaddressToAddress( (struct sockaddr *)&from[i], &addresses[numpackets] ) )
+				continue;
+
+			if( numpackets != i )
+				memcpy( messages[numpackets].data, messages[i].data, hdrs[i].msg_len );
+			messages[numpackets].readcount = 0;
+			messages[numpackets].cursize = hdrs[i].msg_len;
+			numpackets++;
+		}
+	} while( ret > 0 && !numpackets );
+
+	return numpackets;
+}
+#endif
+
+/*
+* NET_GetPackets
+*
+* Receives up to count packets in one go, using a single system call where
+* the platform allows it. Returns the number of packets read, 0 if none
+* were ready, or -1 on error.
+*/
+int NET_GetPackets( const socket_t *socket, netadr_t *addresses, msg_t *messages, int count )
+{
+	int i, ret;
+
+	assert( socket->open );
+	assert( count > 0 );
+
+	if( !socket->open )
+		return -1;
+
+#ifdef NET_USE_MMSG
+	if( socket->type == SOCKET_UDP )
+		return NET_UDP_GetPackets( socket, addresses, messages, count );
+#endif
+
+	for( i = 0; i < count; i++ )
+	{
+		ret = NET_GetPacket( socket, &addresses[i], &messages[i] );
+		if( ret == 0 )
+			break;
+		if( ret == -1 )
+		{
+			if( !i )
+				return -1;
+			Com_DPrintf( "NET_GetPacket: Error: %s\n", NET_ErrorString() );
+			break;
+		}
+	}
+
+	return i;
+}
+
+#ifdef NET_USE_MMSG
+/*
+* NET_FlushSendBatch
+*
+* Sends the queued packets, one sendmmsg call per run of packets
+* going out through the same socket.
+*/
+static void NET_FlushSendBatch( void )
+{
+	struct mmsghdr hdrs[NET_MAX_SENDBATCH];
+	struct iovec iovs[NET_MAX_SENDBATCH];
+	net_batchpacket_t *packet;
+	int i, first, last, ret;
+
+	for( i = 0; i < net_numbatchpackets; i++ )
+	{
+		packet = &net_batchpackets[i];
+		iovs[i].iov_base = packet->data;
+		iovs[i].iov_len = packet->length;
+		memset( &hdrs[i], 0, sizeof( hdrs[i] ) );
+		hdrs[i].msg_hdr.msg_name = &packet->addr;
+		hdrs[i].msg_hdr.msg_namelen = packet->addrlen;
+		hdrs[i].msg_hdr.msg_iov = &iovs[i];
+		hdrs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	for( first = 0; first < net_numbatchpackets; first = last )
+	{
+		for( last = first + 1; last < net_numbatchpackets; last++ )
+		{
+			if( net_batchpackets[last].handle != net_batchpackets[first].handle )
+				break;
+		}
+
+		while( first < last )
+		{
+			ret = sendmmsg( net_batchpackets[first].handle, &hdrs[first], last - first, 0 );
+			if( ret == SOCKET_ERROR )
+			{
+				if( errno == EINTR )
+					continue;
+
+				// the packet is lost, just like a failed sendto on an unreliable socket
+				NET_SetErrorStringFromLastError( "sendmmsg" );
+				Com_DPrintf( "NET_SendPacket: Error: %s\n", NET_ErrorString() );
+				ret = 1;
+			}
+			first += ret;
+		}
+	}
+
+	net_numbatchpackets = 0;
+}
+#endif
+
+/*
+* NET_BeginSendBatch
+*
+* Queues UDP packets passed to NET_SendPacket until NET_EndSendBatch,
+* so they can go out in a single system call where the platform allows it.
+* Errors on queued packets are only reported to the developer console.
+* Must be paired with NET_EndSendBatch in the same function, before
+* waiting for packets. While another thread is batching, packets are
+* sent right away as usual.
+*/
+void NET_BeginSendBatch( void )
+{
+#ifdef NET_USE_MMSG
+	assert( !net_sendbatching );
+	if( !Sys_Atomic_CAS( &net_sendbatchowned, 0, 1, NULL ) )
+		return;
+	net_sendbatching = true;
+#endif
+}
+
+/*
+* NET_EndSendBatch
+*/
+void NET_EndSendBatch( void )
+{
+#ifdef NET_USE_MMSG
+	if( !net_sendbatching )
+		return;
+	NET_FlushSendBatch();
+	net_sendbatching = false;
+	Sys_Atomic_CAS( &net_sendbatchowned, 1, 0, NULL );
+#endif
+}
+
 /*
 * NET_Get
 * 
@@ -1832,16 +2098,9 @@ void NET_Sleep( int msec, socket_t *sockets[] )
 }
 
 /*
-* NET_Monitor
-* Monitors the given sockets with the given timeout in milliseconds
-* It ignores closed and loopback sockets.
-* Calls the callback function read_cb(socket_t *) with the socket as parameter when incoming data was detected on it
-* Calls the callback function write_cb(socket_t *) with the socket as parameter when the socket is ready to accept outgoing data
-* Calls the callback function exception_cb(socket_t *) with the socket as parameter when a socket exception was detected on that socket
-* For both callbacks, NULL can be passed. When NULL is passed for the exception_cb, no exception detection is performed
-* Incoming data is always detected, even if the 'read_cb' callback was NULL.
+* NET_SelectMonitor
 */
-int NET_Monitor( int msec, socket_t *sockets[], void (*read_cb)(socket_t *, void*), void (*write_cb)(socket_t *, void*), void (*exception_cb)(socket_t *, void*), void *privatep[] )
+static int NET_SelectMonitor( int msec, socket_t *sockets[], void (*read_cb)(socket_t *, void*), void (*write_cb)(socket_t *, void*), void (*exception_cb)(socket_t *, void*), void *privatep[] )
 {
 	struct timeval timeout;
 	fd_set fdsetr, fdsetw, fdsete;
@@ -1919,6 +2178,293 @@ int NET_Monitor( int msec, socket_t *sockets[], void (*read_cb)(socket_t *, void
 	return ret;
 }
 
+#define NET_MONITOR_MAX_EVENTS		64
+
+// allocated once per socket handle and never moved, so epoll hands it back in data.ptr
+typedef struct
+{
+	int fd;
+	unsigned int serial;		// serial of the socket registered on this handle, 0 if none
+	unsigned int events;		// registered event mask
+	unsigned int seen;			// generation of the last NET_Monitor call the handle was passed to
+	int index;					// index into the sockets array of that call
+	int slot;					// index into the registered array while serial is set
+} net_monitor_handle_t;
+
+struct net_monitor_s
+{
+	int epfd;					// -1 when falling back to select
+
+#ifdef NET_USE_EPOLL
+	unsigned int generation;
+	int numhandles;
+	net_monitor_handle_t **handles;		// indexed by socket handle
+	int numregistered;
+	net_monitor_handle_t **registered;	// handles in the interest set, numhandles of them at most
+	struct epoll_event events[NET_MONITOR_MAX_EVENTS];
+#endif
+};
+
+/*
+* NET_CreateMonitor
+*
+* Monitors keep their interest set between NET_Monitor calls, so
+* they must be owned and used by a single thread.
+*/
+net_monitor_t *NET_CreateMonitor( void )
+{
+	net_monitor_t *monitor;
+
+	monitor = Q_malloc( sizeof( *monitor ) );
+	memset( monitor, 0, sizeof( *monitor ) );
+	monitor->epfd = -1;
+
+#ifdef NET_USE_EPOLL
+	monitor->epfd = epoll_create1( EPOLL_CLOEXEC );
+	if( monitor->epfd < 0 ) {
+		Com_Printf( "NET_CreateMonitor: epoll_create1 failed (%s), falling back to select\n", GetLastErrorString() );
+	}
+#endif
+
+	return monitor;
+}
+
+/*
+* NET_DestroyMonitor
+*/
+void NET_DestroyMonitor( net_monitor_t **pmonitor )
+{
+	net_monitor_t *monitor;
+
+	if( !pmonitor || !*pmonitor ) {
+		return;
+	}
+
+	monitor = *pmonitor;
+#ifdef NET_USE_EPOLL
+	if( monitor->epfd >= 0 ) {
+		close( monitor->epfd );
+	}
+	if( monitor->handles ) {
+		int i;
+
+		for( i = 0; i < monitor->numhandles; i++ ) {
+			if( monitor->handles[i] ) {
+				Q_free( monitor->handles[i] );
+			}
+		}
+		Q_free( monitor->handles );
+		Q_free( monitor->registered );
+	}
+#endif
+	Q_free( monitor );
+
+	*pmonitor = NULL;
+}
+
+#ifdef NET_USE_EPOLL
+
+/*
+* NET_EpollUnregister
+*/
+static void NET_EpollUnregister( net_monitor_t *monitor, net_monitor_handle_t *h )
+{
+	net_monitor_handle_t *last;
+
+	if( !h->serial ) {
+		return;
+	}
+
+	last = monitor->registered[--monitor->numregistered];
+	monitor->registered[h->slot] = last;
+	last->slot = h->slot;
+
+	h->serial = 0;
+	h->events = 0;
+}
+
+/*
+* NET_EpollRegister
+*
+* Adds the socket to the interest set or updates its event mask. A handle
+* that comes back with a different serial belongs to a new socket: the kernel
+* dropped the old registration when the previous socket was closed.
+*/
+static bool NET_EpollRegister( net_monitor_t *monitor, const socket_t *socket, unsigned int events )
+{
+	int fd = (int)socket->handle;
+	net_monitor_handle_t *h;
+	struct epoll_event ev;
+	int op;
+
+	if( fd >= monitor->numhandles ) {
+		int newsize = max( fd + 1, monitor->numhandles * 2 );
+		monitor->handles = Q_realloc( monitor->handles, newsize * sizeof( *monitor->handles ) );
+		memset( monitor->handles + monitor->numhandles, 0, ( newsize - monitor->numhandles ) * sizeof( *monitor->handles ) );
+		monitor->registered = Q_realloc( monitor->registered, newsize * sizeof( *monitor->registered ) );
+		monitor->numhandles = newsize;
+	}
+
+	h = monitor->handles[fd];
+	if( !h ) {
+		h = Q_malloc( sizeof( *h ) );
+		memset( h, 0, sizeof( *h ) );
+		h->fd = fd;
+		monitor->handles[fd] = h;
+	}
+
+	if( h->serial == socket->serial && h->events == events ) {
+		return true;
+	}
+
+	memset( &ev, 0, sizeof( ev ) );
+	ev.events = events;
+	ev.data.ptr = h;
+
+	op = h->serial == socket->serial ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+	if( epoll_ctl( monitor->epfd, op, fd, &ev ) < 0 ) {
+		if( op == EPOLL_CTL_MOD && errno == ENOENT ) {
+			op = EPOLL_CTL_ADD;
+		} else if( op == EPOLL_CTL_ADD && errno == EEXIST ) {
+			op = EPOLL_CTL_MOD;
+		} else {
+			NET_EpollUnregister( monitor, h );
+			return false;
+		}
+
+		if( epoll_ctl( monitor->epfd, op, fd, &ev ) < 0 ) {
+			NET_EpollUnregister( monitor, h );
+			return false;
+		}
+	}
+
+	if( !h->serial ) {
+		h->slot = monitor->numregistered;
+		monitor->registered[monitor->numregistered++] = h;
+	}
+	h->serial = socket->serial;
+	h->events = events;
+	return true;
+}
+
+/*
+* NET_EpollMonitor
+*/
+static int NET_EpollMonitor( net_monitor_t *monitor, int msec, socket_t *sockets[], void (*read_cb)(socket_t *, void*), void (*write_cb)(socket_t *, void*), void (*exception_cb)(socket_t *, void*), void *privatep[] )
+{
+	int i, ret;
+	unsigned int events;
+	net_monitor_handle_t *h;
+
+	events = EPOLLIN;
+	if( write_cb )
+		events |= EPOLLOUT;
+	if( exception_cb )
+		events |= EPOLLPRI;
+
+	monitor->generation++;
+	if( !monitor->generation )
+		monitor->generation++;
+
+	for( i = 0; sockets[i]; i++ )
+	{
+		if( !sockets[i]->open )
+			continue;
+
+		switch( sockets[i]->type )
+		{
+		case SOCKET_UDP:
+#ifdef TCP_SUPPORT
+		case SOCKET_TCP:
+#endif
+			assert( sockets[i]->handle > 0 );
+			if( !NET_EpollRegister( monitor, sockets[i], events ) ) {
+				Com_DPrintf( "NET_Monitor: epoll_ctl failed on %s: %s\n", NET_SocketToString( sockets[i] ), GetLastErrorString() );
+				continue;
+			}
+			h = monitor->handles[sockets[i]->handle];
+			h->seen = monitor->generation;
+			h->index = i;
+			break;
+		case SOCKET_LOOPBACK:
+		default:
+			continue;
+		}
+	}
+
+	// drop handles that were not passed this time, if they are still
+	// registered at all (closing a socket removes it from the set)
+	for( i = 0; i < monitor->numregistered; )
+	{
+		h = monitor->registered[i];
+		if( h->seen != monitor->generation ) {
+			epoll_ctl( monitor->epfd, EPOLL_CTL_DEL, h->fd, NULL );
+			NET_EpollUnregister( monitor, h );
+			continue;
+		}
+		i++;
+	}
+
+	ret = epoll_wait( monitor->epfd, monitor->events, NET_MONITOR_MAX_EVENTS, msec );
+	if( ret <= 0 || !( read_cb || write_cb || exception_cb ) ) {
+		return ret;
+	}
+
+	// launch callbacks, same order as the select path
+	for( i = 0; i < ret; i++ )
+	{
+		socket_t *socket;
+		void *priv;
+		unsigned int revents = monitor->events[i].events;
+
+		h = monitor->events[i].data.ptr;
+		if( !h->serial || h->seen != monitor->generation )
+			continue;
+
+		socket = sockets[h->index];
+		priv = privatep ? privatep[h->index] : NULL;
+
+		if( exception_cb && ( revents & EPOLLPRI ) ) {
+			exception_cb( socket, priv );
+		}
+		if( read_cb && ( revents & ( EPOLLIN|EPOLLERR|EPOLLHUP ) ) ) {
+			read_cb( socket, priv );
+		}
+		if( write_cb && ( revents & ( EPOLLOUT|EPOLLERR ) ) ) {
+			write_cb( socket, priv );
+		}
+	}
+
+	return ret;
+}
+
+#endif // NET_USE_EPOLL
+
+/*
+* NET_Monitor
+* Monitors the given sockets with the given timeout in milliseconds
+* It ignores closed and loopback sockets.
+* Calls the callback function read_cb(socket_t *) with the socket as parameter when incoming data was detected on it
+* Calls the callback function write_cb(socket_t *) with the socket as parameter when the socket is ready to accept outgoing data
+* Calls the callback function exception_cb(socket_t *) with the socket as parameter when a socket exception was detected on that socket
+* For both callbacks, NULL can be passed. When NULL is passed for the exception_cb, no exception detection is performed
+* Incoming data is always detected, even if the 'read_cb' callback was NULL.
+* When a monitor created with NET_CreateMonitor is passed, the sockets are kept in a persistent
+* epoll interest set on Linux instead of rebuilding a select set on every call.
+*/
+int NET_Monitor( net_monitor_t *monitor, int msec, socket_t *sockets[], void (*read_cb)(socket_t *, void*), void (*write_cb)(socket_t *, void*), void (*exception_cb)(socket_t *, void*), void *privatep[] )
+{
+	if( !sockets || !sockets[0] )
+		return 0;
+
+#ifdef NET_USE_EPOLL
+	if( monitor && monitor->epfd >= 0 )
+		return NET_EpollMonitor( monitor, msec, sockets, read_cb, write_cb, exception_cb, privatep );
+#endif
+
+	return NET_SelectMonitor( msec, sockets, read_cb, write_cb, exception_cb, privatep );
+}
+
 /*
 * NET_SendFile
 */
@@ -131,6 +131,7 @@ void Netchan_OutOfBandPrint( const socket_t *socket, const netadr_t *address, co
 */
 void Netchan_Setup( netchan_t *chan, const socket_t *socket, const netadr_t *address, int game_port )
 {
+	Netchan_Release( chan );
 	memset( chan, 0, sizeof( *chan ) );
 
 	chan->socket = socket;
@@ -141,7 +142,13 @@ void Netchan_Setup( netchan_t *chan, const socket_t *socket, const netadr_t *add
 }
 
 
+// messages may be compressed on several threads at once, so each gets its own buffer
+// and zlib streams, which are released by calling Netchan_Shutdown from that thread
+#ifdef ATTRIBUTE_THREAD_LOCAL
+static ATTRIBUTE_THREAD_LOCAL uint8_t msg_process_data[MAX_MSGLEN];
+#else
 static uint8_t msg_process_data[MAX_MSGLEN];
+#endif
 
 //=============================================================
 // Zlib compression
@@ -213,31 +220,319 @@ static int Netchan_ZLibDecompressChunk( const uint8_t *source, unsigned long sou
 	return result;
 }
 
+/*
+=============================================================================
+
+Dictionary compression
+
+Consecutive messages, snapshots in particular, are very much alike. When
+the remote end asks for it, each message is deflated with the last message
+it has acknowledged as preset dictionary. Both ends keep the recent messages
+in a ring indexed by sequence, and the zlib header carries the adler32 of
+the dictionary, so the receiver can find it without any change to the
+packet header. A message is only used as dictionary while the receiver's
+ring can't have wrapped over it. A receiver failing to decompress a message
+drops it like any other bad packet, keeps acknowledging the last message it
+could decompress and asks again for compression, the sender then only uses
+the messages it sends from there on, so an undecodable message only costs
+the messages that were already in flight.
+
+=============================================================================
+*/
+
+#ifdef ATTRIBUTE_THREAD_LOCAL
+static ATTRIBUTE_THREAD_LOCAL z_stream netchan_deflate_stream;
+static ATTRIBUTE_THREAD_LOCAL z_stream netchan_inflate_stream;
+static ATTRIBUTE_THREAD_LOCAL bool netchan_deflate_init;
+static ATTRIBUTE_THREAD_LOCAL bool netchan_inflate_init;
+#else
+static z_stream netchan_deflate_stream;
+static z_stream netchan_inflate_stream;
+static bool netchan_deflate_init;
+static bool netchan_inflate_init;
+#endif
+
+/*
+* Netchan_StoreDict
+*/
+static void Netchan_StoreDict( netchan_dict_t *dicts, int sequence, const uint8_t *data, size_t length )
+{
+	netchan_dict_t *dict = &dicts[sequence & ( NETCHAN_DICT_SLOTS - 1 )];
+
+	if( length > NETCHAN_DICT_SIZE )
+		length = NETCHAN_DICT_SIZE;
+
+	dict->sequence = sequence;
+	dict->length = length;
+	memcpy( dict->data, data, length );
+	dict->adler = qzadler32( qzadler32( 0L, Z_NULL, 0 ), dict->data, length );
+}
+
+/*
+* Netchan_Release
+* 
+* Frees what the channel allocated, it must have been set up before or zeroed
+*/
+void Netchan_Release( netchan_t *chan )
+{
+	if( chan->sentDicts )
+	{
+		Mem_ZoneFree( chan->sentDicts );
+		chan->sentDicts = NULL;
+	}
+	if( chan->receivedDicts )
+	{
+		Mem_ZoneFree( chan->receivedDicts );
+		chan->receivedDicts = NULL;
+	}
+	chan->compressDict = false;
+	chan->decompressDict = false;
+}
+
+/*
+* Netchan_SetCompressDict
+* 
+* Most channels never compress against previous messages, so the ring of
+* sent messages is only allocated when the remote end first asks for it
+*/
+void Netchan_SetCompressDict( netchan_t *chan, bool enable )
+{
+	if( enable && !chan->sentDicts )
+		chan->sentDicts = Mem_ZoneMalloc( sizeof( netchan_dict_t ) * NETCHAN_DICT_SLOTS );
+	chan->compressDict = enable;
+}
+
+/*
+* Netchan_SetDecompressDict
+*/
+void Netchan_SetDecompressDict( netchan_t *chan, bool enable )
+{
+	if( enable && !chan->receivedDicts )
+		chan->receivedDicts = Mem_ZoneMalloc( sizeof( netchan_dict_t ) * NETCHAN_DICT_SLOTS );
+	chan->decompressDict = enable;
+}
+
+/*
+* Netchan_AckSequence
+* 
+* The incoming sequence written in the header. Messages which failed to
+* decompress are not acknowledged, so they're never used as dictionary.
+*/
+static int Netchan_AckSequence( const netchan_t *chan )
+{
+	return chan->decompressDict ? chan->decodedSequence : chan->incomingSequence;
+}
+
+/*
+* Netchan_AckedDict
+*
+* Returns the last message acknowledged by the remote end, if it's still usable
+*/
+static const netchan_dict_t *Netchan_AckedDict( const netchan_t *chan )
+{
+	int sequence = chan->incoming_acknowledged;
+	const netchan_dict_t *dict = &chan->sentDicts[sequence & ( NETCHAN_DICT_SLOTS - 1 )];
+
+	if( sequence <= 0 || sequence < chan->dictStartSequence || dict->sequence != sequence || !dict->length )
+		return NULL;
+
+	// the remote end may have received enough messages since to overwrite it
+	if( chan->outgoingSequence - sequence >= NETCHAN_DICT_SLOTS )
+		return NULL;
+
+	return dict;
+}
+
+/*
+* Netchan_FindReceivedDict
+*/
+static const netchan_dict_t *Netchan_FindReceivedDict( const netchan_t *chan, unsigned adler )
+{
+	int i;
+	const netchan_dict_t *dict;
+
+	for( i = 0; i < NETCHAN_DICT_SLOTS; i++ )
+	{
+		dict = &chan->receivedDicts[i];
+		if( dict->sequence > 0 && dict->length && dict->adler == adler )
+			return dict;
+	}
+
+	return NULL;
+}
+
+/*
+* Netchan_ZLibCompressChunkDict
+*/
+static int Netchan_ZLibCompressChunkDict( const uint8_t *source, unsigned long sourceLen, uint8_t *dest, unsigned long destLen,
+										 int level, const netchan_dict_t *dict )
+{
+	int zlerror;
+	z_stream *strm = &netchan_deflate_stream;
+
+	if( !netchan_deflate_init )
+	{
+		memset( strm, 0, sizeof( *strm ) );
+		zlerror = qzdeflateInit2( strm, level, Z_DEFLATED, MAX_WBITS, 8, Z_DEFAULT_STRATEGY );
+		if( zlerror != Z_OK )
+		{
+			Com_DPrintf( "ZLib data error! Error code %i on deflateInit.\n", zlerror );
+			return -1;
+		}
+		netchan_deflate_init = true;
+	}
+	else
+	{
+		qzdeflateReset( strm );
+	}
+
+	zlerror = qzdeflateSetDictionary( strm, dict->data, dict->length );
+	if( zlerror != Z_OK )
+	{
+		Com_DPrintf( "ZLib data error! Error code %i on deflateSetDictionary.\n", zlerror );
+		return -1;
+	}
+
+	strm->next_in = ( Bytef * )source;
+	strm->avail_in = sourceLen;
+	strm->next_out = dest;
+	strm->avail_out = destLen;
+
+	zlerror = qzdeflate( strm, Z_FINISH );
+	if( zlerror != Z_STREAM_END )
+	{
+		Com_DPrintf( "ZLib data error! Error code %i on compress.\n", zlerror );
+		return -1;
+	}
+
+	return destLen - strm->avail_out;
+}
+
+/*
+* Netchan_ZLibDecompressChunkDict
+*
+* Decompresses messages with or without a preset dictionary
+*/
+static int Netchan_ZLibDecompressChunkDict( netchan_t *chan, const uint8_t *source, unsigned long sourceLen, uint8_t *dest, unsigned long destLen )
+{
+	int zlerror;
+	const netchan_dict_t *dict;
+	z_stream *strm = &netchan_inflate_stream;
+
+	if( !netchan_inflate_init )
+	{
+		memset( strm, 0, sizeof( *strm ) );
+		zlerror = qzinflateInit2( strm, MAX_WBITS );
+		if( zlerror != Z_OK )
+		{
+			Com_DPrintf( "ZLib data error! Error code %i on inflateInit.\n", zlerror );
+			return -1;
+		}
+		netchan_inflate_init = true;
+	}
+	else
+	{
+		qzinflateReset( strm );
+	}
+
+	strm->next_in = ( Bytef * )source;
+	strm->avail_in = sourceLen;
+	strm->next_out = dest;
+	strm->avail_out = destLen;
+
+	zlerror = qzinflate( strm, Z_FINISH );
+	if( zlerror == Z_NEED_DICT )
+	{
+		dict = Netchan_FindReceivedDict( chan, strm->adler );
+		if( !dict )
+		{
+			chan->compressStats.dictMisses++;
+			Com_DPrintf( "ZLib data error! Unknown dictionary on decompress.\n" );
+			return -1;
+		}
+
+		qzinflateSetDictionary( strm, dict->data, dict->length );
+		zlerror = qzinflate( strm, Z_FINISH );
+	}
+
+	if( zlerror != Z_STREAM_END )
+	{
+		Com_DPrintf( "ZLib data error! Error code %i on decompress.\n", zlerror );
+		return -1;
+	}
+
+	return destLen - strm->avail_out;
+}
+
 /*
 * Netchan_CompressMessage
+*
+* The channel may be NULL, otherwise it's the one the message is about to be
+* transmitted on.
 */
-int Netchan_CompressMessage( msg_t *msg )
+int Netchan_CompressMessage( netchan_t *chan, msg_t *msg )
 {
 	int length;
+	uint64_t start;
+	const netchan_dict_t *dict;
 
 	if( msg == NULL || !msg->data )
 		return 0;
 
+	start = Sys_Microseconds();
+
+	dict = NULL;
+	if( chan && chan->compressDict )
+	{
+		dict = Netchan_AckedDict( chan );
+
+		// remember what the remote end will have once it acknowledges this message
+		Netchan_StoreDict( chan->sentDicts, chan->outgoingSequence, msg->data, msg->cursize );
+	}
+
 	// zero-fill our buffer
 	length = 0;
 	memset( msg_process_data, 0, sizeof( msg_process_data ) );
 
 	//compress the message
-	length = Netchan_ZLibCompressChunk( msg->data, msg->cursize, 
-		msg_process_data, sizeof( msg_process_data ), Z_BEST_COMPRESSION, -MAX_WBITS );
-	if( length < 0 )  // failed to compress, return the error
-		return length;
+	if( dict )
+	{
+		length = Netchan_ZLibCompressChunkDict( msg->data, msg->cursize,
+			msg_process_data, sizeof( msg_process_data ), Z_BEST_COMPRESSION, dict );
+	}
+	else
+	{
+		length = Netchan_ZLibCompressChunk( msg->data, msg->cursize, 
+			msg_process_data, sizeof( msg_process_data ), Z_BEST_COMPRESSION, -MAX_WBITS );
+	}
 
-	if( (size_t)length >= msg->cursize || length >= MAX_MSGLEN )
+	if( chan )
 	{
+		chan->compressStats.usec += Sys_Microseconds() - start;
+		chan->compressStats.bytesIn += msg->cursize;
+	}
+
+	if( length < 0 || (size_t)length >= msg->cursize || length >= MAX_MSGLEN )
+	{
+		if( chan )
+		{
+			chan->compressStats.uncompressed++;
+			chan->compressStats.bytesOut += msg->cursize;
+		}
+
+		if( length < 0 )  // failed to compress, return the error
+			return length;
 		return 0; // compressed was bigger. Send uncompressed
 	}
 
+	if( chan )
+	{
+		chan->compressStats.packets++;
+		if( dict )
+			chan->compressStats.dictPackets++;
+		chan->compressStats.bytesOut += length;
+	}
+
 	//write it back into the original container
 	MSG_Clear( msg );
 	MSG_CopyData( msg, msg_process_data, length );
@@ -248,8 +543,11 @@ int Netchan_CompressMessage( msg_t *msg )
 
 /*
 * Netchan_DecompressMessage
+*
+* Must be called for every message accepted by Netchan_Process, compressed
+* or not, so the channel can keep the messages the remote end may compress against.
 */
-int Netchan_DecompressMessage( msg_t *msg )
+int Netchan_DecompressMessage( netchan_t *chan, msg_t *msg )
 {
 	int length;
 
@@ -257,16 +555,23 @@ int Netchan_DecompressMessage( msg_t *msg )
 		return 0;
 
 	if( msg->compressed == false )
-		return 0;
+	{
+		length = 0;
+		goto done;
+	}
 
-	length = Netchan_ZLibDecompressChunk( msg->data + msg->readcount, msg->cursize - msg->readcount, msg_process_data, ( sizeof( msg_process_data ) - msg->readcount ), -MAX_WBITS );
+	if( chan && chan->decompressDict )
+		length = Netchan_ZLibDecompressChunkDict( chan, msg->data + msg->readcount, msg->cursize - msg->readcount, msg_process_data, ( sizeof( msg_process_data ) - msg->readcount ) );
+	else
+		length = Netchan_ZLibDecompressChunk( msg->data + msg->readcount, msg->cursize - msg->readcount, msg_process_data, ( sizeof( msg_process_data ) - msg->readcount ), -MAX_WBITS );
 	if( length < 0 )
-		return length;
+		goto done;
 
 	if( ( msg->readcount + length ) >= msg->maxsize )
 	{
 		Com_Printf( "Netchan_DecompressMessage: Packet too big\n" );
-		return -1;
+		length = -1;
+		goto done;
 	}
 
 	//write it back into the original container
@@ -274,6 +579,22 @@ int Netchan_DecompressMessage( msg_t *msg )
 	MSG_CopyData( msg, msg_process_data, length );
 	msg->compressed = false;
 
+done:
+	if( chan )
+	{
+		if( length >= 0 )
+		{
+			chan->dictFailures = 0;
+			chan->decodedSequence = chan->incomingSequence;
+			if( chan->decompressDict )
+				Netchan_StoreDict( chan->receivedDicts, chan->incomingSequence, msg->data + msg->readcount, msg->cursize - msg->readcount );
+		}
+		else
+		{
+			chan->dictFailures++;
+		}
+	}
+
 	return length;
 }
 
@@ -314,9 +635,9 @@ bool Netchan_TransmitNextFragment( netchan_t *chan )
 	// wsw : jal : by now our header sends incoming ack too (q3 doesn't)
 	// wsw : also add compressed bit if it's compressed
 	if( chan->unsentIsCompressed )
-		MSG_WriteLong( &send, chan->incomingSequence | FRAGMENT_BIT );
+		MSG_WriteLong( &send, Netchan_AckSequence( chan ) | FRAGMENT_BIT );
 	else
-		MSG_WriteLong( &send, chan->incomingSequence );
+		MSG_WriteLong( &send, Netchan_AckSequence( chan ) );
 
 	// send the game port if we are a client
 	if( !chan->socket->server )
@@ -423,9 +744,9 @@ bool Netchan_Transmit( netchan_t *chan, msg_t *msg )
 	// wsw : jal : by now our header sends incoming ack too (q3 doesn't)
 	// wsw : jal : also add compressed information if it's compressed
 	if( msg->compressed )
-		MSG_WriteLong( &send, chan->incomingSequence | FRAGMENT_BIT );
+		MSG_WriteLong( &send, Netchan_AckSequence( chan ) | FRAGMENT_BIT );
 	else
-		MSG_WriteLong( &send, chan->incomingSequence );
+		MSG_WriteLong( &send, Netchan_AckSequence( chan ) );
 
 	chan->outgoingSequence++;
 
@@ -442,7 +763,7 @@ bool Netchan_Transmit( netchan_t *chan, msg_t *msg )
 	if( showpackets->integer )
 	{
 		Com_Printf( "%s send %4i : s=%i ack=%i\n", NET_SocketToString( chan->socket ), send.cursize,
-			chan->outgoingSequence - 1, chan->incomingSequence );
+			chan->outgoingSequence - 1, Netchan_AckSequence( chan ) );
 	}
 
 	return true;
@@ -664,7 +985,20 @@ void Netchan_Init( void )
 
 /*
 * Netchan_Shutdown
+*
+* Releases the compression state of the calling thread
 */
 void Netchan_Shutdown( void )
 {
+	if( netchan_deflate_init )
+	{
+		qzdeflateEnd( &netchan_deflate_stream );
+		netchan_deflate_init = false;
+	}
+
+	if( netchan_inflate_init )
+	{
+		qzinflateEnd( &netchan_inflate_stream );
+		netchan_inflate_init = false;
+	}
 }
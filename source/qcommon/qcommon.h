@@ -59,6 +59,8 @@ typedef struct
 	size_t cursize;
 	size_t readcount;
 	bool compressed;
+	size_t writebits;		// bit cursor of MSG_WriteBits, reset by byte writes
+	size_t readbits;		// bit cursor of MSG_ReadBits, reset by byte reads
 } msg_t;
 
 // msg.c
@@ -88,6 +90,14 @@ void MSG_WriteDeltaUsercmd( msg_t *sb, struct usercmd_s *from, struct usercmd_s
 void MSG_WriteDeltaEntity( struct entity_state_s *from, struct entity_state_s *to, msg_t *msg, bool force, bool newentity );
 void MSG_WriteDir( msg_t *sb, vec3_t vector );
 
+// bit-level IO, consecutive bit writes share bytes
+void MSG_WriteBits( msg_t *sb, unsigned value, int nbits );
+void MSG_WriteVarBits( msg_t *sb, unsigned value );
+void MSG_WriteDeltaBits( msg_t *sb, int delta );
+void MSG_WriteEntityNumberBits( msg_t *msg, int lastnum, int number, bool remove );
+bool MSG_WriteDeltaEntityBits( struct entity_state_s *from, struct entity_state_s *to, msg_t *msg, bool force, bool updateOtherOrigin );
+#define MSG_Int3( x ) ( ( ( ( x ) & 0xFFFFFF ) ^ 0x800000 ) - 0x800000 )	// sign-extends the low 24 bits like MSG_ReadInt3
+
 
 void MSG_BeginReading( msg_t *sb );
 
@@ -109,6 +119,12 @@ void MSG_ReadDeltaUsercmd( msg_t *sb, struct usercmd_s *from, struct usercmd_s *
 int MSG_ReadEntityBits( msg_t *msg, unsigned *bits );
 void MSG_ReadDeltaEntity( msg_t *msg, entity_state_t *from, entity_state_t *to, int number, unsigned bits );
 
+unsigned MSG_ReadBits( msg_t *sb, int nbits );
+unsigned MSG_ReadVarBits( msg_t *sb );
+int MSG_ReadDeltaBits( msg_t *sb );
+int MSG_ReadEntityNumberBits( msg_t *msg, int lastnum, unsigned *bits );
+void MSG_ReadDeltaEntityBits( msg_t *msg, entity_state_t *from, entity_state_t *to, int number, unsigned bits );
+
 void MSG_ReadDir( msg_t *sb, vec3_t vector );
 void MSG_ReadData( msg_t *sb, void *buffer, size_t length );
 int MSG_SkipData( msg_t *sb, size_t length );
@@ -134,25 +150,109 @@ void Com_FreePureList( purelist_t **purelist );
 
 #define SNAP_MAX_DEMO_META_DATA_SIZE	16*1024
 
+#define	MAX_SNAPSHOT_ENTITIES			1024
+
 // define this 0 to disable compression of demo files
 #define SNAP_DEMO_GZ					FS_GZ
 
 void SNAP_ParseBaseline( msg_t *msg, entity_state_t *baselines );
 void SNAP_SkipFrame( msg_t *msg, struct snapshot_s *header );
-struct snapshot_s *SNAP_ParseFrame( msg_t *msg, struct snapshot_s *lastFrame, int *suppressCount, struct snapshot_s *backup, entity_state_t *baselines, int showNet );
+struct snapshot_s *SNAP_ParseFrame( msg_t *msg, struct snapshot_s *lastFrame, int *suppressCount, struct snapshot_s *backup, entity_state_t *baselines, int showNet,
+	bool *bitpacked );
+
+struct snap_deltacache_s;
+typedef struct snap_deltacache_s snap_deltacache_t;
+
+typedef struct
+{
+	uint64_t frames;
+	uint64_t lookups;
+	uint64_t hits;
+	uint64_t overflows;				// encodings that didn't fit into the cache
+	uint64_t bytesEncoded;
+	uint64_t bytesSaved;			// bytes copied from the cache instead of being encoded
+} snap_deltacache_stats_t;
+
+snap_deltacache_t *SNAP_CreateDeltaCache( struct mempool_s *mempool );
+void SNAP_FreeDeltaCache( snap_deltacache_t **pcache );
+const snap_deltacache_stats_t *SNAP_DeltaCacheStats( const snap_deltacache_t *cache );
+void SNAP_ResetDeltaCacheStats( snap_deltacache_t *cache );
+
+struct snap_viscache_s;
+typedef struct snap_viscache_s snap_viscache_t;
+
+typedef struct
+{
+	uint64_t frames;
+	uint64_t lookups;
+	uint64_t hits;					// clients that reused the entity list of another client
+	uint64_t entitiesCulled;		// entities tested against a client's PVS
+	uint64_t entitiesReused;		// entities taken from the cache without testing
+} snap_viscache_stats_t;
+
+snap_viscache_t *SNAP_CreateVisCache( struct mempool_s *mempool );
+void SNAP_FreeVisCache( snap_viscache_t **pcache );
+const snap_viscache_stats_t *SNAP_VisCacheStats( const snap_viscache_t *cache );
+void SNAP_ResetVisCacheStats( snap_viscache_t *cache );
+
+struct snap_framecache_s;
+typedef struct snap_framecache_s snap_framecache_t;
+
+typedef struct
+{
+	uint64_t frames;
+	uint64_t lookups;
+	uint64_t hits;					// clients that were sent the frame encoded for another client
+	uint64_t overflows;				// encodings that didn't fit into the cache
+	uint64_t bytesEncoded;
+	uint64_t bytesSaved;			// bytes copied from the cache instead of being encoded
+} snap_framecache_stats_t;
+
+snap_framecache_t *SNAP_CreateFrameCache( struct mempool_s *mempool );
+void SNAP_FreeFrameCache( snap_framecache_t **pcache );
+const snap_framecache_stats_t *SNAP_FrameCacheStats( const snap_framecache_t *cache );
+void SNAP_ResetFrameCacheStats( snap_framecache_t *cache );
 
 void SNAP_WriteFrameSnapToClient( struct ginfo_s *gi, struct client_s *client, msg_t *msg, unsigned int frameNum, unsigned int gameTime,
 								 entity_state_t *baselines, struct client_entities_s *client_entities,
-								 int numcmds, gcommand_t *commands, const char *commandsData );
+								 int numcmds, gcommand_t *commands, const char *commandsData,
+								 snap_deltacache_t *deltaCache, snap_framecache_t *frameCache );
 
 void SNAP_BuildClientFrameSnap( struct cmodel_state_s *cms, struct ginfo_s *gi, unsigned int frameNum, unsigned int timeStamp,
 							   struct fatvis_s *fatvis, struct client_s *client, 
 							   game_state_t *gameState, struct client_entities_s *client_entities,
 							   bool relay, struct mempool_s *mempool );
+int SNAP_BuildClientFrameSnapList( struct cmodel_state_s *cms, struct ginfo_s *gi, unsigned int frameNum, unsigned int timeStamp,
+								  struct fatvis_s *fatvis, struct client_s *client, game_state_t *gameState,
+								  bool relay, struct mempool_s *mempool, int *snapEntities );
+int SNAP_CheckClientEntitiesList( struct cmodel_state_s *cms, struct ginfo_s *gi, unsigned int frameNum,
+								 struct fatvis_s *fatvis, struct client_s *client );
+void SNAP_DumpClientFrameSnapEntities( struct ginfo_s *gi, struct client_s *client, unsigned int frameNum,
+									  struct client_entities_s *client_entities, unsigned first_entity,
+									  const int *snapEntities, int numSnapEntities );
 
 void SNAP_FreeClientFrames( struct client_s *client );
 
 void SNAP_RecordDemoMessage( int demofile, msg_t *msg, int offset );
+
+struct snap_demowriter_s;
+typedef struct snap_demowriter_s snap_demowriter_t;
+
+typedef struct
+{
+	uint64_t messages;
+	uint64_t bytes;
+	uint64_t batches;				// writes handed over to the writer thread
+	uint64_t dropped;				// messages dropped because the writer was too far behind
+	uint64_t stalls;				// times a reliable message had to wait for the writer
+	size_t maxQueued;				// high-water mark of bytes waiting to be written
+} snap_demowriter_stats_t;
+
+snap_demowriter_t *SNAP_CreateDemoWriter( int demofile, size_t queueSize );
+void SNAP_FreeDemoWriter( snap_demowriter_t **pwriter );
+bool SNAP_WriteDemoMessage( snap_demowriter_t *writer, msg_t *msg, int offset, bool reliable );
+unsigned int SNAP_DemoWriterTell( const snap_demowriter_t *writer );
+const snap_demowriter_stats_t *SNAP_DemoWriterStats( const snap_demowriter_t *writer );
 int SNAP_ReadDemoMessage( int demofile, msg_t *msg );
 void SNAP_BeginDemoRecording( int demofile, unsigned int spawncount, unsigned int snapFrameTime, 
 								const char *sv_name, unsigned int sv_bitflags, purelist_t *purelist, 
@@ -164,6 +264,32 @@ size_t SNAP_SetDemoMetaKeyValue( char *meta_data, size_t meta_data_max_size, siz
 							  const char *key, const char *value );
 size_t SNAP_ReadDemoMetaData( int demofile, char *meta_data, size_t meta_data_size );
 
+// demo seek index, stored in the demo meta data under the "keyframes" key
+#define SNAP_MAX_DEMO_KEYFRAMES		256
+
+typedef struct
+{
+	unsigned int time;				// serverTime of the keyframe snapshot
+	unsigned int offset;			// uncompressed file offset of the first keyframe message
+} snap_demokeyframe_t;
+
+typedef struct
+{
+	unsigned int interval;			// minimum time between keyframes, doubled each time the index fills up
+	unsigned int numkeyframes;
+	snap_demokeyframe_t keyframes[SNAP_MAX_DEMO_KEYFRAMES];
+} snap_demoindex_t;
+
+void SNAP_InitDemoIndex( snap_demoindex_t *index, unsigned int interval );
+bool SNAP_DemoKeyframeDue( const snap_demoindex_t *index, unsigned int time );
+void SNAP_AddDemoKeyframe( snap_demoindex_t *index, unsigned int time, unsigned int offset );
+size_t SNAP_SetDemoMetaKeyframes( char *meta_data, size_t meta_data_max_size, size_t meta_data_realsize,
+								 const snap_demoindex_t *index );
+unsigned int SNAP_ReadDemoMetaKeyframes( const char *meta_data, size_t meta_data_realsize,
+										snap_demokeyframe_t *keyframes, unsigned int maxkeyframes );
+const snap_demokeyframe_t *SNAP_FindDemoKeyframe( const snap_demokeyframe_t *keyframes, unsigned int numkeyframes,
+												 unsigned int time );
+
 //============================================================================
 
 int COM_Argc( void );
@@ -275,11 +401,14 @@ enum clc_ops_e
 #define SV_BITFLAGS_TVSERVER		( 1<<2 )
 #define SV_BITFLAGS_HTTP			( 1<<3 )
 #define SV_BITFLAGS_HTTP_BASEURL	( 1<<4 )
+#define SV_BITFLAGS_BITPACKED		( 1<<5 )	// the server can send bit-packed snapshots, see the "bitpacking" command
+#define SV_BITFLAGS_NETDICT			( 1<<6 )	// the server can compress against acknowledged packets, see the "netdict" command
 
 // framesnap flags
 #define FRAMESNAP_FLAG_DELTA		( 1<<0 )
 #define FRAMESNAP_FLAG_ALLENTITIES	( 1<<1 )
 #define FRAMESNAP_FLAG_MULTIPOV		( 1<<2 )
+#define FRAMESNAP_FLAG_BITPACKED	( 1<<3 )	// playerinfos and packetentities are bit-packed
 
 // plyer_state_t communication
 
@@ -534,6 +663,7 @@ NET
 #define	MAX_RELIABLE_COMMANDS	64          // max string commands buffered for restransmit
 #define	MAX_PACKETLEN			1400        // max size of a network packet
 #define	MAX_MSGLEN				32768       // max length of a message, which may be fragmented into multiple packets
+#define	NET_MAX_RECVBATCH		16          // max number of packets read by a single NET_GetPackets call
 
 // wsw: Medar: doubled the MSGLEN as a temporary solution for multiview on bigger servers
 #define	FRAGMENT_SIZE			( MAX_PACKETLEN - 96 )
@@ -594,8 +724,11 @@ typedef struct
 	netadr_t remoteAddress;
 
 	socket_handle_t handle;
+	unsigned int serial;		// tells reused handles apart in socket monitors
 } socket_t;
 
+typedef struct net_monitor_s net_monitor_t;
+
 typedef enum
 {
 	CONNECTION_FAILED = -1,
@@ -629,14 +762,19 @@ int			NET_Accept( const socket_t *socket, socket_t *newsocket, netadr_t *address
 #endif
 
 int			NET_GetPacket( const socket_t *socket, netadr_t *address, msg_t *message );
+int			NET_GetPackets( const socket_t *socket, netadr_t *addresses, msg_t *messages, int count );
 bool		NET_SendPacket( const socket_t *socket, const void *data, size_t length, const netadr_t *address );
+void		NET_BeginSendBatch( void );
+void		NET_EndSendBatch( void );
 
 int			NET_Get( const socket_t *socket, netadr_t *address, void *data, size_t length );
 int         NET_Send( const socket_t *socket, const void *data, size_t length, const netadr_t *address );
 int64_t		NET_SendFile( const socket_t *socket, int file, size_t offset, size_t count, const netadr_t *address );
 
 void	    NET_Sleep( int msec, socket_t *sockets[] );
-int         NET_Monitor( int msec, socket_t *sockets[], 
+net_monitor_t *NET_CreateMonitor( void );
+void		NET_DestroyMonitor( net_monitor_t **pmonitor );
+int         NET_Monitor( net_monitor_t *monitor, int msec, socket_t *sockets[], 
 				void (*read_cb)(socket_t *socket, void*), 
 				void (*write_cb)(socket_t *socket, void*), 
 				void (*exception_cb)(socket_t *socket, void*), void *privatep[] );
@@ -664,6 +802,29 @@ void	NET_BroadcastAddress( netadr_t *address, int port );
 
 //============================================================================
 
+#define NETCHAN_DICT_SLOTS		16			// must be a power of two
+#define NETCHAN_DICT_SIZE		MAX_PACKETLEN
+
+// a recently sent or received message, usable as a preset compression dictionary
+typedef struct
+{
+	int sequence;
+	unsigned adler;
+	size_t length;
+	uint8_t data[NETCHAN_DICT_SIZE];
+} netchan_dict_t;
+
+typedef struct
+{
+	uint64_t packets;           // compressed messages
+	uint64_t dictPackets;       // compressed against a dictionary
+	uint64_t uncompressed;      // compression didn't help or failed
+	uint64_t bytesIn;           // before compression
+	uint64_t bytesOut;          // after compression
+	uint64_t usec;              // spent compressing
+	uint64_t dictMisses;        // received messages referencing an unknown dictionary
+} netchan_compress_stats_t;
+
 typedef struct
 {
 	const socket_t *socket;
@@ -691,6 +852,16 @@ typedef struct
 	uint8_t unsentBuffer[MAX_MSGLEN];
 	bool unsentIsCompressed;
 
+	// compression against the last message acknowledged by the remote end
+	bool compressDict;          // the remote end asked for it
+	bool decompressDict;        // keep received messages, the remote end may compress against them
+	int dictStartSequence;      // only messages sent from this one on are used as dictionary
+	int dictFailures;           // received messages that failed to decompress in a row
+	int decodedSequence;        // last incoming message that decompressed, acknowledged instead of incomingSequence
+	netchan_dict_t *sentDicts;  // NETCHAN_DICT_SLOTS messages each, allocated the first time they're needed
+	netchan_dict_t *receivedDicts;
+	netchan_compress_stats_t compressStats;
+
 	bool fatal_error;
 } netchan_t;
 
@@ -700,12 +871,15 @@ extern netadr_t	net_from;
 void Netchan_Init( void );
 void Netchan_Shutdown( void );
 void Netchan_Setup( netchan_t *chan, const socket_t *socket, const netadr_t *address, int qport );
+void Netchan_Release( netchan_t *chan );
+void Netchan_SetCompressDict( netchan_t *chan, bool enable );
+void Netchan_SetDecompressDict( netchan_t *chan, bool enable );
 bool Netchan_Process( netchan_t *chan, msg_t *msg );
 bool Netchan_Transmit( netchan_t *chan, msg_t *msg );
 bool Netchan_PushAllFragments( netchan_t *chan );
 bool Netchan_TransmitNextFragment( netchan_t *chan );
-int Netchan_CompressMessage( msg_t *msg );
-int Netchan_DecompressMessage( msg_t *msg );
+int Netchan_CompressMessage( netchan_t *chan, msg_t *msg );
+int Netchan_DecompressMessage( netchan_t *chan, msg_t *msg );
 void Netchan_OutOfBand( const socket_t *socket, const netadr_t *address, size_t length, const uint8_t *data );
 void Netchan_OutOfBandPrint( const socket_t *socket, const netadr_t *address, const char *format, ... );
 int Netchan_GamePort( void );
@@ -841,10 +1015,12 @@ void	    Com_BeginRedirect( int target, char *buffer, int buffersize,
 				void ( *flush )(int, const char*, const void*), const void *extra );
 void	    Com_EndRedirect( void );
 void 	    Com_DeferConsoleLogReopen( void );
+void	    Com_FlushConsoleLog( void );
 void	    Com_Printf( const char *format, ... );
 void	    Com_DPrintf( const char *format, ... );
 void	    Com_Error( com_error_code_t code, const char *format, ... );
 void		Com_DeferQuit( void );
+bool		Com_SetThreadAbortFrame( void *frame );
 void	    Com_Quit( void );
 
 int			Com_ClientState( void );        // this should have just been a cvar...
@@ -892,6 +1068,8 @@ typedef struct mempool_s mempool_t;
 #define MEMPOOL_ANGELSCRIPT			64
 #define MEMPOOL_CINMODULE			128
 #define MEMPOOL_REFMODULE			256
+#define MEMPOOL_THREADARENA			512		// per-thread bump arenas, only released with Mem_EmptyPool
+#define MEMPOOL_THREADSLABS			1024	// small allocations come from per-thread size-class slabs
 
 void Memory_Init( void );
 void Memory_InitCommands( void );
@@ -918,6 +1096,7 @@ size_t Mem_PoolTotalSize( mempool_t *pool );
 #define Mem_Realloc( data, size ) _Mem_Realloc( data, size, __FILE__, __LINE__ )
 #define Mem_Free( mem ) _Mem_Free( mem, 0, 0, __FILE__, __LINE__ )
 #define Mem_AllocPool( parent, name ) _Mem_AllocPool( parent, name, 0, __FILE__, __LINE__ )
+#define Mem_AllocPoolExt( parent, name, flags ) _Mem_AllocPool( parent, name, flags, __FILE__, __LINE__ )
 #define Mem_AllocTempPool( name ) _Mem_AllocTempPool( name, __FILE__, __LINE__ )
 #define Mem_FreePool( pool ) _Mem_FreePool( pool, 0, 0, __FILE__, __LINE__ )
 #define Mem_EmptyPool( pool ) _Mem_EmptyPool( pool, 0, 0, __FILE__, __LINE__ )
@@ -943,6 +1122,17 @@ extern mempool_t *zoneMemPool;
 #define Mem_TempMalloc( size ) Mem_Alloc( tempMemPool, size )
 #define Mem_TempFree( data ) Mem_Free( data )
 
+// per-thread linear scratch memory, released by Mem_ResetFrameArena at the end of each frame,
+// or right away by Mem_FrameFree if it's the last block the thread took
+extern mempool_t *frameMemPool;
+
+#define Mem_FrameMallocExt( size, z ) Mem_AllocExt( frameMemPool, size, z )
+#define Mem_FrameMalloc( size ) Mem_Alloc( frameMemPool, size )
+#define Mem_FrameFree( data ) Mem_Free( data )
+
+void Mem_ResetFrameArena( void );
+void Mem_ThreadExit( void );
+
 void *Q_malloc( size_t size );
 void *Q_realloc( void *buf, size_t newsize );
 void Q_free( void *buf );
@@ -992,6 +1182,7 @@ void	*Sys_AcquireWakeLock( void );
 void	Sys_ReleaseWakeLock( void *wl );
 
 int 	Sys_GetCurrentProcessId( void );
+int 	Sys_GetNumberOfProcessors( void );
 
 /*
 ==============================================================
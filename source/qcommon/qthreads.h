@@ -35,10 +35,18 @@ typedef struct qcondvar_s qcondvar_t;
 struct qbufPipe_s;
 typedef struct qbufPipe_s qbufPipe_t;
 
+struct qjobpool_s;
+typedef struct qjobpool_s qjobpool_t;
+
+typedef void (*qjobfunc_t)( unsigned first, unsigned items, unsigned thread, void *arg );
+
 qmutex_t *QMutex_Create( void );
 void QMutex_Destroy( qmutex_t **pmutex );
 void QMutex_Lock( qmutex_t *mutex );
+bool QMutex_TryLock( qmutex_t *mutex );
 void QMutex_Unlock( qmutex_t *mutex );
+int QMutex_NumHeld( void );
+void QMutex_UnlockHeld( int num );
 
 qcondvar_t *QCondVar_Create( void );
 void QCondVar_Destroy( qcondvar_t **pcond );
@@ -49,6 +57,7 @@ qthread_t *QThread_Create( void *(*routine) (void*), void *param );
 void QThread_Join( qthread_t *thread );
 int QThread_Cancel( qthread_t *thread );
 void QThread_Yield( void );
+uintptr_t QThread_Id( void );
 
 void QThreads_Init( void );
 void QThreads_Shutdown( void );
@@ -61,4 +70,11 @@ int QBufPipe_ReadCmds( qbufPipe_t *queue, unsigned( **cmdHandlers )(const void *
 void QBufPipe_Wait( qbufPipe_t *queue, int (*read)( qbufPipe_t *, unsigned( ** )(const void *), bool ), 
 	unsigned (**cmdHandlers)( const void * ), unsigned timeout_msec );
 
+qjobpool_t *QJobPool_Create( unsigned numThreads, void (*threadExit)( void ) );
+void QJobPool_Destroy( qjobpool_t **ppool );
+unsigned QJobPool_NumThreads( const qjobpool_t *pool );
+void QJobPool_Run( qjobpool_t *pool, unsigned thread, qjobfunc_t job, void *arg, unsigned first, unsigned items );
+void QJobPool_Schedule( qjobpool_t *pool, qjobfunc_t job, void *arg, unsigned items );
+void QJobPool_Complete( qjobpool_t *pool );
+
 #endif // Q_THREADS_H
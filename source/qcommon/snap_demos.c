@@ -19,6 +19,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 */
 
 #include "qcommon.h"
+#include "sys_threads.h"
 
 #define DEMO_SAFEWRITE(demofile,msg,force) \
 	if( force || (msg)->cursize > (msg)->maxsize / 2 ) \
@@ -50,6 +51,256 @@ void SNAP_RecordDemoMessage( int demofile, msg_t *msg, int offset )
 	FS_Write( msg->data + offset, len, demofile );
 }
 
+/*
+==============================================================
+
+BACKGROUND DEMO WRITER
+
+Messages are packed into batches on the recording thread, the batches are
+handed over to a writer thread through a command pipe. The writer does the
+file I/O and, for compressed demos, the compression. When the writer falls
+behind, new messages are dropped instead of blocking the caller, unless they
+carry reliable data, in which case the caller waits for the writer to catch up.
+
+==============================================================
+*/
+
+#define SNAP_DEMOWRITER_BATCH_SIZE		0x10000
+
+enum
+{
+	DEMOWRITER_CMD_WRITE,
+	DEMOWRITER_CMD_QUIT,
+
+	NUM_DEMOWRITER_CMDS
+};
+
+typedef struct
+{
+	int id;
+	int len;
+	struct snap_demowriter_s *writer;
+	// immediately followed by data
+} snapDemoWriteCmd_t;
+
+// a write command with room for its data, sent to the pipe in one piece
+typedef struct
+{
+	snapDemoWriteCmd_t cmd;
+	uint8_t data[SNAP_DEMOWRITER_BATCH_SIZE + 4];
+} snapDemoWriteBatch_t;
+
+typedef struct snap_demowriter_s
+{
+	int demofile;
+	qbufPipe_t *pipe;
+	qthread_t *thread;
+
+	size_t queueSize;					// bytes that may be pending in the pipe
+	volatile int queued;
+
+	unsigned int offset;				// file position the next accepted message will be written at
+
+	snap_demowriter_stats_t stats;
+
+	size_t batchlen;
+	snapDemoWriteBatch_t batch;
+} snap_demowriter_t;
+
+/*
+* SNAP_DemoWriterWriteCmd
+*/
+static unsigned SNAP_DemoWriterWriteCmd( const void *pcmd )
+{
+	const snapDemoWriteCmd_t *cmd = pcmd;
+	snap_demowriter_t *writer = cmd->writer;
+
+	FS_Write( ( const uint8_t * )( cmd + 1 ), cmd->len, writer->demofile );
+	Sys_Atomic_Add( &writer->queued, -cmd->len, NULL );
+
+	return sizeof( *cmd ) + ( ( cmd->len + 3 ) & ~3 );
+}
+
+/*
+* SNAP_DemoWriterQuitCmd
+*/
+static unsigned SNAP_DemoWriterQuitCmd( const void *pcmd )
+{
+	return 0;
+}
+
+/*
+* SNAP_DemoWriterCmdsWaiter
+*/
+static int SNAP_DemoWriterCmdsWaiter( qbufPipe_t *queue, unsigned( **cmdHandlers )( const void * ), bool timeout )
+{
+	return QBufPipe_ReadCmds( queue, cmdHandlers );
+}
+
+/*
+* SNAP_DemoWriterThread
+*/
+static void *SNAP_DemoWriterThread( void *param )
+{
+	snap_demowriter_t *writer = param;
+	unsigned ( *cmdHandlers[NUM_DEMOWRITER_CMDS] )( const void * ) =
+	{
+		SNAP_DemoWriterWriteCmd,
+		SNAP_DemoWriterQuitCmd,
+	};
+
+	QBufPipe_Wait( writer->pipe, SNAP_DemoWriterCmdsWaiter, cmdHandlers, Q_THREADS_WAIT_INFINITE );
+
+	return NULL;
+}
+
+/*
+* SNAP_SendDemoWriterBatch
+* 
+* Returns false if the writer is too far behind to take the batch.
+*/
+static bool SNAP_SendDemoWriterBatch( snap_demowriter_t *writer )
+{
+	int queued;
+	snapDemoWriteCmd_t *cmd;
+
+	if( !writer->batchlen )
+		return true;
+
+	queued = writer->queued;
+	if( queued + writer->batchlen > writer->queueSize )
+		return false;
+
+	Sys_Atomic_Add( &writer->queued, writer->batchlen, NULL );
+	queued += writer->batchlen;
+	if( (size_t)queued > writer->stats.maxQueued )
+		writer->stats.maxQueued = queued;
+
+	cmd = &writer->batch.cmd;
+	cmd->id = DEMOWRITER_CMD_WRITE;
+	cmd->len = writer->batchlen;
+	cmd->writer = writer;
+	QBufPipe_WriteCmd( writer->pipe, cmd, sizeof( *cmd ) + ( ( writer->batchlen + 3 ) & ~3 ) );
+
+	writer->stats.batches++;
+	writer->batchlen = 0;
+	return true;
+}
+
+/*
+* SNAP_CreateDemoWriter
+* 
+* Takes over writing to the demo file until SNAP_FreeDemoWriter, queueSize bytes
+* can be waiting to be written before new messages are dropped.
+*/
+snap_demowriter_t *SNAP_CreateDemoWriter( int demofile, size_t queueSize )
+{
+	snap_demowriter_t *writer;
+
+	// the writer thread finds the data right after the command
+	assert( offsetof( snapDemoWriteBatch_t, data ) == sizeof( snapDemoWriteCmd_t ) );
+
+	writer = ( snap_demowriter_t * )Mem_ZoneMalloc( sizeof( *writer ) );
+	writer->demofile = demofile;
+	writer->queueSize = max( queueSize, SNAP_DEMOWRITER_BATCH_SIZE );
+	writer->offset = FS_Tell( demofile );
+
+	// twice as large, so the pipe never runs out of space for what we let through
+	writer->pipe = QBufPipe_Create( writer->queueSize * 2 + sizeof( snapDemoWriteCmd_t ) * 2 + SNAP_DEMOWRITER_BATCH_SIZE, 0 );
+	writer->thread = QThread_Create( SNAP_DemoWriterThread, writer );
+
+	return writer;
+}
+
+/*
+* SNAP_FreeDemoWriter
+* 
+* Writes all pending messages and stops the writer thread.
+*/
+void SNAP_FreeDemoWriter( snap_demowriter_t **pwriter )
+{
+	int cmd = DEMOWRITER_CMD_QUIT;
+	snap_demowriter_t *writer;
+
+	if( !pwriter || !*pwriter )
+		return;
+
+	writer = *pwriter;
+	*pwriter = NULL;
+
+	// the last batch must not be dropped, wait for the pipe to drain
+	if( !SNAP_SendDemoWriterBatch( writer ) )
+	{
+		QBufPipe_Finish( writer->pipe );
+		SNAP_SendDemoWriterBatch( writer );
+	}
+
+	QBufPipe_WriteCmd( writer->pipe, &cmd, sizeof( cmd ) );
+	QThread_Join( writer->thread );
+	QBufPipe_Destroy( &writer->pipe );
+
+	Mem_ZoneFree( writer );
+}
+
+/*
+* SNAP_WriteDemoMessage
+* 
+* Same as SNAP_RecordDemoMessage, but the actual writing is done on the writer
+* thread. Returns false if the message had to be dropped. Reliable messages
+* are never dropped, the caller waits for the writer to make room instead.
+*/
+bool SNAP_WriteDemoMessage( snap_demowriter_t *writer, msg_t *msg, int offset, bool reliable )
+{
+	int len;
+
+	len = LittleLong( msg->cursize ) - offset;
+	if( len <= 0 )
+		return true;
+
+	if( writer->batchlen + 4 + len > SNAP_DEMOWRITER_BATCH_SIZE )
+	{
+		if( !SNAP_SendDemoWriterBatch( writer ) )
+		{
+			if( !reliable )
+			{
+				writer->stats.dropped++;
+				return false;
+			}
+
+			QBufPipe_Finish( writer->pipe );
+			SNAP_SendDemoWriterBatch( writer );
+			writer->stats.stalls++;
+		}
+	}
+
+	memcpy( writer->batch.data + writer->batchlen, &len, 4 );
+	memcpy( writer->batch.data + writer->batchlen + 4, msg->data + offset, len );
+	writer->batchlen += 4 + len;
+	writer->offset += 4 + len;
+
+	writer->stats.messages++;
+	writer->stats.bytes += 4 + len;
+	return true;
+}
+
+/*
+* SNAP_DemoWriterTell
+* 
+* Returns the uncompressed file offset the next message is going to be written at.
+*/
+unsigned int SNAP_DemoWriterTell( const snap_demowriter_t *writer )
+{
+	return writer->offset;
+}
+
+/*
+* SNAP_DemoWriterStats
+*/
+const snap_demowriter_stats_t *SNAP_DemoWriterStats( const snap_demowriter_t *writer )
+{
+	return &writer->stats;
+}
+
 /*
 * SNAP_ReadDemoMessage
 */
@@ -416,3 +667,183 @@ size_t SNAP_ReadDemoMetaData( int demofile, char *meta_data, size_t meta_data_si
 
 	return meta_data_realsize;
 }
+
+/*
+==============================================================
+
+DEMO SEEK INDEX
+
+The recorder periodically writes keyframes: the full set of configstrings
+followed by a snapshot that isn't delta compressed, so playback can start
+from any of them. Their times and file offsets are stored in the meta data,
+letting players seek straight to the closest keyframe instead of parsing
+the demo from the start.
+
+==============================================================
+*/
+
+#define SNAP_DEMO_KEYFRAMES_KEY		"keyframes"
+
+/*
+* SNAP_InitDemoIndex
+*/
+void SNAP_InitDemoIndex( snap_demoindex_t *index, unsigned int interval )
+{
+	index->interval = interval;
+	index->numkeyframes = 0;
+}
+
+/*
+* SNAP_DemoKeyframeDue
+*/
+bool SNAP_DemoKeyframeDue( const snap_demoindex_t *index, unsigned int time )
+{
+	if( !index->interval )
+		return false;
+	if( !index->numkeyframes )
+		return true;
+	return time >= index->keyframes[index->numkeyframes-1].time + index->interval;
+}
+
+/*
+* SNAP_AddDemoKeyframe
+* 
+* When the index is full, every other keyframe is forgotten and the interval
+* is doubled, so arbitrarily long demos still get evenly spaced keyframes.
+*/
+void SNAP_AddDemoKeyframe( snap_demoindex_t *index, unsigned int time, unsigned int offset )
+{
+	unsigned int i;
+
+	if( index->numkeyframes == SNAP_MAX_DEMO_KEYFRAMES )
+	{
+		for( i = 0; i < SNAP_MAX_DEMO_KEYFRAMES / 2; i++ )
+			index->keyframes[i] = index->keyframes[i * 2];
+		index->numkeyframes = SNAP_MAX_DEMO_KEYFRAMES / 2;
+		index->interval *= 2;
+
+		if( !SNAP_DemoKeyframeDue( index, time ) )
+			return;
+	}
+
+	index->keyframes[index->numkeyframes].time = time;
+	index->keyframes[index->numkeyframes].offset = offset;
+	index->numkeyframes++;
+}
+
+/*
+* SNAP_SetDemoMetaKeyframes
+* 
+* Stores the index as a list of "time offset" pairs.
+*/
+size_t SNAP_SetDemoMetaKeyframes( char *meta_data, size_t meta_data_max_size, size_t meta_data_realsize,
+								 const snap_demoindex_t *index )
+{
+	unsigned int i;
+	size_t len;
+	char *value;
+	const size_t value_size = SNAP_MAX_DEMO_KEYFRAMES * 24 + 1;
+
+	if( !index->numkeyframes )
+		return meta_data_realsize;
+
+	value = Mem_TempMalloc( value_size );
+
+	len = 0;
+	for( i = 0; i < index->numkeyframes; i++ )
+	{
+		Q_snprintfz( value + len, value_size - len, "%s%u %u", i ? " " : "",
+			index->keyframes[i].time, index->keyframes[i].offset );
+		len += strlen( value + len );
+	}
+
+	meta_data_realsize = SNAP_SetDemoMetaKeyValue( meta_data, meta_data_max_size, meta_data_realsize,
+		SNAP_DEMO_KEYFRAMES_KEY, value );
+
+	Mem_TempFree( value );
+
+	return meta_data_realsize;
+}
+
+/*
+* SNAP_ReadDemoMetaKeyframes
+* 
+* Returns the number of keyframes read from meta data, 0 for demos recorded without the index.
+*/
+unsigned int SNAP_ReadDemoMetaKeyframes( const char *meta_data, size_t meta_data_realsize,
+										snap_demokeyframe_t *keyframes, unsigned int maxkeyframes )
+{
+	unsigned int numkeyframes;
+	const char *s, *key, *value;
+	const char *end = meta_data + meta_data_realsize;
+	char *next;
+
+	value = NULL;
+	for( s = meta_data; s < end && *s; ) {
+		key = s;
+		s += strlen( s ) + 1;
+		if( s >= end ) {
+			break;
+		}
+
+		if( !Q_stricmp( key, SNAP_DEMO_KEYFRAMES_KEY ) ) {
+			value = s;
+			break;
+		}
+		s += strlen( s ) + 1;
+	}
+
+	if( !value ) {
+		return 0;
+	}
+
+	numkeyframes = 0;
+	while( numkeyframes < maxkeyframes ) {
+		keyframes[numkeyframes].time = strtoul( value, &next, 10 );
+		if( next == value ) {
+			break;
+		}
+		value = next;
+
+		keyframes[numkeyframes].offset = strtoul( value, &next, 10 );
+		if( next == value ) {
+			break;
+		}
+		value = next;
+
+		// the index must be sorted for lookups
+		if( numkeyframes && keyframes[numkeyframes].time < keyframes[numkeyframes-1].time ) {
+			break;
+		}
+		numkeyframes++;
+	}
+
+	return numkeyframes;
+}
+
+/*
+* SNAP_FindDemoKeyframe
+* 
+* Returns the last keyframe at or before the given time, NULL if there's none.
+*/
+const snap_demokeyframe_t *SNAP_FindDemoKeyframe( const snap_demokeyframe_t *keyframes, unsigned int numkeyframes,
+												 unsigned int time )
+{
+	unsigned int lo, hi, mid;
+
+	if( !numkeyframes || keyframes[0].time > time )
+		return NULL;
+
+	lo = 0;
+	hi = numkeyframes;
+	while( hi - lo > 1 )
+	{
+		mid = ( lo + hi ) / 2;
+		if( keyframes[mid].time <= time )
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	return &keyframes[lo];
+}
@@ -275,11 +275,145 @@ static void SNAP_ParsePlayerstate( msg_t *msg, player_state_t *oldstate, player_
 	}
 }
 
+/*
+* SNAP_ParsePlayerstateBits
+*
+* Bit-packed counterpart of SNAP_ParsePlayerstate
+*/
+static void SNAP_ParsePlayerstateBits( msg_t *msg, player_state_t *oldstate, player_state_t *state )
+{
+	int flags;
+	int i, index;
+	unsigned gap;
+
+	// clear to old value before delta parsing
+	if( oldstate )
+		memcpy( state, oldstate, sizeof( *state ) );
+	else
+		memset( state, 0, sizeof( *state ) );
+
+	flags = MSG_ReadBits( msg, 8 );
+	if( flags & PS_MOREBITS1 )
+		flags |= MSG_ReadBits( msg, 8 )<<8;
+	if( flags & PS_MOREBITS2 )
+		flags |= MSG_ReadBits( msg, 8 )<<16;
+	if( flags & PS_MOREBITS3 )
+		flags |= MSG_ReadBits( msg, 8 )<<24;
+
+	if( flags & PS_M_TYPE )
+		state->pmove.pm_type = MSG_ReadBits( msg, 8 );
+
+	for( i = 0; i < 3; i++ )
+	{
+		if( flags & ( PS_M_ORIGIN0<<i ) )
+			state->pmove.origin[i] = (float)MSG_Int3( MSG_Int3( (int)( state->pmove.origin[i]*PM_VECTOR_SNAP ) ) + MSG_ReadDeltaBits( msg ) )*( 1.0/PM_VECTOR_SNAP );
+	}
+
+	for( i = 0; i < 3; i++ )
+	{
+		if( flags & ( PS_M_VELOCITY0<<i ) )
+			state->pmove.velocity[i] = (float)MSG_Int3( MSG_Int3( (int)( state->pmove.velocity[i]*PM_VECTOR_SNAP ) ) + MSG_ReadDeltaBits( msg ) )*( 1.0/PM_VECTOR_SNAP );
+	}
+
+	if( flags & PS_M_TIME )
+		state->pmove.pm_time = MSG_ReadBits( msg, 8 );
+
+	if( flags & PS_M_SKIM )
+		state->pmove.skim_time = MSG_ReadBits( msg, 8 );
+
+	if( flags & PS_M_FLAGS )
+		state->pmove.pm_flags = (short)MSG_ReadBits( msg, 16 );
+
+	for( i = 0; i < 3; i++ )
+	{
+		if( flags & ( PS_M_DELTA_ANGLES0<<i ) )
+			state->pmove.delta_angles[i] = (short)MSG_ReadBits( msg, 16 );
+	}
+
+	for( i = 0; i < 2; i++ )
+	{
+		if( flags & ( i ? PS_EVENT2 : PS_EVENT ) )
+		{
+			state->event[i] = MSG_ReadBits( msg, 7 );
+			state->eventParm[i] = MSG_ReadBits( msg, 1 ) ? MSG_ReadBits( msg, 8 ) : 0;
+		}
+		else
+		{
+			state->event[i] = state->eventParm[i] = 0;
+		}
+	}
+
+	if( flags & PS_VIEWANGLES )
+	{
+		for( i = 0; i < 3; i++ )
+		{
+			if( MSG_ReadBits( msg, 1 ) )
+				state->viewangles[i] = SHORT2ANGLE( (short)MSG_ReadBits( msg, 16 ) );
+		}
+	}
+
+	if( flags & PS_M_GRAVITY )
+		state->pmove.gravity = (short)MSG_ReadBits( msg, 16 );
+
+	if( flags & PS_WEAPONSTATE )
+		state->weaponState = MSG_ReadBits( msg, 8 );
+
+	if( flags & PS_FOV )
+		state->fov = MSG_ReadBits( msg, 8 );
+
+	if( flags & PS_POVNUM )
+		state->POVnum = MSG_ReadBits( msg, 8 );
+	if( state->POVnum == 0 )
+		Com_Error( ERR_DROP, "SNAP_ParsePlayerstate: Invalid POVnum %i", state->POVnum );
+
+	if( flags & PS_PLAYERNUM )
+		state->playerNum = MSG_ReadBits( msg, 8 );
+	if( state->playerNum >= MAX_CLIENTS )
+		Com_Error( ERR_DROP, "SNAP_ParsePlayerstate: Invalid playerNum %i", state->playerNum );
+
+	if( flags & PS_VIEWHEIGHT )
+		state->viewheight = (signed char)MSG_ReadBits( msg, 8 );
+
+	if( flags & PS_PMOVESTATS )
+	{
+		for( i = 0; i < PM_STAT_SIZE; i++ )
+		{
+			if( MSG_ReadBits( msg, 1 ) )
+				state->pmove.stats[i] = (short)MSG_ReadBits( msg, 16 );
+		}
+	}
+
+	if( flags & PS_INVENTORY )
+	{
+		for( index = -1; ( gap = MSG_ReadVarBits( msg ) ) != 0; )
+		{
+			index += gap;
+			if( index >= MAX_ITEMS )
+				Com_Error( ERR_DROP, "SNAP_ParsePlayerstate: Invalid inventory index %i", index );
+			state->inventory[index] = MSG_ReadBits( msg, 8 );
+		}
+	}
+
+	if( flags & PS_PLRKEYS )
+		state->plrkeys = MSG_ReadBits( msg, 8 );
+
+	// parse stats
+	for( index = -1; ( gap = MSG_ReadVarBits( msg ) ) != 0; )
+	{
+		index += gap;
+		if( index >= PS_MAX_STATS )
+			Com_Error( ERR_DROP, "SNAP_ParsePlayerstate: Invalid stat index %i", index );
+		state->stats[index] = (short)MSG_ReadBits( msg, 16 );
+	}
+}
+
 /*
 * SNAP_ParseEntityBits
 */
-static int SNAP_ParseEntityBits( msg_t *msg, unsigned *bits )
+static int SNAP_ParseEntityBits( msg_t *msg, int lastnum, bool bitpacked, unsigned *bits )
 {
+	if( bitpacked )
+		return MSG_ReadEntityNumberBits( msg, lastnum, bits );
 	return MSG_ReadEntityBits( msg, bits );
 }
 
@@ -289,13 +423,16 @@ static int SNAP_ParseEntityBits( msg_t *msg, unsigned *bits )
 * Parses deltas from the given base and adds the resulting entity
 * to the current frame
 */
-static void SNAP_DeltaEntity( msg_t *msg, snapshot_t *frame, int newnum, entity_state_t *old, unsigned bits )
+static void SNAP_DeltaEntity( msg_t *msg, snapshot_t *frame, int newnum, entity_state_t *old, bool bitpacked, unsigned bits )
 {
 	entity_state_t *state;
 
 	state = &frame->parsedEntities[frame->numEntities & ( MAX_PARSE_ENTITIES-1 )];
 	frame->numEntities++;
-	MSG_ReadDeltaEntity( msg, old, state, newnum, bits );
+	if( bitpacked )
+		MSG_ReadDeltaEntityBits( msg, old, state, newnum, bits );
+	else
+		MSG_ReadDeltaEntity( msg, old, state, newnum, bits );
 }
 
 /*
@@ -321,9 +458,9 @@ void SNAP_ParseBaseline( msg_t *msg, entity_state_t *baselines )
 * An svc_packetentities has just been parsed, deal with the
 * rest of the data stream.
 */
-static void SNAP_ParsePacketEntities( msg_t *msg, snapshot_t *oldframe, snapshot_t *newframe, entity_state_t *baselines, int shownet )
+static void SNAP_ParsePacketEntities( msg_t *msg, snapshot_t *oldframe, snapshot_t *newframe, entity_state_t *baselines, bool bitpacked, int shownet )
 {
-	int newnum;
+	int newnum, lastnum;
 	unsigned bits;
 	entity_state_t *oldstate = NULL;
 	int oldindex, oldnum;
@@ -344,9 +481,10 @@ static void SNAP_ParsePacketEntities( msg_t *msg, snapshot_t *oldframe, snapshot
 		oldnum = oldstate->number;
 	}
 
+	lastnum = 0;
 	while( true )
 	{
-		newnum = SNAP_ParseEntityBits( msg, &bits );
+		newnum = SNAP_ParseEntityBits( msg, lastnum, bitpacked, &bits );
 		if( newnum >= MAX_EDICTS )
 			Com_Error( ERR_DROP, "CL_ParsePacketEntities: bad number:%i", newnum );
 		if( msg->readcount > msg->cursize )
@@ -354,6 +492,7 @@ static void SNAP_ParsePacketEntities( msg_t *msg, snapshot_t *oldframe, snapshot
 
 		if( !newnum )
 			break;
+		lastnum = newnum;
 
 		while( oldnum < newnum )
 		{
@@ -361,7 +500,7 @@ static void SNAP_ParsePacketEntities( msg_t *msg, snapshot_t *oldframe, snapshot
 			if( shownet == 3 )
 				Com_Printf( "   unchanged: %i\n", oldnum );
 
-			SNAP_DeltaEntity( msg, newframe, oldnum, oldstate, 0 );
+			SNAP_DeltaEntity( msg, newframe, oldnum, oldstate, false, 0 );
 
 			oldindex++;
 			if( oldindex >= oldframe->numEntities )
@@ -388,7 +527,7 @@ static void SNAP_ParsePacketEntities( msg_t *msg, snapshot_t *oldframe, snapshot
 			if( shownet == 3 )
 				Com_Printf( "   baseline: %i\n", newnum );
 
-			SNAP_DeltaEntity( msg, newframe, newnum, &baselines[newnum], bits );
+			SNAP_DeltaEntity( msg, newframe, newnum, &baselines[newnum], bitpacked, bits );
 			continue;
 		}
 
@@ -420,7 +559,7 @@ static void SNAP_ParsePacketEntities( msg_t *msg, snapshot_t *oldframe, snapshot
 			if( shownet == 3 )
 				Com_Printf( "   delta: %i\n", newnum );
 
-			SNAP_DeltaEntity( msg, newframe, newnum, oldstate, bits );
+			SNAP_DeltaEntity( msg, newframe, newnum, oldstate, bitpacked, bits );
 
 			oldindex++;
 			if( oldindex >= oldframe->numEntities )
@@ -443,7 +582,7 @@ static void SNAP_ParsePacketEntities( msg_t *msg, snapshot_t *oldframe, snapshot
 		if( shownet == 3 )
 			Com_Printf( "   unchanged: %i\n", oldnum );
 
-		SNAP_DeltaEntity( msg, newframe, oldnum, oldstate, 0 );
+		SNAP_DeltaEntity( msg, newframe, oldnum, oldstate, false, 0 );
 
 		oldindex++;
 		if( oldindex >= oldframe->numEntities )
@@ -461,7 +600,7 @@ static void SNAP_ParsePacketEntities( msg_t *msg, snapshot_t *oldframe, snapshot
 /*
 * SNAP_ParseFrameHeader
 */
-static snapshot_t *SNAP_ParseFrameHeader( msg_t *msg, snapshot_t *newframe, int *suppressCount, snapshot_t *backup, bool skipBody )
+static snapshot_t *SNAP_ParseFrameHeader( msg_t *msg, snapshot_t *newframe, int *suppressCount, snapshot_t *backup, bool skipBody, bool *bitpacked )
 {
 	int len, pos;
 	int areabytes;
@@ -495,6 +634,8 @@ static snapshot_t *SNAP_ParseFrameHeader( msg_t *msg, snapshot_t *newframe, int
 	newframe->delta = ( flags & FRAMESNAP_FLAG_DELTA ) ? true : false;
 	newframe->multipov = ( flags & FRAMESNAP_FLAG_MULTIPOV ) ? true : false;
 	newframe->allentities = ( flags & FRAMESNAP_FLAG_ALLENTITIES ) ? true : false;
+	if( bitpacked )
+		*bitpacked = ( flags & FRAMESNAP_FLAG_BITPACKED ) ? true : false;
 
 	supCnt = MSG_ReadByte( msg );
 	if( suppressCount )
@@ -559,13 +700,16 @@ static snapshot_t *SNAP_ParseFrameHeader( msg_t *msg, snapshot_t *newframe, int
 void SNAP_SkipFrame( msg_t *msg, snapshot_t *header )
 {
 	static snapshot_t frame;
-	SNAP_ParseFrameHeader( msg, header ? header : &frame, NULL, NULL, true );
+	SNAP_ParseFrameHeader( msg, header ? header : &frame, NULL, NULL, true, NULL );
 }
 
 /*
 * SNAP_ParseFrame
+*
+* If not NULL, bitpacked is set to whether the frame was sent bit-packed
 */
-snapshot_t *SNAP_ParseFrame( msg_t *msg, snapshot_t *lastFrame, int *suppressCount, snapshot_t *backup, entity_state_t *baselines, int showNet )
+snapshot_t *SNAP_ParseFrame( msg_t *msg, snapshot_t *lastFrame, int *suppressCount, snapshot_t *backup, entity_state_t *baselines, int showNet,
+	bool *pbitpacked )
 {
 	int cmd;
 	size_t len;
@@ -575,10 +719,13 @@ snapshot_t *SNAP_ParseFrame( msg_t *msg, snapshot_t *lastFrame, int *suppressCou
 	int framediff, numtargets;
 	gcommand_t *gcmd;
 	snapshot_t	*newframe;
+	bool bitpacked;
 
 	// read header
-	newframe = SNAP_ParseFrameHeader( msg, NULL, suppressCount, backup, false );
+	newframe = SNAP_ParseFrameHeader( msg, NULL, suppressCount, backup, false, &bitpacked );
 	deltaframe = NULL;
+	if( pbitpacked )
+		*pbitpacked = bitpacked;
 
 	if( showNet == 3 )
 	{
@@ -658,13 +805,17 @@ snapshot_t *SNAP_ParseFrame( msg_t *msg, snapshot_t *lastFrame, int *suppressCou
 	numplayers = 0;
 	while( ( cmd = MSG_ReadByte( msg ) ) )
 	{
+		player_state_t *oldstate;
+
 		_SHOWNET( msg, svc_strings[cmd], showNet );
 		if( cmd != svc_playerinfo )
 			Com_Error( ERR_DROP, "SNAP_ParseFrame: not playerinfo" );
-		if( deltaframe && deltaframe->numplayers >= numplayers )
-			SNAP_ParsePlayerstate( msg, &deltaframe->playerStates[numplayers], &newframe->playerStates[numplayers] );
+		oldstate = ( deltaframe && deltaframe->numplayers > numplayers ) ? &deltaframe->playerStates[numplayers] : NULL;
+
+		if( bitpacked )
+			SNAP_ParsePlayerstateBits( msg, oldstate, &newframe->playerStates[numplayers] );
 		else
-			SNAP_ParsePlayerstate( msg, NULL, &newframe->playerStates[numplayers] );
+			SNAP_ParsePlayerstate( msg, oldstate, &newframe->playerStates[numplayers] );
 		numplayers++;
 	}
 	newframe->numplayers = numplayers;
@@ -675,7 +826,7 @@ snapshot_t *SNAP_ParseFrame( msg_t *msg, snapshot_t *lastFrame, int *suppressCou
 	_SHOWNET( msg, svc_strings[cmd], showNet );
 	if( cmd != svc_packetentities )
 		Com_Error( ERR_DROP, "SNAP_ParseFrame: not packetentities" );
-	SNAP_ParsePacketEntities( msg, deltaframe, newframe, baselines, showNet );
+	SNAP_ParsePacketEntities( msg, deltaframe, newframe, baselines, bitpacked, showNet );
 
 	return newframe;
 }
@@ -30,18 +30,258 @@ Encode a client frame onto the network channel
 =========================================================================
 */
 
+/*
+=========================================================================
+
+Per-frame entity delta cache
+
+Most clients ack the same previous frame, so the same (old, new) entity
+state pair gets delta encoded over and over again during a server frame.
+The cache remembers the encoded bytes for each pair, keyed by entity
+number, the frame the delta is made from and the encoding flags. Both
+states are compared in full before reusing a cached encoding, so a stale
+or colliding entry can never change what is written.
+
+=========================================================================
+*/
+
+#define SNAP_DELTACACHE_ENTRIES		1024		// must be a power of two
+#define SNAP_DELTACACHE_PROBES		8
+#define SNAP_DELTACACHE_DATASIZE	0x10000
+
+#define SNAP_DELTA_FORCE			1
+#define SNAP_DELTA_OTHERORIGIN		2
+#define SNAP_DELTA_BITPACKED		4
+
+typedef struct
+{
+	unsigned stamp;					// the entry is valid only for the cache's current stamp
+	int number;
+	int fromFrame;					// -1 for baselines
+	int flags;
+	unsigned offset, length;		// into the data buffer, length is in bits for bit-packed deltas
+	entity_state_t from, to;
+} snap_deltacache_entry_t;
+
+struct snap_deltacache_s
+{
+	unsigned stamp;					// bumped every frame, 0 is never valid
+	unsigned frameNum;
+	unsigned datasize;
+	snap_deltacache_stats_t stats;
+	snap_deltacache_entry_t entries[SNAP_DELTACACHE_ENTRIES];
+	uint8_t data[SNAP_DELTACACHE_DATASIZE];
+};
+
+/*
+* SNAP_CreateDeltaCache
+*/
+snap_deltacache_t *SNAP_CreateDeltaCache( mempool_t *mempool )
+{
+	snap_deltacache_t *cache;
+
+	cache = ( snap_deltacache_t * )Mem_Alloc( mempool, sizeof( *cache ) );
+	return cache;
+}
+
+/*
+* SNAP_FreeDeltaCache
+*/
+void SNAP_FreeDeltaCache( snap_deltacache_t **pcache )
+{
+	if( !pcache || !*pcache )
+		return;
+	Mem_Free( *pcache );
+	*pcache = NULL;
+}
+
+/*
+* SNAP_DeltaCacheStats
+*/
+const snap_deltacache_stats_t *SNAP_DeltaCacheStats( const snap_deltacache_t *cache )
+{
+	return &cache->stats;
+}
+
+/*
+* SNAP_ResetDeltaCacheStats
+*/
+void SNAP_ResetDeltaCacheStats( snap_deltacache_t *cache )
+{
+	memset( &cache->stats, 0, sizeof( cache->stats ) );
+}
+
+/*
+* SNAP_DeltaCacheBeginFrame
+*
+* Entries are invalidated wholesale by bumping the stamp they're tagged with.
+*/
+static void SNAP_DeltaCacheBeginFrame( snap_deltacache_t *cache, unsigned frameNum )
+{
+	int i;
+
+	if( cache->stamp && cache->frameNum == frameNum )
+		return;
+
+	// make sure no entry survives a stamp wraparound
+	if( !++cache->stamp )
+	{
+		for( i = 0; i < SNAP_DELTACACHE_ENTRIES; i++ )
+			cache->entries[i].stamp = 0;
+		cache->stamp = 1;
+	}
+
+	cache->frameNum = frameNum;
+	cache->datasize = 0;
+	cache->stats.frames++;
+}
+
+/*
+* SNAP_WriteEntityBits
+*
+* Writes an entity record header followed by a bit-packed delta body.
+*/
+static void SNAP_WriteEntityBits( msg_t *msg, int *lastnum, int number, const uint8_t *data, unsigned nbits )
+{
+	MSG_WriteEntityNumberBits( msg, *lastnum, number, false );
+	*lastnum = number;
+
+	for( ; nbits >= 8; nbits -= 8 )
+		MSG_WriteBits( msg, *data++, 8 );
+	if( nbits )
+		MSG_WriteBits( msg, *data, nbits );
+}
+
+/*
+* SNAP_EncodeDeltaEntity
+*
+* Encodes the delta to msg, or in bit-packed frames (lastnum is not NULL)
+* to a scratch buffer whose contents are returned.
+*/
+static unsigned SNAP_EncodeDeltaEntity( entity_state_t *from, entity_state_t *to, msg_t *msg, bool force, bool updateOtherOrigin,
+	int *lastnum, msg_t *bitsmsg )
+{
+	unsigned start;
+
+	if( !lastnum )
+	{
+		start = msg->cursize;
+		MSG_WriteDeltaEntity( from, to, msg, force, updateOtherOrigin );
+		return msg->cursize - start;
+	}
+
+	MSG_Clear( bitsmsg );
+	if( !MSG_WriteDeltaEntityBits( from, to, bitsmsg, force, updateOtherOrigin ) )
+		return 0;
+	return bitsmsg->writebits;
+}
+
+/*
+* SNAP_WriteDeltaEntity
+*
+* MSG_WriteDeltaEntity going through the delta cache, if there's any.
+* In bit-packed frames lastnum holds the previously written entity number.
+*/
+static void SNAP_WriteDeltaEntity( snap_deltacache_t *cache, entity_state_t *from, int fromFrame, entity_state_t *to, msg_t *msg, bool force, bool updateOtherOrigin, int *lastnum )
+{
+	int i, flags;
+	unsigned hash, length, datalength;
+	const uint8_t *data;
+	snap_deltacache_entry_t *entry, *free_entry;
+	msg_t bitsmsg;
+	uint8_t bitsmsg_buf[256];
+
+	MSG_Init( &bitsmsg, bitsmsg_buf, sizeof( bitsmsg_buf ) );
+
+	if( !cache )
+	{
+		length = SNAP_EncodeDeltaEntity( from, to, msg, force, updateOtherOrigin, lastnum, &bitsmsg );
+		if( lastnum && length )
+			SNAP_WriteEntityBits( msg, lastnum, to->number, bitsmsg.data, length );
+		return;
+	}
+
+	flags = ( force ? SNAP_DELTA_FORCE : 0 ) | ( updateOtherOrigin ? SNAP_DELTA_OTHERORIGIN : 0 ) | ( lastnum ? SNAP_DELTA_BITPACKED : 0 );
+	hash = ( (unsigned)to->number * 2654435761u ) ^ ( (unsigned)fromFrame * 40503u ) ^ (unsigned)flags;
+
+	cache->stats.lookups++;
+
+	free_entry = NULL;
+	for( i = 0; i < SNAP_DELTACACHE_PROBES; i++ )
+	{
+		entry = &cache->entries[( hash + i ) & ( SNAP_DELTACACHE_ENTRIES - 1 )];
+		if( entry->stamp != cache->stamp )
+		{
+			free_entry = entry;
+			break;
+		}
+
+		if( entry->number != to->number || entry->fromFrame != fromFrame || entry->flags != flags )
+			continue;
+		if( memcmp( &entry->to, to, sizeof( *to ) ) || memcmp( &entry->from, from, sizeof( *from ) ) )
+			continue;
+
+		// hit
+		datalength = lastnum ? ( entry->length + 7 ) >> 3 : entry->length;
+		if( entry->length )
+		{
+			if( lastnum )
+				SNAP_WriteEntityBits( msg, lastnum, to->number, cache->data + entry->offset, entry->length );
+			else
+				MSG_WriteData( msg, cache->data + entry->offset, entry->length );
+		}
+		cache->stats.hits++;
+		cache->stats.bytesSaved += datalength;
+		return;
+	}
+
+	length = SNAP_EncodeDeltaEntity( from, to, msg, force, updateOtherOrigin, lastnum, &bitsmsg );
+	if( lastnum )
+	{
+		data = bitsmsg.data;
+		datalength = ( length + 7 ) >> 3;
+		if( length )
+			SNAP_WriteEntityBits( msg, lastnum, to->number, data, length );
+	}
+	else
+	{
+		data = msg->data + msg->cursize - length;
+		datalength = length;
+	}
+
+	cache->stats.bytesEncoded += datalength;
+
+	if( !free_entry || cache->datasize + datalength > SNAP_DELTACACHE_DATASIZE )
+	{
+		cache->stats.overflows++;
+		return;
+	}
+
+	free_entry->stamp = cache->stamp;
+	free_entry->number = to->number;
+	free_entry->fromFrame = fromFrame;
+	free_entry->flags = flags;
+	free_entry->offset = cache->datasize;
+	free_entry->length = length;
+	free_entry->from = *from;
+	free_entry->to = *to;
+	memcpy( cache->data + cache->datasize, data, datalength );
+	cache->datasize += datalength;
+}
+
 /*
 * SNAP_EmitPacketEntities
 *
 * Writes a delta update of an entity_state_t list to the message.
 */
-static void SNAP_EmitPacketEntities( ginfo_t *gi, client_snapshot_t *from, client_snapshot_t *to, msg_t *msg, entity_state_t *baselines, entity_state_t *client_entities, int num_client_entities )
+static void SNAP_EmitPacketEntities( ginfo_t *gi, client_snapshot_t *from, int fromFrame, client_snapshot_t *to, msg_t *msg, entity_state_t *baselines, entity_state_t *client_entities, int num_client_entities, snap_deltacache_t *deltaCache, bool bitpacked )
 {
 	entity_state_t *oldent, *newent;
 	int oldindex, newindex;
 	int oldnum, newnum;
 	int from_num_entities;
 	int bits;
+	int lastnum, *plastnum;
 
 	MSG_WriteByte( msg, svc_packetentities );
 
@@ -50,6 +290,9 @@ static void SNAP_EmitPacketEntities( ginfo_t *gi, client_snapshot_t *from, clien
 	else
 		from_num_entities = from->num_entities;
 
+	lastnum = 0;
+	plastnum = bitpacked ? &lastnum : NULL;
+
 	newindex = 0;
 	oldindex = 0;
 	while( newindex < to->num_entities || oldindex < from_num_entities )
@@ -83,7 +326,7 @@ static void SNAP_EmitPacketEntities( ginfo_t *gi, client_snapshot_t *from, clien
 			// in any bytes being emited if the entity has not changed at all
 			// note that players are always 'newentities', this updates their oldorigin always
 			// and prevents warping ( wsw : jal : I removed it from the players )
-			MSG_WriteDeltaEntity( oldent, newent, msg, false, ( ( EDICT_NUM( newent->number ) )->r.svflags & SVF_TRANSMITORIGIN2 ) ? true : false );
+			SNAP_WriteDeltaEntity( deltaCache, oldent, fromFrame, newent, msg, false, ( ( EDICT_NUM( newent->number ) )->r.svflags & SVF_TRANSMITORIGIN2 ) ? true : false, plastnum );
 			oldindex++;
 			newindex++;
 			continue;
@@ -92,7 +335,7 @@ static void SNAP_EmitPacketEntities( ginfo_t *gi, client_snapshot_t *from, clien
 		if( newnum < oldnum )
 		{
 			// this is a new entity, send it from the baseline
-			MSG_WriteDeltaEntity( &baselines[newnum], newent, msg, true, ( ( EDICT_NUM( newent->number ) )->r.svflags & SVF_TRANSMITORIGIN2 ) ? true : false );
+			SNAP_WriteDeltaEntity( deltaCache, &baselines[newnum], -1, newent, msg, true, ( ( EDICT_NUM( newent->number ) )->r.svflags & SVF_TRANSMITORIGIN2 ) ? true : false, plastnum );
 			newindex++;
 			continue;
 		}
@@ -100,6 +343,14 @@ static void SNAP_EmitPacketEntities( ginfo_t *gi, client_snapshot_t *from, clien
 		if( newnum > oldnum )
 		{
 			// the old entity isn't present in the new message
+			if( bitpacked )
+			{
+				MSG_WriteEntityNumberBits( msg, lastnum, oldnum, true );
+				lastnum = oldnum;
+				oldindex++;
+				continue;
+			}
+
 			bits = U_REMOVE;
 			if( oldnum >= 256 )
 				bits |= ( U_NUMBER16 | U_MOREBITS1 );
@@ -118,7 +369,10 @@ static void SNAP_EmitPacketEntities( ginfo_t *gi, client_snapshot_t *from, clien
 		}
 	}
 
-	MSG_WriteShort( msg, 0 ); // end of packetentities
+	if( bitpacked )
+		MSG_WriteEntityNumberBits( msg, lastnum, 0, false );
+	else
+		MSG_WriteShort( msg, 0 ); // end of packetentities
 }
 
 /*
@@ -184,24 +438,15 @@ static void SNAP_WriteDeltaGameStateToClient( client_snapshot_t *from, client_sn
 }
 
 /*
-* SNAP_WritePlayerstateToClient
+* SNAP_PlayerstateFlags
+*
+* Determines what needs to be sent
 */
-static void SNAP_WritePlayerstateToClient( player_state_t *ops, player_state_t *ps, msg_t *msg )
+static int SNAP_PlayerstateFlags( player_state_t *ops, player_state_t *ps )
 {
 	int i;
 	int pflags;
-	player_state_t dummy;
-	int statbits[SNAP_STATS_LONGS];
-
-	if( !ops )
-	{
-		memset( &dummy, 0, sizeof( dummy ) );
-		ops = &dummy;
-	}
 
-	//
-	// determine what needs to be sent
-	//
 	pflags = 0;
 
 	if( ps->pmove.pm_type != ops->pmove.pm_type )
@@ -287,6 +532,27 @@ static void SNAP_WritePlayerstateToClient( player_state_t *ops, player_state_t *
 	if( ps->plrkeys != ops->plrkeys )
 		pflags |= PS_PLRKEYS;
 
+	return pflags;
+}
+
+/*
+* SNAP_WritePlayerstateToClient
+*/
+static void SNAP_WritePlayerstateToClient( player_state_t *ops, player_state_t *ps, msg_t *msg )
+{
+	int i;
+	int pflags;
+	player_state_t dummy;
+	int statbits[SNAP_STATS_LONGS];
+
+	if( !ops )
+	{
+		memset( &dummy, 0, sizeof( dummy ) );
+		ops = &dummy;
+	}
+
+	pflags = SNAP_PlayerstateFlags( ops, ps );
+
 	//
 	// write it
 	//
@@ -465,6 +731,166 @@ static void SNAP_WritePlayerstateToClient( player_state_t *ops, player_state_t *
 	}
 }
 
+/*
+* SNAP_WritePlayerstateBitsToClient
+*
+* Bit-packed counterpart of SNAP_WritePlayerstateToClient. Origin and velocity
+* are sent as deltas of their quantized values, stats and inventory as sparse
+* lists of changed slots.
+*/
+static void SNAP_WritePlayerstateBitsToClient( player_state_t *ops, player_state_t *ps, msg_t *msg )
+{
+	int i, last;
+	int pflags;
+	player_state_t dummy;
+
+	if( !ops )
+	{
+		memset( &dummy, 0, sizeof( dummy ) );
+		ops = &dummy;
+	}
+
+	pflags = SNAP_PlayerstateFlags( ops, ps );
+
+	MSG_WriteByte( msg, svc_playerinfo );
+
+	if( pflags & 0xff000000 )
+		pflags |= PS_MOREBITS3 | PS_MOREBITS2 | PS_MOREBITS1;
+	else if( pflags & 0x00ff0000 )
+		pflags |= PS_MOREBITS2 | PS_MOREBITS1;
+	else if( pflags & 0x0000ff00 )
+		pflags |= PS_MOREBITS1;
+
+	MSG_WriteBits( msg, pflags&255, 8 );
+	if( pflags & PS_MOREBITS1 )
+		MSG_WriteBits( msg, ( pflags>>8 )&255, 8 );
+	if( pflags & PS_MOREBITS2 )
+		MSG_WriteBits( msg, ( pflags>>16 )&255, 8 );
+	if( pflags & PS_MOREBITS3 )
+		MSG_WriteBits( msg, ( pflags>>24 )&255, 8 );
+
+	if( pflags & PS_M_TYPE )
+		MSG_WriteBits( msg, ps->pmove.pm_type, 8 );
+
+	for( i = 0; i < 3; i++ )
+	{
+		if( pflags & ( PS_M_ORIGIN0<<i ) )
+			MSG_WriteDeltaBits( msg, MSG_Int3( (int)( ps->pmove.origin[i]*PM_VECTOR_SNAP ) ) - MSG_Int3( (int)( ops->pmove.origin[i]*PM_VECTOR_SNAP ) ) );
+	}
+
+	for( i = 0; i < 3; i++ )
+	{
+		if( pflags & ( PS_M_VELOCITY0<<i ) )
+			MSG_WriteDeltaBits( msg, MSG_Int3( (int)( ps->pmove.velocity[i]*PM_VECTOR_SNAP ) ) - MSG_Int3( (int)( ops->pmove.velocity[i]*PM_VECTOR_SNAP ) ) );
+	}
+
+	if( pflags & PS_M_TIME )
+		MSG_WriteBits( msg, ps->pmove.pm_time, 8 );
+
+	if( pflags & PS_M_SKIM )
+		MSG_WriteBits( msg, ps->pmove.skim_time, 8 );
+
+	if( pflags & PS_M_FLAGS )
+		MSG_WriteBits( msg, ps->pmove.pm_flags, 16 );
+
+	for( i = 0; i < 3; i++ )
+	{
+		if( pflags & ( PS_M_DELTA_ANGLES0<<i ) )
+			MSG_WriteBits( msg, ps->pmove.delta_angles[i], 16 );
+	}
+
+	for( i = 0; i < 2; i++ )
+	{
+		if( !( pflags & ( i ? PS_EVENT2 : PS_EVENT ) ) )
+			continue;
+
+		MSG_WriteBits( msg, ps->event[i] & ~EV_INVERSE, 7 );
+		MSG_WriteBits( msg, ps->eventParm[i] ? 1 : 0, 1 );
+		if( ps->eventParm[i] )
+			MSG_WriteBits( msg, ps->eventParm[i], 8 );
+	}
+
+	// only the components that have changed
+	if( pflags & PS_VIEWANGLES )
+	{
+		for( i = 0; i < 3; i++ )
+		{
+			if( ps->viewangles[i] != ops->viewangles[i] )
+			{
+				MSG_WriteBits( msg, 1, 1 );
+				MSG_WriteBits( msg, ANGLE2SHORT( ps->viewangles[i] ), 16 );
+			}
+			else
+			{
+				MSG_WriteBits( msg, 0, 1 );
+			}
+		}
+	}
+
+	if( pflags & PS_M_GRAVITY )
+		MSG_WriteBits( msg, ps->pmove.gravity, 16 );
+
+	if( pflags & PS_WEAPONSTATE )
+		MSG_WriteBits( msg, ps->weaponState, 8 );
+
+	if( pflags & PS_FOV )
+		MSG_WriteBits( msg, (uint8_t)ps->fov, 8 );
+
+	if( pflags & PS_POVNUM )
+		MSG_WriteBits( msg, (uint8_t)ps->POVnum, 8 );
+
+	if( pflags & PS_PLAYERNUM )
+		MSG_WriteBits( msg, (uint8_t)ps->playerNum, 8 );
+
+	if( pflags & PS_VIEWHEIGHT )
+		MSG_WriteBits( msg, (uint8_t)(char)ps->viewheight, 8 );
+
+	if( pflags & PS_PMOVESTATS )
+	{
+		for( i = 0; i < PM_STAT_SIZE; i++ )
+		{
+			if( ps->pmove.stats[i] != ops->pmove.stats[i] )
+			{
+				MSG_WriteBits( msg, 1, 1 );
+				MSG_WriteBits( msg, (unsigned short)ps->pmove.stats[i], 16 );
+			}
+			else
+			{
+				MSG_WriteBits( msg, 0, 1 );
+			}
+		}
+	}
+
+	if( pflags & PS_INVENTORY )
+	{
+		for( i = 0, last = -1; i < MAX_ITEMS; i++ )
+		{
+			if( ps->inventory[i] != ops->inventory[i] )
+			{
+				MSG_WriteVarBits( msg, i - last );
+				MSG_WriteBits( msg, (uint8_t)ps->inventory[i], 8 );
+				last = i;
+			}
+		}
+		MSG_WriteVarBits( msg, 0 );
+	}
+
+	if( pflags & PS_PLRKEYS )
+		MSG_WriteBits( msg, ps->plrkeys, 8 );
+
+	// send stats
+	for( i = 0, last = -1; i < PS_MAX_STATS; i++ )
+	{
+		if( ps->stats[i] != ops->stats[i] )
+		{
+			MSG_WriteVarBits( msg, i - last );
+			MSG_WriteBits( msg, (unsigned short)ps->stats[i], 16 );
+			last = i;
+		}
+	}
+	MSG_WriteVarBits( msg, 0 );
+}
+
 /*
 * SNAP_WriteMultiPOVCommands
 */
@@ -579,10 +1005,12 @@ static void SNAP_WriteMultiPOVCommands( ginfo_t *gi, client_t *client, msg_t *ms
 
 /*
 * SNAP_RelayMultiPOVCommands
+* 
+* Returns the number of commands left out for lack of room in the message
 */
-static void SNAP_RelayMultiPOVCommands( ginfo_t *gi, client_t *client, msg_t *msg, int numcmds, gcommand_t *commands, const char *commandsData )
+static int SNAP_RelayMultiPOVCommands( ginfo_t *gi, client_t *client, msg_t *msg, int numcmds, gcommand_t *commands, const char *commandsData )
 {
-	int i, index;
+	int i, index, skipped = 0;
 	int first_index, last_index;
 	gcommand_t *gcmd;
 	const char *command;
@@ -599,7 +1027,10 @@ static void SNAP_RelayMultiPOVCommands( ginfo_t *gi, client_t *client, msg_t *ms
 
 		// do not allow the message buffer to overflow (can happen on flood updates)
 		if( msg->cursize + strlen( command ) + 512 > msg->maxsize )
+		{
+			skipped++;
 			continue;
+		}
 
 		MSG_WriteShort( msg, 0 );
 		MSG_WriteString( msg, command );
@@ -622,19 +1053,246 @@ static void SNAP_RelayMultiPOVCommands( ginfo_t *gi, client_t *client, msg_t *ms
 			MSG_WriteData( msg, gcmd->targets, bytes );
 		}
 	}
+
+	return skipped;
 }
 
 /*
-* SNAP_WriteFrameSnapToClient
-*/
-void SNAP_WriteFrameSnapToClient( ginfo_t *gi, client_t *client, msg_t *msg, unsigned int frameNum, unsigned int gameTime,
-								 entity_state_t *baselines, client_entities_t *client_entities,
-								 int numcmds, gcommand_t *commands, const char *commandsData )
-{
-	client_snapshot_t *frame, *oldframe;
-	int flags, i, index, pos, length, supcnt;
+=========================================================================
 
-	// this is the frame we are creating
+Per-frame snapshot cache
+
+Relayed multiview frames send the same game commands to everyone, so two
+clients whose frames were given the same share key, and that are delta
+compressed from frames with the same share key too, get exactly the same
+frame body. The body is encoded for the first of them and copied for the
+others, only the frame header differs between clients. Whoever builds the
+frames is responsible for handing out share keys.
+
+=========================================================================
+*/
+
+#define SNAP_FRAMECACHE_ENTRIES		64
+#define SNAP_FRAMECACHE_DATASIZE	0x40000
+
+typedef struct
+{
+	unsigned stamp;					// the entry is valid only for the cache's current stamp
+	unsigned shareKey;
+	unsigned deltaShareKey;			// 0 for non-delta frames
+	bool bitpacked;
+	unsigned offset, length;
+} snap_framecache_entry_t;
+
+struct snap_framecache_s
+{
+	unsigned stamp;					// bumped every frame, 0 is never valid
+	unsigned frameNum;
+	unsigned datasize;
+	int numEntries;
+	snap_framecache_stats_t stats;
+	snap_framecache_entry_t entries[SNAP_FRAMECACHE_ENTRIES];
+	uint8_t data[SNAP_FRAMECACHE_DATASIZE];
+};
+
+/*
+* SNAP_CreateFrameCache
+*/
+snap_framecache_t *SNAP_CreateFrameCache( mempool_t *mempool )
+{
+	snap_framecache_t *cache;
+
+	cache = ( snap_framecache_t * )Mem_Alloc( mempool, sizeof( *cache ) );
+	return cache;
+}
+
+/*
+* SNAP_FreeFrameCache
+*/
+void SNAP_FreeFrameCache( snap_framecache_t **pcache )
+{
+	if( !pcache || !*pcache )
+		return;
+	Mem_Free( *pcache );
+	*pcache = NULL;
+}
+
+/*
+* SNAP_FrameCacheStats
+*/
+const snap_framecache_stats_t *SNAP_FrameCacheStats( const snap_framecache_t *cache )
+{
+	return &cache->stats;
+}
+
+/*
+* SNAP_ResetFrameCacheStats
+*/
+void SNAP_ResetFrameCacheStats( snap_framecache_t *cache )
+{
+	memset( &cache->stats, 0, sizeof( cache->stats ) );
+}
+
+/*
+* SNAP_FrameCacheBeginFrame
+*/
+static void SNAP_FrameCacheBeginFrame( snap_framecache_t *cache, unsigned frameNum )
+{
+	int i;
+
+	if( cache->stamp && cache->frameNum == frameNum )
+		return;
+
+	// make sure no entry survives a stamp wraparound
+	if( !++cache->stamp )
+	{
+		for( i = 0; i < SNAP_FRAMECACHE_ENTRIES; i++ )
+			cache->entries[i].stamp = 0;
+		cache->stamp = 1;
+	}
+
+	cache->frameNum = frameNum;
+	cache->datasize = 0;
+	cache->numEntries = 0;
+	cache->stats.frames++;
+}
+
+/*
+* SNAP_FrameCacheFindEntry
+*/
+static snap_framecache_entry_t *SNAP_FrameCacheFindEntry( snap_framecache_t *cache, unsigned shareKey, unsigned deltaShareKey, bool bitpacked )
+{
+	int i;
+	snap_framecache_entry_t *entry;
+
+	for( i = 0, entry = cache->entries; i < cache->numEntries; i++, entry++ )
+	{
+		if( entry->stamp == cache->stamp && entry->shareKey == shareKey &&
+			entry->deltaShareKey == deltaShareKey && entry->bitpacked == bitpacked )
+			return entry;
+	}
+
+	return NULL;
+}
+
+/*
+* SNAP_FrameCacheAddEntry
+*/
+static void SNAP_FrameCacheAddEntry( snap_framecache_t *cache, unsigned shareKey, unsigned deltaShareKey, bool bitpacked,
+	const uint8_t *data, unsigned length )
+{
+	snap_framecache_entry_t *entry;
+
+	if( cache->numEntries == SNAP_FRAMECACHE_ENTRIES || cache->datasize + length > SNAP_FRAMECACHE_DATASIZE )
+	{
+		cache->stats.overflows++;
+		return;
+	}
+
+	entry = &cache->entries[cache->numEntries++];
+	entry->stamp = cache->stamp;
+	entry->shareKey = shareKey;
+	entry->deltaShareKey = deltaShareKey;
+	entry->bitpacked = bitpacked;
+	entry->offset = cache->datasize;
+	entry->length = length;
+	memcpy( cache->data + cache->datasize, data, length );
+	cache->datasize += length;
+}
+
+/*
+* SNAP_WriteFrameSnapBody
+*
+* Everything in the frame that follows the header. Returns false if game commands
+* were left out for lack of room, the body then depends on what came before it
+* in the message and can't be shared.
+*/
+static bool SNAP_WriteFrameSnapBody( ginfo_t *gi, client_t *client, msg_t *msg, unsigned int frameNum,
+									client_snapshot_t *frame, client_snapshot_t *oldframe,
+									entity_state_t *baselines, client_entities_t *client_entities,
+									int numcmds, gcommand_t *commands, const char *commandsData,
+									snap_deltacache_t *deltaCache )
+{
+	int i, index, skipped = 0;
+
+	// add game comands
+	MSG_WriteByte( msg, svc_gamecommands );
+	if( frame->multipov )
+	{
+		if( frame->relay )
+			skipped = SNAP_RelayMultiPOVCommands( gi, client, msg, numcmds, commands, commandsData );
+		else
+			SNAP_WriteMultiPOVCommands( gi, client, msg, frameNum );
+	}
+	else
+	{
+		for( i = client->gameCommandCurrent - MAX_RELIABLE_COMMANDS + 1; i <= client->gameCommandCurrent; i++ )
+		{
+			index = i & ( MAX_RELIABLE_COMMANDS - 1 );
+
+			// check that it is valid command and that has not already been sent
+			// we can only allow commands from certain amount of old frames, so the short won't overflow
+			if( !client->gameCommands[index].command[0] || client->gameCommands[index].framenum + 256 < frameNum ||
+				client->gameCommands[index].framenum > frameNum ||
+				( client->lastframe >= 0 && client->gameCommands[index].framenum <= (unsigned)client->lastframe ) )
+				continue;
+
+			// do not allow the message buffer to overflow (can happen on flood updates)
+			if( msg->cursize + strlen( client->gameCommands[index].command ) + 512 > msg->maxsize )
+			{
+				skipped++;
+				continue;
+			}
+
+			// send it
+			MSG_WriteShort( msg, frameNum - client->gameCommands[index].framenum );
+			MSG_WriteString( msg, client->gameCommands[index].command );
+		}
+	}
+	MSG_WriteShort( msg, -1 );
+
+	// send over the areabits
+	MSG_WriteByte( msg, frame->areabytes );
+	MSG_WriteData( msg, frame->areabits, frame->areabytes );
+
+	SNAP_WriteDeltaGameStateToClient( oldframe, frame, msg );
+
+	// delta encode the playerstate
+	for( i = 0; i < frame->numplayers; i++ )
+	{
+		player_state_t *ops = ( oldframe && oldframe->numplayers > i ) ? &oldframe->ps[i] : NULL;
+
+		if( client->bitpacked )
+			SNAP_WritePlayerstateBitsToClient( ops, &frame->ps[i], msg );
+		else
+			SNAP_WritePlayerstateToClient( ops, &frame->ps[i], msg );
+	}
+	MSG_WriteByte( msg, 0 );
+
+	// delta encode the entities
+	if( deltaCache )
+		SNAP_DeltaCacheBeginFrame( deltaCache, frameNum );
+	SNAP_EmitPacketEntities( gi, oldframe, client->lastframe, frame, msg, baselines,
+		client_entities ? client_entities->entities : NULL, client_entities ? client_entities->num_entities : 0, deltaCache, client->bitpacked );
+
+	return skipped == 0;
+}
+
+/*
+* SNAP_WriteFrameSnapToClient
+*/
+void SNAP_WriteFrameSnapToClient( ginfo_t *gi, client_t *client, msg_t *msg, unsigned int frameNum, unsigned int gameTime,
+								 entity_state_t *baselines, client_entities_t *client_entities,
+								 int numcmds, gcommand_t *commands, const char *commandsData,
+								 snap_deltacache_t *deltaCache, snap_framecache_t *frameCache )
+{
+	client_snapshot_t *frame, *oldframe;
+	int flags, pos, length, supcnt;
+	unsigned bodystart, deltaShareKey;
+	bool complete;
+	snap_framecache_entry_t *entry;
+
+	// this is the frame we are creating
 	frame = &client->snapShots[frameNum & UPDATE_MASK];
 
 	// for non-reliable clients we need to send nodelta frame until the client responds
@@ -685,6 +1343,8 @@ void SNAP_WriteFrameSnapToClient( ginfo_t *gi, client_t *client, msg_t *msg, uns
 		flags |= FRAMESNAP_FLAG_ALLENTITIES;
 	if( frame->multipov )
 		flags |= FRAMESNAP_FLAG_MULTIPOV;
+	if( client->bitpacked )
+		flags |= FRAMESNAP_FLAG_BITPACKED;
 	MSG_WriteByte( msg, flags );
 
 	supcnt = client->suppressCount;
@@ -694,57 +1354,38 @@ void SNAP_WriteFrameSnapToClient( ginfo_t *gi, client_t *client, msg_t *msg, uns
 	client->suppressCount = 0;
 	MSG_WriteByte( msg, supcnt );	// rate dropped packets
 
-	// add game comands
-	MSG_WriteByte( msg, svc_gamecommands );
-	if( frame->multipov )
+	// frames sharing contents with a frame that was already encoded get a copy of it
+	if( frameCache && frame->shareKey && frame->multipov && frame->relay && ( !oldframe || oldframe->shareKey ) )
 	{
-		if( frame->relay )
-			SNAP_RelayMultiPOVCommands( gi, client, msg, numcmds, commands, commandsData );
+		SNAP_FrameCacheBeginFrame( frameCache, frameNum );
+		frameCache->stats.lookups++;
+
+		deltaShareKey = oldframe ? oldframe->shareKey : 0;
+		entry = SNAP_FrameCacheFindEntry( frameCache, frame->shareKey, deltaShareKey, client->bitpacked );
+		if( entry && msg->cursize + entry->length <= msg->maxsize )
+		{
+			MSG_WriteData( msg, frameCache->data + entry->offset, entry->length );
+			frameCache->stats.hits++;
+			frameCache->stats.bytesSaved += entry->length;
+		}
 		else
-			SNAP_WriteMultiPOVCommands( gi, client, msg, frameNum );
-	}
-	else
-	{
-		for( i = client->gameCommandCurrent - MAX_RELIABLE_COMMANDS + 1; i <= client->gameCommandCurrent; i++ )
 		{
-			index = i & ( MAX_RELIABLE_COMMANDS - 1 );
-
-			// check that it is valid command and that has not already been sent
-			// we can only allow commands from certain amount of old frames, so the short won't overflow
-			if( !client->gameCommands[index].command[0] || client->gameCommands[index].framenum + 256 < frameNum ||
-				client->gameCommands[index].framenum > frameNum ||
-				( client->lastframe >= 0 && client->gameCommands[index].framenum <= (unsigned)client->lastframe ) )
-				continue;
-
-			// do not allow the message buffer to overflow (can happen on flood updates)
-			if( msg->cursize + strlen( client->gameCommands[index].command ) + 512 > msg->maxsize )
-				continue;
-
-			// send it
-			MSG_WriteShort( msg, frameNum - client->gameCommands[index].framenum );
-			MSG_WriteString( msg, client->gameCommands[index].command );
+			bodystart = msg->cursize;
+			complete = SNAP_WriteFrameSnapBody( gi, client, msg, frameNum, frame, oldframe, baselines, client_entities,
+				numcmds, commands, commandsData, deltaCache );
+			frameCache->stats.bytesEncoded += msg->cursize - bodystart;
+
+			// a body missing commands only fitted this client's message
+			if( !entry && complete )
+				SNAP_FrameCacheAddEntry( frameCache, frame->shareKey, deltaShareKey, client->bitpacked,
+					msg->data + bodystart, msg->cursize - bodystart );
 		}
 	}
-	MSG_WriteShort( msg, -1 );
-
-	// send over the areabits
-	MSG_WriteByte( msg, frame->areabytes );
-	MSG_WriteData( msg, frame->areabits, frame->areabytes );
-
-	SNAP_WriteDeltaGameStateToClient( oldframe, frame, msg );
-
-	// delta encode the playerstate
-	for( i = 0; i < frame->numplayers; i++ )
+	else
 	{
-		if( oldframe && oldframe->numplayers > i )
-			SNAP_WritePlayerstateToClient( &oldframe->ps[i], &frame->ps[i], msg );
-		else
-			SNAP_WritePlayerstateToClient( NULL, &frame->ps[i], msg );
+		SNAP_WriteFrameSnapBody( gi, client, msg, frameNum, frame, oldframe, baselines, client_entities,
+			numcmds, commands, commandsData, deltaCache );
 	}
-	MSG_WriteByte( msg, 0 );
-
-	// delta encode the entities
-	SNAP_EmitPacketEntities( gi, oldframe, frame, msg, baselines, client_entities ? client_entities->entities : NULL, client_entities ? client_entities->num_entities : 0 );
 
 	// write length into reserved space
 	length = msg->cursize - pos - 2;
@@ -805,10 +1446,10 @@ static bool SNAP_BitsCullEntity( cmodel_state_t *cms, edict_t *ent, uint8_t *bit
 
 //=====================================================================
 
-#define	MAX_SNAPSHOT_ENTITIES	1024
 typedef struct
 {
 	int numSnapshotEntities;
+	int maxSnapshotEntities;		// MAX_SNAPSHOT_ENTITIES, but for SNAP_CheckClientEntitiesList
 	int snapshotEntities[MAX_SNAPSHOT_ENTITIES];
 	int entityAddedToSnapList[MAX_EDICTS];
 } snapshotEntityNumbers_t;
@@ -818,7 +1459,7 @@ typedef struct
 */
 static void SNAP_AddEntNumToSnapList( int entNum, snapshotEntityNumbers_t *entsList )
 {
-	if( entsList->numSnapshotEntities >= MAX_SNAPSHOT_ENTITIES )  // silent ignore of overflood
+	if( entsList->numSnapshotEntities >= entsList->maxSnapshotEntities )  // silent ignore of overflood
 		return;
 
 	// don't double add entities
@@ -965,14 +1606,359 @@ static bool SNAP_SnapCullEntity( cmodel_state_t *cms, edict_t *ent, edict_t *cle
 	return snd_culled && SNAP_PVSCullEntity( cms, fatpvs, ent );	// cull by PVS
 }
 
+/*
+* SNAP_AddEntToSnapList
+*
+* Adds the entity and, if it's forcing its owner to be sent too, the owner.
+*/
+static void SNAP_AddEntToSnapList( ginfo_t *gi, edict_t *ent, snapshotEntityNumbers_t *entsList )
+{
+	SNAP_AddEntNumToSnapList( ent->s.number, entsList );
+
+	if( ent->r.svflags & SVF_FORCEOWNER )
+	{
+		// make sure owner number is valid too
+		if( ent->s.ownerNum > 0 && ent->s.ownerNum < gi->num_edicts )
+		{
+			SNAP_AddEntNumToSnapList( ent->s.ownerNum, entsList );
+		}
+		else
+		{
+			Com_Printf( "FIXING ENT->S.OWNERNUM: %i %i!!!\n", ent->s.type, ent->s.ownerNum );
+			ent->s.ownerNum = 0;
+		}
+	}
+}
+
+/*
+=========================================================================
+
+Per-frame visibility cache
+
+Clients that share a PVS cluster and see the same areas end up with the
+same merged PVS, so the result of culling is the same for all entities
+that don't care who's looking at them. At the start of a frame entities
+are split into those shared ones and the ones that depend on the viewer
+(team and owner filters, sound attenuation). The shared ones are culled
+once per distinct merged PVS and area row, the rest are still culled for
+every client.
+
+=========================================================================
+*/
+
+#define SNAP_VISCACHE_ENTRIES		16
+
+typedef struct
+{
+	unsigned stamp;					// the entry is valid only for the cache's current stamp
+	unsigned hash;
+	int clientarea;
+	uint8_t *vis;					// merged PVS followed by the client area row
+	int numEntities;
+	int entities[MAX_EDICTS];
+} snap_viscache_entry_t;
+
+struct snap_viscache_s
+{
+	mempool_t *mempool;
+	unsigned stamp;					// bumped every frame, 0 is never valid
+	unsigned frameNum;
+	int numEdicts;
+	int pvsSize, areaSize;
+	unsigned nextEntry;
+
+	int numPortals;
+	int portals[MAX_EDICTS];
+	int numShared;
+	int shared[MAX_EDICTS];			// culled by visibility alone
+	int numViewer;
+	int viewer[MAX_EDICTS];			// culled for each client
+
+	snap_viscache_stats_t stats;
+	snap_viscache_entry_t entries[SNAP_VISCACHE_ENTRIES];
+};
+
+/*
+* SNAP_CreateVisCache
+*/
+snap_viscache_t *SNAP_CreateVisCache( mempool_t *mempool )
+{
+	snap_viscache_t *cache;
+
+	cache = ( snap_viscache_t * )Mem_Alloc( mempool, sizeof( *cache ) );
+	cache->mempool = mempool;
+	return cache;
+}
+
+/*
+* SNAP_FreeVisCache
+*/
+void SNAP_FreeVisCache( snap_viscache_t **pcache )
+{
+	int i;
+	snap_viscache_t *cache;
+
+	if( !pcache || !*pcache )
+		return;
+
+	cache = *pcache;
+	for( i = 0; i < SNAP_VISCACHE_ENTRIES; i++ )
+	{
+		if( cache->entries[i].vis )
+			Mem_Free( cache->entries[i].vis );
+	}
+	Mem_Free( cache );
+	*pcache = NULL;
+}
+
+/*
+* SNAP_VisCacheStats
+*/
+const snap_viscache_stats_t *SNAP_VisCacheStats( const snap_viscache_t *cache )
+{
+	return &cache->stats;
+}
+
+/*
+* SNAP_ResetVisCacheStats
+*/
+void SNAP_ResetVisCacheStats( snap_viscache_t *cache )
+{
+	memset( &cache->stats, 0, sizeof( cache->stats ) );
+}
+
+/*
+* SNAP_ViewerDependentEntity
+*
+* Whether SNAP_SnapCullEntity may give different answers to two clients
+* with the same merged PVS and area bits. Follows the order of the tests
+* in SNAP_SnapCullEntity.
+*/
+static bool SNAP_ViewerDependentEntity( edict_t *ent )
+{
+	if( ent->r.svflags & SVF_NOCLIENT )
+		return false;
+	if( ent->r.svflags & ( SVF_ONLYTEAM|SVF_ONLYOWNER ) )
+		return true;
+	if( ent->r.svflags & SVF_BROADCAST )
+		return false;
+	if( ent->r.svflags & SVF_FORCETEAM )
+		return true;
+	if( ent->r.areanum < 0 )
+		return false;
+
+	// sound culling depends on the view origin
+	if( ent->r.svflags & SVF_SOUNDCULL )
+		return true;
+	if( ent->s.events[0] || ent->s.sound )
+		return true;
+	return false;
+}
+
+/*
+* SNAP_VisCacheBeginFrame
+*
+* Drops all cached lists and sorts entities into shared and viewer-dependent.
+*/
+static void SNAP_VisCacheBeginFrame( snap_viscache_t *cache, cmodel_state_t *cms, ginfo_t *gi, unsigned frameNum )
+{
+	int i, entNum;
+	int pvsSize, areaSize;
+	edict_t *ent;
+
+	if( cache->stamp && cache->frameNum == frameNum && cache->numEdicts == gi->num_edicts )
+		return;
+
+	// make sure no entry survives a stamp wraparound
+	if( !++cache->stamp )
+	{
+		for( i = 0; i < SNAP_VISCACHE_ENTRIES; i++ )
+			cache->entries[i].stamp = 0;
+		cache->stamp = 1;
+	}
+
+	cache->frameNum = frameNum;
+	cache->numEdicts = gi->num_edicts;
+	cache->nextEntry = 0;
+	cache->stats.frames++;
+
+	pvsSize = CM_ClusterRowSize( cms );
+	areaSize = CM_AreaRowSize( cms );
+	if( cache->pvsSize != pvsSize || cache->areaSize != areaSize )
+	{
+		for( i = 0; i < SNAP_VISCACHE_ENTRIES; i++ )
+		{
+			if( cache->entries[i].vis )
+				Mem_Free( cache->entries[i].vis );
+			cache->entries[i].vis = ( uint8_t * )Mem_Alloc( cache->mempool, pvsSize + areaSize );
+			cache->entries[i].stamp = 0;
+		}
+		cache->pvsSize = pvsSize;
+		cache->areaSize = areaSize;
+	}
+
+	cache->numPortals = cache->numShared = cache->numViewer = 0;
+	for( entNum = 1; entNum < gi->num_edicts; entNum++ )
+	{
+		ent = EDICT_NUM( entNum );
+
+		// fix number if broken
+		if( ent->s.number != entNum )
+		{
+			Com_Printf( "FIXING ENT->S.NUMBER: %i %i!!!\n", ent->s.number, entNum );
+			ent->s.number = entNum;
+		}
+
+		if( ent->r.svflags & SVF_NOCLIENT )
+			continue;
+
+		if( ent->r.svflags & SVF_PORTAL )
+			cache->portals[cache->numPortals++] = entNum;
+
+		if( SNAP_ViewerDependentEntity( ent ) )
+			cache->viewer[cache->numViewer++] = entNum;
+		else
+			cache->shared[cache->numShared++] = entNum;
+	}
+}
+
+/*
+* SNAP_VisCacheFindEntry
+*
+* Returns the entry culled for the given merged PVS and area row, culling
+* the shared entities into a new entry if there's none yet.
+*/
+static snap_viscache_entry_t *SNAP_VisCacheFindEntry( snap_viscache_t *cache, cmodel_state_t *cms, ginfo_t *gi, edict_t *clent, client_snapshot_t *frame, vec3_t vieworg, uint8_t *fatpvs )
+{
+	int i;
+	unsigned hash;
+	uint8_t *areabits;
+	snap_viscache_entry_t *entry;
+
+	areabits = frame->areabits + frame->clientarea * cache->areaSize;
+
+	hash = 5381 + frame->clientarea;
+	for( i = 0; i < cache->pvsSize; i++ )
+		hash = hash * 33 + fatpvs[i];
+	for( i = 0; i < cache->areaSize; i++ )
+		hash = hash * 33 + areabits[i];
+
+	cache->stats.lookups++;
+
+	for( i = 0; i < SNAP_VISCACHE_ENTRIES; i++ )
+	{
+		entry = &cache->entries[i];
+		if( entry->stamp != cache->stamp || entry->hash != hash || entry->clientarea != frame->clientarea )
+			continue;
+		if( memcmp( entry->vis, fatpvs, cache->pvsSize ) || memcmp( entry->vis + cache->pvsSize, areabits, cache->areaSize ) )
+			continue;
+
+		cache->stats.hits++;
+		cache->stats.entitiesReused += cache->numShared;
+		return entry;
+	}
+
+	// replace entries in order, the oldest one is the least likely to be needed again
+	entry = &cache->entries[cache->nextEntry++ % SNAP_VISCACHE_ENTRIES];
+	entry->stamp = cache->stamp;
+	entry->hash = hash;
+	entry->clientarea = frame->clientarea;
+	memcpy( entry->vis, fatpvs, cache->pvsSize );
+	memcpy( entry->vis + cache->pvsSize, areabits, cache->areaSize );
+
+	// the shared entities don't look at the viewer, so clent doesn't matter here
+	entry->numEntities = 0;
+	for( i = 0; i < cache->numShared; i++ )
+	{
+		if( !SNAP_SnapCullEntity( cms, EDICT_NUM( cache->shared[i] ), clent, frame, vieworg, fatpvs ) )
+			entry->entities[entry->numEntities++] = cache->shared[i];
+	}
+	cache->stats.entitiesCulled += cache->numShared;
+
+	return entry;
+}
+
+/*
+* SNAP_BuildSnapEntitiesListCached
+*
+* SNAP_BuildSnapEntitiesList for a client with a known area, reusing the
+* shared entities culled for an earlier client with the same view.
+*/
+static void SNAP_BuildSnapEntitiesListCached( snap_viscache_t *cache, cmodel_state_t *cms, ginfo_t *gi, unsigned frameNum, edict_t *clent, vec3_t vieworg, vec3_t skyorg, uint8_t *fatpvs, client_snapshot_t *frame, snapshotEntityNumbers_t *entsList )
+{
+	int i, j, clientarea = frame->clientarea;
+	int clentNum;
+	bool culled, clentAdded;
+	edict_t *ent;
+	snap_viscache_entry_t *entry;
+
+	SNAP_VisCacheBeginFrame( cache, cms, gi, frameNum );
+
+	// merge PVS for sky portal and portal entities
+	if( skyorg )
+		CM_MergeVisSets( cms, skyorg, fatpvs, frame->areabits + clientarea * CM_AreaRowSize( cms ) );
+
+	for( i = 0; i < cache->numPortals; i++ )
+	{
+		ent = EDICT_NUM( cache->portals[i] );
+		if( SNAP_SnapCullEntity( cms, ent, clent, frame, vieworg, fatpvs ) )
+			continue;
+
+		if( !VectorCompare( ent->s.origin, ent->s.origin2 ) )
+			CM_MergeVisSets( cms, ent->s.origin2, fatpvs, frame->areabits + clientarea * CM_AreaRowSize( cms ) );
+	}
+
+	entry = SNAP_VisCacheFindEntry( cache, cms, gi, clent, frame, vieworg, fatpvs );
+
+	// merge both sorted lists and the client entity, so entities are added in the
+	// same order as SNAP_BuildSnapEntitiesList does and a full list cuts the same ones
+	clentNum = NUM_FOR_EDICT( clent );
+	clentAdded = false;
+	i = j = 0;
+	while( i < entry->numEntities || j < cache->numViewer )
+	{
+		if( j >= cache->numViewer || ( i < entry->numEntities && entry->entities[i] < cache->viewer[j] ) )
+		{
+			ent = EDICT_NUM( entry->entities[i++] );
+
+			// the game may have freed it while sending to earlier clients
+			culled = ( ent->r.svflags & SVF_NOCLIENT ) ? true : false;
+		}
+		else
+		{
+			ent = EDICT_NUM( cache->viewer[j++] );
+			culled = ent != clent && SNAP_SnapCullEntity( cms, ent, clent, frame, vieworg, fatpvs );
+		}
+
+		// always add the client entity, even if SVF_NOCLIENT
+		if( !clentAdded && ent->s.number >= clentNum )
+		{
+			SNAP_AddEntToSnapList( gi, clent, entsList );
+			clentAdded = true;
+		}
+
+		if( ent == clent || culled )
+			continue;
+
+		SNAP_AddEntToSnapList( gi, ent, entsList );
+	}
+	cache->stats.entitiesCulled += cache->numViewer;
+
+	if( !clentAdded )
+		SNAP_AddEntToSnapList( gi, clent, entsList );
+
+	SNAP_SortSnapList( entsList );
+}
+
 /*
 * SNAP_BuildSnapEntitiesList
 */
-static void SNAP_BuildSnapEntitiesList( cmodel_state_t *cms, ginfo_t *gi, edict_t *clent, vec3_t vieworg, vec3_t skyorg, uint8_t *fatpvs, client_snapshot_t *frame, snapshotEntityNumbers_t *entsList )
+static void SNAP_BuildSnapEntitiesList( cmodel_state_t *cms, ginfo_t *gi, unsigned int frameNum, edict_t *clent, vec3_t vieworg, vec3_t skyorg, fatvis_t *fatvis, client_snapshot_t *frame, snapshotEntityNumbers_t *entsList )
 {
 	int leafnum = -1, clusternum = -1, clientarea = -1;
 	int entNum;
 	edict_t	*ent;
+	uint8_t *fatpvs = fatvis->pvs;
 
 	// find the client's PVS
 	if( frame->allentities )
@@ -1009,6 +1995,12 @@ static void SNAP_BuildSnapEntitiesList( cmodel_state_t *cms, ginfo_t *gi, edict_
 		}
 	}
 
+	if( fatvis->viscache && clent && !frame->allentities && clientarea >= 0 )
+	{
+		SNAP_BuildSnapEntitiesListCached( fatvis->viscache, cms, gi, frameNum, clent, vieworg, skyorg, fatpvs, frame, entsList );
+		return;
+	}
+
 	// no need of merging when we are sending the whole level
 	if( !frame->allentities && clientarea >= 0 )
 	{
@@ -1048,42 +2040,31 @@ static void SNAP_BuildSnapEntitiesList( cmodel_state_t *cms, ginfo_t *gi, edict_
 			continue;
 
 		// add it
-		SNAP_AddEntNumToSnapList( entNum, entsList );
-
-		if( ent->r.svflags & SVF_FORCEOWNER )
-		{
-			// make sure owner number is valid too
-			if( ent->s.ownerNum > 0 && ent->s.ownerNum < gi->num_edicts )
-			{
-				SNAP_AddEntNumToSnapList( ent->s.ownerNum, entsList );
-			}
-			else
-			{
-				Com_Printf( "FIXING ENT->S.OWNERNUM: %i %i!!!\n", ent->s.type, ent->s.ownerNum );
-				ent->s.ownerNum = 0;
-			}
-		}
+		SNAP_AddEntToSnapList( gi, ent, entsList );
 	}
 
 	SNAP_SortSnapList( entsList );
 }
 
 /*
-* SNAP_BuildClientFrameSnap
+* SNAP_BuildClientFrameSnapList
 *
 * Decides which entities are going to be visible to the client, and
-* copies off the playerstat and areabits.
+* copies off the playerstat and areabits. The sorted entity numbers are
+* stored in snapEntities, which must hold MAX_SNAPSHOT_ENTITIES numbers.
+* Only touches the client's own frame, so different clients can be
+* processed in parallel as long as each thread has its own fatvis.
+*
+* Returns the number of entities or -1 if the client is not in game yet.
 */
-void SNAP_BuildClientFrameSnap( cmodel_state_t *cms, ginfo_t *gi, unsigned int frameNum, unsigned int timeStamp,
-							   fatvis_t *fatvis, client_t *client,
-							   game_state_t *gameState, client_entities_t *client_entities,
-							   bool relay, mempool_t *mempool )
+int SNAP_BuildClientFrameSnapList( cmodel_state_t *cms, ginfo_t *gi, unsigned int frameNum, unsigned int timeStamp,
+								  fatvis_t *fatvis, client_t *client, game_state_t *gameState,
+								  bool relay, mempool_t *mempool, int *snapEntities )
 {
-	int e, i, ne;
+	int e, i;
 	vec3_t org;
 	edict_t	*ent, *clent;
 	client_snapshot_t *frame;
-	entity_state_t *state;
 	int numplayers, numareas;
 	snapshotEntityNumbers_t entsList;
 
@@ -1091,7 +2072,7 @@ void SNAP_BuildClientFrameSnap( cmodel_state_t *cms, ginfo_t *gi, unsigned int f
 
 	clent = client->edict;
 	if( clent && !clent->r.client )		// allow NULL ent for server record
-		return;		// not in game yet
+		return -1;		// not in game yet
 
 	if( clent )
 	{
@@ -1152,6 +2133,8 @@ void SNAP_BuildClientFrameSnap( cmodel_state_t *cms, ginfo_t *gi, unsigned int f
 		frame->numplayers = 1;
 	}
 
+	// frames are reused from the client's backup ring, so only grow the arrays. Multiview
+	// frames get room for everyone at once, or every player joining would realloc them
 	if( frame->ps_size < frame->numplayers )
 	{
 		if( frame->ps )
@@ -1160,8 +2143,8 @@ void SNAP_BuildClientFrameSnap( cmodel_state_t *cms, ginfo_t *gi, unsigned int f
 			frame->ps = NULL;
 		}
 
-		frame->ps = ( player_state_t* )Mem_Alloc( mempool, sizeof( player_state_t )*frame->numplayers );
-		frame->ps_size = frame->numplayers;
+		frame->ps_size = frame->multipov ? max( frame->numplayers, gi->max_clients ) : frame->numplayers;
+		frame->ps = ( player_state_t* )Mem_Alloc( mempool, sizeof( player_state_t )*frame->ps_size );
 	}
 
 	if( frame->multipov )
@@ -1187,8 +2170,9 @@ void SNAP_BuildClientFrameSnap( cmodel_state_t *cms, ginfo_t *gi, unsigned int f
 	// build up the list of visible entities
 	//=============================
 	entsList.numSnapshotEntities = 0;
+	entsList.maxSnapshotEntities = MAX_SNAPSHOT_ENTITIES;
 	memset( entsList.entityAddedToSnapList, 0, sizeof( entsList.entityAddedToSnapList ) );
-	SNAP_BuildSnapEntitiesList( cms, gi, clent, org, fatvis->skyorg, fatvis->pvs, frame, &entsList );
+	SNAP_BuildSnapEntitiesList( cms, gi, frameNum, clent, org, fatvis->skyorg, fatvis, frame, &entsList );
 
 	//Com_Printf( "Snap NumEntities:%i\n", entsList.numSnapshotEntities );
 
@@ -1206,17 +2190,100 @@ void SNAP_BuildClientFrameSnap( cmodel_state_t *cms, ginfo_t *gi, unsigned int f
 	// store current match state information
 	frame->gameState = *gameState;
 
-	//=============================
+	memcpy( snapEntities, entsList.snapshotEntities, entsList.numSnapshotEntities * sizeof( int ) );
+	return entsList.numSnapshotEntities;
+}
+
+/*
+* SNAP_CheckClientEntitiesList
+*
+* Builds the entity list of a client that is already in game with and without
+* the visibility cache, as is and capped just below its size, where the order
+* entities are added in decides which get cut. Returns the number of lists that
+* differ, or -1 if the client can't be checked.
+*/
+int SNAP_CheckClientEntitiesList( cmodel_state_t *cms, ginfo_t *gi, unsigned int frameNum,
+								 fatvis_t *fatvis, client_t *client )
+{
+	int i, j, limit, numDiffering;
+	int limits[3];
+	vec3_t org;
+	edict_t *clent;
+	client_snapshot_t *frame;
+	snap_viscache_t *viscache;
+	snapshotEntityNumbers_t *lists;
+
+	clent = client->edict;
+	frame = &client->snapShots[frameNum & UPDATE_MASK];
+	if( !clent || !clent->r.client || client->mv || !fatvis->viscache || !frame->areabits )
+		return -1;
+
+	VectorCopy( clent->s.origin, org );
+	org[2] += clent->r.client->ps.viewheight;
+
+	lists = Mem_TempMalloc( sizeof( *lists ) * 2 );
+	viscache = fatvis->viscache;
+	numDiffering = 0;
+
+	limits[0] = MAX_SNAPSHOT_ENTITIES;
+	for( i = 0; i < 3; i++ )
+	{
+		limit = limits[i];
+
+		for( j = 0; j < 2; j++ )
+		{
+			lists[j].numSnapshotEntities = 0;
+			lists[j].maxSnapshotEntities = limit;
+			memset( lists[j].entityAddedToSnapList, 0, sizeof( lists[j].entityAddedToSnapList ) );
+
+			fatvis->viscache = j ? viscache : NULL;
+			SNAP_BuildSnapEntitiesList( cms, gi, frameNum, clent, org, fatvis->skyorg, fatvis, frame, &lists[j] );
+		}
+		fatvis->viscache = viscache;
+
+		if( lists[0].numSnapshotEntities != lists[1].numSnapshotEntities ||
+			memcmp( lists[0].snapshotEntities, lists[1].snapshotEntities, lists[0].numSnapshotEntities * sizeof( int ) ) )
+			numDiffering++;
+
+		if( !i )
+		{
+			// the uncapped size tells where the boundary is
+			limits[1] = max( lists[0].numSnapshotEntities - 1, 1 );
+			limits[2] = max( lists[0].numSnapshotEntities / 2, 1 );
+		}
+	}
+
+	Mem_TempFree( lists );
+	return numDiffering;
+}
 
-	// dump the entities list
-	ne = client_entities->next_entities;
+/*
+* SNAP_DumpClientFrameSnapEntities
+*
+* Copies the states of the listed entities into the circular client_entities
+* array, starting at first_entity. The caller is responsible for handing out
+* non-overlapping ranges when several clients are dumped in parallel.
+*/
+void SNAP_DumpClientFrameSnapEntities( ginfo_t *gi, client_t *client, unsigned int frameNum,
+									  client_entities_t *client_entities, unsigned first_entity,
+									  const int *snapEntities, int numSnapEntities )
+{
+	int e;
+	unsigned ne;
+	edict_t *ent;
+	client_snapshot_t *frame;
+	entity_state_t *state;
+
+	frame = &client->snapShots[frameNum & UPDATE_MASK];
+
+	ne = first_entity;
 	frame->num_entities = 0;
 	frame->first_entity = ne;
 
-	for( e = 0; e < entsList.numSnapshotEntities; e++ )
+	for( e = 0; e < numSnapEntities; e++ )
 	{
 		// add it to the circular client_entities array
-		ent = EDICT_NUM( entsList.snapshotEntities[e] );
+		ent = EDICT_NUM( snapEntities[e] );
 		state = &client_entities->entities[ne%client_entities->num_entities];
 
 		*state = ent->s;
@@ -1229,10 +2296,30 @@ void SNAP_BuildClientFrameSnap( cmodel_state_t *cms, ginfo_t *gi, unsigned int f
 		frame->num_entities++;
 		ne++;
 	}
+}
 
-	client_entities->next_entities = ne;
+/*
+* SNAP_BuildClientFrameSnap
+*/
+void SNAP_BuildClientFrameSnap( cmodel_state_t *cms, ginfo_t *gi, unsigned int frameNum, unsigned int timeStamp,
+							   fatvis_t *fatvis, client_t *client,
+							   game_state_t *gameState, client_entities_t *client_entities,
+							   bool relay, mempool_t *mempool )
+{
+	int numSnapEntities;
+	int snapEntities[MAX_SNAPSHOT_ENTITIES];
+
+	numSnapEntities = SNAP_BuildClientFrameSnapList( cms, gi, frameNum, timeStamp, fatvis, client,
+		gameState, relay, mempool, snapEntities );
+	if( numSnapEntities < 0 )
+		return;
+
+	SNAP_DumpClientFrameSnapEntities( gi, client, frameNum, client_entities, client_entities->next_entities,
+		snapEntities, numSnapEntities );
+	client_entities->next_entities += numSnapEntities;
 }
 
+
 /*
 * SNAP_FreeClientFrame
 *
@@ -24,13 +24,16 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 int Sys_Thread_Create( qthread_t **pthread, void *(*routine) (void*), void *param );
 void Sys_Thread_Join( qthread_t *thread );
 void Sys_Thread_Yield( void );
+uintptr_t Sys_Thread_Id( void );
 
 int Sys_Mutex_Create( qmutex_t **pmutex );
 void Sys_Mutex_Destroy( qmutex_t *mutex );
 void Sys_Mutex_Lock( qmutex_t *mutex );
+bool Sys_Mutex_TryLock( qmutex_t *mutex );
 void Sys_Mutex_Unlock( qmutex_t *mutex );
 int Sys_Atomic_Add( volatile int *value, int add, qmutex_t *mutex );
 bool Sys_Atomic_CAS( volatile int *value, int oldval, int newval, qmutex_t *mutex );
+bool Sys_Atomic_CASPtr( void * volatile *value, void *oldval, void *newval, qmutex_t *mutex );
 
 int Sys_CondVar_Create( qcondvar_t **pcond );
 void Sys_CondVar_Destroy( qcondvar_t *cond );
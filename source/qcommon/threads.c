@@ -21,6 +21,14 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "qcommon.h"
 #include "sys_threads.h"
 
+#define QTHREAD_MAX_HELD_MUTEXES	16
+
+#ifdef ATTRIBUTE_THREAD_LOCAL
+// mutexes held by the calling thread in locking order, see QMutex_UnlockHeld
+static ATTRIBUTE_THREAD_LOCAL qmutex_t *qthread_heldmutexes[QTHREAD_MAX_HELD_MUTEXES];
+static ATTRIBUTE_THREAD_LOCAL int qthread_numheldmutexes;
+#endif
+
 /*
 * QMutex_Create
 */
@@ -48,6 +56,43 @@ void QMutex_Destroy( qmutex_t **pmutex )
 	}
 }
 
+/*
+* QMutex_PushHeld
+*/
+static inline void QMutex_PushHeld( qmutex_t *mutex )
+{
+#ifdef ATTRIBUTE_THREAD_LOCAL
+	if( qthread_numheldmutexes < QTHREAD_MAX_HELD_MUTEXES ) {
+		qthread_heldmutexes[qthread_numheldmutexes] = mutex;
+	}
+	qthread_numheldmutexes++;
+#endif
+}
+
+/*
+* QMutex_PopHeld
+*/
+static inline void QMutex_PopHeld( qmutex_t *mutex )
+{
+#ifdef ATTRIBUTE_THREAD_LOCAL
+	int i, num;
+
+	if( qthread_numheldmutexes <= 0 ) {
+		return;
+	}
+
+	// mutexes are almost always released in reverse order, so search from the top
+	num = min( qthread_numheldmutexes, QTHREAD_MAX_HELD_MUTEXES );
+	for( i = num - 1; i >= 0; i-- ) {
+		if( qthread_heldmutexes[i] == mutex ) {
+			memmove( &qthread_heldmutexes[i], &qthread_heldmutexes[i+1], ( num - i - 1 ) * sizeof( qmutex_t * ) );
+			break;
+		}
+	}
+	qthread_numheldmutexes--;
+#endif
+}
+
 /*
 * QMutex_Lock
 */
@@ -55,6 +100,22 @@ void QMutex_Lock( qmutex_t *mutex )
 {
 	assert( mutex != NULL );
 	Sys_Mutex_Lock( mutex );
+	QMutex_PushHeld( mutex );
+}
+
+/*
+* QMutex_TryLock
+* 
+* Returns false instead of waiting if the mutex is already held.
+*/
+bool QMutex_TryLock( qmutex_t *mutex )
+{
+	assert( mutex != NULL );
+	if( !Sys_Mutex_TryLock( mutex ) ) {
+		return false;
+	}
+	QMutex_PushHeld( mutex );
+	return true;
 }
 
 /*
@@ -63,9 +124,47 @@ void QMutex_Lock( qmutex_t *mutex )
 void QMutex_Unlock( qmutex_t *mutex )
 {
 	assert( mutex != NULL );
+	QMutex_PopHeld( mutex );
 	Sys_Mutex_Unlock( mutex );
 }
 
+/*
+* QMutex_NumHeld
+* 
+* Returns the number of mutexes currently held by the calling thread.
+*/
+int QMutex_NumHeld( void )
+{
+#ifdef ATTRIBUTE_THREAD_LOCAL
+	return qthread_numheldmutexes;
+#else
+	return 0;
+#endif
+}
+
+/*
+* QMutex_UnlockHeld
+* 
+* Releases the mutexes the calling thread took after QMutex_NumHeld returned
+* the given number, newest first. Used to unwind a thread before a longjmp.
+*/
+void QMutex_UnlockHeld( int num )
+{
+#ifdef ATTRIBUTE_THREAD_LOCAL
+	qmutex_t *mutex;
+
+	while( qthread_numheldmutexes > num ) {
+		qthread_numheldmutexes--;
+		if( qthread_numheldmutexes >= QTHREAD_MAX_HELD_MUTEXES ) {
+			Com_Printf( S_COLOR_YELLOW "QMutex_UnlockHeld: lost track of a held mutex\n" );
+			continue;
+		}
+		mutex = qthread_heldmutexes[qthread_numheldmutexes];
+		Sys_Mutex_Unlock( mutex );
+	}
+#endif
+}
+
 /*
 * QCondVar_Create
 */
@@ -109,6 +208,30 @@ void QCondVar_Wake( qcondvar_t *cond )
 	Sys_CondVar_Wake( cond );
 }
 
+typedef struct
+{
+	void *(*routine) (void*);
+	void *param;
+} qthreadstart_t;
+
+/*
+* QThread_Start
+*/
+static void *QThread_Start( void *param )
+{
+	void *ret;
+	qthreadstart_t start = *( qthreadstart_t * )param;
+
+	free( param );
+
+	ret = start.routine( start.param );
+
+	// let another thread have its arenas
+	Mem_ThreadExit();
+
+	return ret;
+}
+
 /*
 * QThread_Create
 */
@@ -116,8 +239,16 @@ qthread_t *QThread_Create( void *(*routine) (void*), void *param )
 {
 	int ret;
 	qthread_t *thread;
+	qthreadstart_t *start;
+
+	start = malloc( sizeof( *start ) );
+	if( !start ) {
+		Sys_Error( "QThread_Create: out of memory" );
+	}
+	start->routine = routine;
+	start->param = param;
 
-	ret = Sys_Thread_Create( &thread, routine, param );
+	ret = Sys_Thread_Create( &thread, QThread_Start, start );
 	if( ret != 0 ) {
 		Sys_Error( "QThread_Create: failed with code %i", ret );
 	}
@@ -140,6 +271,16 @@ void QThread_Yield( void )
 	Sys_Thread_Yield();
 }
 
+/*
+* QThread_Id
+*
+* Identifies the calling thread, a new thread may get the id of one that has exited
+*/
+uintptr_t QThread_Id( void )
+{
+	return Sys_Thread_Id();
+}
+
 /*
 * QThreads_Init
 */
@@ -421,3 +562,225 @@ void QBufPipe_Wait( qbufPipe_t *pipe, int (*read)( qbufPipe_t *, unsigned( ** )(
 		}
 	}
 }
+
+// ============================================================================
+
+enum
+{
+	CMD_JOB_RUN,
+	CMD_JOB_QUIT,
+
+	NUM_JOB_CMDS
+};
+
+typedef struct
+{
+	int id;
+	unsigned thread;
+	unsigned first;
+	unsigned items;
+	qjobfunc_t job;
+	void *job_arg;
+} qjobRunCmd_t;
+
+typedef struct
+{
+	struct qjobpool_s *pool;
+	qbufPipe_t *queue;
+	qthread_t *thread;
+} qjobworker_t;
+
+typedef struct qjobpool_s
+{
+	unsigned numThreads;
+	void (*threadExit)( void );
+	qjobworker_t *workers;
+} qjobpool_t;
+
+static void *QJobPool_ThreadProc( void *param );
+
+/*
+* QJobPool_Create
+*
+* Starts a pool of numThreads worker threads, each with its own command queue.
+* threadExit, if not NULL, is called by every worker before it terminates.
+*/
+qjobpool_t *QJobPool_Create( unsigned numThreads, void (*threadExit)( void ) )
+{
+	unsigned i;
+	qjobpool_t *pool;
+
+	assert( numThreads > 0 );
+
+	pool = malloc( sizeof( *pool ) + numThreads * sizeof( qjobworker_t ) );
+	if( !pool ) {
+		Sys_Error( "QJobPool_Create: out of memory" );
+	}
+	pool->numThreads = numThreads;
+	pool->threadExit = threadExit;
+	pool->workers = ( qjobworker_t * )( pool + 1 );
+
+	for( i = 0; i < numThreads; i++ ) {
+		pool->workers[i].pool = pool;
+		pool->workers[i].queue = QBufPipe_Create( 0x4000, 1 );
+		pool->workers[i].thread = QThread_Create( QJobPool_ThreadProc, &pool->workers[i] );
+	}
+
+	return pool;
+}
+
+/*
+* QJobPool_Destroy
+*
+* Waits for the queued jobs to finish and stops the worker threads.
+*/
+void QJobPool_Destroy( qjobpool_t **ppool )
+{
+	unsigned i;
+	int cmd = CMD_JOB_QUIT;
+	qjobpool_t *pool;
+
+	assert( ppool != NULL );
+	if( !ppool || !*ppool ) {
+		return;
+	}
+
+	pool = *ppool;
+	*ppool = NULL;
+
+	for( i = 0; i < pool->numThreads; i++ ) {
+		QBufPipe_WriteCmd( pool->workers[i].queue, &cmd, sizeof( cmd ) );
+	}
+
+	QJobPool_Complete( pool );
+
+	for( i = 0; i < pool->numThreads; i++ ) {
+		QThread_Join( pool->workers[i].thread );
+		QBufPipe_Destroy( &pool->workers[i].queue );
+	}
+
+	free( pool );
+}
+
+/*
+* QJobPool_NumThreads
+*/
+unsigned QJobPool_NumThreads( const qjobpool_t *pool )
+{
+	return pool ? pool->numThreads : 0;
+}
+
+/*
+* QJobPool_Run
+*
+* Queues the job on the given worker thread. Jobs queued on the same thread
+* run in order.
+*/
+void QJobPool_Run( qjobpool_t *pool, unsigned thread, qjobfunc_t job, void *arg, unsigned first, unsigned items )
+{
+	qjobRunCmd_t cmd;
+
+	assert( thread < pool->numThreads );
+
+	cmd.id = CMD_JOB_RUN;
+	cmd.thread = thread;
+	cmd.first = first;
+	cmd.items = items;
+	cmd.job = job;
+	cmd.job_arg = arg;
+	QBufPipe_WriteCmd( pool->workers[thread].queue, &cmd, sizeof( cmd ) );
+}
+
+/*
+* QJobPool_Schedule
+*
+* Splits items in contiguous blocks, one per worker thread. The thread
+* index is passed to the job so it can pick its own scratch buffers.
+*/
+void QJobPool_Schedule( qjobpool_t *pool, qjobfunc_t job, void *arg, unsigned items )
+{
+	unsigned thread, first, last, block;
+
+	if( !items ) {
+		return;
+	}
+
+	block = ( items + pool->numThreads - 1 ) / pool->numThreads;
+
+	for( thread = 0, first = 0; first < items; thread++ ) {
+		last = first + block;
+		if( last > items ) {
+			last = items;
+		}
+
+		QJobPool_Run( pool, thread, job, arg, first, last - first );
+
+		first = last;
+	}
+}
+
+/*
+* QJobPool_Complete
+*
+* Blocks until all queued jobs are done.
+*/
+void QJobPool_Complete( qjobpool_t *pool )
+{
+	unsigned i;
+
+	for( i = 0; i < pool->numThreads; i++ ) {
+		QBufPipe_Finish( pool->workers[i].queue );
+	}
+}
+
+/*
+* QJobPool_HandleRunCmd
+*/
+static unsigned QJobPool_HandleRunCmd( const void *pcmd )
+{
+	const qjobRunCmd_t *cmd = pcmd;
+
+	cmd->job( cmd->first, cmd->items, cmd->thread, cmd->job_arg );
+
+	// jobs only run within a frame, so their scratch memory can go right away
+	Mem_ResetFrameArena();
+
+	return sizeof( *cmd );
+}
+
+/*
+* QJobPool_HandleQuitCmd
+*/
+static unsigned QJobPool_HandleQuitCmd( const void *pcmd )
+{
+	return 0;
+}
+
+/*
+* QJobPool_CmdsWaiter
+*/
+static int QJobPool_CmdsWaiter( qbufPipe_t *queue, unsigned( **cmdHandlers )( const void * ), bool timeout )
+{
+	return QBufPipe_ReadCmds( queue, cmdHandlers );
+}
+
+/*
+* QJobPool_ThreadProc
+*/
+static void *QJobPool_ThreadProc( void *param )
+{
+	qjobworker_t *worker = param;
+	unsigned (*cmdHandlers[NUM_JOB_CMDS])( const void * ) =
+	{
+		QJobPool_HandleRunCmd,
+		QJobPool_HandleQuitCmd,
+	};
+
+	QBufPipe_Wait( worker->queue, QJobPool_CmdsWaiter, cmdHandlers, Q_THREADS_WAIT_INFINITE );
+
+	if( worker->pool->threadExit ) {
+		worker->pool->threadExit();
+	}
+
+	return NULL;
+}
@@ -69,6 +69,14 @@ void Sys_Mutex_Lock( qmutex_t *mutex )
 	SDL_LockMutex(mutex->m);
 }
 
+/*
+* Sys_Mutex_TryLock
+*/
+bool Sys_Mutex_TryLock( qmutex_t *mutex )
+{
+	return SDL_TryLockMutex(mutex->m) == 0;
+}
+
 /*
 * Sys_Mutex_Unlock
 */
@@ -112,6 +120,14 @@ void Sys_Thread_Yield( void )
 	Sys_Sleep(0);
 }
 
+/*
+* Sys_Thread_Id
+*/
+uintptr_t Sys_Thread_Id( void )
+{
+	return ( uintptr_t )SDL_ThreadID();
+}
+
 /*
 * Sys_Atomic_Add
 */
@@ -125,7 +141,15 @@ int Sys_Atomic_Add( volatile int *value, int add, qmutex_t *mutex )
 */
 bool Sys_Atomic_CAS( volatile int *value, int oldval, int newval, qmutex_t *mutex )
 {
-	return SDL_AtomicCAS( ( SDL_atomic_t * )value, newval, oldval ) == SDL_TRUE;
+	return SDL_AtomicCAS( ( SDL_atomic_t * )value, oldval, newval ) == SDL_TRUE;
+}
+
+/*
+* Sys_Atomic_CASPtr
+*/
+bool Sys_Atomic_CASPtr( void * volatile *value, void *oldval, void *newval, qmutex_t *mutex )
+{
+	return SDL_AtomicCASPtr( ( void ** )value, oldval, newval ) == SDL_TRUE;
 }
 
 /*
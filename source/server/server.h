@@ -102,6 +102,7 @@ typedef struct
 	int first_entity;                   // into the circular sv.client_entities[]
 	unsigned int sentTimeStamp;         // time at what this frame snap was sent to the clients
 	unsigned int UcmdExecuted;
+	unsigned int shareKey;              // frames with the same non-zero key have the same contents
 	game_state_t gameState;
 } client_snapshot_t;
 
@@ -161,6 +162,7 @@ typedef struct client_s
 	int lastframe;                  // used for delta compression etc.
 	bool nodelta;               // send one non delta compressed frame trough
 	int nodelta_frame;              // when we get confirmation of this frame, the non-delta frame is trough
+	bool bitpacked;                 // client asked for bit-packed snapshots
 	unsigned int lastSentFrameNum;  // for knowing which was last frame we sent
 
 	int frame_latency[LATENCY_COUNTS];
@@ -206,6 +208,9 @@ typedef struct client_s
 // to be sent to a client into a snap. It's used for finding size of the backup storage
 #define MAX_SNAP_ENTITIES 64
 
+// maximum number of worker threads for per-client frame work, see sv_snapthreads
+#define SV_MAX_JOB_THREADS 16
+
 typedef struct
 {
 	netadr_t adr;
@@ -217,11 +222,13 @@ typedef struct
 typedef struct
 {
 	int file;
+	snap_demowriter_t *writer;		// does the file I/O and compression off the main thread
 	char *filename;
 	char *tempname;
 	time_t localtime;
 	unsigned int basetime, duration;
 	client_t client;                // special client for writing the messages
+	snap_demoindex_t index;         // keyframes for seeking, stored in meta data
 	char meta_data[SNAP_MAX_DEMO_META_DATA_SIZE];
 	size_t meta_data_realsize;
 } server_static_demo_t;
@@ -253,8 +260,20 @@ typedef struct fatvis_s
 	vec_t *skyorg;
 	uint8_t pvs[MAX_MAP_LEAFS/8];
 	uint8_t phs[MAX_MAP_LEAFS/8];
+	snap_viscache_t *viscache;		// culled entity lists shared by clients with the same view
 } fatvis_t;
 
+// per-client scratch for building and encoding snapshots on the job threads
+typedef struct
+{
+	bool prepared;						// msg holds this frame's datagram
+	int numSnapEntities;				// -1 if the client is not in game yet
+	unsigned firstEntity;				// into the circular svs.client_entities
+	int snapEntities[MAX_SNAPSHOT_ENTITIES];
+	msg_t msg;
+	uint8_t msgData[MAX_MSGLEN];
+} client_snapjob_t;
+
 typedef struct
 {
 	bool initialized;               // sv_init has completed
@@ -276,6 +295,9 @@ typedef struct
 
 	client_t *clients;                  // [sv_maxclients->integer];
 	client_entities_t client_entities;
+	client_snapjob_t *snapjobs;         // [sv_maxclients->integer], only with sv_snapthreads
+	fatvis_t *snapjobs_fatvis;          // [SV_Jobs_NumThreads()], only with sv_snapthreads
+	snap_deltacache_t *deltacache[SV_MAX_JOB_THREADS+1]; // main thread first, then one per job thread
 
 	challenge_t challenges[MAX_CHALLENGES]; // to prevent invalid IPs from connecting
 #ifdef TCP_ALLOW_CONNECT
@@ -349,6 +371,11 @@ extern cvar_t *sv_highchars;
 //wsw : jal
 extern cvar_t *sv_maxrate;
 extern cvar_t *sv_compresspackets;
+extern cvar_t *sv_snapthreads;
+extern cvar_t *sv_deltacache;
+extern cvar_t *sv_snapcache;
+extern cvar_t *sv_snapbitpacking;
+extern cvar_t *sv_compressdict;
 extern cvar_t *sv_public;         // should heartbeats be sent
 
 // wsw : debug netcode
@@ -373,6 +400,7 @@ extern cvar_t *sv_lastAutoUpdate;
 extern cvar_t *sv_defaultmap;
 
 extern cvar_t *sv_demodir;
+extern cvar_t *sv_demokeyframes;
 
 extern cvar_t *sv_mm_authkey;
 extern cvar_t *sv_mm_loginonly;
@@ -463,6 +491,17 @@ typedef struct
 void SV_FlushRedirect( int sv_redirected, const char *outputbuf, const void *extra );
 void SV_SendClientMessages( void );
 
+//
+// sv_jobs.c
+//
+typedef qjobfunc_t sv_jobfunc_t;
+
+void SV_Jobs_Init( int numThreads );
+unsigned SV_Jobs_NumThreads( void );
+void SV_Jobs_Schedule( sv_jobfunc_t job, void *arg, unsigned items );
+void SV_Jobs_Complete( void );
+void SV_Jobs_Shutdown( void );
+
 void SV_Multicast( vec3_t origin, multicast_t to );
 void SV_BroadcastCommand( const char *format, ... );
 
@@ -492,7 +531,7 @@ void SV_Status_f( void );
 //
 // sv_ents.c
 //
-void SV_WriteFrameSnapToClient( client_t *client, msg_t *msg );
+void SV_WriteFrameSnapToClient( client_t *client, msg_t *msg, snap_deltacache_t *deltaCache );
 void SV_BuildClientFrameSnap( client_t *client );
 
 
@@ -562,6 +601,7 @@ void SV_Web_Init( void );
 void SV_Web_Shutdown( void );
 bool SV_Web_Running( void );
 const char *SV_Web_UpstreamBaseUrl( void );
+void SV_Web_PrintStats( void );
 bool SV_Web_AddGameClient( const char *session, int clientNum, const netadr_t *netAdr );
 void SV_Web_RemoveGameClient( const char *session );
 void SV_Web_GameFrame( http_game_query_cb cb );
@@ -403,6 +403,360 @@ static void SV_CvarCheck_f( void )
 	SV_SendServerCommand( client, "cvarinfo \"%s\"", Cmd_Argv( 2 ) );
 }
 
+/*
+* SV_DeltaCacheStats_f
+* Print entity delta cache efficiency, summed over all snapshot threads
+*/
+static void SV_DeltaCacheStats_f( void )
+{
+	int i;
+	snap_deltacache_stats_t total;
+	const snap_deltacache_stats_t *stats;
+
+	if( !svs.deltacache[0] )
+	{
+		Com_Printf( "Delta cache is not active\n" );
+		return;
+	}
+
+	memset( &total, 0, sizeof( total ) );
+	for( i = 0; i < SV_MAX_JOB_THREADS+1; i++ )
+	{
+		if( !svs.deltacache[i] )
+			continue;
+
+		stats = SNAP_DeltaCacheStats( svs.deltacache[i] );
+		total.frames = max( total.frames, stats->frames );
+		total.lookups += stats->lookups;
+		total.hits += stats->hits;
+		total.overflows += stats->overflows;
+		total.bytesEncoded += stats->bytesEncoded;
+		total.bytesSaved += stats->bytesSaved;
+
+		if( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ) )
+			SNAP_ResetDeltaCacheStats( svs.deltacache[i] );
+	}
+
+	Com_Printf( "frames:        %llu\n", (unsigned long long)total.frames );
+	Com_Printf( "lookups:       %llu\n", (unsigned long long)total.lookups );
+	Com_Printf( "hits:          %llu (%.1f%%)\n", (unsigned long long)total.hits,
+		total.lookups ? 100.0 * (double)total.hits / (double)total.lookups : 0.0 );
+	Com_Printf( "overflows:     %llu\n", (unsigned long long)total.overflows );
+	Com_Printf( "bytes encoded: %llu\n", (unsigned long long)total.bytesEncoded );
+	Com_Printf( "bytes saved:   %llu\n", (unsigned long long)total.bytesSaved );
+}
+
+/*
+* SV_SnapCacheStats_f
+* Print how often clients reused the culled entity list of another client
+*/
+static void SV_SnapCacheStats_f( void )
+{
+	int i;
+	fatvis_t *fatvis;
+	snap_viscache_stats_t total;
+	const snap_viscache_stats_t *stats;
+
+	if( !svs.fatvis.viscache )
+	{
+		Com_Printf( "Snapshot cache is not active\n" );
+		return;
+	}
+
+	memset( &total, 0, sizeof( total ) );
+	for( i = -1; i < (int)SV_Jobs_NumThreads(); i++ )
+	{
+		fatvis = i < 0 ? &svs.fatvis : &svs.snapjobs_fatvis[i];
+		if( !fatvis->viscache )
+			continue;
+
+		stats = SNAP_VisCacheStats( fatvis->viscache );
+		total.frames = max( total.frames, stats->frames );
+		total.lookups += stats->lookups;
+		total.hits += stats->hits;
+		total.entitiesCulled += stats->entitiesCulled;
+		total.entitiesReused += stats->entitiesReused;
+
+		if( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ) )
+			SNAP_ResetVisCacheStats( fatvis->viscache );
+	}
+
+	Com_Printf( "frames:          %llu\n", (unsigned long long)total.frames );
+	Com_Printf( "lookups:         %llu\n", (unsigned long long)total.lookups );
+	Com_Printf( "reused:          %llu (%.1f%%)\n", (unsigned long long)total.hits,
+		total.lookups ? 100.0 * (double)total.hits / (double)total.lookups : 0.0 );
+	Com_Printf( "entities culled: %llu\n", (unsigned long long)total.entitiesCulled );
+	Com_Printf( "entities reused: %llu\n", (unsigned long long)total.entitiesReused );
+}
+
+/*
+* SV_SnapCacheCheck_f
+* Check that the snapshot cache gives every client the same entities as culling
+* them one by one, also when the entity list is full
+*/
+static void SV_SnapCacheCheck_f( void )
+{
+	int i, result, checked, failed;
+	client_t *client;
+
+	if( !svs.fatvis.viscache )
+	{
+		Com_Printf( "Snapshot cache is not active\n" );
+		return;
+	}
+
+	checked = failed = 0;
+	for( i = 0, client = svs.clients; i < sv_maxclients->integer; i++, client++ )
+	{
+		if( client->state < CS_SPAWNED )
+			continue;
+
+		result = SNAP_CheckClientEntitiesList( svs.cms, &sv.gi, sv.framenum, &svs.fatvis, client );
+		if( result < 0 )
+			continue;
+
+		checked++;
+		if( result > 0 )
+		{
+			failed++;
+			Com_Printf( S_COLOR_RED "%s" S_COLOR_RED ": %i entity lists differ\n", client->name, result );
+		}
+	}
+
+	Com_Printf( "%i clients checked, %i failed\n", checked, failed );
+}
+
+/*
+* SV_CompressStats_f
+* Print netchan compression ratio and cost per client
+*/
+static void SV_CompressStats_f( void )
+{
+	int i;
+	client_t *cl;
+	netchan_compress_stats_t total;
+	const netchan_compress_stats_t *stats;
+	bool reset;
+
+	if( !svs.clients )
+	{
+		Com_Printf( "No server running.\n" );
+		return;
+	}
+
+	reset = Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" );
+
+	memset( &total, 0, sizeof( total ) );
+	Com_Printf( "num dict packets  dict    ratio  usec/pkt name\n" );
+	Com_Printf( "--- ---- -------- ------- ------ -------- ---------------\n" );
+	for( i = 0, cl = svs.clients; i < sv_maxclients->integer; i++, cl++ )
+	{
+		if( cl->state < CS_CONNECTED )
+			continue;
+
+		stats = &cl->netchan.compressStats;
+		Com_Printf( "%3i %4s %8llu %7llu %5.1f%% %8.1f %s\n", i, cl->netchan.compressDict ? "yes" : "no",
+			(unsigned long long)stats->packets, (unsigned long long)stats->dictPackets,
+			stats->bytesIn ? 100.0 * (double)stats->bytesOut / (double)stats->bytesIn : 100.0,
+			stats->packets + stats->uncompressed ? (double)stats->usec / (double)( stats->packets + stats->uncompressed ) : 0.0,
+			cl->name );
+
+		total.packets += stats->packets;
+		total.dictPackets += stats->dictPackets;
+		total.uncompressed += stats->uncompressed;
+		total.bytesIn += stats->bytesIn;
+		total.bytesOut += stats->bytesOut;
+		total.usec += stats->usec;
+
+		if( reset )
+			memset( &cl->netchan.compressStats, 0, sizeof( cl->netchan.compressStats ) );
+	}
+
+	Com_Printf( "packets:      %llu (%llu against a dictionary, %llu sent uncompressed)\n", (unsigned long long)total.packets,
+		(unsigned long long)total.dictPackets, (unsigned long long)total.uncompressed );
+	Com_Printf( "bytes in:     %llu\n", (unsigned long long)total.bytesIn );
+	Com_Printf( "bytes out:    %llu (%.1f%%)\n", (unsigned long long)total.bytesOut,
+		total.bytesIn ? 100.0 * (double)total.bytesOut / (double)total.bytesIn : 100.0 );
+	Com_Printf( "usec/packet:  %.1f\n", total.packets + total.uncompressed ? (double)total.usec / (double)( total.packets + total.uncompressed ) : 0.0 );
+}
+
+/*
+* Collision trace benchmark, the same traces are split between more and more threads
+*/
+
+#define TRACEBENCH_MAX_THREADS	32
+
+typedef struct
+{
+	vec3_t start, end;
+	vec3_t mins, maxs;
+} tracebench_trace_t;
+
+typedef struct
+{
+	int first, count;
+	const tracebench_trace_t *traces;
+	float *fractions;
+	qmutex_t *gate;			// held until all the workers are created
+} tracebench_job_t;
+
+/*
+* SV_TraceBenchThread
+*/
+static void *SV_TraceBenchThread( void *param )
+{
+	int i;
+	trace_t tr;
+	const tracebench_trace_t *t;
+	tracebench_job_t *job = param;
+
+	if( job->gate )
+	{
+		QMutex_Lock( job->gate );
+		QMutex_Unlock( job->gate );
+	}
+
+	for( i = job->first; i < job->first + job->count; i++ )
+	{
+		t = &job->traces[i];
+		CM_TransformedBoxTrace( svs.cms, &tr, (float *)t->start, (float *)t->end, (float *)t->mins, (float *)t->maxs,
+			NULL, MASK_PLAYERSOLID, NULL, NULL );
+		job->fractions[i] = tr.fraction;
+	}
+
+	return NULL;
+}
+
+/*
+* SV_TraceBench_f
+*/
+static void SV_TraceBench_f( void )
+{
+	int i, j, numtraces, numthreads, maxthreads, mismatches;
+	unsigned int seed;
+	vec3_t mins, maxs, dir;
+	tracebench_trace_t *traces, *t;
+	float *fractions, *reference;
+	tracebench_job_t jobs[TRACEBENCH_MAX_THREADS];
+	qthread_t *threads[TRACEBENCH_MAX_THREADS];
+	qmutex_t *gate;
+	uint64_t start, usec, singleusec;
+	int nodetraces, brushtraces;
+
+	if( sv.state < ss_loading || !svs.cms )
+	{
+		Com_Printf( "No map loaded.\n" );
+		return;
+	}
+
+	numtraces = Cmd_Argc() > 1 ? atoi( Cmd_Argv( 1 ) ) : 100000;
+	maxthreads = Cmd_Argc() > 2 ? atoi( Cmd_Argv( 2 ) ) : Sys_GetNumberOfProcessors();
+	clamp( numtraces, 1, 10000000 );
+	clamp( maxthreads, 1, TRACEBENCH_MAX_THREADS );
+
+	// random moves of up to 1024 units from inside the world, half of them for a player box
+	CM_InlineModelBounds( svs.cms, CM_InlineModel( svs.cms, 0 ), mins, maxs );
+	traces = Mem_TempMalloc( sizeof( *traces ) * numtraces );
+	fractions = Mem_TempMalloc( sizeof( *fractions ) * numtraces );
+	reference = Mem_TempMalloc( sizeof( *reference ) * numtraces );
+
+	seed = 0x51f15e;
+	for( i = 0, t = traces; i < numtraces; i++, t++ )
+	{
+		for( j = 0; j < 3; j++ )
+		{
+			seed = seed * 1103515245 + 12345;
+			t->start[j] = mins[j] + ( maxs[j] - mins[j] ) * ( ( seed >> 8 ) & 0xffff ) / 65535.0f;
+			seed = seed * 1103515245 + 12345;
+			dir[j] = ( ( seed >> 8 ) & 0xffff ) / 32767.5f - 1.0f;
+		}
+		seed = seed * 1103515245 + 12345;
+		VectorNormalize( dir );
+		VectorMA( t->start, ( ( seed >> 8 ) & 0xffff ) / 64.0f, dir, t->end );
+
+		if( i & 1 )
+		{
+			VectorSet( t->mins, -16, -16, -24 );
+			VectorSet( t->maxs, 16, 16, 40 );
+		}
+		else
+		{
+			VectorClear( t->mins );
+			VectorClear( t->maxs );
+		}
+	}
+
+	Com_Printf( "Tracing %i moves through %s\n", numtraces, sv.mapname );
+	Com_Printf( "threads  msec   traces/sec  speedup\n" );
+	Com_Printf( "------- ------ ----------- -------\n" );
+
+	gate = QMutex_Create();
+	singleusec = 0;
+	nodetraces = brushtraces = 0;
+	for( numthreads = 1; ; numthreads = min( numthreads * 2, maxthreads ) )
+	{
+		for( i = 0; i < numthreads; i++ )
+		{
+			jobs[i].first = numtraces * i / numthreads;
+			jobs[i].count = numtraces * ( i + 1 ) / numthreads - jobs[i].first;
+			jobs[i].traces = traces;
+			jobs[i].fractions = numthreads == 1 ? reference : fractions;
+			jobs[i].gate = numthreads == 1 ? NULL : gate;
+		}
+
+		if( numthreads == 1 )
+		{
+			start = Sys_Microseconds();
+			nodetraces = c_node_traces;
+			brushtraces = c_brush_traces;
+			SV_TraceBenchThread( &jobs[0] );
+			nodetraces = c_node_traces - nodetraces;
+			brushtraces = c_brush_traces - brushtraces;
+		}
+		else
+		{
+			// don't count the thread creation
+			QMutex_Lock( gate );
+			for( i = 0; i < numthreads; i++ )
+				threads[i] = QThread_Create( SV_TraceBenchThread, &jobs[i] );
+			start = Sys_Microseconds();
+			QMutex_Unlock( gate );
+
+			for( i = 0; i < numthreads; i++ )
+				QThread_Join( threads[i] );
+		}
+		usec = max( Sys_Microseconds() - start, 1 );
+
+		if( numthreads == 1 )
+			singleusec = usec;
+
+		mismatches = 0;
+		if( numthreads > 1 )
+		{
+			for( i = 0; i < numtraces; i++ )
+			{
+				if( fractions[i] != reference[i] )
+					mismatches++;
+			}
+		}
+
+		Com_Printf( "%7i %6.1f %11.0f %6.2fx%s\n", numthreads, usec / 1000.0, numtraces * 1000000.0 / usec,
+			(double)singleusec / usec, mismatches ? va( " %i traces differ from a single thread!", mismatches ) : "" );
+
+		if( numthreads == maxthreads )
+			break;
+	}
+
+	// cache misses are left to an external profiler, e.g. perf stat -e cache-misses,
+	// run once more after reloading the map with cm_noNodeLayout 1 to compare
+	Com_Printf( "%.1f nodes and %.1f brushes per trace\n", (float)nodetraces / numtraces, (float)brushtraces / numtraces );
+
+	QMutex_Destroy( &gate );
+	Mem_TempFree( reference );
+	Mem_TempFree( fractions );
+	Mem_TempFree( traces );
+}
+
 //===========================================================
 
 /*
@@ -435,6 +789,13 @@ void SV_InitOperatorCommands( void )
 
 	Cmd_AddCommand( "cvarcheck", SV_CvarCheck_f );
 
+	Cmd_AddCommand( "sv_deltacache_stats", SV_DeltaCacheStats_f );
+	Cmd_AddCommand( "sv_snapcache_stats", SV_SnapCacheStats_f );
+	Cmd_AddCommand( "sv_snapcache_check", SV_SnapCacheCheck_f );
+	Cmd_AddCommand( "sv_compress_stats", SV_CompressStats_f );
+	Cmd_AddCommand( "sv_http_stats", SV_Web_PrintStats );
+	Cmd_AddCommand( "sv_tracebench", SV_TraceBench_f );
+
 	Cmd_SetCompletionFunc( "map", SV_MapComplete_f );
 	Cmd_SetCompletionFunc( "devmap", SV_MapComplete_f );
 	Cmd_SetCompletionFunc( "gamemap", SV_MapComplete_f );
@@ -469,4 +830,11 @@ void SV_ShutdownOperatorCommands( void )
 	}
 
 	Cmd_RemoveCommand( "cvarcheck" );
+
+	Cmd_RemoveCommand( "sv_deltacache_stats" );
+	Cmd_RemoveCommand( "sv_snapcache_stats" );
+	Cmd_RemoveCommand( "sv_snapcache_check" );
+	Cmd_RemoveCommand( "sv_compress_stats" );
+	Cmd_RemoveCommand( "sv_http_stats" );
+	Cmd_RemoveCommand( "sv_tracebench" );
 }
@@ -90,6 +90,7 @@ bool SV_ClientConnect( const socket_t *socket, const netadr_t *address, client_t
 
 
 	// the connection is accepted, set up the client slot
+	Netchan_Release( &client->netchan );
 	memset( client, 0, sizeof( *client ) );
 	client->edict = ent;
 	client->challenge = challenge; // save challenge for checksumming
@@ -293,6 +294,10 @@ static void SV_New_f( client_t *client )
 		return;
 	}
 
+	// the client has to ask for these again, if the server still allows them
+	client->bitpacked = false;
+	Netchan_SetCompressDict( &client->netchan, false );
+
 	//
 	// serverdata needs to go over for all types of servers
 	// to make sure the protocol is right, and to set the gamedir
@@ -334,6 +339,10 @@ static void SV_New_f( client_t *client )
 			if( baseurl[0] )
 				sv_bitflags |= SV_BITFLAGS_HTTP_BASEURL;
 		}
+		if( sv_snapbitpacking->integer )
+			sv_bitflags |= SV_BITFLAGS_BITPACKED;
+		if( sv_compressdict->integer )
+			sv_bitflags |= SV_BITFLAGS_NETDICT;
 		MSG_WriteByte( &tmpMessage, sv_bitflags );
 	}
 
@@ -882,6 +891,32 @@ static void SV_NoDelta_f( client_t *client )
 	client->lastframe = -1; // jal : I'm not sure about this. Seems like it's missing but...
 }
 
+/*
+* SV_Bitpacking_f
+*/
+static void SV_Bitpacking_f( client_t *client )
+{
+	if( !sv_snapbitpacking->integer )
+		return;
+
+	client->bitpacked = ( atoi( Cmd_Argv( 1 ) ) != 0 );
+}
+
+/*
+* SV_Netdict_f
+*/
+static void SV_Netdict_f( client_t *client )
+{
+	if( !sv_compressdict->integer )
+		return;
+
+	Netchan_SetCompressDict( &client->netchan, atoi( Cmd_Argv( 1 ) ) != 0 );
+
+	// also sent again by clients that failed to decompress a message, whatever
+	// was sent until now may have been compressed against it
+	client->netchan.dictStartSequence = client->netchan.outgoingSequence;
+}
+
 /*
 * SV_Multiview_f
 */
@@ -937,6 +972,8 @@ ucmd_t ucmds[] =
 	{ "usri", SV_UserinfoCommand_f },
 
 	{ "nodelta", SV_NoDelta_f },
+	{ "bitpacking", SV_Bitpacking_f },
+	{ "netdict", SV_Netdict_f },
 
 	{ "multiview", SV_Multiview_f },
 
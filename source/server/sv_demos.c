@@ -22,18 +22,108 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #define SV_DEMO_DIR va( "demos/server%s%s", sv_demodir->string[0] ? "/" : "", sv_demodir->string[0] ? sv_demodir->string : "" )
 
+#define SV_DEMO_QUEUE_SIZE	0x100000	// bytes the demo writer may fall behind before frames are dropped
+
 /*
 * SV_Demo_WriteMessage
 * 
-* Writes given message to the demofile
+* Writes given message to the demofile, returns false if it was dropped.
+* Reliable messages are never dropped.
 */
-static void SV_Demo_WriteMessage( msg_t *msg )
+static bool SV_Demo_WriteMessage( msg_t *msg, bool reliable )
 {
 	assert( svs.demo.file );
 	if( !svs.demo.file )
-		return;
+		return false;
+
+	if( !svs.demo.writer )
+	{
+		SNAP_RecordDemoMessage( svs.demo.file, msg, 0 );
+		return true;
+	}
+
+	if( !SNAP_WriteDemoMessage( svs.demo.writer, msg, 0, reliable ) )
+	{
+		if( SNAP_DemoWriterStats( svs.demo.writer )->dropped == 1 )
+			Com_Printf( "Warning: Server demo writer can't keep up, dropping frames\n" );
+
+		// the next frame can't be delta compressed against the dropped one
+		svs.demo.client.nodelta = true;
+		return false;
+	}
+
+	return true;
+}
+
+/*
+* SV_Demo_Tell
+* 
+* Returns the uncompressed file offset the next message will be written at
+*/
+static unsigned int SV_Demo_Tell( void )
+{
+	if( svs.demo.writer )
+		return SNAP_DemoWriterTell( svs.demo.writer );
+	return FS_Tell( svs.demo.file );
+}
+
+/*
+* SV_Demo_WriteKeyframeConfigstrings
+* 
+* Keyframes start with the current configstrings, so playback can begin at
+* the keyframe without the configstring updates that came before it. Empty
+* ones are written as well, or those cleared since would keep the value they
+* had where the player seeked from, many of them are batched in a single command.
+* Returns false if any of them was dropped, the frame then can't be a keyframe.
+*/
+static bool SV_Demo_WriteKeyframeConfigstrings( msg_t *msg )
+{
+	int i, numempty;
+	bool written;
+	char empty[MAX_STRING_CHARS];
+
+	numempty = 0;
+	empty[0] = '\0';
+
+	for( i = 0; i < MAX_CONFIGSTRINGS; i++ )
+	{
+		if( !sv.configstrings[i][0] )
+		{
+			Q_strncatz( empty, va( " %i \"\"", i ), sizeof( empty ) );
+			numempty++;
+		}
+		else
+		{
+			MSG_WriteByte( msg, svc_servercs );
+			MSG_WriteString( msg, va( "cs %i \"%s\"", i, sv.configstrings[i] ) );
+		}
+
+		if( numempty && ( numempty == 64 || i == MAX_CONFIGSTRINGS - 1 ) )
+		{
+			MSG_WriteByte( msg, svc_servercs );
+			MSG_WriteString( msg, va( "cs%s", empty ) );
+			numempty = 0;
+			empty[0] = '\0';
+		}
 
-	SNAP_RecordDemoMessage( svs.demo.file, msg, 0 );
+		if( msg->cursize > msg->maxsize / 2 )
+		{
+			written = SV_Demo_WriteMessage( msg, false );
+			MSG_Clear( msg );
+			if( !written )
+				return false;
+		}
+	}
+
+	if( msg->cursize )
+	{
+		written = SV_Demo_WriteMessage( msg, false );
+		MSG_Clear( msg );
+		if( !written )
+			return false;
+	}
+
+	return true;
 }
 
 /*
@@ -55,7 +145,9 @@ void SV_Demo_WriteSnap( void )
 {
 	int i;
 	msg_t msg;
-	uint8_t msg_buffer[MAX_MSGLEN];
+	uint8_t *msg_buffer;
+	bool keyframe, written;
+	unsigned int keyframe_offset = 0;
 
 	if( !svs.demo.file )
 		return;
@@ -73,15 +165,33 @@ void SV_Demo_WriteSnap( void )
 		return;
 	}
 
-	MSG_Init( &msg, msg_buffer, sizeof( msg_buffer ) );
+	msg_buffer = ( uint8_t * )Mem_FrameMallocExt( MAX_MSGLEN, 0 );
+	MSG_Init( &msg, msg_buffer, MAX_MSGLEN );
+
+	keyframe = SNAP_DemoKeyframeDue( &svs.demo.index, svs.gametime );
+	if( keyframe )
+	{
+		keyframe_offset = SV_Demo_Tell();
+		keyframe = SV_Demo_WriteKeyframeConfigstrings( &msg );
+		svs.demo.client.nodelta = true;
+	}
 
 	SV_BuildClientFrameSnap( &svs.demo.client );
 
-	SV_WriteFrameSnapToClient( &svs.demo.client, &msg );
+	SV_WriteFrameSnapToClient( &svs.demo.client, &msg, svs.deltacache[0] );
+
+	written = SV_Demo_WriteMessage( &msg, false );
+	MSG_Clear( &msg );
 
+	// the commands are acknowledged as soon as they are written, so they go
+	// in a message of their own that can't be dropped along with the frame
 	SV_AddReliableCommandsToMessage( &svs.demo.client, &msg );
+	SV_Demo_WriteMessage( &msg, true );
 
-	SV_Demo_WriteMessage( &msg );
+	if( written && keyframe )
+		SNAP_AddDemoKeyframe( &svs.demo.index, svs.gametime, keyframe_offset );
+
+	Mem_FrameFree( msg_buffer );
 
 	svs.demo.duration = svs.gametime - svs.demo.basetime;
 	svs.demo.client.lastframe = sv.framenum; // FIXME: is this needed?
@@ -187,6 +297,7 @@ void SV_Demo_Start_f( void )
 	Com_Printf( "Recording server demo: %s\n", svs.demo.filename );
 
 	SV_Demo_InitClient();
+	SNAP_InitDemoIndex( &svs.demo.index, max( sv_demokeyframes->integer, 0 ) * 1000 );
 
 	// write serverdata, configstrings and baselines
 	svs.demo.duration = 0;
@@ -194,10 +305,12 @@ void SV_Demo_Start_f( void )
 	svs.demo.localtime = time( NULL );
 	SV_Demo_WriteStartMessages();
 
+	// from now on, the file is written on the demo writer thread
+	svs.demo.writer = SNAP_CreateDemoWriter( svs.demo.file, SV_DEMO_QUEUE_SIZE );
+
 	// write one nodelta frame
 	svs.demo.client.nodelta = true;
 	SV_Demo_WriteSnap();
-	svs.demo.client.nodelta = false;
 }
 
 /*
@@ -213,6 +326,16 @@ static void SV_Demo_Stop( bool cancel, bool silent )
 		return;
 	}
 
+	if( svs.demo.writer )
+	{
+		const snap_demowriter_stats_t *stats = SNAP_DemoWriterStats( svs.demo.writer );
+		if( stats->dropped )
+			Com_Printf( "Warning: %llu server demo frames were dropped, the disk couldn't keep up\n", (unsigned long long)stats->dropped );
+		if( stats->stalls )
+			Com_Printf( "Warning: the server waited %llu times for the demo writer\n", (unsigned long long)stats->stalls );
+		SNAP_FreeDemoWriter( &svs.demo.writer );
+	}
+
 	if( cancel )
 	{
 		Com_Printf( "Canceled server demo recording: %s\n", svs.demo.filename );
@@ -245,6 +368,8 @@ static void SV_Demo_Stop( bool cancel, bool silent )
 		SV_SetDemoMetaKeyValue( "matchname", sv.configstrings[CS_MATCHNAME] );
 		SV_SetDemoMetaKeyValue( "matchscore", sv.configstrings[CS_MATCHSCORE] );
 		SV_SetDemoMetaKeyValue( "matchuuid", sv.configstrings[CS_MATCHUUID] );
+		svs.demo.meta_data_realsize = SNAP_SetDemoMetaKeyframes( svs.demo.meta_data, sizeof( svs.demo.meta_data ),
+			svs.demo.meta_data_realsize, &svs.demo.index );
 
 		SNAP_WriteDemoMetaData( svs.demo.tempname, svs.demo.meta_data, svs.demo.meta_data_realsize );
 
@@ -355,6 +355,29 @@ void SV_InitGame( void )
 	svs.client_entities.num_entities = sv_maxclients->integer * UPDATE_BACKUP * MAX_SNAP_ENTITIES;
 	svs.client_entities.entities = Mem_Alloc( sv_mempool, sizeof( entity_state_t ) * svs.client_entities.num_entities );
 
+	// build and encode client snapshots on worker threads
+	if( sv_snapthreads->integer > 0 )
+	{
+		SV_Jobs_Init( sv_snapthreads->integer );
+		svs.snapjobs = Mem_Alloc( sv_mempool, sizeof( client_snapjob_t )*sv_maxclients->integer );
+		svs.snapjobs_fatvis = Mem_Alloc( sv_mempool, sizeof( fatvis_t )*SV_Jobs_NumThreads() );
+	}
+
+	// share culled entity lists between clients with the same view
+	if( sv_snapcache->integer )
+	{
+		svs.fatvis.viscache = SNAP_CreateVisCache( sv_mempool );
+		for( i = 0; i < (int)SV_Jobs_NumThreads(); i++ )
+			svs.snapjobs_fatvis[i].viscache = SNAP_CreateVisCache( sv_mempool );
+	}
+
+	// share encoded entity deltas between clients
+	if( sv_deltacache->integer )
+	{
+		for( i = 0; i <= (int)SV_Jobs_NumThreads(); i++ )
+			svs.deltacache[i] = SNAP_CreateDeltaCache( sv_mempool );
+	}
+
 	// init network stuff
 
 	address.type = NA_NOTRANSMIT;
@@ -509,6 +532,8 @@ static void SV_FinalMessage( const char *message, bool reconnect )
 */
 void SV_ShutdownGame( const char *finalmsg, bool reconnect )
 {
+	int i;
+
 	if( !svs.initialized )
 		return;
 
@@ -520,6 +545,16 @@ void SV_ShutdownGame( const char *finalmsg, bool reconnect )
 
 	SV_ShutdownGameProgs();
 
+	if( svs.snapjobs_fatvis )
+	{
+		for( i = 0; i < (int)SV_Jobs_NumThreads(); i++ )
+			SNAP_FreeVisCache( &svs.snapjobs_fatvis[i].viscache );
+		Mem_Free( svs.snapjobs_fatvis );
+		svs.snapjobs_fatvis = NULL;
+	}
+
+	SV_Jobs_Shutdown();
+
 	// SV_MM_Shutdown();
 
 	SV_MasterSendQuit();
@@ -534,6 +569,13 @@ void SV_ShutdownGame( const char *finalmsg, bool reconnect )
 	}
 #endif
 
+	// the array was allocated for the old sv_maxclients
+	if( svs.clients )
+	{
+		for( i = 0; i < sv_maxclients->integer; i++ )
+			Netchan_Release( &svs.clients[i].netchan );
+	}
+
 	// get any latched variable changes (sv_maxclients, etc)
 	Cvar_GetLatchedVars( CVAR_LATCH );
 
@@ -549,6 +591,17 @@ void SV_ShutdownGame( const char *finalmsg, bool reconnect )
 		memset( &svs.client_entities, 0, sizeof( svs.client_entities ) );
 	}
 
+	if( svs.snapjobs )
+	{
+		Mem_Free( svs.snapjobs );
+		svs.snapjobs = NULL;
+	}
+
+	SNAP_FreeVisCache( &svs.fatvis.viscache );
+
+	for( i = 0; i < SV_MAX_JOB_THREADS+1; i++ )
+		SNAP_FreeDeltaCache( &svs.deltacache[i] );
+
 	if( svs.cms )
 	{
 		// CM_ReleaseReference will take care of freeing up the memory
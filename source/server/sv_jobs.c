@@ -0,0 +1,84 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// sv_jobs.c -- worker threads for per-client frame work
+
+#include "server.h"
+
+static qjobpool_t *sv_job_pool;
+
+/*
+* SV_Jobs_Init
+*/
+void SV_Jobs_Init( int numThreads )
+{
+	clamp( numThreads, 0, SV_MAX_JOB_THREADS );
+
+	if( numThreads > 0 ) {
+		sv_job_pool = QJobPool_Create( numThreads, NULL );
+	}
+}
+
+/*
+* SV_Jobs_NumThreads
+*/
+unsigned SV_Jobs_NumThreads( void )
+{
+	return QJobPool_NumThreads( sv_job_pool );
+}
+
+/*
+* SV_Jobs_Schedule
+*
+* Splits items in contiguous blocks, one per worker thread. The thread
+* index is passed to the job so it can pick its own scratch buffers.
+*/
+void SV_Jobs_Schedule( sv_jobfunc_t job, void *arg, unsigned items )
+{
+	if( !items ) {
+		return;
+	}
+
+	if( !sv_job_pool ) {
+		job( 0, items, 0, arg );
+		return;
+	}
+
+	QJobPool_Schedule( sv_job_pool, job, arg, items );
+}
+
+/*
+* SV_Jobs_Complete
+*
+* Blocks until all scheduled jobs are done.
+*/
+void SV_Jobs_Complete( void )
+{
+	if( sv_job_pool ) {
+		QJobPool_Complete( sv_job_pool );
+	}
+}
+
+/*
+* SV_Jobs_Shutdown
+*/
+void SV_Jobs_Shutdown( void )
+{
+	QJobPool_Destroy( &sv_job_pool );
+}
@@ -82,6 +82,11 @@ cvar_t *sv_reconnectlimit; // minimum seconds between connect messages
 
 cvar_t *sv_maxrate;
 cvar_t *sv_compresspackets;
+cvar_t *sv_snapthreads;
+cvar_t *sv_deltacache;
+cvar_t *sv_snapcache;
+cvar_t *sv_snapbitpacking;
+cvar_t *sv_compressdict;
 cvar_t *sv_masterservers;
 cvar_t *sv_masterservers_steam;
 cvar_t *sv_skilllevel;
@@ -97,6 +102,7 @@ cvar_t *sv_autoUpdate;
 cvar_t *sv_lastAutoUpdate;
 
 cvar_t *sv_demodir;
+cvar_t *sv_demokeyframes;
 
 //============================================================================
 
@@ -163,20 +169,73 @@ static bool SV_ProcessPacket( netchan_t *netchan, msg_t *msg )
 	MSG_ReadLong( msg ); // sequence
 	MSG_ReadLong( msg ); // sequence_ack
 	MSG_ReadShort( msg ); // game_port
-	if( msg->compressed )
+	zerror = Netchan_DecompressMessage( netchan, msg );
+	if( zerror < 0 )
 	{
-		zerror = Netchan_DecompressMessage( msg );
-		if( zerror < 0 )
-		{
-			// compression error. Drop the packet
-			Com_DPrintf( "SV_ProcessPacket: Compression error %i. Dropping packet\n", zerror );
-			return false;
-		}
+		// compression error. Drop the packet
+		Com_DPrintf( "SV_ProcessPacket: Compression error %i. Dropping packet\n", zerror );
+		return false;
 	}
 
 	return true;
 }
 
+/*
+* SV_ReadSharedSocketPacket
+*
+* Handles a packet read from one of the sockets shared by all clients.
+*/
+static void SV_ReadSharedSocketPacket( socket_t *socket, const netadr_t *address, msg_t *msg )
+{
+	int i;
+	int game_port;
+	client_t *cl;
+
+	// check for connectionless packet (0xffffffff) first
+	if( *(int *)msg->data == -1 )
+	{
+		SV_ConnectionlessPacket( socket, address, msg );
+		return;
+	}
+
+	// read the game port out of the message so we can fix up
+	// stupid address translating routers
+	MSG_BeginReading( msg );
+	MSG_ReadLong( msg ); // sequence number
+	MSG_ReadLong( msg ); // sequence number
+	game_port = MSG_ReadShort( msg ) & 0xffff;
+	// data follows
+
+	// check for packets from connected clients
+	for( i = 0, cl = svs.clients; i < sv_maxclients->integer; i++, cl++ )
+	{
+		unsigned short addr_port;
+
+		if( cl->state == CS_FREE || cl->state == CS_ZOMBIE )
+			continue;
+		if( cl->edict && ( cl->edict->r.svflags & SVF_FAKECLIENT ) )
+			continue;
+		if( !NET_CompareBaseAddress( address, &cl->netchan.remoteAddress ) )
+			continue;
+		if( cl->netchan.game_port != game_port )
+			continue;
+
+		addr_port = NET_GetAddressPort( address );
+		if( NET_GetAddressPort( &cl->netchan.remoteAddress ) != addr_port )
+		{
+			Com_Printf( "SV_ReadPackets: fixing up a translated port\n" );
+			NET_SetAddressPort( &cl->netchan.remoteAddress, addr_port );
+		}
+
+		if( SV_ProcessPacket( &cl->netchan, msg ) ) // this is a valid, sequenced packet, so process it
+		{
+			cl->lastPacketReceivedTime = svs.realtime;
+			SV_ParseClientMessage( cl, msg );
+		}
+		break;
+	}
+}
+
 /*
 * SV_ReadPackets
 */
@@ -187,12 +246,14 @@ static void SV_ReadPackets( void )
 #ifdef TCP_ALLOW_CONNECT
 	socket_t newsocket;
 #endif
-	int game_port;
 	socket_t *socket;
 	netadr_t address;
 
 	static msg_t msg;
 	static uint8_t msgData[MAX_MSGLEN];
+	static msg_t msgs[NET_MAX_RECVBATCH];
+	static uint8_t msgsData[NET_MAX_RECVBATCH][MAX_MSGLEN];
+	static netadr_t addresses[NET_MAX_RECVBATCH];
 
 #ifdef TCP_ALLOW_CONNECT
 	socket_t* tcpsockets [] =
@@ -210,6 +271,8 @@ static void SV_ReadPackets( void )
 	};
 
 	MSG_Init( &msg, msgData, sizeof( msgData ) );
+	for( i = 0; i < NET_MAX_RECVBATCH; i++ )
+		MSG_Init( &msgs[i], msgsData[i], sizeof( msgsData[i] ) );
 
 #ifdef TCP_ALLOW_CONNECT
 	for( socketind = 0; socketind < sizeof( tcpsockets ) / sizeof( tcpsockets[0] ); socketind++ )
@@ -283,7 +346,7 @@ static void SV_ReadPackets( void )
 		if( !socket->open )
 			continue;
 
-		while( ( ret = NET_GetPacket( socket, &address, &msg ) ) != 0 )
+		while( ( ret = NET_GetPackets( socket, addresses, msgs, NET_MAX_RECVBATCH ) ) != 0 )
 		{
 			if( ret == -1 )
 			{
@@ -291,49 +354,8 @@ static void SV_ReadPackets( void )
 				continue;
 			}
 
-			// check for connectionless packet (0xffffffff) first
-			if( *(int *)msg.data == -1 )
-			{
-				SV_ConnectionlessPacket( socket, &address, &msg );
-				continue;
-			}
-
-			// read the game port out of the message so we can fix up
-			// stupid address translating routers
-			MSG_BeginReading( &msg );
-			MSG_ReadLong( &msg ); // sequence number
-			MSG_ReadLong( &msg ); // sequence number
-			game_port = MSG_ReadShort( &msg ) & 0xffff;
-			// data follows
-
-			// check for packets from connected clients
-			for( i = 0, cl = svs.clients; i < sv_maxclients->integer; i++, cl++ )
-			{
-				unsigned short addr_port;
-
-				if( cl->state == CS_FREE || cl->state == CS_ZOMBIE )
-					continue;
-				if( cl->edict && ( cl->edict->r.svflags & SVF_FAKECLIENT ) )
-					continue;
-				if( !NET_CompareBaseAddress( &address, &cl->netchan.remoteAddress ) )
-					continue;
-				if( cl->netchan.game_port != game_port )
-					continue;
-
-				addr_port = NET_GetAddressPort( &address );
-				if( NET_GetAddressPort( &cl->netchan.remoteAddress ) != addr_port )
-				{
-					Com_Printf( "SV_ReadPackets: fixing up a translated port\n" );
-					NET_SetAddressPort( &cl->netchan.remoteAddress, addr_port );
-				}
-
-				if( SV_ProcessPacket( &cl->netchan, &msg ) ) // this is a valid, sequenced packet, so process it
-				{
-					cl->lastPacketReceivedTime = svs.realtime;
-					SV_ParseClientMessage( cl, &msg );
-				}
-				break;
-			}
+			for( i = 0; i < ret; i++ )
+				SV_ReadSharedSocketPacket( socket, &addresses[i], &msgs[i] );
 		}
 	}
 
@@ -806,6 +828,9 @@ void SV_Frame( int realmsec, int gamemsec )
 	SV_CheckAutoUpdate();
 
 	SV_CheckPostUpdateRestart();
+
+	// release this frame's scratch memory
+	Mem_ResetFrameArena();
 }
 
 //============================================================================
@@ -1009,10 +1034,16 @@ void SV_Init( void )
 		Com_Printf( "Invalid demo prefix string: %s\n", sv_demodir->string );
 		Cvar_ForceSet( "sv_demodir", "" );
 	}
+	sv_demokeyframes = Cvar_Get( "sv_demokeyframes", "10", CVAR_ARCHIVE );
 
 	// wsw : jal : cap client's exceding server rules
 	sv_maxrate =		    Cvar_Get( "sv_maxrate", "0", CVAR_DEVELOPER );
 	sv_compresspackets =	    Cvar_Get( "sv_compresspackets", "1", CVAR_DEVELOPER );
+	sv_snapthreads =	    Cvar_Get( "sv_snapthreads", "0", CVAR_ARCHIVE | CVAR_LATCH );
+	sv_deltacache =		    Cvar_Get( "sv_deltacache", "1", CVAR_ARCHIVE | CVAR_LATCH );
+	sv_snapcache =		    Cvar_Get( "sv_snapcache", "1", CVAR_ARCHIVE | CVAR_LATCH );
+	sv_snapbitpacking =	    Cvar_Get( "sv_snapbitpacking", "1", CVAR_ARCHIVE );
+	sv_compressdict =	    Cvar_Get( "sv_compressdict", "1", CVAR_ARCHIVE );
 	sv_skilllevel =		    Cvar_Get( "sv_skilllevel", "2", CVAR_SERVERINFO|CVAR_ARCHIVE|CVAR_LATCH );
 
 	if( sv_skilllevel->integer > 2 )
@@ -261,6 +261,9 @@ bool SV_SendClientsFragments( void )
 	int i;
 	bool sent = false;
 
+	// queue the datagrams so they go out in as few system calls as possible
+	NET_BeginSendBatch();
+
 	// send a message to each connected client
 	for( i = 0, client = svs.clients; i < sv_maxclients->integer; i++, client++ )
 	{
@@ -283,6 +286,8 @@ bool SV_SendClientsFragments( void )
 		sent = true;
 	}
 
+	NET_EndSendBatch();
+
 	return sent;
 }
 
@@ -299,7 +304,7 @@ bool SV_Netchan_Transmit( netchan_t *netchan, msg_t *msg )
 
 	if( sv_compresspackets->integer )
 	{
-		zerror = Netchan_CompressMessage( msg );
+		zerror = Netchan_CompressMessage( netchan, msg );
 		if( zerror < 0 )
 		{          // it's compression error, just send uncompressed
 			Com_DPrintf( "SV_Netchan_Transmit (ignoring compression): Compression error %i\n", zerror );
@@ -367,19 +372,17 @@ void SV_ResetClientFrameCounters( void )
 /*
 * SV_WriteFrameSnapToClient
 */
-void SV_WriteFrameSnapToClient( client_t *client, msg_t *msg )
+void SV_WriteFrameSnapToClient( client_t *client, msg_t *msg, snap_deltacache_t *deltaCache )
 {
 	SNAP_WriteFrameSnapToClient( &sv.gi, client, msg, sv.framenum, svs.gametime, sv.baselines,
-		&svs.client_entities, 0, NULL, NULL );
+		&svs.client_entities, 0, NULL, NULL, deltaCache, NULL );
 }
 
 /*
-* SV_BuildClientFrameSnap
+* SV_SkyPortalOrigin
 */
-void SV_BuildClientFrameSnap( client_t *client )
+static vec_t *SV_SkyPortalOrigin( vec3_t origin )
 {
-	vec_t *skyorg = NULL, origin[3];
-
 	if( sv.configstrings[CS_SKYBOX][0] != '\0' )
 	{
 		int noents = 0;
@@ -388,11 +391,21 @@ void SV_BuildClientFrameSnap( client_t *client )
 		if( sscanf( sv.configstrings[CS_SKYBOX], "%f %f %f %f %f %i", &origin[0], &origin[1], &origin[2], &f1, &f2, &noents ) >= 3 )
 		{
 			if( !noents )
-				skyorg = origin;
+				return origin;
 		}
 	}
 
-	svs.fatvis.skyorg = skyorg;		// HACK HACK HACK
+	return NULL;
+}
+
+/*
+* SV_BuildClientFrameSnap
+*/
+void SV_BuildClientFrameSnap( client_t *client )
+{
+	vec3_t origin;
+
+	svs.fatvis.skyorg = SV_SkyPortalOrigin( origin );		// HACK HACK HACK
 	SNAP_BuildClientFrameSnap( svs.cms, &sv.gi, sv.framenum, svs.gametime,
 		&svs.fatvis, client, ge->GetGameState(), 
 		&svs.client_entities,
@@ -405,9 +418,19 @@ void SV_BuildClientFrameSnap( client_t *client )
 */
 static bool SV_SendClientDatagram( client_t *client )
 {
+	client_snapjob_t *job;
+
 	if( client->edict && ( client->edict->r.svflags & SVF_FAKECLIENT ) )
 		return true;
 
+	// already built and encoded on the job threads
+	job = svs.snapjobs ? &svs.snapjobs[client - svs.clients] : NULL;
+	if( job && job->prepared )
+	{
+		job->prepared = false;
+		return SV_SendMessageToClient( client, &job->msg );
+	}
+
 	SV_InitClientMessage( client, &tmpMessage, NULL, 0 );
 
 	SV_AddReliableCommandsToMessage( client, &tmpMessage );
@@ -416,11 +439,156 @@ static bool SV_SendClientDatagram( client_t *client )
 	// and the player_state_t
 	SV_BuildClientFrameSnap( client );
 
-	SV_WriteFrameSnapToClient( client, &tmpMessage );
+	SV_WriteFrameSnapToClient( client, &tmpMessage, svs.deltacache[0] );
 
 	return SV_SendMessageToClient( client, &tmpMessage );
 }
 
+//===============================================================================
+//
+//PARALLEL FRAME UPDATES
+//
+//===============================================================================
+
+typedef struct
+{
+	int numClients;
+	client_t *clients[MAX_CLIENTS];
+	vec_t *skyorg;
+	game_state_t *gameState;
+} sv_snapjobs_arg_t;
+
+static sv_snapjobs_arg_t sv_snapjobs_arg;
+
+/*
+* SV_BuildClientFrameSnapsJob
+*
+* PVS culling and entity list building, one fatvis per thread.
+*/
+static void SV_BuildClientFrameSnapsJob( unsigned first, unsigned items, unsigned thread, void *parg )
+{
+	unsigned i;
+	client_t *client;
+	client_snapjob_t *job;
+	fatvis_t *fatvis = &svs.snapjobs_fatvis[thread];
+	sv_snapjobs_arg_t *arg = parg;
+
+	fatvis->skyorg = arg->skyorg;
+
+	for( i = first; i < first + items; i++ )
+	{
+		client = arg->clients[i];
+		job = &svs.snapjobs[client - svs.clients];
+
+		job->numSnapEntities = SNAP_BuildClientFrameSnapList( svs.cms, &sv.gi, sv.framenum, svs.gametime,
+			fatvis, client, arg->gameState, false, sv_mempool, job->snapEntities );
+	}
+
+	fatvis->skyorg = NULL;
+}
+
+/*
+* SV_WriteClientFrameSnapsJob
+*
+* Fills the client's range of the client_entities ring and delta encodes
+* the frame into the client's own message buffer.
+*/
+static void SV_WriteClientFrameSnapsJob( unsigned first, unsigned items, unsigned thread, void *parg )
+{
+	unsigned i;
+	client_t *client;
+	client_snapjob_t *job;
+	sv_snapjobs_arg_t *arg = parg;
+
+	for( i = first; i < first + items; i++ )
+	{
+		client = arg->clients[i];
+		job = &svs.snapjobs[client - svs.clients];
+
+		if( job->numSnapEntities >= 0 )
+			SNAP_DumpClientFrameSnapEntities( &sv.gi, client, sv.framenum, &svs.client_entities,
+				job->firstEntity, job->snapEntities, job->numSnapEntities );
+
+		SV_InitClientMessage( client, &job->msg, job->msgData, sizeof( job->msgData ) );
+		SV_AddReliableCommandsToMessage( client, &job->msg );
+		SV_WriteFrameSnapToClient( client, &job->msg, svs.deltacache[1+thread] );
+
+		job->prepared = true;
+	}
+}
+
+/*
+* SV_PrepareClientDatagrams
+*
+* Builds and encodes the datagrams of all spawned clients on the job threads.
+* The client_entities ring is handed out in client order between the two
+* passes, so the ring layout and the resulting messages are the same as
+* the ones the serial path produces. The datagrams are transmitted later
+* from SV_SendClientMessages, on the main thread.
+*/
+static void SV_PrepareClientDatagrams( void )
+{
+	int i;
+	client_t *client;
+	client_snapjob_t *job;
+	vec3_t origin;
+	sv_snapjobs_arg_t *arg = &sv_snapjobs_arg;
+
+	arg->numClients = 0;
+	for( i = 0, client = svs.clients; i < sv_maxclients->integer; i++, client++ )
+	{
+		svs.snapjobs[i].prepared = false;
+
+		if( client->state != CS_SPAWNED )
+			continue;
+		if( client->edict && ( client->edict->r.svflags & SVF_FAKECLIENT ) )
+			continue;
+		arg->clients[arg->numClients++] = client;
+	}
+
+	if( !arg->numClients )
+		return;
+
+	arg->skyorg = SV_SkyPortalOrigin( origin );
+	arg->gameState = ge->GetGameState();
+
+	SV_Jobs_Schedule( SV_BuildClientFrameSnapsJob, arg, arg->numClients );
+	SV_Jobs_Complete();
+
+	for( i = 0; i < arg->numClients; i++ )
+	{
+		job = &svs.snapjobs[arg->clients[i] - svs.clients];
+		if( job->numSnapEntities < 0 )
+			continue;
+
+		job->firstEntity = svs.client_entities.next_entities;
+		svs.client_entities.next_entities += job->numSnapEntities;
+	}
+
+	SV_Jobs_Schedule( SV_WriteClientFrameSnapsJob, arg, arg->numClients );
+	SV_Jobs_Complete();
+
+	arg->skyorg = NULL;
+}
+
+/*
+* SV_DiscardClientDatagrams
+*
+* Dropping a client may queue commands for the others and change entities,
+* so whatever was prepared for the clients that come after it is built again
+* on the main thread, as the serial path would have done.
+*/
+static void SV_DiscardClientDatagrams( void )
+{
+	int i;
+
+	if( !svs.snapjobs )
+		return;
+
+	for( i = 0; i < sv_maxclients->integer; i++ )
+		svs.snapjobs[i].prepared = false;
+}
+
 /*
 * SV_SendClientMessages
 */
@@ -429,6 +597,12 @@ void SV_SendClientMessages( void )
 	int i;
 	client_t *client;
 
+	if( svs.snapjobs && SV_Jobs_NumThreads() > 0 )
+		SV_PrepareClientDatagrams();
+
+	// queue the datagrams so they go out in as few system calls as possible
+	NET_BeginSendBatch();
+
 	// send a message to each connected client
 	for( i = 0, client = svs.clients; i < sv_maxclients->integer; i++, client++ )
 	{
@@ -453,6 +627,7 @@ void SV_SendClientMessages( void )
 				if( client->reliable )
 				{
 					SV_DropClient( client, DROP_TYPE_GENERAL, "Error sending message: %s\n", NET_ErrorString() );
+					SV_DiscardClientDatagrams();
 				}
 			}
 		}
@@ -470,9 +645,12 @@ void SV_SendClientMessages( void )
 					if( client->reliable )
 					{
 						SV_DropClient( client, DROP_TYPE_GENERAL, "Error sending message: %s\n", NET_ErrorString() );
+						SV_DiscardClientDatagrams();
 					}
 				}
 			}
 		}
 	}
+
+	NET_EndSendBatch();
 }
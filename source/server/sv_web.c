@@ -34,6 +34,11 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #define HTTP_SERVER_SLEEP_TIME					50 // milliseconds
 
+// every connection holds at most one file, so there is always a slot to recycle
+#define MAX_HTTP_CACHED_FILES					( MAX_INCOMING_HTTP_CONNECTIONS + 16 )
+#define HTTP_CACHED_FILE_IDLE_TIMEOUT			60 // seconds
+#define HTTP_CACHED_FILE_REVALIDATE_TIME		2000 // milliseconds between checks for changes on disk
+
 typedef enum
 {
 	HTTP_CONN_STATE_NONE = 0,
@@ -50,8 +55,8 @@ typedef enum
 } sv_http_content_state_t;
 
 typedef struct {
-	long begin;
-	long end;
+	int64_t begin;
+	int64_t end;
 } sv_http_content_range_t;
 
 typedef struct {
@@ -88,6 +93,27 @@ typedef struct {
 	bool close_after_resp;
 } sv_http_request_t;
 
+// open file descriptors shared between the connections serving the same file,
+// sendfile calls pass explicit offsets so the file position is never used
+typedef struct {
+	char *filename;
+	time_t mtime;
+	int file;
+	int fileno;
+	size_t data_offset;
+	size_t length;
+	unsigned int refcount;
+	unsigned int last_used;
+	unsigned int last_checked;	// when mtime was last compared with the file on disk
+	bool stale;					// file changed on disk, close once released
+} sv_http_cached_file_t;
+
+typedef struct {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t reopens;
+} sv_http_file_cache_stats_t;
+
 typedef struct {
 	uint64_t request_id;
 	http_response_code_t code;
@@ -97,9 +123,7 @@ typedef struct {
 	char *content;
 	size_t content_length;
 
-	int file;
-	int fileno;
-	size_t file_data_offset;
+	sv_http_cached_file_t *file;
 	size_t file_send_pos;
 	char *filename;
 } sv_http_response_t;
@@ -120,6 +144,14 @@ typedef struct sv_http_connection_s
 
 	bool is_upstream;
 
+	// throughput stats
+	unsigned int connect_time;
+	unsigned int requests;
+	uint64_t bytes_received;
+	uint64_t bytes_sent;
+	unsigned int resp_start_time;
+	uint64_t resp_bytes_sent;
+
 	struct sv_http_connection_s *next, *prev;
 } sv_http_connection_t;
 
@@ -153,10 +185,163 @@ static qbufPipe_t *sv_http_incoming_queue;
 static qbufPipe_t *sv_http_outgoing_queue;
 
 static qthread_t *sv_http_thread = NULL;
+static net_monitor_t *sv_http_monitor = NULL;
+
+static sv_http_cached_file_t sv_http_cached_files[MAX_HTTP_CACHED_FILES];
+static sv_http_file_cache_stats_t sv_http_file_cache_stats;
+static volatile bool sv_http_print_stats = false;
 static void *SV_Web_ThreadProc( void *param );
 
 // ============================================================================
 
+/*
+* SV_Web_CloseCachedFile
+*/
+static void SV_Web_CloseCachedFile( sv_http_cached_file_t *cf )
+{
+	assert( !cf->refcount );
+
+	FS_FCloseFile( cf->file );
+	Mem_Free( cf->filename );
+	memset( cf, 0, sizeof( *cf ) );
+}
+
+/*
+* SV_Web_AcquireFile
+*
+* Returns a shared open descriptor for the file, reopening it if it was
+* modified on disk since it was cached. The file is only looked up on disk
+* again every HTTP_CACHED_FILE_REVALIDATE_TIME milliseconds, so a burst of
+* requests for the same file costs a single stat. Must be released with
+* SV_Web_ReleaseFile.
+*/
+static sv_http_cached_file_t *SV_Web_AcquireFile( const char *filename )
+{
+	int i;
+	int file, fileno, length;
+	size_t data_offset;
+	time_t mtime = 0;
+	bool checked = false;
+	unsigned int now = Sys_Milliseconds();
+	sv_http_cached_file_t *cf, *slot = NULL;
+
+	for( i = 0, cf = sv_http_cached_files; i < MAX_HTTP_CACHED_FILES; i++, cf++ ) {
+		if( !cf->filename ) {
+			if( !slot ) {
+				slot = cf;
+			}
+			continue;
+		}
+		if( cf->stale || strcmp( cf->filename, filename ) ) {
+			continue;
+		}
+
+		if( now - cf->last_checked >= HTTP_CACHED_FILE_REVALIDATE_TIME ) {
+			mtime = FS_BaseFileMTime( filename );
+			checked = true;
+		}
+
+		if( !checked || cf->mtime == mtime ) {
+			sv_http_file_cache_stats.hits++;
+			cf->refcount++;
+			cf->last_used = now;
+			if( checked ) {
+				cf->last_checked = now;
+			}
+			return cf;
+		}
+
+		// modified on disk, transfers in progress keep the old descriptor
+		sv_http_file_cache_stats.reopens++;
+		if( cf->refcount ) {
+			cf->stale = true;
+		}
+		else {
+			SV_Web_CloseCachedFile( cf );
+			if( !slot ) {
+				slot = cf;
+			}
+		}
+	}
+
+	sv_http_file_cache_stats.misses++;
+
+	if( !checked ) {
+		mtime = FS_BaseFileMTime( filename );
+	}
+
+	length = FS_FOpenBaseFile( filename, &file, FS_READ );
+	if( !file ) {
+		return NULL;
+	}
+	fileno = FS_FileNo( file, &data_offset );
+	if( fileno == -1 || length < 0 ) {
+		FS_FCloseFile( file );
+		return NULL;
+	}
+
+	if( !slot ) {
+		// recycle the least recently used idle descriptor
+		for( i = 0, cf = sv_http_cached_files; i < MAX_HTTP_CACHED_FILES; i++, cf++ ) {
+			if( cf->refcount ) {
+				continue;
+			}
+			if( !slot || now - cf->last_used > now - slot->last_used ) {
+				slot = cf;
+			}
+		}
+		assert( slot != NULL );
+		SV_Web_CloseCachedFile( slot );
+	}
+
+	slot->filename = ZoneCopyString( filename );
+	slot->mtime = mtime;
+	slot->file = file;
+	slot->fileno = fileno;
+	slot->data_offset = data_offset;
+	slot->length = length;
+	slot->refcount = 1;
+	slot->last_used = now;
+	slot->last_checked = now;
+	slot->stale = false;
+	return slot;
+}
+
+/*
+* SV_Web_ReleaseFile
+*/
+static void SV_Web_ReleaseFile( sv_http_cached_file_t *cf )
+{
+	assert( cf->refcount > 0 );
+
+	cf->refcount--;
+	cf->last_used = Sys_Milliseconds();
+	if( !cf->refcount && cf->stale ) {
+		SV_Web_CloseCachedFile( cf );
+	}
+}
+
+/*
+* SV_Web_PruneFileCache
+*
+* Closes descriptors that have not been used for a while.
+*/
+static void SV_Web_PruneFileCache( bool all )
+{
+	int i;
+	unsigned int now = Sys_Milliseconds();
+	sv_http_cached_file_t *cf;
+
+	for( i = 0, cf = sv_http_cached_files; i < MAX_HTTP_CACHED_FILES; i++, cf++ ) {
+		if( !cf->filename || cf->refcount ) {
+			continue;
+		}
+		if( all || now - cf->last_used > HTTP_CACHED_FILE_IDLE_TIMEOUT*1000 ) {
+			SV_Web_CloseCachedFile( cf );
+		}
+	}
+}
+
 /*
 * SV_Web_ResetStream
 */
@@ -233,11 +418,9 @@ static void SV_Web_ResetResponse( sv_http_response_t *response )
 		response->filename = NULL;
 	}
 	if( response->file ) {
-		FS_FCloseFile( response->file );
-		response->file = 0;
+		SV_Web_ReleaseFile( response->file );
+		response->file = NULL;
 	}
-	response->fileno = -1;
-	response->file_data_offset = 0;
 	response->file_send_pos = 0;
 
 	response->content_state = CONTENT_STATE_DEFAULT;
@@ -278,6 +461,12 @@ static sv_http_connection_t *SV_Web_AllocConnection( void )
 	con->state = HTTP_CONN_STATE_NONE;
 	con->close_after_resp = false;
 	con->is_upstream = false;
+	con->connect_time = Sys_Milliseconds();
+	con->requests = 0;
+	con->bytes_received = 0;
+	con->bytes_sent = 0;
+	con->resp_start_time = 0;
+	con->resp_bytes_sent = 0;
 	return con;
 }
 
@@ -490,6 +679,9 @@ static int SV_Web_Get( sv_http_connection_t *con, void *recvbuf, size_t recvbuf_
 		con->open = false;
 		Com_DPrintf( "HTTP connection recv error from %s\n", NET_AddressToString( &con->address ) );
 	}
+	else {
+		con->bytes_received += read;
+	}
 	return read;
 }
 
@@ -505,6 +697,10 @@ static int SV_Web_Send( sv_http_connection_t *con, void *sendbuf, size_t sendbuf
 		Com_DPrintf( "HTTP transmission error to %s\n", NET_AddressToString( &con->address ) );
 		con->open = false;
 	}
+	else {
+		con->bytes_sent += sent;
+		con->resp_bytes_sent += sent;
+	}
 	return sent;
 }
 
@@ -527,6 +723,8 @@ static int64_t SV_Web_SendFile( sv_http_connection_t *con, int fileno, size_t fi
 	}
 	else {
 		*pos += sent;
+		con->bytes_sent += sent;
+		con->resp_bytes_sent += sent;
 	}
 	return sent;
 }
@@ -792,53 +990,58 @@ static void SV_Web_AnalyzeHeader( sv_http_request_t *request, const char *key, c
 	}
 	else if( !Q_stricmp( key, "Range" ) 
 		&& ( request->method == HTTP_METHOD_GET || request->method == HTTP_METHOD_HEAD ) ) {
-		const char *delim = strchr( value, '-' );
+		sv_http_content_range_t *range = &stream->content_range;
+		const char *p;
+		char *end;
 
-		if( Q_strnicmp( value, "bytes=", 6 ) || !delim ) {
+		if( Q_strnicmp( value, "bytes=", 6 ) ) {
 			request->error = HTTP_RESP_BAD_REQUEST;
+			return;
+		}
+
+		// a negative begin stands for the last N bytes of the file,
+		// a negative end for everything from the first byte pos onwards
+		p = value + 6;
+		if( *p == '-' ) {
+			// bytes=-100
+			range->begin = -strtoll( p + 1, &end, 10 );
+			range->end = -1;
+			if( end == p + 1 || range->begin >= 0 ) {
+				request->error = HTTP_RESP_REQUESTED_RANGE_NOT_SATISFIABLE;
+				return;
+			}
 		}
 		else {
-			bool neg_end = false;
-			const char *p = value;
-
-			// first byte pos
-			while( *p && p < delim ) {
-				if( *p >= '0' && *p <= '9' )
-					stream->content_range.begin = stream->content_range.begin*10 + *p - '0';
-				p++;
+			range->begin = strtoll( p, &end, 10 );
+			if( end == p || *end != '-' || range->begin < 0 ) {
+				request->error = HTTP_RESP_BAD_REQUEST;
+				return;
 			}
-			p++;
 
-			// last byte pos
-			if( *p == '-' ) {
-				if( value != delim ) {
+			p = end + 1;
+			if( *p == '\0' || *p == ',' ) {
+				// bytes=200-
+				range->end = -1;
+				end = (char *)p;
+			}
+			else {
+				// bytes=200-300
+				range->end = strtoll( p, &end, 10 );
+				if( end == p ) {
+					request->error = HTTP_RESP_BAD_REQUEST;
+					return;
+				}
+				if( range->end < range->begin ) {
 					request->error = HTTP_RESP_REQUESTED_RANGE_NOT_SATISFIABLE;
 					return;
 				}
-				neg_end = true;
-				p++;
-			}
-			while( *p ) {
-				if( *p >= '0' && *p <= '9' )
-				stream->content_range.end = stream->content_range.end*10 + *p++ - '0';
-			}
-
-			// partial content request
-			if( neg_end && stream->content_range.end ) {
-				// bytes=-100
-				request->partial = true;
-				stream->content_range.end = -stream->content_range.end;
-			} else if( stream->content_range.end >= stream->content_range.begin ) {
-				// bytes=200-300
-				request->partial = true;
-			} else if( stream->content_range.begin >= 0 && *(delim+1) == '\0' ) {
-				// bytes=200-
-				request->partial = true;
 			}
+		}
 
-			if( request->partial ) {
-				request->partial_content_range = stream->content_range;
-			}
+		// multiple ranges are not supported, serve the whole file instead
+		if( *end == '\0' ) {
+			request->partial = true;
+			request->partial_content_range = *range;
 		}
 	} else if( !Q_stricmp( key, "X-Client" ) ) {
 		request->clientNum = atoi( value );
@@ -1108,17 +1311,14 @@ static void SV_Web_RouteRequest( const sv_http_request_t *request, sv_http_respo
 				return;
 			}
 
-			*content_length = FS_FOpenBaseFile( filename, &response->file, FS_READ );
-			response->fileno = -1;
-			if( response->file ) {
-				response->fileno = FS_FileNo( response->file, &response->file_data_offset );
-			}
-			if( response->fileno == -1 ) {
+			response->file = SV_Web_AcquireFile( filename );
+			if( !response->file ) {
 				response->code = HTTP_RESP_NOT_FOUND;
 				*content_length = 0;
 			}
 			else {
 				response->code = HTTP_RESP_OK;
+				*content_length = response->file->length;
 			}
 		}
 		else {
@@ -1169,33 +1369,44 @@ static void SV_Web_RespondToQuery( sv_http_connection_t *con )
 
 		// serve range requests
 		if( request->partial && response->file ) {
-			// seek to first byte pos and clamp the last byte pos to content length
-			if( request->partial_content_range.begin > 0 ) { 
-				FS_Seek( response->file, request->partial_content_range.begin, FS_SEEK_SET );
-				// range.end may be set to 0 for 'bytes=100-' style requests
-				response->stream.content_range.end = request->partial_content_range.end 
-					? request->partial_content_range.end : content_length;
-
-			} else if( request->partial_content_range.end < 0 ) {
-				// seek to N last bytes in the file
-				FS_Seek( response->file, request->partial_content_range.end, FS_SEEK_END );
-				response->stream.content_range.end = -request->partial_content_range.end;
+			int64_t begin = request->partial_content_range.begin;
+			int64_t end = request->partial_content_range.end;
+
+			if( begin < 0 ) {
+				// last N bytes in the file
+				begin = max( (int64_t)content_length + begin, 0 );
+				end = (int64_t)content_length - 1;
+			}
+			else if( end < 0 || end >= (int64_t)content_length ) {
+				end = (int64_t)content_length - 1;
 			}
 
-			// Content-Range header values
-			response->file_send_pos = FS_Tell( response->file );
-			response->stream.content_range.begin = response->file_send_pos;
-			response->stream.content_range.end = min( (int)content_length, response->stream.content_range.end );
-			response->code = HTTP_RESP_PARTIAL_CONTENT;
+			if( begin >= (int64_t)content_length ) {
+				response->code = HTTP_RESP_REQUESTED_RANGE_NOT_SATISFIABLE;
+			}
+			else {
+				// Content-Range header values, both ends inclusive
+				response->file_send_pos = begin;
+				response->stream.content_range.begin = begin;
+				response->stream.content_range.end = end;
+				response->code = HTTP_RESP_PARTIAL_CONTENT;
+			}
 		}
 
-		if( request->method == HTTP_METHOD_HEAD && response->file ) {
-			FS_FCloseFile( response->file );
-			response->file = 0;
+		if( response->file ) {
+			con->resp_start_time = Sys_Milliseconds();
+			con->resp_bytes_sent = 0;
+		}
+
+		if( response->file 
+			&& ( request->method == HTTP_METHOD_HEAD || response->code == HTTP_RESP_REQUESTED_RANGE_NOT_SATISFIABLE ) ) {
+			SV_Web_ReleaseFile( response->file );
+			response->file = NULL;
 		}
 	}
 
 	con->state = HTTP_CONN_STATE_SEND;
+	con->requests++;
 
 	Q_snprintfz( resp_stream->header_buf, sizeof( resp_stream->header_buf ), 
 		"%s %i %s\r\nServer: " APPLICATION " v" APP_VERSION_STR "\r\n", 
@@ -1205,24 +1416,24 @@ static void SV_Web_RespondToQuery( sv_http_connection_t *con )
 			sizeof( resp_stream->header_buf ) );
 
 	if( response->code == HTTP_RESP_REQUESTED_RANGE_NOT_SATISFIABLE ) {
-		int file_length = FS_FOpenBaseFile( request->resource, NULL, FS_READ );
-
 		// in accordance with RFC 2616, send the Content-Range entity header,
 		// specifying the length of the resource
-		if( file_length < 0 ) {
+		if( !content_length ) {
 			Q_strncatz( resp_stream->header_buf, "Content-Range: bytes */*\r\n",
 				sizeof( resp_stream->header_buf ) );
 		}
 		else {
-			Q_snprintfz( vastr, sizeof( vastr ), "Content-Range: bytes */%i\r\n", content_length );
+			Q_snprintfz( vastr, sizeof( vastr ), "Content-Range: bytes */%llu\r\n", (unsigned long long)content_length );
 			Q_strncatz( resp_stream->header_buf, vastr, sizeof( resp_stream->header_buf ) );
 		}
+		content_length = 0;
 	}
 	else if( response->code == HTTP_RESP_PARTIAL_CONTENT ) {
-		Q_snprintfz( vastr, sizeof( vastr ), "Content-Range: bytes %i-%i/%i\r\n", 
-			response->stream.content_range.begin, response->stream.content_range.end, content_length );
+		Q_snprintfz( vastr, sizeof( vastr ), "Content-Range: bytes %lld-%lld/%llu\r\n", 
+			(long long)response->stream.content_range.begin, (long long)response->stream.content_range.end, 
+			(unsigned long long)content_length );
 		Q_strncatz( resp_stream->header_buf, vastr, sizeof( resp_stream->header_buf ) );
-		content_length = response->stream.content_range.end - response->stream.content_range.begin;
+		content_length = response->stream.content_range.end - response->stream.content_range.begin + 1;
 	}
 
 	if( response->code >= HTTP_RESP_BAD_REQUEST || !content_length ) {
@@ -1237,7 +1448,7 @@ static void SV_Web_RespondToQuery( sv_http_connection_t *con )
 	}
 
 	// resource length
-	Q_strncatz( resp_stream->header_buf, va( "Content-Length: %i\r\n", content_length ),
+	Q_strncatz( resp_stream->header_buf, va( "Content-Length: %llu\r\n", (unsigned long long)content_length ),
 			sizeof( resp_stream->header_buf ) );
 
 	if( response->file ) {
@@ -1259,7 +1470,7 @@ static void SV_Web_RespondToQuery( sv_http_connection_t *con )
 		memcpy( resp_stream->content, content, content_length );
 	}
 	resp_stream->header_length = header_length;
-	resp_stream->content_length = content_length;
+	resp_stream->content_length = request->method == HTTP_METHOD_HEAD ? 0 : content_length;
 }
 
 /*
@@ -1295,7 +1506,7 @@ static size_t SV_Web_SendResponse( sv_http_connection_t *con )
 		while( stream->content_p < stream->content_length && sv_http_running ) {
 			if( response->file ) {
 				sendbuf_size = stream->content_length - stream->content_p;
-				sent = SV_Web_SendFile( con, response->fileno, response->file_data_offset, &response->file_send_pos, sendbuf_size );
+				sent = SV_Web_SendFile( con, response->file->fileno, response->file->data_offset, &response->file_send_pos, sendbuf_size );
 			}
 			else {
 				if( !stream->content ) {
@@ -1323,6 +1534,14 @@ static size_t SV_Web_SendResponse( sv_http_connection_t *con )
 	if( stream->header_done 
 		&& (!stream->content_length || stream->content_p >= stream->content_length) ) {
 		con->state = HTTP_CONN_STATE_RECV;
+
+		if( response->file ) {
+			unsigned int msecs = max( Sys_Milliseconds() - con->resp_start_time, 1 );
+
+			Com_DPrintf( "HTTP sent '%s' to '%s': %llu bytes in %u ms, %.1f KiB/s\n", 
+				response->filename, NET_AddressToString( &con->address ), 
+				(unsigned long long)con->resp_bytes_sent, msecs, (double)con->resp_bytes_sent / 1.024 / msecs );
+		}
 	}
 
 	return total_sent;
@@ -1484,14 +1703,76 @@ void SV_Web_Init( void )
 	sv_http_thread = QThread_Create( SV_Web_ThreadProc, NULL );
 }
 
+/*
+* SV_Web_WriteStats
+*
+* Prints the throughput of active connections, runs on the HTTP thread.
+*/
+static void SV_Web_WriteStats( void )
+{
+	int i, numfiles = 0;
+	unsigned int now = Sys_Milliseconds();
+	sv_http_connection_t *con, *hnode = &sv_http_connection_headnode;
+	const sv_http_file_cache_stats_t *stats = &sv_http_file_cache_stats;
+
+	Com_Printf( "address                                   state reqs      recv      sent  KiB/s progress\n" );
+	Com_Printf( "----------------------------------------- ----- ---- --------- --------- ------ --------\n" );
+	for( con = hnode->prev; con != hnode; con = con->prev ) {
+		unsigned int msecs = max( now - con->connect_time, 1 );
+		const sv_http_response_t *response = &con->response;
+		char progress[32];
+
+		progress[0] = '\0';
+		if( con->state == HTTP_CONN_STATE_SEND && response->file && response->stream.content_length ) {
+			Q_snprintfz( progress, sizeof( progress ), "%3.0f%% %s", 
+				100.0 * response->stream.content_p / response->stream.content_length, COM_FileBase( response->filename ) );
+		}
+
+		Com_Printf( "%-41s %5s %4u %9llu %9llu %6.1f %s\n", NET_AddressToString( &con->address ),
+			con->state == HTTP_CONN_STATE_RECV ? "recv" : ( con->state == HTTP_CONN_STATE_SEND ? "send" : "resp" ),
+			con->requests, (unsigned long long)con->bytes_received, (unsigned long long)con->bytes_sent,
+			(double)con->bytes_sent / 1.024 / msecs, progress );
+	}
+
+	for( i = 0; i < MAX_HTTP_CACHED_FILES; i++ ) {
+		if( sv_http_cached_files[i].filename ) {
+			numfiles++;
+		}
+	}
+
+	Com_Printf( "file cache: %i open, %llu hits, %llu misses, %llu reopened\n", numfiles,
+		(unsigned long long)stats->hits, (unsigned long long)stats->misses, (unsigned long long)stats->reopens );
+}
+
+/*
+* SV_Web_MonitorRead
+*/
+static void SV_Web_MonitorRead( socket_t *socket, void *con )
+{
+	// listening sockets are handled by SV_Web_Listen
+	if( con ) {
+		SV_Web_ReceiveRequest( socket, con );
+	}
+}
+
+/*
+* SV_Web_MonitorWrite
+*/
+static void SV_Web_MonitorWrite( socket_t *socket, void *con )
+{
+	if( con ) {
+		SV_Web_WriteResponse( socket, con );
+	}
+}
+
 /*
 * SV_Web_Frame
 */
 static void SV_Web_Frame( void )
 {
 	sv_http_connection_t *con, *next, *hnode = &sv_http_connection_headnode;
-	socket_t *sockets[MAX_INCOMING_HTTP_CONNECTIONS+1];
-	void *connections[MAX_INCOMING_HTTP_CONNECTIONS];
+	socket_t *sockets[MAX_INCOMING_HTTP_CONNECTIONS+3];
+	void *connections[MAX_INCOMING_HTTP_CONNECTIONS+2];
 	int num_sockets = 0;
 	bool upstream_is_set;
 
@@ -1539,28 +1820,23 @@ static void SV_Web_Frame( void )
 				break;
 		}
 	}
+	// also wake up on the listening sockets so new connections
+	// are accepted without waiting for the timeout
+	if( sv_socket_http.address.type == NA_IP ) {
+		connections[num_sockets] = NULL;
+		sockets[num_sockets++] = &sv_socket_http;
+	}
+	if( sv_socket_http6.address.type == NA_IP6 ) {
+		connections[num_sockets] = NULL;
+		sockets[num_sockets++] = &sv_socket_http6;
+	}
 	sockets[num_sockets] = NULL;
 
 	// read query results from the game module
 	SV_Web_ReadOutgoingQueueCmds();
 
-	if( num_sockets != 0 ) {
-		NET_Monitor( HTTP_SERVER_SLEEP_TIME, sockets,
-			(void (*)(socket_t *, void*))SV_Web_ReceiveRequest,
-			(void (*)(socket_t *, void*))SV_Web_WriteResponse,
-			NULL, connections );
-	}
-	else {
-		// sleep on network sockets if got nothing else to do
-		if( sv_socket_http.address.type == NA_IP ) {
-			sockets[num_sockets++] = &sv_socket_http;
-		}
-		if( sv_socket_http6.address.type == NA_IP6 ) {
-			sockets[num_sockets++] = &sv_socket_http6;
-		}
-		sockets[num_sockets] = NULL;
-		NET_Sleep( HTTP_SERVER_SLEEP_TIME, sockets );
-	}
+	NET_Monitor( sv_http_monitor, HTTP_SERVER_SLEEP_TIME, sockets,
+		SV_Web_MonitorRead, SV_Web_MonitorWrite, NULL, connections );
 
 	// close dead connections
 	for( con = hnode->prev; con != hnode; con = next )
@@ -1596,6 +1872,13 @@ static void SV_Web_Frame( void )
 			SV_Web_FreeConnection( con );
 		}
 	}
+
+	SV_Web_PruneFileCache( false );
+
+	if( sv_http_print_stats ) {
+		SV_Web_WriteStats();
+		sv_http_print_stats = false;
+	}
 }
 
 /*
@@ -1619,11 +1902,17 @@ void SV_Web_GameFrame( http_game_query_cb cb )
 */
 static void *SV_Web_ThreadProc( void *param )
 {
+	sv_http_monitor = NET_CreateMonitor();
+
 	while( sv_http_running ) {
 		SV_Web_Frame();
 	}
 
 	SV_Web_ShutdownConnections();
+
+	SV_Web_PruneFileCache( true );
+
+	NET_DestroyMonitor( &sv_http_monitor );
 	return NULL;
 }
 
@@ -1655,6 +1944,20 @@ const char *SV_Web_UpstreamBaseUrl( void )
 	return sv_http_upstream_baseurl->string;
 }
 
+/*
+* SV_Web_PrintStats
+*
+* The connections are owned by the HTTP thread, which prints them on its next frame.
+*/
+void SV_Web_PrintStats( void )
+{
+	if( !sv_http_running ) {
+		Com_Printf( "HTTP server is not running\n" );
+		return;
+	}
+	sv_http_print_stats = true;
+}
+
 #else
 
 /*
@@ -1694,4 +1997,12 @@ const char *SV_Web_UpstreamBaseUrl( void )
 	return "";
 }
 
+/*
+* SV_Web_PrintStats
+*/
+void SV_Web_PrintStats( void )
+{
+	Com_Printf( "HTTP server is not running\n" );
+}
+
 #endif // HTTP_SUPPORT
@@ -24,6 +24,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "tv_upstream.h"
 #include "tv_upstream_demos.h"
+#include "tv_relay.h"
+#include "tv_downstream.h"
 
 static char *TV_ConnstateToString( connstate_t state )
 {
@@ -329,6 +331,52 @@ exit:
 	Mem_TempFree( servername );
 }
 
+/*
+* TV_DemoJump_f
+*
+* demojump <upstream> <time>
+* Skips ahead in a demo played by the upstream
+*/
+static void TV_DemoJump_f( void )
+{
+	const char *text, *p;
+	unsigned int time;
+	bool res;
+	upstream_t *upstream;
+
+	if( Cmd_Argc() != 3 )
+	{
+		Com_Printf( "Usage: %s <upstream> <time>\n", Cmd_Argv( 0 ) );
+		Com_Printf( "Time format is [minutes:]seconds\n" );
+		Com_Printf( "Use '+' in front of the time to specify it in relation to current position\n" );
+		return;
+	}
+
+	text = Cmd_Argv( 1 );
+	res = TV_UpstreamForText( text, &upstream );
+	if( !res || !upstream )
+	{
+		Com_Printf( "No such upstream: %s\n", text );
+		return;
+	}
+
+	p = Cmd_Argv( 2 );
+	if( *p == '-' )
+	{
+		Com_Printf( "Can't jump backwards, relayed clients can't go back in time\n" );
+		return;
+	}
+	if( *p == '+' )
+		p++;
+
+	if( strchr( p, ':' ) )
+		time = ( atoi( p ) * 60 + atoi( strchr( p, ':' ) + 1 ) ) * 1000;
+	else
+		time = atoi( p ) * 1000;
+
+	TV_Upstream_DemoJump( upstream, time, Cmd_Argv( 2 )[0] == '+' );
+}
+
 /*
 * TV_Record_f
 *
@@ -474,6 +522,126 @@ static void TV_Music_f( void )
 	TV_Upstream_SetAudioTrack( upstream, music );
 }
 
+/*
+* TV_Stress_f
+*
+* stress <upstream> <count> [mv]
+* 
+* Only available with developer set
+*/
+static void TV_Stress_f( void )
+{
+	const char *text;
+	int count, added;
+	bool res, mv;
+	upstream_t *upstream;
+
+	if( !developer->integer )
+	{
+		Com_Printf( "%s requires developer to be set\n", Cmd_Argv( 0 ) );
+		return;
+	}
+
+	if( Cmd_Argc() < 3 )
+	{
+		Com_Printf( "%s <upstream> <count> [mv]\n", Cmd_Argv( 0 ) );
+		return;
+	}
+
+	text = Cmd_Argv( 1 );
+	res = TV_UpstreamForText( text, &upstream );
+	if( !res || !upstream )
+	{
+		Com_Printf( "No such upstream: %s\n", text );
+		return;
+	}
+
+	if( upstream->relay.state != CA_ACTIVE )
+	{
+		Com_Printf( "%s" S_COLOR_WHITE ": relay is not active\n", upstream->name );
+		return;
+	}
+
+	count = atoi( Cmd_Argv( 2 ) );
+	mv = ( Cmd_Argc() > 3 && !Q_stricmp( Cmd_Argv( 3 ), "mv" ) );
+
+	added = TV_Downstream_StressClients( &upstream->relay, count, mv );
+	if( count > 0 )
+		Com_Printf( "Added %i of %i simulated spectators to %s\n", added, count, upstream->name );
+}
+
+/*
+* TV_SnapStats_f
+*
+* snapstats <upstream> [reset]
+* 
+* Only available with developer set
+*/
+static void TV_SnapStats_f( void )
+{
+	const char *text;
+	bool res;
+	upstream_t *upstream;
+	relay_t *relay;
+	const snap_framecache_stats_t *frames;
+	const snap_deltacache_stats_t *deltas;
+
+	if( !developer->integer )
+	{
+		Com_Printf( "%s requires developer to be set\n", Cmd_Argv( 0 ) );
+		return;
+	}
+
+	if( Cmd_Argc() < 2 )
+	{
+		Com_Printf( "%s <upstream> [reset]\n", Cmd_Argv( 0 ) );
+		return;
+	}
+
+	text = Cmd_Argv( 1 );
+	res = TV_UpstreamForText( text, &upstream );
+	if( !res || !upstream )
+	{
+		Com_Printf( "No such upstream: %s\n", text );
+		return;
+	}
+
+	relay = &upstream->relay;
+	if( !relay->frameCache || !relay->deltaCache )
+	{
+		Com_Printf( "%s" S_COLOR_WHITE ": relay is not active\n", upstream->name );
+		return;
+	}
+
+	frames = SNAP_FrameCacheStats( relay->frameCache );
+	Com_Printf( "frame cache:\n" );
+	Com_Printf( "frames:        %llu\n", (unsigned long long)frames->frames );
+	Com_Printf( "lookups:       %llu\n", (unsigned long long)frames->lookups );
+	Com_Printf( "hits:          %llu (%.1f%%)\n", (unsigned long long)frames->hits,
+		frames->lookups ? 100.0 * (double)frames->hits / (double)frames->lookups : 0.0 );
+	Com_Printf( "overflows:     %llu\n", (unsigned long long)frames->overflows );
+	Com_Printf( "bytes encoded: %llu\n", (unsigned long long)frames->bytesEncoded );
+	Com_Printf( "bytes saved:   %llu\n", (unsigned long long)frames->bytesSaved );
+
+	deltas = SNAP_DeltaCacheStats( relay->deltaCache );
+	Com_Printf( "delta cache:\n" );
+	Com_Printf( "lookups:       %llu\n", (unsigned long long)deltas->lookups );
+	Com_Printf( "hits:          %llu (%.1f%%)\n", (unsigned long long)deltas->hits,
+		deltas->lookups ? 100.0 * (double)deltas->hits / (double)deltas->lookups : 0.0 );
+	Com_Printf( "bytes saved:   %llu\n", (unsigned long long)deltas->bytesSaved );
+
+	Com_Printf( "send time:     %.3f ms per frame over %u frames\n",
+		relay->sendFrames ? relay->sendTime / ( 1000.0 * relay->sendFrames ) : 0.0, relay->sendFrames );
+
+	if( Cmd_Argc() > 2 && !Q_stricmp( Cmd_Argv( 2 ), "reset" ) )
+	{
+		SNAP_ResetFrameCacheStats( relay->frameCache );
+		SNAP_ResetDeltaCacheStats( relay->deltaCache );
+		relay->sendTime = 0;
+		relay->sendFrames = 0;
+	}
+}
+
 // List of commands
 typedef struct
 {
@@ -490,6 +658,7 @@ static cmd_function_t cmdlist[] =
 	{ "disconnect", TV_Disconnect_f },
 
 	{ "demo", TV_Demo_f },
+	{ "demojump", TV_DemoJump_f },
 	{ "record", TV_Record_f },
 	{ "stop", TV_Stop_f },
 
@@ -502,6 +671,9 @@ static cmd_function_t cmdlist[] =
 
 	{ "music", TV_Music_f },
 
+	{ "stress", TV_Stress_f },
+	{ "snapstats", TV_SnapStats_f },
+
 	{ NULL, NULL }
 };
 
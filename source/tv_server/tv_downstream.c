@@ -308,7 +308,7 @@ static bool TV_Downstream_Netchan_Transmit( netchan_t *netchan, msg_t *msg )
 
 	if( tv_compresspackets->integer )
 	{
-		zerror = Netchan_CompressMessage( msg );
+		zerror = Netchan_CompressMessage( netchan, msg );
 		if( zerror < 0 )
 		{
 			// it's compression error, just send uncompressed
@@ -531,7 +531,11 @@ void TV_Downstream_DropClient( client_t *drop, int type, const char *format, ...
 
 	if( drop->mv )
 	{
-		tvs.nummvclients--;
+		// relays running on worker threads count their own, see TV_Relay_EndFrame
+		if( drop->relay && drop->relay->onworker )
+			drop->relay->droppedmvclients++;
+		else
+			tvs.nummvclients--;
 		drop->mv = false;
 	}
 
@@ -540,6 +544,7 @@ void TV_Downstream_DropClient( client_t *drop, int type, const char *format, ...
 	drop->edict = NULL;
 	drop->relay = NULL;
 	drop->tv = false;
+	drop->stress = false;
 	drop->state = CS_ZOMBIE;    // become free in a few seconds
 	drop->name[0] = 0;
 }
@@ -588,6 +593,77 @@ bool TV_Downstream_ChangeStream( client_t *client, relay_t *relay )
 	return true;
 }
 
+/*
+* TV_Downstream_StressClients
+*
+* Replaces the simulated spectators of the relay with count new ones, which
+* are sent everything a real spectator would be sent, packets go nowhere.
+* Returns the number of spectators that could be added.
+*/
+int TV_Downstream_StressClients( relay_t *relay, int count, bool mv )
+{
+	int i, added;
+	client_t *client;
+	netadr_t address;
+	char userinfo[MAX_INFO_STRING];
+
+	assert( relay );
+
+	for( i = 0, client = tvs.clients; i < tv_maxclients->integer; i++, client++ )
+	{
+		if( !client->stress || client->relay != relay )
+			continue;
+
+		TV_Downstream_DropClient( client, DROP_TYPE_GENERAL, "Stress test over" );
+		client->state = CS_FREE;
+		userinfo_modified = true;
+	}
+
+	if( count <= 0 || !tvs.socket_udp.open )
+		return 0;
+
+	NET_InitAddress( &address, NA_NOTRANSMIT );
+
+	added = 0;
+	for( i = 0, client = tvs.clients; i < tv_maxclients->integer && added < count; i++, client++ )
+	{
+		if( client->state != CS_FREE )
+			continue;
+
+		Q_snprintfz( userinfo, sizeof( userinfo ), "\\name\\stress%i", added );
+		if( !TV_Relay_CanConnect( relay, client, userinfo ) )
+			break;
+
+		TV_Downstream_ClientResetCommandBuffers( client, true );
+		Netchan_Setup( &client->netchan, &tvs.socket_udp, &address, i );
+		Q_strncpyz( client->userinfo, userinfo, sizeof( client->userinfo ) );
+
+		client->tv = true;
+		client->reliable = false;
+		client->individual_socket = false;
+		client->socket.open = false;
+		client->stress = true;
+		client->mv = false;
+		if( mv && tvs.nummvclients < tv_maxmvclients->integer )
+		{
+			client->mv = true;
+			tvs.nummvclients++;
+		}
+
+		client->lastPacketReceivedTime = tvs.realtime;
+		client->lastconnect = tvs.realtime;
+
+		TV_Relay_ClientConnect( relay, client );
+		client->state = CS_SPAWNED;
+		TV_Relay_ClientBegin( relay, client );
+		added++;
+	}
+
+	userinfo_modified = true;
+
+	return added;
+}
+
 /*
 * TV_Downstream_ProcessPacket
 */
@@ -605,14 +681,11 @@ static bool TV_Downstream_ProcessPacket( netchan_t *netchan, msg_t *msg )
 	/*sequence = */MSG_ReadLong( msg );
 	/*sequence_ack = */MSG_ReadLong( msg );
 	/*game_port = */MSG_ReadShort( msg );
-	if( msg->compressed )
-	{
-		zerror = Netchan_DecompressMessage( msg );
-		if( zerror < 0 )
-		{          // compression error. Drop the packet
-			Com_DPrintf( "TV_Downstream_ProcessPacket: Compression error %i. Dropping packet\n", zerror );
-			return false;
-		}
+	zerror = Netchan_DecompressMessage( netchan, msg );
+	if( zerror < 0 )
+	{          // compression error. Drop the packet
+		Com_DPrintf( "TV_Downstream_ProcessPacket: Compression error %i. Dropping packet\n", zerror );
+		return false;
 	}
 
 	return true;
@@ -30,6 +30,7 @@ void TV_Downstream_Msg( client_t *client, relay_t *relay, client_t *who, bool ch
 void TV_Downstream_ClientResetCommandBuffers( client_t *client, bool resetReliable );
 char *TV_Downstream_FixName( const char *orginal_name, client_t *client );
 bool TV_Downstream_ChangeStream( client_t *client, relay_t *relay );
+int TV_Downstream_StressClients( relay_t *relay, int count, bool mv );
 void TV_Downstream_AddGameCommand( relay_t *relay, client_t *client, const char *cmd );
 void TV_Downstream_UserinfoChanged( client_t *cl );
 void TV_Downstream_AddServerCommand( client_t *client, const char *cmd );
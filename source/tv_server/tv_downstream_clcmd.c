@@ -131,9 +131,14 @@ void TV_Downstream_New_f( client_t *client )
 
 	memset( &client->lastcmd, 0, sizeof( client->lastcmd ) );
 
+	// the client has to ask for it again, if we still allow it
+	client->bitpacked = false;
+
 	tv_bitflags = SV_BITFLAGS_TVSERVER;
 	if( client->reliable )
 		tv_bitflags |= SV_BITFLAGS_RELIABLE;
+	if( tv_snapbitpacking->integer )
+		tv_bitflags |= SV_BITFLAGS_BITPACKED;
 
 	MSG_WriteByte( &message, tv_bitflags ); // sv_bitflags
 
@@ -375,6 +380,17 @@ static void TV_Downstream_NoDelta_f( client_t *client )
 	client->nodelta_frame = 0;
 }
 
+/*
+* TV_Downstream_Bitpacking_f
+*/
+static void TV_Downstream_Bitpacking_f( client_t *client )
+{
+	if( !tv_snapbitpacking->integer )
+		return;
+
+	client->bitpacked = ( atoi( Cmd_Argv( 1 ) ) != 0 );
+}
+
 /*
 * TV_Downstream_Multiview_f
 */
@@ -646,6 +662,7 @@ static ucmd_t ucmds[] =
 	{ "disconnect", TV_Downstream_Disconnect_f },
 	{ "usri", TV_Downstream_UserinfoCommand_f },
 	{ "nodelta", TV_Downstream_NoDelta_f },
+	{ "bitpacking", TV_Downstream_Bitpacking_f },
 
 	{ "multiview", TV_Downstream_Multiview_f },
 	{ "watch", TV_Downstream_Watch_f },
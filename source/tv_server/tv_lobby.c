@@ -34,7 +34,7 @@ static void TV_Lobby_WriteFrameSnapToClient( client_t *client, msg_t *msg )
 
 	memset( &gi, 0, sizeof( ginfo_t ) );
 
-	SNAP_WriteFrameSnapToClient( &gi, client, msg, tvs.lobby.framenum, tvs.realtime, NULL, NULL, 0, NULL, NULL );
+	SNAP_WriteFrameSnapToClient( &gi, client, msg, tvs.lobby.framenum, tvs.realtime, NULL, NULL, 0, NULL, NULL, NULL, NULL );
 }
 
 /*
@@ -42,18 +42,24 @@ static void TV_Lobby_WriteFrameSnapToClient( client_t *client, msg_t *msg )
 */
 static bool TV_Lobby_SendClientDatagram( client_t *client )
 {
-	uint8_t msg_buf[MAX_MSGLEN];
+	uint8_t *msg_buf;
 	msg_t msg;
+	bool sent;
 
 	assert( client );
 	assert( !client->relay );
 
-	TV_Downstream_InitClientMessage( client, &msg, msg_buf, sizeof( msg_buf ) );
+	msg_buf = ( uint8_t * )Mem_FrameMallocExt( MAX_MSGLEN, 0 );
+	TV_Downstream_InitClientMessage( client, &msg, msg_buf, MAX_MSGLEN );
 
 	TV_Downstream_AddReliableCommandsToMessage( client, &msg );
 	TV_Lobby_WriteFrameSnapToClient( client, &msg );
 
-	return TV_Downstream_SendMessageToClient( client, &msg );
+	sent = TV_Downstream_SendMessageToClient( client, &msg );
+
+	Mem_FrameFree( msg_buf );
+
+	return sent;
 }
 
 /*
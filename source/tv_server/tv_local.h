@@ -102,6 +102,7 @@ typedef struct
 	int first_entity;                   // into the circular sv_packet_entities[]
 	unsigned int sentTimeStamp;         // time at what this frame snap was sent to the clients
 	unsigned int UcmdExecuted;
+	unsigned int shareKey;              // frames with the same non-zero key have the same contents
 	game_state_t gameState;
 } client_snapshot_t;
 
@@ -170,6 +171,7 @@ typedef struct client_s
 	int lastframe;                  // used for delta compression etc.
 	bool nodelta;               // send one non delta compressed frame trough
 	int nodelta_frame;              // when we get confirmation of this frame, the non-delta frame is trough
+	bool bitpacked;                 // client asked for bit-packed snapshots
 	usercmd_t lastcmd;              // for filling in big drops
 	unsigned int lastSentFrameNum;  // for knowing which was last frame we sent
 
@@ -189,6 +191,7 @@ typedef struct client_s
 
 	int challenge;                  // challenge of this user, randomly generated
 	bool tv;
+	bool stress;                    // simulated spectator, see TV_Downstream_StressClients
 	client_flood_t flood;
 
 	netchan_t netchan;
@@ -254,6 +257,8 @@ extern cvar_t *tv_reconnectlimit;
 extern cvar_t *tv_public;
 extern cvar_t *tv_autorecord;
 extern cvar_t *tv_lobbymusic;
+extern cvar_t *tv_threads;
+extern cvar_t *tv_snapbitpacking;
 
 extern cvar_t *tv_masterservers;
 extern cvar_t *tv_masterservers_steam;
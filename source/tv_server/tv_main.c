@@ -26,6 +26,7 @@
 #include "tv_cmds.h"
 #include "tv_downstream.h"
 #include "tv_lobby.h"
+#include "tv_workers.h"
 
 tv_t tvs;
 
@@ -46,6 +47,8 @@ cvar_t *tv_tcp;
 cvar_t *tv_public;
 cvar_t *tv_autorecord;
 cvar_t *tv_lobbymusic;
+cvar_t *tv_threads;         // worker threads running the relays
+cvar_t *tv_snapbitpacking;
 
 cvar_t *tv_timeout;
 cvar_t *tv_zombietime;
@@ -107,6 +110,8 @@ void TV_Init( void )
 	tv_rcon_password = Cvar_Get( "tv_rcon_password", "", 0 );
 	tv_autorecord = Cvar_Get( "tv_autorecord", "", CVAR_ARCHIVE );
 	tv_lobbymusic = Cvar_Get( "tv_lobbymusic", "", CVAR_ARCHIVE );
+	tv_threads = Cvar_Get( "tv_threads", "0", CVAR_ARCHIVE | CVAR_NOSET );
+	tv_snapbitpacking = Cvar_Get( "tv_snapbitpacking", "1", CVAR_ARCHIVE );
 
 	tv_masterservers = Cvar_Get( "tv_masterservers", DEFAULT_MASTER_SERVERS_IPS, CVAR_LATCH );
 	tv_masterservers_steam = Cvar_Get( "tv_masterservers_steam", DEFAULT_MASTER_SERVERS_STEAM_IPS, CVAR_LATCH );
@@ -209,6 +214,8 @@ void TV_Init( void )
 #endif
 
 	TV_Downstream_InitMaster();
+
+	TV_Workers_Init( tv_threads->integer );
 }
 
 /*
@@ -234,6 +241,20 @@ void TV_Frame( int realmsec, int gamemsec )
 	}
 	userinfo_modified = false;
 
+	// module frames and client messages, on the worker threads if there are any
+	for( i = 0; i < tvs.numupstreams; i++ )
+	{
+		if( tvs.upstreams[i] )
+			TV_Workers_RunRelayFrame( &tvs.upstreams[i]->relay );
+	}
+	TV_Workers_Complete();
+
+	for( i = 0; i < tvs.numupstreams; i++ )
+	{
+		if( tvs.upstreams[i] )
+			TV_Upstream_EndFrame( tvs.upstreams[i] );
+	}
+
 	TV_Downstream_ReadPackets();
 	TV_Downstream_SendClientMessages();
 	TV_Downstream_CheckTimeouts();
@@ -243,6 +264,9 @@ void TV_Frame( int realmsec, int gamemsec )
 
 	TV_Downstream_MasterHeartbeat();
 
+	// release this frame's scratch memory
+	Mem_ResetFrameArena();
+
 	Sys_Sleep( 5 );
 }
 
@@ -266,6 +290,8 @@ void TV_Shutdown( const char *finalmsg )
 	tvs.upstreams = NULL;
 	tvs.numupstreams = 0;
 
+	TV_Workers_Shutdown();
+
 	TV_RemoveCommands();
 }
 
@@ -81,9 +81,6 @@ static int TVM_Chase_FindFollowPOV( edict_t *ent )
 	int newpov = -1;
 	tvm_relay_t *relay = ent->relay;
 	edict_t *target;
-	static int ctfpov = -1, poweruppov = -1;
-	static unsigned int flagswitchTime = 0;
-	static unsigned int pwupswitchTime = 0;
 #define CARRIERSWITCHDELAY 8000
 
 	if( !ent->r.client || !ent->r.client->chase.active || !ent->r.client->chase.followmode )
@@ -116,10 +113,10 @@ static int TVM_Chase_FindFollowPOV( edict_t *ent )
 		if( !TVM_Chase_IsValidTarget( ent, target ) )
 		{
 			// check if old targets are still valid
-			if( ctfpov == ENTNUM( target ) )
-				ctfpov = -1;
-			if( poweruppov == ENTNUM( target ) )
-				poweruppov = -1;
+			if( relay->autochase.ctfpov == ENTNUM( target ) )
+				relay->autochase.ctfpov = -1;
+			if( relay->autochase.poweruppov == ENTNUM( target ) )
+				relay->autochase.poweruppov = -1;
 			continue;
 		}
 		if( target->s.team <= 0 || target->s.team >= sizeof( flags ) / sizeof( flags[0] ) )
@@ -167,14 +164,14 @@ static int TVM_Chase_FindFollowPOV( edict_t *ent )
 	if( i < maxteam )
 	{
 		// default to old ctfpov
-		if( ctfpov >= 0 )
-			newctfpov = ctfpov;
-		if( ctfpov < 0 || relay->serverTime > flagswitchTime )
+		if( relay->autochase.ctfpov >= 0 )
+			newctfpov = relay->autochase.ctfpov;
+		if( relay->autochase.ctfpov < 0 || relay->serverTime > relay->autochase.flagswitchTime )
 		{
 			// alternate between flag carriers
 			for( i = 0; i < maxteam; i++ )
 			{
-				if( flags[i] != ctfpov )
+				if( flags[i] != relay->autochase.ctfpov )
 					continue;
 
 				for( j = 0; j < maxteam-1; j++ )
@@ -189,37 +186,37 @@ static int TVM_Chase_FindFollowPOV( edict_t *ent )
 			}
 		}
 
-		if( newctfpov != ctfpov )
+		if( newctfpov != relay->autochase.ctfpov )
 		{
-			ctfpov = newctfpov;
-			flagswitchTime = relay->serverTime + CARRIERSWITCHDELAY;
+			relay->autochase.ctfpov = newctfpov;
+			relay->autochase.flagswitchTime = relay->serverTime + CARRIERSWITCHDELAY;
 		}
 	}
 	else
 	{
-		ctfpov = newctfpov;
-		flagswitchTime = 0;
+		relay->autochase.ctfpov = newctfpov;
+		relay->autochase.flagswitchTime = 0;
 	}
 
 	if( quad != -1 && warshell != -1 && quad != warshell )
 	{
 		// default to old powerup
-		if( poweruppov >= 0 )
-			newpoweruppov = poweruppov;
-		if( poweruppov < 0 || relay->serverTime > pwupswitchTime )
+		if( relay->autochase.poweruppov >= 0 )
+			newpoweruppov = relay->autochase.poweruppov;
+		if( relay->autochase.poweruppov < 0 || relay->serverTime > relay->autochase.pwupswitchTime )
 		{
-			if( poweruppov == quad )
+			if( relay->autochase.poweruppov == quad )
 				newpoweruppov = warshell;
-			else if( poweruppov == warshell )
+			else if( relay->autochase.poweruppov == warshell )
 				newpoweruppov = quad;
 			else 
 				newpoweruppov = ( rand() & 1 ) ? quad : warshell;
 		}
 
-		if( poweruppov != newpoweruppov )
+		if( relay->autochase.poweruppov != newpoweruppov )
 		{
-			poweruppov = newpoweruppov;
-			pwupswitchTime = relay->serverTime + CARRIERSWITCHDELAY;
+			relay->autochase.poweruppov = newpoweruppov;
+			relay->autochase.pwupswitchTime = relay->serverTime + CARRIERSWITCHDELAY;
 		}
 	}
 	else
@@ -231,15 +228,15 @@ static int TVM_Chase_FindFollowPOV( edict_t *ent )
 		else if( regen != -1 )
 			newpoweruppov = regen;
 
-		poweruppov = newpoweruppov;
-		pwupswitchTime = 0;
+		relay->autochase.poweruppov = newpoweruppov;
+		relay->autochase.pwupswitchTime = 0;
 	}
 
 	// so, we got all, select what we prefer to show
-	if( ctfpov != -1 && ( ent->r.client->chase.followmode & 4 ) )
-		newpov = ctfpov;
-	else if( poweruppov != -1 && ( ent->r.client->chase.followmode & 2 ) )
-		newpov = poweruppov;
+	if( relay->autochase.ctfpov != -1 && ( ent->r.client->chase.followmode & 4 ) )
+		newpov = relay->autochase.ctfpov;
+	else if( relay->autochase.poweruppov != -1 && ( ent->r.client->chase.followmode & 2 ) )
+		newpov = relay->autochase.poweruppov;
 	else if( scorelead != -1 && ( ent->r.client->chase.followmode & 1 ) )
 		newpov = scorelead;
 
@@ -320,7 +320,7 @@ static void TVM_ClientMakePlrkeys( gclient_t *client, usercmd_t *ucmd )
 void TVM_ClientThink( tvm_relay_t *relay, edict_t *ent, usercmd_t *ucmd, int timeDelta )
 {
 	gclient_t *client;
-	static pmove_t pm;
+	pmove_t pm;
 
 	assert( ent && ent->local && ent->r.client );
 	assert( ucmd );
@@ -77,6 +77,14 @@ struct tvm_relay_s
 	{
 		int quad, shell, regen, enemy_flag;
 	} effects;
+
+	// automatic chasecam targets, see TVM_Chase_FindFollowPOV
+	struct
+	{
+		int ctfpov, poweruppov;
+		unsigned int flagswitchTime;
+		unsigned int pwupswitchTime;
+	} autochase;
 };
 
 typedef struct
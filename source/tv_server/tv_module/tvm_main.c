@@ -135,6 +135,7 @@ tvm_relay_t *TVM_InitRelay( relay_t *relay_server, unsigned int snapFrameTime, i
 	relay->server = relay_server;
 	relay->playernum = playernum;
 	relay->snapFrameTime = snapFrameTime;
+	relay->autochase.ctfpov = relay->autochase.poweruppov = -1;
 
 	// initialize all entities for this game
 	relay->maxentities = MAX_EDICTS;
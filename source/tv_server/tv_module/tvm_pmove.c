@@ -35,8 +35,14 @@ typedef struct
 	float forwardPush, sidePush, upPush;
 } pml_t;
 
-pmove_t	*pm;
-pml_t pml;
+// relays may run their frames on several threads at once
+#ifdef ATTRIBUTE_THREAD_LOCAL
+static ATTRIBUTE_THREAD_LOCAL pmove_t *pm;
+static ATTRIBUTE_THREAD_LOCAL pml_t pml;
+#else
+static pmove_t *pm;
+static pml_t pml;
+#endif
 
 vec3_t playerbox_stand_mins = { -16, -16, -24 };
 vec3_t playerbox_stand_maxs = { 16, 16, 40 };
@@ -28,11 +28,6 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "tv_relay_client.h"
 #include "tv_downstream.h"
 
-#include <setjmp.h>
-
-// for jumping over relay handling when it's disconnected
-jmp_buf relay_abortframe;
-
 /*
 * TV_Relay_RunSnap
 */
@@ -172,7 +167,7 @@ void TV_Relay_Error( relay_t *relay, const char *format, ... )
 	va_end( argptr );
 
 	TV_Relay_Shutdown( relay, "%s", msg );
-	longjmp( relay_abortframe, -1 );
+	longjmp( relay->abortframe, -1 );
 }
 
 /*
@@ -195,6 +190,19 @@ void TV_Relay_Shutdown( relay_t *relay, const char *format, ... )
 	Q_vsnprintfz( msg, sizeof( msg ), format, argptr );
 	va_end( argptr );
 
+	// the clients of other relays are touched, leave it to the main thread
+	if( relay->onworker )
+	{
+		if( !relay->shutdownPending )
+		{
+			relay->shutdownPending = true;
+			Q_strncpyz( relay->shutdownReason, msg, sizeof( relay->shutdownReason ) );
+		}
+		return;
+	}
+
+	relay->shutdownPending = false;
+
 	Com_Printf( "%s" S_COLOR_WHITE ": Relay shutdown: %s\n", relay->upstream->name, msg );
 
 	// send a message to each connected client
@@ -236,6 +244,10 @@ void TV_Relay_Shutdown( relay_t *relay, const char *format, ... )
 		memset( &relay->client_entities, 0, sizeof( relay->client_entities ) );
 	}
 
+	SNAP_FreeDeltaCache( &relay->deltaCache );
+	SNAP_FreeFrameCache( &relay->frameCache );
+	SNAP_FreeVisCache( &relay->fatvis.viscache );
+
 	CM_ReleaseReference( relay->cms );
 	relay->cms = NULL;
 
@@ -388,8 +400,9 @@ static void TV_Relay_ReadPackets( relay_t *relay )
 void TV_Relay_Run( relay_t *relay, int msec )
 {
 	relay->realtime += msec;
+	relay->runFrame = false;
 
-	if( setjmp( relay_abortframe ) )  // disconnect while running
+	if( setjmp( relay->abortframe ) )  // disconnect while running
 		return;
 
 	relay->serverTime = relay->realtime + relay->serverTimeDelta;
@@ -398,19 +411,59 @@ void TV_Relay_Run( relay_t *relay, int msec )
 	if( relay->state <= CA_DISCONNECTED )
 		return;
 
-	if( TV_Relay_RunSnap( relay ) )
+	relay->runFrame = TV_Relay_RunSnap( relay );
+}
+
+/*
+* TV_Relay_RunFrame
+*
+* Runs the module on the new snapshot and sends it to the clients. May be
+* called on a worker thread, so it must only touch this relay and its clients.
+*/
+void TV_Relay_RunFrame( relay_t *relay )
+{
+	if( !relay->runFrame )
+		return;
+	relay->runFrame = false;
+
+	if( setjmp( relay->abortframe ) )
 	{
-		relay->module_export->RunFrame( relay->module, relay->realtime - relay->lastrun );
-		relay->lastrun = relay->realtime;
+		// after TV_Relay_Error the relay is already down and this does nothing,
+		// but an ERR_DROP on a worker thread lands here directly
+		TV_Relay_Shutdown( relay, "Relay frame aborted" );
+		return;
+	}
+
+	relay->module_export->RunFrame( relay->module, relay->realtime - relay->lastrun );
+	relay->lastrun = relay->realtime;
 
-		relay->module_export->NewFrameSnapshot( relay->module, relay->curFrame );
-		relay->module_export->SnapFrame( relay->module );
+	relay->module_export->NewFrameSnapshot( relay->module, relay->curFrame );
+	relay->module_export->SnapFrame( relay->module );
 
-		TV_Relay_SendClientMessages( relay );
+	TV_Relay_SendClientMessages( relay );
 
-		relay->module_export->ClearSnap( relay->module );
+	relay->module_export->ClearSnap( relay->module );
+}
+
+/*
+* TV_Relay_EndFrame
+*
+* Called on the main thread once the relay frames are done
+*/
+void TV_Relay_EndFrame( relay_t *relay )
+{
+	tvs.nummvclients -= relay->droppedmvclients;
+	relay->droppedmvclients = 0;
+
+	if( relay->shutdownPending )
+	{
+		TV_Relay_Shutdown( relay, "%s", relay->shutdownReason );
+		return;
 	}
 
+	if( relay->state <= CA_DISCONNECTED )
+		return;
+
 	if( relay->upstream->state == CA_DISCONNECTED && relay->packetqueue_pos == relay->upstream->packetqueue_head )
 		TV_Relay_Shutdown( relay, "Out of data" );
 }
@@ -442,6 +495,9 @@ void TV_Relay_Init( relay_t *relay, upstream_t *upstream, int delay )
 
 	relay->client_entities.num_entities = tv_maxclients->integer * UPDATE_BACKUP * MAX_SNAP_ENTITIES;
 	relay->client_entities.entities = Mem_Alloc( upstream->mempool, sizeof( entity_state_t ) * relay->client_entities.num_entities );
+	relay->deltaCache = SNAP_CreateDeltaCache( upstream->mempool );
+	relay->frameCache = SNAP_CreateFrameCache( upstream->mempool );
+	relay->fatvis.viscache = SNAP_CreateVisCache( upstream->mempool );
 
 	relay->cms = CM_New( upstream->mempool );
 	CM_AddReference( relay->cms );
@@ -23,6 +23,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "tv_local.h"
 
+#include <setjmp.h>
+
 #define EDICT_NUM( u, n ) ( (edict_t *)( (uint8_t *)u->gi.edicts + u->gi.edict_size*( n ) ) )
 #define NUM_FOR_EDICT( u, e ) ( ( (uint8_t *)( e )-(uint8_t *)u->gi.edicts ) / u->gi.edict_size )
 
@@ -54,6 +56,7 @@ typedef struct fatvis_s
 	vec_t *skyorg;
 	uint8_t pvs[MAX_MAP_LEAFS/8];
 	uint8_t phs[MAX_MAP_LEAFS/8];
+	snap_viscache_t *viscache;		// culled entity lists shared by clients with the same view
 } fatvis_t;
 
 typedef struct client_entities_s
@@ -63,6 +66,18 @@ typedef struct client_entities_s
 	entity_state_t *entities;			// [num_entities]
 } client_entities_t;
 
+#define TV_RELAY_MAX_SNAPGROUPS		32
+
+// spectators whose multiview frames are built from the same inputs share the frame
+typedef struct
+{
+	unsigned int shareKey;
+	bool noedict;
+	entity_state_t s;
+	unsigned int svflags;
+	player_state_t ps;
+} relay_snapgroup_t;
+
 struct relay_s
 {
 	connstate_t state;
@@ -104,6 +119,22 @@ struct relay_s
 	unsigned int framenum;
 
 	client_entities_t client_entities;
+	snap_deltacache_t *deltaCache;          // entity deltas shared between downstream clients
+	snap_framecache_t *frameCache;          // whole frames shared between downstream clients
+
+	relay_snapgroup_t snapGroups[TV_RELAY_MAX_SNAPGROUPS];
+	int numSnapGroups;                      // groups of the current send pass
+	unsigned int snapShareKey;              // last given out share key
+
+	uint64_t sendTime;                      // microseconds spent sending client messages
+	unsigned int sendFrames;
+
+	jmp_buf abortframe;                     // for jumping over relay handling when it's disconnected
+	bool runFrame;                          // a new snapshot is waiting for TV_Relay_RunFrame
+	bool onworker;                          // running TV_Relay_RunFrame on a worker thread
+	bool shutdownPending;                   // shut down on a worker thread, see TV_Relay_EndFrame
+	char shutdownReason[MAX_STRING_CHARS];
+	int droppedmvclients;                   // multiview clients dropped on a worker thread
 
 	// serverdata
 	int playernum;
@@ -122,6 +153,8 @@ void TV_Relay_InitMap( relay_t *relay );
 void TV_Relay_Error( relay_t *relay, const char *format, ... );
 void TV_Relay_Shutdown( relay_t *relay, const char *format, ... );
 void TV_Relay_Run( relay_t *relay, int msec );
+void TV_Relay_RunFrame( relay_t *relay );
+void TV_Relay_EndFrame( relay_t *relay );
 void TV_Relay_UpstreamUserinfoChanged( relay_t *relay );
 int TV_Relay_NumPlayers( relay_t *relay );
 void TV_Relay_NameNotify( relay_t *relay, client_t *client );
@@ -25,6 +25,56 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "tv_relay.h"
 #include "tv_downstream.h"
 
+/*
+* TV_Relay_ShareClientFrame
+*
+* The only per-spectator inputs of a multiview frame are the state of the edict
+* the spectator is given, everything else is the same for all spectators of the
+* relay. Spectators with equal inputs get the same share key for this frame.
+*/
+static void TV_Relay_ShareClientFrame( relay_t *relay, client_t *client, client_snapshot_t *frame )
+{
+	int i;
+	relay_snapgroup_t *group;
+	edict_t *ent = client->edict;
+
+	for( i = 0, group = relay->snapGroups; i < relay->numSnapGroups; i++, group++ )
+	{
+		if( !ent )
+		{
+			if( group->noedict )
+				break;
+			continue;
+		}
+
+		if( !group->noedict && group->svflags == ent->r.svflags &&
+			!memcmp( &group->s, &ent->s, sizeof( entity_state_t ) ) &&
+			!memcmp( &group->ps, &ent->r.client->ps, sizeof( player_state_t ) ) )
+			break;
+	}
+
+	if( i == relay->numSnapGroups )
+	{
+		if( relay->numSnapGroups == TV_RELAY_MAX_SNAPGROUPS )
+			return;
+
+		group = &relay->snapGroups[relay->numSnapGroups++];
+		memset( group, 0, sizeof( *group ) );
+		if( !++relay->snapShareKey )
+			relay->snapShareKey++;
+		group->shareKey = relay->snapShareKey;
+		group->noedict = ent ? false : true;
+		if( ent )
+		{
+			group->s = ent->s;
+			group->svflags = ent->r.svflags;
+			group->ps = ent->r.client->ps;
+		}
+	}
+
+	frame->shareKey = group->shareKey;
+}
+
 /*
 * TV_Relay_BuildClientFrameSnap
 */
@@ -34,6 +84,7 @@ void TV_Relay_BuildClientFrameSnap( relay_t *relay, client_t *client )
 	entity_state_t backup_state = { 0 };
 	entity_shared_t backup_shared = { 0 };
 	vec_t *skyorg = NULL, origin[3];
+	client_snapshot_t *frame;
 
 	if( relay->configstrings[CS_SKYBOX][0] != '\0' )
 	{
@@ -76,12 +127,18 @@ void TV_Relay_BuildClientFrameSnap( relay_t *relay, client_t *client )
 		}
 	}
 
+	frame = &client->snapShots[relay->framenum & UPDATE_MASK];
+	frame->shareKey = 0;
+
 	relay->fatvis.skyorg = skyorg;		// HACK HACK HACK
 	SNAP_BuildClientFrameSnap( relay->cms, &relay->gi, relay->framenum, relay->realtime, &relay->fatvis,
 		client, relay->module_export->GetGameState( relay->module ),
 		&relay->client_entities,
 		true, tv_mempool );
 
+	if( client->mv && ( !client->edict || client->edict->r.client ) )
+		TV_Relay_ShareClientFrame( relay, client, frame );
+
 	if( relay->playernum >= 0 )
 	{
 		client->edict->s = backup_state;
@@ -95,15 +152,17 @@ void TV_Relay_BuildClientFrameSnap( relay_t *relay, client_t *client )
 */
 static bool TV_Relay_SendClientDatagram( relay_t *relay, client_t *client )
 {
-	uint8_t msg_buf[MAX_MSGLEN];
+	uint8_t *msg_buf;
 	msg_t msg;
 	snapshot_t *frame;
+	bool sent;
 
 	assert( relay );
 	assert( client );
 	assert( relay == client->relay );
 
-	TV_Downstream_InitClientMessage( client, &msg, msg_buf, sizeof( msg_buf ) );
+	msg_buf = ( uint8_t * )Mem_FrameMallocExt( MAX_MSGLEN, 0 );
+	TV_Downstream_InitClientMessage( client, &msg, msg_buf, MAX_MSGLEN );
 
 	TV_Downstream_AddReliableCommandsToMessage( client, &msg );
 
@@ -113,9 +172,14 @@ static bool TV_Relay_SendClientDatagram( relay_t *relay, client_t *client )
 
 	frame = relay->curFrame;
 	SNAP_WriteFrameSnapToClient( &relay->gi, client, &msg, relay->framenum, relay->serverTime, relay->baselines,
-		&relay->client_entities, frame->numgamecommands, frame->gamecommands, frame->gamecommandsData );
+		&relay->client_entities, frame->numgamecommands, frame->gamecommands, frame->gamecommandsData, relay->deltaCache,
+		relay->frameCache );
 
-	return TV_Downstream_SendMessageToClient( client, &msg );
+	sent = TV_Downstream_SendMessageToClient( client, &msg );
+
+	Mem_FrameFree( msg_buf );
+
+	return sent;
 }
 
 /*
@@ -168,9 +232,13 @@ void TV_Relay_SendClientMessages( relay_t *relay )
 {
 	int i;
 	client_t *client;
+	uint64_t start;
 
 	assert( relay );
 
+	start = Sys_Microseconds();
+	relay->numSnapGroups = 0;
+
 	// send a message to each connected client
 	for( i = 0, client = tvs.clients; i < tv_maxclients->integer; i++, client++ )
 	{
@@ -188,7 +256,18 @@ void TV_Relay_SendClientMessages( relay_t *relay )
 					NET_ErrorString() );
 			}
 		}
+		else if( client->stress )
+		{
+			// simulated spectators ack right away, except for some lost packets
+			if( ( relay->framenum + i ) % 8 )
+				client->lastframe = client->lastSentFrameNum;
+			client->reliableAcknowledge = client->reliableSent;
+			client->lastPacketReceivedTime = tvs.realtime;
+		}
 	}
+
+	relay->sendTime += Sys_Microseconds() - start;
+	relay->sendFrames++;
 }
 
 /*
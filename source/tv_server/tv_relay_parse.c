@@ -35,7 +35,7 @@ static void TV_Relay_ParseFrame( relay_t *relay, msg_t *msg )
 {
 	snapshot_t *snap;
 
-	snap = SNAP_ParseFrame( msg, relay->lastFrame, NULL, relay->frames, relay->baselines, 0 );
+	snap = SNAP_ParseFrame( msg, relay->lastFrame, NULL, relay->frames, relay->baselines, 0, NULL );
 
 	// ignore older than already received
 	if( relay->lastFrame && snap->serverFrame <= relay->lastFrame->serverFrame )
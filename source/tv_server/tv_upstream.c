@@ -165,7 +165,7 @@ static void TV_Upstream_Netchan_Transmit( upstream_t *upstream, msg_t *msg )
 
 	// do not enable client compression until I fix the compression+fragmentation rare case bug
 	/*if( cl_compresspackets->integer ) {
-	zerror = Netchan_CompressMessage( msg );
+	zerror = Netchan_CompressMessage( &upstream->netchan, msg );
 	if( zerror < 0 ) {  // it's compression error, just send uncompressed
 	Com_DPrintf( "TV_Upstream_Netchan_Transmit (ignoring compression): Compression error %i\n", zerror );
 	}
@@ -190,14 +190,11 @@ static bool TV_Upstream_ProcessPacket( netchan_t *netchan, msg_t *msg )
 	MSG_BeginReading( msg );
 	/*sequence = */MSG_ReadLong( msg );
 	/*sequence_ack = */MSG_ReadLong( msg );
-	if( msg->compressed )
-	{
-		zerror = Netchan_DecompressMessage( msg );
-		if( zerror < 0 )
-		{          // compression error. Drop the packet
-			Com_Printf( "Compression error %i. Dropping packet\n", zerror );
-			return false;
-		}
+	zerror = Netchan_DecompressMessage( netchan, msg );
+	if( zerror < 0 )
+	{          // compression error. Drop the packet
+		Com_Printf( "Compression error %i. Dropping packet\n", zerror );
+		return false;
 	}
 
 	return true;
@@ -830,8 +827,19 @@ void TV_Upstream_Run( upstream_t *upstream, int msec )
 	}
 
 	if( upstream->relay.state != CA_UNINITIALIZED )
-	{
 		TV_Relay_Run( &upstream->relay, msec );
+}
+
+/*
+* TV_Upstream_EndFrame
+*
+* Called once the relay frames are done
+*/
+void TV_Upstream_EndFrame( upstream_t *upstream )
+{
+	if( upstream->relay.state != CA_UNINITIALIZED )
+	{
+		TV_Relay_EndFrame( &upstream->relay );
 		TV_Upstream_FreePackets( upstream );
 	}
 
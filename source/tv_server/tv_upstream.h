@@ -97,6 +97,8 @@ struct upstream_s
 		int filelen;
 		char *filename, *tempname;
 		bool random;
+		snap_demokeyframe_t *keyframes;		// seek index of the demo being played
+		unsigned int numkeyframes;
 
 		time_t localtime;
 
@@ -119,6 +121,7 @@ void TV_Upstream_Shutdown( upstream_t *upstream, const char *format, ... );
 void TV_Upstream_ClearState( upstream_t *upstream );
 void TV_Upstream_AddReliableCommand( upstream_t *upstream, const char *cmd );
 void TV_Upstream_Run( upstream_t *upstream, int msec );
+void TV_Upstream_EndFrame( upstream_t *upstream );
 void TV_Upstream_SavePacket( upstream_t *upstream, msg_t *msg, int timeBias );
 void TV_Upstream_SendConnectPacket( upstream_t *upstream );
 void TV_Upstream_Connect( upstream_t *upstream, const char *servername, const char *password, socket_type_t type, netadr_t *address );
@@ -514,6 +514,84 @@ void TV_Upstream_NextDemo( const char *demoname, const char *curdemo, bool rando
 	Mem_TempFree( dir );
 }
 
+/*
+* TV_Upstream_LoadDemoKeyframes
+*/
+static void TV_Upstream_LoadDemoKeyframes( upstream_t *upstream )
+{
+	char *meta_data;
+	size_t meta_data_realsize;
+	snap_demokeyframe_t keyframes[SNAP_MAX_DEMO_KEYFRAMES];
+
+	if( !upstream->demo.filehandle )
+		return;
+
+	meta_data = Mem_TempMalloc( SNAP_MAX_DEMO_META_DATA_SIZE );
+	meta_data_realsize = SNAP_ReadDemoMetaData( upstream->demo.filehandle, meta_data, SNAP_MAX_DEMO_META_DATA_SIZE );
+	FS_Seek( upstream->demo.filehandle, 0, FS_SEEK_SET );
+
+	upstream->demo.numkeyframes = SNAP_ReadDemoMetaKeyframes( meta_data, meta_data_realsize, 
+		keyframes, SNAP_MAX_DEMO_KEYFRAMES );
+	if( upstream->demo.numkeyframes )
+	{
+		upstream->demo.keyframes = Mem_Alloc( upstream->mempool, sizeof( *keyframes ) * upstream->demo.numkeyframes );
+		memcpy( upstream->demo.keyframes, keyframes, sizeof( *keyframes ) * upstream->demo.numkeyframes );
+	}
+
+	Mem_TempFree( meta_data );
+}
+
+/*
+* TV_Upstream_DemoJump
+* 
+* Skips to the closest keyframe before the given time, in milliseconds from
+* the start of the demo. Relayed clients can't go back in time, so jumps
+* backwards are refused.
+*/
+bool TV_Upstream_DemoJump( upstream_t *upstream, unsigned int time, bool relative )
+{
+	unsigned int basetime, target;
+	const snap_demokeyframe_t *keyframe;
+
+	if( !upstream->demo.playing || !upstream->demo.filehandle )
+	{
+		Com_Printf( "%s: Not playing a demo\n", upstream->name );
+		return false;
+	}
+
+	if( !upstream->demo.numkeyframes )
+	{
+		Com_Printf( "%s: The demo has no seek index\n", upstream->name );
+		return false;
+	}
+
+	basetime = upstream->demo.keyframes[0].time;
+	if( relative )
+		time += upstream->serverTime > basetime ? upstream->serverTime - basetime : 0;
+
+	target = basetime + time;
+	if( target < upstream->serverTime )
+	{
+		Com_Printf( "%s: Can't jump backwards, relayed clients can't go back in time\n", upstream->name );
+		return false;
+	}
+
+	keyframe = SNAP_FindDemoKeyframe( upstream->demo.keyframes, upstream->demo.numkeyframes, target );
+	if( !keyframe || keyframe->time <= upstream->serverTime )
+	{
+		Com_Printf( "%s: No keyframe between the current position and the given time\n", upstream->name );
+		return false;
+	}
+
+	if( FS_Seek( upstream->demo.filehandle, keyframe->offset, FS_SEEK_SET ) < 0 )
+	{
+		TV_Upstream_Error( upstream, "Error seeking in demo file" );
+		return false;
+	}
+
+	return true;
+}
+
 /*
 * TV_Upstream_StartDemo
 */
@@ -544,6 +622,7 @@ void TV_Upstream_StartDemo( upstream_t *upstream, const char *demoname, bool ran
 	upstream->demo.filehandle = tempdemofilehandle;
 	upstream->demo.filelen = tempdemofilelen;
 	upstream->demo.random = randomize;
+	TV_Upstream_LoadDemoKeyframes( upstream );
 	upstream->state = CA_HANDSHAKE;
 	upstream->reliable = false;
 
@@ -576,6 +655,13 @@ void TV_Upstream_StopDemo( upstream_t *upstream )
 		upstream->demo.filename = NULL;
 	}
 
+	if( upstream->demo.keyframes )
+	{
+		Mem_Free( upstream->demo.keyframes );
+		upstream->demo.keyframes = NULL;
+	}
+	upstream->demo.numkeyframes = 0;
+
 	upstream->demo.filelen = 0;
 	upstream->demo.playing = false;
 }
@@ -31,5 +31,6 @@ void TV_Upstream_StopDemoRecord( upstream_t *upstream, bool silent, bool cancel
 
 void TV_Upstream_StartDemo( upstream_t *upstream, const char *demoname, bool randomize );
 void TV_Upstream_StopDemo( upstream_t *upstream );
+bool TV_Upstream_DemoJump( upstream_t *upstream, unsigned int time, bool relative );
 
 #endif // __TV_UPSTREAM_DEMOS_H
@@ -0,0 +1,112 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// tv_workers.c -- worker threads running the relay frames
+//
+// Each relay is pinned to a worker thread, which runs the module frame on the
+// relay's new snapshot and sends it to the relay's clients. Everything else,
+// upstream and downstream packets, commands and anything touching more than
+// one relay, stays on the main thread, which waits for the workers before
+// going on with the frame.
+
+#include "tv_local.h"
+
+#include "tv_workers.h"
+
+#include "tv_upstream.h"
+#include "tv_relay.h"
+
+static qjobpool_t *tv_worker_pool;
+
+/*
+* TV_Workers_Init
+*/
+void TV_Workers_Init( int numThreads )
+{
+	clamp( numThreads, 0, TV_MAX_WORKER_THREADS );
+	if( !numThreads )
+		return;
+
+	// errors on the worker threads need to unwind to the relay
+	if( !Com_SetThreadAbortFrame( NULL ) )
+	{
+		Com_Printf( "Worker threads are not supported on this platform\n" );
+		return;
+	}
+
+	// the workers release their compression state on exit
+	tv_worker_pool = QJobPool_Create( numThreads, Netchan_Shutdown );
+
+	Com_Printf( "Running relays on %i worker threads\n", numThreads );
+}
+
+/*
+* TV_Workers_RelayFrameJob
+*/
+static void TV_Workers_RelayFrameJob( unsigned first, unsigned items, unsigned thread, void *arg )
+{
+	relay_t *relay = arg;
+
+	relay->onworker = true;
+	Com_SetThreadAbortFrame( &relay->abortframe );
+
+	TV_Relay_RunFrame( relay );
+
+	Com_SetThreadAbortFrame( NULL );
+	relay->onworker = false;
+}
+
+/*
+* TV_Workers_RunRelayFrame
+*
+* Runs the relay frame on the relay's worker thread, or right away without workers
+*/
+void TV_Workers_RunRelayFrame( relay_t *relay )
+{
+	if( !relay->runFrame )
+		return;
+
+	if( !tv_worker_pool )
+	{
+		TV_Relay_RunFrame( relay );
+		return;
+	}
+
+	QJobPool_Run( tv_worker_pool, relay->upstream->number % QJobPool_NumThreads( tv_worker_pool ),
+		TV_Workers_RelayFrameJob, relay, 0, 1 );
+}
+
+/*
+* TV_Workers_Complete
+*
+* Blocks until all relay frames are done
+*/
+void TV_Workers_Complete( void )
+{
+	if( tv_worker_pool )
+		QJobPool_Complete( tv_worker_pool );
+}
+
+/*
+* TV_Workers_Shutdown
+*/
+void TV_Workers_Shutdown( void )
+{
+	QJobPool_Destroy( &tv_worker_pool );
+}
@@ -168,6 +168,8 @@ void Sys_Error( const char *format, ... )
 
 	fprintf( stderr, "Error: %s\n", string );
 
+	Com_FlushConsoleLog();
+
 	_exit( 1 );
 }
 
@@ -251,6 +253,15 @@ int Sys_GetCurrentProcessId( void )
 	return getpid();
 }
 
+/*
+* Sys_GetNumberOfProcessors
+*/
+int Sys_GetNumberOfProcessors( void )
+{
+	long n = sysconf( _SC_NPROCESSORS_ONLN );
+	return n > 0 ? (int)n : 1;
+}
+
 /*
 * Sys_GetPreferredLanguage
 */
@@ -80,6 +80,14 @@ void Sys_Mutex_Lock( qmutex_t *mutex )
 	pthread_mutex_lock( &mutex->m );
 }
 
+/*
+* Sys_Mutex_TryLock
+*/
+bool Sys_Mutex_TryLock( qmutex_t *mutex )
+{
+	return pthread_mutex_trylock( &mutex->m ) == 0;
+}
+
 /*
 * Sys_Mutex_Unlock
 */
@@ -127,6 +135,14 @@ void Sys_Thread_Yield( void )
 	sched_yield();
 }
 
+/*
+* Sys_Thread_Id
+*/
+uintptr_t Sys_Thread_Id( void )
+{
+	return ( uintptr_t )pthread_self();
+}
+
 /*
 * Sys_Atomic_Add
 */
@@ -143,6 +159,14 @@ bool Sys_Atomic_CAS( volatile int *value, int oldval, int newval, qmutex_t *mute
 	return __sync_bool_compare_and_swap( value, oldval, newval );
 }
 
+/*
+* Sys_Atomic_CASPtr
+*/
+bool Sys_Atomic_CASPtr( void * volatile *value, void *oldval, void *newval, qmutex_t *mutex )
+{
+	return __sync_bool_compare_and_swap( value, oldval, newval );
+}
+
 /*
 * Sys_CondVar_Create
 */
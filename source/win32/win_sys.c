@@ -77,6 +77,8 @@ void Sys_Error( const char *format, ... )
 	Q_vsnprintfz( msg, sizeof( msg ), format, argptr );
 	va_end( argptr );
 
+	Com_FlushConsoleLog();
+
 	MessageBox( NULL, msg, "Error", 0 /* MB_OK */ );
 
 	// shut down QHOST hooks if necessary
@@ -222,6 +224,17 @@ int Sys_GetCurrentProcessId( void )
 	return GetCurrentProcessId();
 }
 
+/*
+* Sys_GetNumberOfProcessors
+*/
+int Sys_GetNumberOfProcessors( void )
+{
+	SYSTEM_INFO sysInfo;
+
+	GetSystemInfo( &sysInfo );
+	return sysInfo.dwNumberOfProcessors > 0 ? (int)sysInfo.dwNumberOfProcessors : 1;
+}
+
 /*
 * Sys_GetPreferredLanguage
 * Get the preferred language through the MUI API. Works on Vista and newer.
@@ -81,6 +81,14 @@ void Sys_Mutex_Lock( qmutex_t *mutex )
 	EnterCriticalSection( &mutex->h );
 }
 
+/*
+* Sys_Mutex_TryLock
+*/
+bool Sys_Mutex_TryLock( qmutex_t *mutex )
+{
+	return TryEnterCriticalSection( &mutex->h ) != 0;
+}
+
 /*
 * Sys_Mutex_Unlock
 */
@@ -134,6 +142,14 @@ void Sys_Mutex_Lock( qmutex_t *mutex )
 	WaitForSingleObject( mutex->h, INFINITE );
 }
 
+/*
+* Sys_Mutex_TryLock
+*/
+bool Sys_Mutex_TryLock( qmutex_t *mutex )
+{
+	return WaitForSingleObject( mutex->h, 0 ) == WAIT_OBJECT_0;
+}
+
 /*
 * Sys_Mutex_Unlock
 */
@@ -184,6 +200,14 @@ void Sys_Thread_Yield( void )
 	Sys_Sleep( 0 );
 }
 
+/*
+* Sys_Thread_Id
+*/
+uintptr_t Sys_Thread_Id( void )
+{
+	return ( uintptr_t )GetCurrentThreadId();
+}
+
 /*
 * Sys_Atomic_Add
 */
@@ -200,6 +224,14 @@ bool Sys_Atomic_CAS( volatile int *value, int oldval, int newval, qmutex_t *mute
 	return InterlockedCompareExchange( (volatile LONG*)value, newval, oldval ) == oldval;
 }
 
+/*
+* Sys_Atomic_CASPtr
+*/
+bool Sys_Atomic_CASPtr( void * volatile *value, void *oldval, void *newval, qmutex_t *mutex )
+{
+	return InterlockedCompareExchangePointer( value, newval, oldval ) == oldval;
+}
+
 /*
 * Sys_CondVar_Create
 */